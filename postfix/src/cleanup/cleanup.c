@@ -45,6 +45,18 @@
 /*	to deal with the problem. Alternatively, the client can request
 /*	the \fBcleanup\fR(8) daemon to bounce the message back to the sender
 /*	in case of trouble.
+/*
+/*	When the program is invoked under the name \fBecleanup\fR
+/*	(Postfix 3.4 and later), one \fBcleanup\fR(8) process
+/*	serves many concurrent clients with an event loop, instead
+/*	of one client at a time. This reduces the number of
+/*	processes and their memory footprint on sites with many
+/*	simultaneous submissions. To enable, specify \fBecleanup\fR
+/*	as the command name of the \fBcleanup\fR service in
+/*	\fBmaster.cf\fR, with a process limit of about the number
+/*	of CPU cores. Table lookups, Milter requests and queue file
+/*	fsync() calls are still made synchronously, and therefore
+/*	briefly stall all sessions in the same process.
 /* STANDARDS
 /*	RFC 822 (ARPA Internet Text Messages)
 /*	RFC 2045 (MIME: Format of Internet Message Bodies)
@@ -195,6 +207,17 @@
 /*	Optional list of \fIname=value\fR pairs that specify default
 /*	values for arbitrary macros that Postfix may send to Milter
 /*	applications.
+/* .PP
+/*	Available in Postfix version 3.4 and later:
+/* .IP "\fBmilter_parallel_events (no)\fR"
+/*	Report envelope events to all Milter applications before
+/*	waiting for their replies.
+/* .IP "\fBmilter_connection_reuse (no)\fR"
+/*	Keep negotiated Milter connections open after an SMTP session
+/*	ends, and reuse them for later sessions.
+/* .IP "\fBmilter_body_cache_limit (10240000)\fR"
+/*	The maximal size of the message body copy that is kept in
+/*	memory while a message is sent to multiple Milter applications.
 /* MIME PROCESSING CONTROLS
 /* .ad
 /* .fi
@@ -444,12 +467,14 @@
 #include <signal.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* Utility library. */
 
 #include <msg.h>
 #include <vstring.h>
 #include <dict.h>
+#include <stringops.h>
 
 /* Global library. */
 
@@ -461,7 +486,7 @@
 #include <rec_type.h>
 #include <mail_version.h>
 
-/* Single-threaded server skeleton. */
+/* Single-threaded and event-driven server skeletons. */
 
 #include <mail_server.h>
 
@@ -584,6 +609,13 @@ static void pre_accept(char *unused_name, char **unused_argv)
     }
 }
 
+/* pre_exit - log Milter connection statistics */
+
+static void pre_exit(char *unused_name, char **unused_argv)
+{
+    milter8_conn_stats();
+}
+
 MAIL_VERSION_STAMP_DECLARE;
 
 /* main - the main program */
@@ -603,6 +635,25 @@ int     main(int argc, char **argv)
     signal(SIGTERM, cleanup_sig);
     msg_cleanup(cleanup_all);
 
+    /*
+     * Pass control to the event-driven service skeleton when this program is
+     * invoked under its event-driven personality name. Each process handles
+     * many clients, so there is no need for an unlimited process count.
+     */
+    if (strcmp(sane_basename((VSTRING *) 0, argv[0]), CLEANUP_EVENT_NAME) == 0)
+	event_server_main(argc, argv, cleanup_event_service,
+			  CA_MAIL_SERVER_INT_TABLE(cleanup_int_table),
+			  CA_MAIL_SERVER_BOOL_TABLE(cleanup_bool_table),
+			  CA_MAIL_SERVER_STR_TABLE(cleanup_str_table),
+			  CA_MAIL_SERVER_TIME_TABLE(cleanup_time_table),
+			  CA_MAIL_SERVER_PRE_INIT(cleanup_pre_jail),
+			  CA_MAIL_SERVER_POST_INIT(cleanup_event_post_jail),
+			  CA_MAIL_SERVER_PRE_ACCEPT(cleanup_event_pre_accept),
+			  CA_MAIL_SERVER_EXIT(pre_exit),
+			  CA_MAIL_SERVER_SLOW_EXIT(cleanup_event_drain),
+			  CA_MAIL_SERVER_IN_FLOW_DELAY,
+			  0);
+
     /*
      * Pass control to the single-threaded service skeleton.
      */
@@ -614,6 +665,7 @@ int     main(int argc, char **argv)
 		       CA_MAIL_SERVER_PRE_INIT(cleanup_pre_jail),
 		       CA_MAIL_SERVER_POST_INIT(cleanup_post_jail),
 		       CA_MAIL_SERVER_PRE_ACCEPT(pre_accept),
+		       CA_MAIL_SERVER_EXIT(pre_exit),
 		       CA_MAIL_SERVER_IN_FLOW_DELAY,
 		       CA_MAIL_SERVER_UNLIMITED,
 		       0);
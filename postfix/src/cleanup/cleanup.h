@@ -128,6 +128,13 @@ typedef struct CLEANUP_STATE {
     struct CLEANUP_REGION *body_regions;/* regions with body content */
     struct CLEANUP_REGION *curr_body_region;
 
+    /*
+     * Support for Milter header edit requests.
+     */
+    struct CLEANUP_HDR_POS *hdr_index;	/* header positions */
+    ssize_t hdr_index_len;		/* number of headers */
+    ssize_t hdr_index_size;		/* allocated entries */
+
     /*
      * Internationalization.
      */
@@ -218,6 +225,7 @@ extern void cleanup_all(void);
 extern void cleanup_sig(int);
 extern void cleanup_pre_jail(char *, char **);
 extern void cleanup_post_jail(char *, char **);
+extern MILTERS *cleanup_milters_create(void);
 extern const CONFIG_INT_TABLE cleanup_int_table[];
 extern const CONFIG_BOOL_TABLE cleanup_bool_table[];
 extern const CONFIG_STR_TABLE cleanup_str_table[];
@@ -225,6 +233,17 @@ extern const CONFIG_TIME_TABLE cleanup_time_table[];
 
 #define CLEANUP_RECORD(s, t, b, l)	((s)->action((s), (t), (b), (l)))
 
+ /*
+  * cleanup_event.c
+  */
+#define CLEANUP_EVENT_NAME	"ecleanup"	/* event-driven personality */
+
+extern void cleanup_event_service(VSTREAM *, char *, char **);
+extern void cleanup_event_post_jail(char *, char **);
+extern void cleanup_event_pre_accept(char *, char **);
+extern void cleanup_event_drain(char *, char **);
+extern void cleanup_event_remove(void);
+
  /*
   * cleanup_out.c
   */
@@ -324,6 +343,14 @@ extern void cleanup_milter_emul_mail(CLEANUP_STATE *, MILTERS *, const char *);
 extern void cleanup_milter_emul_rcpt(CLEANUP_STATE *, MILTERS *, const char *);
 extern void cleanup_milter_emul_data(CLEANUP_STATE *, MILTERS *);
 
+typedef struct CLEANUP_HDR_POS {
+    char   *name;			/* header label */
+    off_t   offset;			/* first header record */
+    off_t   ptr_offset;			/* pointer to offset, or 0 */
+} CLEANUP_HDR_POS;
+
+extern void cleanup_milter_hdr_index_free(CLEANUP_STATE *);
+
 #define CLEANUP_MILTER_OK(s) \
     (((s)->flags & CLEANUP_FLAG_MILTER) != 0 \
 	&& (s)->errs == 0 && ((s)->flags & CLEANUP_FLAG_DISCARD) == 0)
@@ -0,0 +1,654 @@
+/*++
+/* NAME
+/*	cleanup_event 3
+/* SUMMARY
+/*	event-driven cleanup service
+/* SYNOPSIS
+/*	#include "cleanup.h"
+/*
+/*	void	cleanup_event_service(src, service_name, argv)
+/*	VSTREAM	*src;
+/*	char	*service_name;
+/*	char	**argv;
+/*
+/*	void	cleanup_event_post_jail(service_name, argv)
+/*	char	*service_name;
+/*	char	**argv;
+/*
+/*	void	cleanup_event_pre_accept(service_name, argv)
+/*	char	*service_name;
+/*	char	**argv;
+/*
+/*	void	cleanup_event_drain(service_name, argv)
+/*	char	*service_name;
+/*	char	**argv;
+/*
+/*	void	cleanup_event_remove()
+/* DESCRIPTION
+/*	This module implements the event-driven personality of the
+/*	cleanup server. One process receives many messages at the
+/*	same time, so that lookup tables, compiled header_checks
+/*	and body_checks patterns, and Milter connections are shared
+/*	among concurrent clients instead of being instantiated once
+/*	per cleanup process.
+/*
+/*	Each client connection has its own CLEANUP_STATE. The
+/*	process waits for client input with the event_server(3)
+/*	event loop, and passes a record to the cleanup_api(3) routines
+/*	only when the entire record has arrived. Thus, a slow client
+/*	never stops the processing of other messages. Work that
+/*	happens after a record has arrived (table lookups, Milter
+/*	requests, and the final fsync() of the queue file) is still
+/*	done synchronously, in the order that records arrive.
+/*
+/*	The cleanup_api(3) routines keep some per-message information
+/*	in global variables: the queue file names that must be removed
+/*	after a fatal error, and the non_smtpd_milters instance.
+/*	This module saves those variables with each client session,
+/*	and restores them before the session's records are processed.
+/*
+/*	cleanup_event_service() opens a queue file, sends the queue
+/*	ID to the client, and arranges for the client's processing
+/*	options and message records to be processed as they arrive.
+/*	This function satisfies the interface as specified in
+/*	event_server(3).
+/*
+/*	cleanup_event_post_jail() performs the initializations of
+/*	cleanup_post_jail(), and sets up the non_smtpd_milters instance
+/*	for use by the first client session.
+/*
+/*	cleanup_event_pre_accept() finishes existing client sessions
+/*	in the background, after a lookup table has changed.
+/*
+/*	cleanup_event_drain() finishes existing client sessions in
+/*	the background, after "postfix reload".
+/*
+/*	cleanup_event_remove() removes the incomplete queue files
+/*	of client sessions that are waiting for input. This function
+/*	is called by cleanup_sig(), and is safe to call from a signal
+/*	handler.
+/* DIAGNOSTICS
+/*	Problems and transactions are logged to \fBsyslogd\fR(8).
+/* BUGS
+/*	A client that sends only part of a record stalls nothing but
+/*	its own session, but a slow Milter application or lookup
+/*	table stalls all sessions that are handled by the same
+/*	process.
+/* SEE ALSO
+/*	cleanup_api(3), cleanup callable interface
+/*	event_server(3), event-driven server skeleton
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifndef NBBY
+#define NBBY 8				/* XXX should be in sys_defs.h */
+#endif
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <vstring.h>
+#include <vstream.h>
+#include <events.h>
+#include <iostuff.h>
+#include <dict.h>
+
+/* Global library. */
+
+#include <cleanup_user.h>
+#include <mail_proto.h>
+#include <mail_params.h>
+#include <record.h>
+#include <rec_type.h>
+
+/* Master process interface. */
+
+#include <mail_server.h>
+
+/* Milter library. */
+
+#include <milter.h>
+
+/* Application-specific. */
+
+#include "cleanup.h"
+
+ /*
+  * Per-client session state. The path, trace_path and milters fields hold
+  * the values of the cleanup_path, cleanup_trace_path and cleanup_milters
+  * global variables while the session is waiting for input. At any point
+  * in time a queue file name is stored in exactly one place, so that
+  * cleanup_sig() will remove it exactly once.
+  */
+typedef struct CLEANUP_SESS {
+    VSTREAM *src;			/* client stream */
+    CLEANUP_STATE *state;		/* per-message state */
+    VSTRING *buf;			/* record buffer */
+    VSTRING *inbuf;			/* client input, not yet consumed */
+    ssize_t inpos;			/* read offset in inbuf */
+    int     phase;			/* see below */
+    int     type;			/* last record type */
+    int     flags;			/* see below */
+    char   *path;			/* saved cleanup_path */
+    VSTRING *trace_path;		/* saved cleanup_trace_path */
+    MILTERS *milters;			/* saved cleanup_milters */
+    struct CLEANUP_SESS *prev;		/* active session list */
+    struct CLEANUP_SESS *next;		/* active or free session list */
+} CLEANUP_SESS;
+
+#define CLEANUP_SESS_PHASE_FLAGS	1	/* expect processing options */
+#define CLEANUP_SESS_PHASE_RECORDS	2	/* expect message records */
+#define CLEANUP_SESS_PHASE_SKIP		3	/* skip records after error */
+#define CLEANUP_SESS_PHASE_DONE		4	/* report status and close */
+
+#define CLEANUP_SESS_FLAG_EOF		(1<<0)	/* no more client input */
+#define CLEANUP_SESS_FLAG_TIMEOUT	(1<<1)	/* client input timeout */
+
+#define CLEANUP_SESS_INPUT_DONE(s) \
+	((s)->flags & (CLEANUP_SESS_FLAG_EOF | CLEANUP_SESS_FLAG_TIMEOUT))
+
+ /*
+  * Private result from cleanup_event_rec_get(), not a record type.
+  */
+#define CLEANUP_SESS_REC_WAIT		(-100)
+
+static CLEANUP_SESS *cleanup_event_active;	/* sessions in progress */
+static CLEANUP_SESS *cleanup_event_free;	/* sessions for reuse */
+static MILTERS *cleanup_event_milters;	/* from cleanup_pre_jail() */
+
+#define STR(x)	vstring_str(x)
+#define LEN(x)	VSTRING_LEN(x)
+
+static void cleanup_event_read(int, void *);
+
+/* cleanup_event_read_fn - read pre-fetched client input first */
+
+static ssize_t cleanup_event_read_fn(int fd, void *buf, size_t len,
+				             int timeout, void *context)
+{
+    CLEANUP_SESS *sess = (CLEANUP_SESS *) context;
+    ssize_t count = LEN(sess->inbuf) - sess->inpos;
+
+    /*
+     * Client input that was read ahead by cleanup_event_fill() must be
+     * consumed before anything else. Otherwise, read from the client
+     * directly. This happens only while the client is known to send a
+     * complete request, such as the Milter information that follows a
+     * REC_TYPE_MILT_COUNT record, or after the client has disconnected.
+     */
+    if (count > 0) {
+	if (count > len)
+	    count = len;
+	memcpy(buf, STR(sess->inbuf) + sess->inpos, count);
+	sess->inpos += count;
+	return (count);
+    }
+    return (timed_read(fd, buf, len, timeout, (void *) 0));
+}
+
+/* cleanup_event_fill - read available client input without blocking */
+
+static void cleanup_event_fill(CLEANUP_SESS *sess)
+{
+    ssize_t count;
+    ssize_t len;
+
+    /*
+     * Discard consumed input, so that the buffer grows no larger than the
+     * largest record.
+     */
+    if (sess->inpos > 0) {
+	vstring_truncate(sess->inbuf, -(LEN(sess->inbuf) - sess->inpos));
+	sess->inpos = 0;
+    }
+
+    /*
+     * The client socket is readable, therefore read() will not block.
+     */
+    len = LEN(sess->inbuf);
+    VSTRING_SPACE(sess->inbuf, VSTREAM_BUFSIZE);
+    count = read(vstream_fileno(sess->src), STR(sess->inbuf) + len,
+		 VSTREAM_BUFSIZE);
+    if (count > 0) {
+	VSTRING_AT_OFFSET(sess->inbuf, len + count);
+    } else if (count == 0 || (errno != EAGAIN && errno != EINTR)) {
+	sess->flags |= CLEANUP_SESS_FLAG_EOF;
+    }
+}
+
+/* cleanup_event_peek - look ahead at unconsumed client input */
+
+static int cleanup_event_peek(CLEANUP_SESS *sess, ssize_t off)
+{
+    ssize_t count = vstream_peek(sess->src);
+
+    /*
+     * Unconsumed input is stored in the VSTREAM buffer, followed by input
+     * that is stored in the read-ahead buffer.
+     */
+    if (off < count)
+	return ((unsigned char) vstream_peek_data(sess->src)[off]);
+    off -= count;
+    if (off < LEN(sess->inbuf) - sess->inpos)
+	return ((unsigned char) STR(sess->inbuf)[sess->inpos + off]);
+    return (-1);
+}
+
+/* cleanup_event_rec_ready - does the client input contain a full record */
+
+static int cleanup_event_rec_ready(CLEANUP_SESS *sess)
+{
+    ssize_t len;
+    ssize_t off;
+    unsigned shift;
+    int     len_byte;
+
+    /*
+     * Decode the record type and length as in rec_get_raw(). A malformed
+     * length is reported as ready, so that rec_get_raw() can complain.
+     */
+    if (cleanup_event_peek(sess, 0) < 0)
+	return (0);
+    for (len = 0, shift = 0, off = 1; /* void */ ; shift += 7, off++) {
+	if (shift >= (int) (NBBY * sizeof(int)))
+	    return (1);
+	if ((len_byte = cleanup_event_peek(sess, off)) < 0)
+	    return (0);
+	len |= (len_byte & 0177) << shift;
+	if ((len_byte & 0200) == 0)
+	    break;
+    }
+    return (len < 0 || cleanup_event_peek(sess, off + len) >= 0);
+}
+
+/* cleanup_event_attr_ready - does the client input contain an attribute list */
+
+static int cleanup_event_attr_ready(CLEANUP_SESS *sess)
+{
+    ssize_t off = 0;
+    int     ch;
+
+    /*
+     * XXX This knows that attr_print0() sends each attribute as a
+     * null-terminated name and a null-terminated value, and terminates the
+     * list with a null byte.
+     */
+    for (;;) {
+	if ((ch = cleanup_event_peek(sess, off++)) <= 0)
+	    return (ch == 0);
+	while ((ch = cleanup_event_peek(sess, off++)) != 0)
+	    if (ch < 0)
+		return (0);
+	while ((ch = cleanup_event_peek(sess, off++)) != 0)
+	    if (ch < 0)
+		return (0);
+    }
+}
+
+/* cleanup_event_rec_get - read one record, if available */
+
+static int cleanup_event_rec_get(CLEANUP_SESS *sess)
+{
+    if (sess->flags & CLEANUP_SESS_FLAG_TIMEOUT)
+	return (REC_TYPE_EOF);
+    if (CLEANUP_SESS_INPUT_DONE(sess) == 0 && !cleanup_event_rec_ready(sess))
+	return (CLEANUP_SESS_REC_WAIT);
+    return (rec_get_raw(sess->src, sess->buf, 0, REC_FLAG_NONE));
+}
+
+/* cleanup_event_swap_in - restore per-session global state */
+
+static void cleanup_event_swap_in(CLEANUP_SESS *sess)
+{
+    if (cleanup_path != 0 || cleanup_trace_path != 0)
+	msg_panic("cleanup_event_swap_in: global state is in use");
+    cleanup_path = sess->path;
+    sess->path = 0;
+    cleanup_trace_path = sess->trace_path;
+    sess->trace_path = 0;
+    cleanup_milters = sess->milters;
+}
+
+/* cleanup_event_swap_out - save per-session global state */
+
+static void cleanup_event_swap_out(CLEANUP_SESS *sess)
+{
+    sess->path = cleanup_path;
+    cleanup_path = 0;
+    sess->trace_path = cleanup_trace_path;
+    cleanup_trace_path = 0;
+    cleanup_milters = 0;
+}
+
+/* cleanup_event_finish - report status to client and clean up */
+
+static void cleanup_event_finish(CLEANUP_SESS *sess)
+{
+    CLEANUP_STATE *state = sess->state;
+    VSTREAM *src = sess->src;
+    int     status;
+
+    event_cancel_timer(cleanup_event_read, (void *) sess);
+    event_disable_readwrite(vstream_fileno(src));
+
+    /*
+     * Log something to make timeout errors easier to debug.
+     */
+    if ((sess->flags & CLEANUP_SESS_FLAG_TIMEOUT) || vstream_ftimeout(src))
+	msg_warn("%s: read timeout on %s",
+		 state->queue_id, VSTREAM_PATH(src));
+
+    /*
+     * Finish this message, and report the result status to the client.
+     */
+    status = cleanup_flush(state);		/* in case state is modified */
+    attr_print(src, ATTR_FLAG_NONE,
+	       SEND_ATTR_INT(MAIL_ATTR_STATUS, status),
+	       SEND_ATTR_STR(MAIL_ATTR_WHY,
+			     (state->flags & CLEANUP_FLAG_SMTP_REPLY)
+			     && state->smtp_reply ? state->smtp_reply :
+			     state->reason ? state->reason : ""),
+	       ATTR_TYPE_END);
+    cleanup_free(state);
+    cleanup_event_swap_out(sess);
+
+    /*
+     * Recycle the session, including the non_smtpd_milters instance. This
+     * is the same as what the single-threaded cleanup server does when it
+     * receives the next message.
+     */
+    if (sess->prev)
+	sess->prev->next = sess->next;
+    else
+	cleanup_event_active = sess->next;
+    if (sess->next)
+	sess->next->prev = sess->prev;
+    sess->state = 0;
+    sess->src = 0;
+    sess->prev = 0;
+    sess->next = cleanup_event_free;
+    cleanup_event_free = sess;
+    event_server_disconnect(src);
+}
+
+/* cleanup_event_read - process client input as it arrives */
+
+static void cleanup_event_read(int event, void *context)
+{
+    CLEANUP_SESS *sess = (CLEANUP_SESS *) context;
+    CLEANUP_STATE *state = sess->state;
+    int     flags;
+    int     type;
+
+    if (event == EVENT_TIME)
+	sess->flags |= CLEANUP_SESS_FLAG_TIMEOUT;
+    else
+	cleanup_event_fill(sess);
+
+    cleanup_event_swap_in(sess);
+
+    /*
+     * The state machine below implements the same protocol as the
+     * single-threaded cleanup_service() routine, except that it returns to
+     * the event loop when the next request has not yet arrived.
+     */
+    for (;;) {
+	switch (sess->phase) {
+
+	    /*
+	     * Read client processing options. If we can't read the client
+	     * processing options we can pretty much forget about the whole
+	     * operation.
+	     */
+	case CLEANUP_SESS_PHASE_FLAGS:
+	    if (CLEANUP_SESS_INPUT_DONE(sess) == 0
+		&& !cleanup_event_attr_ready(sess))
+		goto suspend;
+	    if ((sess->flags & CLEANUP_SESS_FLAG_TIMEOUT)
+		|| attr_scan(sess->src, ATTR_FLAG_STRICT,
+			     RECV_ATTR_INT(MAIL_ATTR_FLAGS, &flags),
+			     ATTR_TYPE_END) != 1) {
+		state->errs |= CLEANUP_STAT_BAD;
+		flags = 0;
+	    }
+	    cleanup_control(state, flags);
+	    sess->phase = CLEANUP_SESS_PHASE_RECORDS;
+	    break;
+
+	    /*
+	     * Copy the envelope records, message content, and extracted
+	     * information to the queue file.
+	     */
+	case CLEANUP_SESS_PHASE_RECORDS:
+	    if (CLEANUP_OUT_OK(state) == 0) {
+		sess->phase = (sess->type > 0 ? CLEANUP_SESS_PHASE_SKIP :
+			       CLEANUP_SESS_PHASE_DONE);
+		break;
+	    }
+	    if ((type = cleanup_event_rec_get(sess)) == CLEANUP_SESS_REC_WAIT)
+		goto suspend;
+	    if ((sess->type = type) < 0) {
+		state->errs |= CLEANUP_STAT_BAD;
+		sess->phase = CLEANUP_SESS_PHASE_DONE;
+		break;
+	    }
+	    if (REC_GET_HIDDEN_TYPE(type)) {
+		msg_warn("%s: record type %d not allowed - discarding this message",
+			 state->queue_id, type);
+		state->errs |= CLEANUP_STAT_BAD;
+		break;
+	    }
+	    CLEANUP_RECORD(state, type, vstring_str(sess->buf),
+			   VSTRING_LEN(sess->buf));
+	    if (type == REC_TYPE_END)
+		sess->phase = CLEANUP_SESS_PHASE_DONE;
+	    break;
+
+	    /*
+	     * Keep reading in case of problems, until the sender is ready to
+	     * receive our status report.
+	     */
+	case CLEANUP_SESS_PHASE_SKIP:
+	    if (sess->type == REC_TYPE_END) {
+		sess->phase = CLEANUP_SESS_PHASE_DONE;
+		break;
+	    }
+	    if ((type = cleanup_event_rec_get(sess)) == CLEANUP_SESS_REC_WAIT)
+		goto suspend;
+	    if ((sess->type = type) <= 0) {
+		sess->phase = CLEANUP_SESS_PHASE_DONE;
+		break;
+	    }
+	    if (type == REC_TYPE_MILT_COUNT) {
+		int     milter_count = atoi(vstring_str(sess->buf));
+
+		/* Avoid deadlock. */
+		if (milter_count >= 0)
+		    cleanup_milter_receive(state, milter_count);
+	    }
+	    break;
+
+	case CLEANUP_SESS_PHASE_DONE:
+	    cleanup_event_finish(sess);
+	    return;
+
+	default:
+	    msg_panic("cleanup_event_read: bad phase %d", sess->phase);
+	}
+    }
+
+    /*
+     * Wait for more client input. Send any pending replies first, such as
+     * the status after receiving Milter information, or the client would
+     * wait for us while we wait for the client. Don't call vstream_fflush()
+     * while reading; that would discard unread input.
+     */
+suspend:
+    if (vstream_bufstat(sess->src, VSTREAM_BST_OUT_PEND) > 0)
+	(void) vstream_fflush(sess->src);
+    cleanup_event_swap_out(sess);
+    event_request_timer(cleanup_event_read, (void *) sess, var_ipc_timeout);
+}
+
+/* cleanup_event_service - start processing one request */
+
+void    cleanup_event_service(VSTREAM *src, char *unused_service, char **argv)
+{
+    CLEANUP_SESS *sess;
+
+    /*
+     * Sanity check. This service takes no command-line arguments.
+     */
+    if (argv[0])
+	msg_fatal("unexpected command-line argument: %s", argv[0]);
+
+    /*
+     * Recycle or create session state. The first session inherits the
+     * non_smtpd_milters instance that was created by cleanup_pre_jail().
+     */
+    if ((sess = cleanup_event_free) != 0) {
+	cleanup_event_free = sess->next;
+    } else {
+	sess = (CLEANUP_SESS *) mymalloc(sizeof(*sess));
+	sess->buf = vstring_alloc(100);
+	sess->inbuf = vstring_alloc(VSTREAM_BUFSIZE);
+	sess->path = 0;
+	sess->trace_path = 0;
+	if (cleanup_event_milters != 0) {
+	    sess->milters = cleanup_event_milters;
+	    cleanup_event_milters = 0;
+	} else {
+	    sess->milters = cleanup_milters_create();
+	}
+    }
+    sess->src = src;
+    VSTRING_RESET(sess->inbuf);
+    sess->inpos = 0;
+    sess->phase = CLEANUP_SESS_PHASE_FLAGS;
+    sess->type = 0;
+    sess->flags = 0;
+    sess->prev = 0;
+    if ((sess->next = cleanup_event_active) != 0)
+	sess->next->prev = sess;
+    cleanup_event_active = sess;
+    vstream_control(src,
+		    CA_VSTREAM_CTL_READ_FN(cleanup_event_read_fn),
+		    CA_VSTREAM_CTL_CONTEXT((void *) sess),
+		    CA_VSTREAM_CTL_END);
+
+    /*
+     * Open a queue file and initialize state. Send the queue id to the
+     * client.
+     */
+    cleanup_event_swap_in(sess);
+    sess->state = cleanup_open(src);
+    attr_print(src, ATTR_FLAG_NONE,
+	       SEND_ATTR_STR(MAIL_ATTR_QUEUEID, sess->state->queue_id),
+	       ATTR_TYPE_END);
+    (void) vstream_fflush(src);
+    cleanup_event_swap_out(sess);
+    event_enable_read(vstream_fileno(src), cleanup_event_read, (void *) sess);
+    event_request_timer(cleanup_event_read, (void *) sess, var_ipc_timeout);
+
+    /*
+     * In stand-alone mode (the -S option) the client is connected to
+     * standard input, and the server terminates as soon as we return.
+     */
+    if (vstream_fileno(src) == STDIN_FILENO)
+	while (sess->src == src)
+	    event_loop(-1);
+}
+
+/* cleanup_event_post_jail - initialize after entering the chroot jail */
+
+void    cleanup_event_post_jail(char *service_name, char **argv)
+{
+    cleanup_post_jail(service_name, argv);
+
+    /*
+     * Each client session needs its own non_smtpd_milters instance. Hand
+     * the instance from cleanup_pre_jail() to the first session.
+     */
+    cleanup_event_milters = cleanup_milters;
+    cleanup_milters = 0;
+}
+
+/* cleanup_event_drain - finish work in progress in the background */
+
+void    cleanup_event_drain(char *unused_name, char **unused_argv)
+{
+    int     count;
+
+    /*
+     * After "postfix reload", complete work-in-progress in the background,
+     * instead of dropping already-accepted connections on the floor.
+     *
+     * All error retry counts shall be limited. Instead of blocking here, we
+     * could retry failed fork() operations in the event call-back routines,
+     * but we don't need perfection. The host system is severely overloaded
+     * and service levels are already way down.
+     */
+    for (count = 0; /* see below */ ; count++) {
+	if (count >= 5) {
+	    msg_fatal("fork: %m");
+	} else if (event_server_drain() != 0) {
+	    msg_warn("fork: %m");
+	    sleep(1);
+	    continue;
+	} else {
+	    return;
+	}
+    }
+}
+
+/* cleanup_event_pre_accept - see if tables have changed */
+
+void    cleanup_event_pre_accept(char *service_name, char **argv)
+{
+    const char *table;
+
+    if ((table = dict_changed_name()) != 0) {
+	if (cleanup_event_active == 0) {
+	    msg_info("table %s has changed -- restarting", table);
+	    exit(0);
+	}
+	msg_info("table %s has changed -- finishing in the background",
+		 table);
+	cleanup_event_drain(service_name, argv);
+    }
+}
+
+/* cleanup_event_remove - remove incomplete queue files */
+
+void    cleanup_event_remove(void)
+{
+    CLEANUP_SESS *sess;
+
+    /*
+     * XXX While running as a signal handler, can't ask the memory manager to
+     * release VSTRING storage.
+     */
+    for (sess = cleanup_event_active; sess != 0; sess = sess->next) {
+	if (sess->trace_path) {
+	    (void) REMOVE(vstring_str(sess->trace_path));
+	    sess->trace_path = 0;
+	}
+	if (sess->path) {
+	    (void) REMOVE(sess->path);
+	    sess->path = 0;
+	}
+    }
+}
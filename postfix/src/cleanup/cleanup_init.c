@@ -25,6 +25,8 @@
 /*	char	*cleanup_path;
 /*	VSTRING	*cleanup_trace_path;
 /*
+/*	MILTERS	*cleanup_milters_create()
+/*
 /*	void	cleanup_all()
 /*
 /*	void	cleanup_sig(sigval)
@@ -44,6 +46,10 @@
 /*	chroot jail. These functions satisfy the interface as specified
 /*	in single_service(3).
 /*
+/*	cleanup_milters_create() instantiates the non_smtpd_milters
+/*	setting. The result is a null pointer when no Milter applications
+/*	are configured.
+/*
 /*	cleanup_path is either a null pointer or it is the name of a queue
 /*	file that currently is being written. This information is used
 /*	by cleanup_all() to remove incomplete files after a fatal error,
@@ -57,7 +63,9 @@
 /*	to remove an incomplete queue file.
 /*
 /*	cleanup_sig() must be called in case of SIGTERM, in order
-/*	to remove an incomplete queue file.
+/*	to remove an incomplete queue file. With the event-driven
+/*	personality, this also removes the queue files of client
+/*	sessions that are waiting for input.
 /* DIAGNOSTICS
 /*	Problems and transactions are logged to \fBsyslogd\fR(8).
 /* SEE ALSO
@@ -168,6 +176,9 @@ char   *var_milt_unk_macros;		/* unknown command macros */
 char   *var_cleanup_milters;		/* non-SMTP mail */
 char   *var_milt_head_checks;		/* post-Milter header checks */
 char   *var_milt_macro_deflts;		/* default macro settings */
+int     var_milt_parallel;		/* parallel envelope events */
+int     var_milt_conn_reuse;		/* reuse Milter connections */
+int     var_milt_body_cache;		/* shared Milter message body */
 int     var_auto_8bit_enc_hdr;		/* auto-detect 8bit encoding header */
 int     var_always_add_hdrs;		/* always add missing headers */
 int     var_virt_addrlen_limit;		/* stop exponential growth */
@@ -181,6 +192,7 @@ const CONFIG_INT_TABLE cleanup_int_table[] = {
     VAR_VIRT_EXPAN_LIMIT, DEF_VIRT_EXPAN_LIMIT, &var_virt_expan_limit, 1, 0,
     VAR_VIRT_ADDRLEN_LIMIT, DEF_VIRT_ADDRLEN_LIMIT, &var_virt_addrlen_limit, 1, 0,
     VAR_BODY_CHECK_LEN, DEF_BODY_CHECK_LEN, &var_body_check_len, 0, 0,
+    VAR_MILT_BODY_CACHE, DEF_MILT_BODY_CACHE, &var_milt_body_cache, 0, 0,
     0,
 };
 
@@ -188,6 +200,8 @@ const CONFIG_BOOL_TABLE cleanup_bool_table[] = {
     VAR_VERP_BOUNCE_OFF, DEF_VERP_BOUNCE_OFF, &var_verp_bounce_off,
     VAR_AUTO_8BIT_ENC_HDR, DEF_AUTO_8BIT_ENC_HDR, &var_auto_8bit_enc_hdr,
     VAR_ALWAYS_ADD_HDRS, DEF_ALWAYS_ADD_HDRS, &var_always_add_hdrs,
+    VAR_MILT_PARALLEL, DEF_MILT_PARALLEL, &var_milt_parallel,
+    VAR_MILT_CONN_REUSE, DEF_MILT_CONN_REUSE, &var_milt_conn_reuse,
     0,
 };
 
@@ -311,11 +325,40 @@ void    cleanup_sig(int sig)
 	    (void) REMOVE(cleanup_path);
 	    cleanup_path = 0;
 	}
+	cleanup_event_remove();
 	if (sig)
 	    _exit(sig);
     }
 }
 
+/* cleanup_milters_create - instantiate non_smtpd_milters */
+
+MILTERS *cleanup_milters_create(void)
+{
+    MILTERS *milters;
+
+    if (*var_cleanup_milters == 0)
+	return (0);
+    milters = milter_create(var_cleanup_milters,
+			    var_milt_conn_time,
+			    var_milt_cmd_time,
+			    var_milt_msg_time,
+			    var_milt_protocol,
+			    var_milt_def_action,
+			    var_milt_conn_macros,
+			    var_milt_helo_macros,
+			    var_milt_mail_macros,
+			    var_milt_rcpt_macros,
+			    var_milt_data_macros,
+			    var_milt_eoh_macros,
+			    var_milt_eod_macros,
+			    var_milt_unk_macros,
+			    var_milt_macro_deflts);
+    milter_parallel_events(milters, var_milt_parallel);
+    milter_conn_reuse(milters, var_milt_conn_reuse);
+    return (milters);
+}
+
 /* cleanup_pre_jail - initialize before entering the chroot jail */
 
 void    cleanup_pre_jail(char *unused_name, char **unused_argv)
@@ -409,22 +452,7 @@ void    cleanup_pre_jail(char *unused_name, char **unused_argv)
 	    maps_create(VAR_RCPT_BCC_MAPS, var_rcpt_bcc_maps,
 			DICT_FLAG_LOCK | DICT_FLAG_FOLD_FIX
 			| DICT_FLAG_UTF8_REQUEST);
-    if (*var_cleanup_milters)
-	cleanup_milters = milter_create(var_cleanup_milters,
-					var_milt_conn_time,
-					var_milt_cmd_time,
-					var_milt_msg_time,
-					var_milt_protocol,
-					var_milt_def_action,
-					var_milt_conn_macros,
-					var_milt_helo_macros,
-					var_milt_mail_macros,
-					var_milt_rcpt_macros,
-					var_milt_data_macros,
-					var_milt_eoh_macros,
-					var_milt_eod_macros,
-					var_milt_unk_macros,
-					var_milt_macro_deflts);
+    cleanup_milters = cleanup_milters_create();
 
     flush_init();
 }
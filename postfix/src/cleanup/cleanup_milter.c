@@ -605,11 +605,64 @@ static const char *cleanup_milter_error(CLEANUP_STATE *state, int err)
 	msg_panic("%s: missing errno to error flag mapping", myname);
     if (state->milter_err_text == 0)
 	state->milter_err_text = vstring_alloc(50);
+    /* Don't trust the header index after a partial queue file update. */
+    cleanup_milter_hdr_index_free(state);
     dp = cleanup_stat_detail(state->errs);
     return (STR(vstring_sprintf(state->milter_err_text,
 				"%d %s %s", dp->smtp, dp->dsn, dp->text)));
 }
 
+/* cleanup_milter_hdr_index_free - destroy header position index */
+
+void    cleanup_milter_hdr_index_free(CLEANUP_STATE *state)
+{
+    CLEANUP_HDR_POS *hp;
+
+    if (state->hdr_index) {
+	for (hp = state->hdr_index;
+	     hp < state->hdr_index + state->hdr_index_len; hp++)
+	    myfree(hp->name);
+	myfree((void *) state->hdr_index);
+	state->hdr_index = 0;
+	state->hdr_index_len = state->hdr_index_size = 0;
+    }
+}
+
+/* cleanup_hdr_index_insert - add header position */
+
+static void cleanup_hdr_index_insert(CLEANUP_STATE *state, ssize_t pos,
+				             const char *name, ssize_t len,
+				             off_t offset, off_t ptr_offset)
+{
+    CLEANUP_HDR_POS *hp;
+
+    if (state->hdr_index_len >= state->hdr_index_size) {
+	state->hdr_index_size *= 2;
+	state->hdr_index = (CLEANUP_HDR_POS *)
+	    myrealloc((void *) state->hdr_index,
+		      state->hdr_index_size * sizeof(*state->hdr_index));
+    }
+    hp = state->hdr_index + pos;
+    memmove((void *) (hp + 1), (void *) hp,
+	    (state->hdr_index_len - pos) * sizeof(*hp));
+    state->hdr_index_len += 1;
+    hp->name = mystrndup(name, len);
+    hp->offset = offset;
+    hp->ptr_offset = ptr_offset;
+}
+
+/* cleanup_hdr_index_delete - remove header position */
+
+static void cleanup_hdr_index_delete(CLEANUP_STATE *state, ssize_t pos)
+{
+    CLEANUP_HDR_POS *hp = state->hdr_index + pos;
+
+    myfree(hp->name);
+    state->hdr_index_len -= 1;
+    memmove((void *) hp, (void *) (hp + 1),
+	    (state->hdr_index_len - pos) * sizeof(*hp));
+}
+
 /* cleanup_add_header - append message header */
 
 static const char *cleanup_add_header(void *context, const char *name,
@@ -621,6 +674,7 @@ static const char *cleanup_add_header(void *context, const char *name,
     VSTRING *buf;
     off_t   reverse_ptr_offset;
     off_t   new_hdr_offset;
+    ssize_t len;
 
     /*
      * To simplify implementation, the cleanup server writes a dummy "header
@@ -664,6 +718,21 @@ static const char *cleanup_add_header(void *context, const char *name,
 	vstring_free(buf);
 	return (cleanup_milter_error(state, errno));
     }
+
+    /*
+     * Update the header position index. The new header will be reached
+     * through the current "header append" pointer record. Text that is not
+     * a header ends the message header, and hides all headers that follow;
+     * leave that mess to a complete queue file scan.
+     */
+    if (state->hdr_index) {
+	if ((len = is_header(STR(buf))) > 0)
+	    cleanup_hdr_index_insert(state, state->hdr_index_len, STR(buf),
+				     len, new_hdr_offset,
+				     state->append_hdr_pt_offset);
+	else
+	    cleanup_milter_hdr_index_free(state);
+    }
     /* XXX emit prepended header, then clear it. */
     cleanup_out_header(state, buf);		/* Includes padding */
     vstring_free(buf);
@@ -712,56 +781,25 @@ static const char *cleanup_add_header(void *context, const char *name,
      */
 }
 
-/* cleanup_find_header_start - find specific header instance */
+/* cleanup_hdr_index_build - find all message headers */
 
-static off_t cleanup_find_header_start(CLEANUP_STATE *state, ssize_t index,
-				               const char *header_label,
-				               VSTRING *buf,
-				               int *prec_type,
-				               int allow_ptr_backup,
-				               int skip_headers)
+static int cleanup_hdr_index_build(CLEANUP_STATE *state)
 {
-    const char *myname = "cleanup_find_header_start";
-    off_t   curr_offset;		/* offset after found record */
-    off_t   ptr_offset;			/* pointer to found record */
-    VSTRING *ptr_buf = 0;
+    const char *myname = "cleanup_hdr_index_build";
+    VSTRING *buf;
+    off_t   curr_offset;		/* offset of current record */
+    off_t   ptr_offset;			/* pointer to current record */
     int     rec_type = REC_TYPE_ERROR;
     int     last_type;
     ssize_t len;
-    int     hdr_count = 0;
-
-    if (msg_verbose)
-	msg_info("%s: index %ld name \"%s\"",
-	      myname, (long) index, header_label ? header_label : "(none)");
-
-    /*
-     * Sanity checks.
-     */
-    if (index < 1)
-	msg_panic("%s: bad header index %ld", myname, (long) index);
 
     /*
      * Skip to the start of the message content, and read records until we
-     * either find the specified header, or until we hit the end of the
-     * headers.
-     * 
-     * The index specifies the header instance: 1 is the first one. The header
-     * label specifies the header name. A null pointer matches any header.
-     * 
-     * When the specified header is not found, the result value is -1.
-     * 
-     * When the specified header is found, its first record is stored in the
-     * caller-provided read buffer, and the result value is the queue file
-     * offset of that record. The file read position is left at the start of
-     * the next (non-filler) queue file record, which can be the remainder of
-     * a multi-record header.
-     * 
-     * When a header is found and allow_ptr_backup is non-zero, then the result
-     * is either the first record of that header, or it is the pointer record
-     * that points to the first record of that header. In the latter case,
-     * the file read position is undefined. Returning the pointer allows us
-     * to do some optimizations when inserting text multiple times at the
-     * same place.
+     * hit the end of the headers. For each header, remember the header
+     * label, the queue file offset of its first record, and the offset of
+     * the pointer record (if any) that was followed to reach that first
+     * record. Milter header edit requests then need no queue file scan; the
+     * edit routines below update the index as they change the queue file.
      * 
      * XXX We can't use the MIME processor here. It not only buffers up the
      * input, it also reads the record that follows a complete header before
@@ -774,40 +812,15 @@ static off_t cleanup_find_header_start(CLEANUP_STATE *state, ssize_t index,
      * duplicate some of its logic here and in the routine that finds the end
      * of the header record. To minimize the duplication we define an ugly
      * macro that is used in all code that scans for header boundaries.
-     * 
-     * XXX Sendmail compatibility (based on Sendmail 8.13.6 measurements).
-     * 
-     * - When changing Received: header #1, we change the Received: header that
-     * follows our own one; a request to change Received: header #0 is
-     * silently treated as a request to change Received: header #1.
-     * 
-     * - When changing Date: header #1, we change the first Date: header; a
-     * request to change Date: header #0 is silently treated as a request to
-     * change Date: header #1.
-     * 
-     * Thus, header change requests are relative to the content as received,
-     * that is, the content after our own Received: header. They can affect
-     * only the headers that the MTA actually exposes to mail filter
-     * applications.
-     * 
-     * - However, when inserting a header at position 0, the new header appears
-     * before our own Received: header, and when inserting at position 1, the
-     * new header appears after our own Received: header.
-     * 
-     * Thus, header insert operations are relative to the content as delivered,
-     * that is, the content including our own Received: header.
-     * 
-     * None of the above is applicable after a Milter inserts a header before
-     * our own Received: header. From then on, our own Received: header
-     * becomes just like other headers.
      */
 #define CLEANUP_FIND_HEADER_NOTFOUND	(-1)
 #define CLEANUP_FIND_HEADER_IOERROR	(-2)
 
-#define CLEANUP_FIND_HEADER_RETURN(offs) do { \
-	if (ptr_buf) \
-	    vstring_free(ptr_buf); \
-	return (offs); \
+#define CLEANUP_HDR_INDEX_RETURN(ret) do { \
+	vstring_free(buf); \
+	if ((ret) < 0) \
+	    cleanup_milter_hdr_index_free(state); \
+	return (ret); \
     } while (0)
 
 #define GET_NEXT_TEXT_OR_PTR_RECORD(rec_type, state, buf, curr_offset, quit) \
@@ -826,16 +839,22 @@ static off_t cleanup_find_header_start(CLEANUP_STATE *state, ssize_t index,
 	break;
     /* End of hairy macros. */
 
+    buf = vstring_alloc(100);
+    state->hdr_index_size = 20;
+    state->hdr_index = (CLEANUP_HDR_POS *)
+	mymalloc(state->hdr_index_size * sizeof(*state->hdr_index));
+    state->hdr_index_len = 0;
+
     if (vstream_fseek(state->dst, state->data_offset, SEEK_SET) < 0) {
 	msg_warn("%s: seek file %s: %m", myname, cleanup_path);
 	cleanup_milter_set_error(state, errno);
-	CLEANUP_FIND_HEADER_RETURN(CLEANUP_FIND_HEADER_IOERROR);
+	CLEANUP_HDR_INDEX_RETURN(CLEANUP_FIND_HEADER_IOERROR);
     }
     for (ptr_offset = 0, last_type = 0; /* void */ ; /* void */ ) {
 	if ((curr_offset = vstream_ftell(state->dst)) < 0) {
 	    msg_warn("%s: vstream_ftell file %s: %m", myname, cleanup_path);
 	    cleanup_milter_set_error(state, errno);
-	    CLEANUP_FIND_HEADER_RETURN(CLEANUP_FIND_HEADER_IOERROR);
+	    CLEANUP_HDR_INDEX_RETURN(CLEANUP_FIND_HEADER_IOERROR);
 	}
 	/* Don't follow the "append header" pointer. */
 	if (curr_offset == state->append_hdr_pt_offset)
@@ -843,21 +862,16 @@ static off_t cleanup_find_header_start(CLEANUP_STATE *state, ssize_t index,
 	/* Caution: this macro terminates the loop at end-of-message. */
 	/* Don't do complex processing while breaking out of this loop. */
 	GET_NEXT_TEXT_OR_PTR_RECORD(rec_type, state, buf, curr_offset,
-		   CLEANUP_FIND_HEADER_RETURN(CLEANUP_FIND_HEADER_IOERROR));
+		     CLEANUP_HDR_INDEX_RETURN(CLEANUP_FIND_HEADER_IOERROR));
 	/* Caution: don't assume ptr->header. This may be header-ptr->body. */
 	if (rec_type == REC_TYPE_PTR) {
 	    if (rec_goto(state->dst, STR(buf)) < 0) {
 		msg_warn("%s: read file %s: %m", myname, cleanup_path);
 		cleanup_milter_set_error(state, errno);
-		CLEANUP_FIND_HEADER_RETURN(CLEANUP_FIND_HEADER_IOERROR);
+		CLEANUP_HDR_INDEX_RETURN(CLEANUP_FIND_HEADER_IOERROR);
 	    }
 	    /* Save PTR record, in case it points to the start of a header. */
-	    if (allow_ptr_backup) {
-		ptr_offset = curr_offset;
-		if (ptr_buf == 0)
-		    ptr_buf = vstring_alloc(100);
-		vstring_strcpy(ptr_buf, STR(buf));
-	    }
+	    ptr_offset = curr_offset;
 	    /* Don't update last_type; PTR can happen after REC_TYPE_CONT. */
 	    continue;
 	}
@@ -870,18 +884,105 @@ static off_t cleanup_find_header_start(CLEANUP_STATE *state, ssize_t index,
 	    break;
 	}
 	/* This the start of a message header. */
-	else if (hdr_count++ < skip_headers)
-	     /* Reset the saved PTR record and update last_type. */ ;
-	else if ((header_label == 0
-		  || (strncasecmp(header_label, STR(buf), len) == 0
-		      && (strlen(header_label) == len)))
-		 && --index == 0) {
-	    /* If we have a saved PTR record, it points to start of header. */
-	    break;
+	else {
+	    cleanup_hdr_index_insert(state, state->hdr_index_len, STR(buf),
+				     len, curr_offset, ptr_offset);
 	}
 	ptr_offset = 0;
 	last_type = rec_type;
     }
+    if (msg_verbose)
+	msg_info("%s: %ld headers", myname, (long) state->hdr_index_len);
+    CLEANUP_HDR_INDEX_RETURN(0);
+}
+
+/* cleanup_find_header_start - find specific header instance */
+
+static off_t cleanup_find_header_start(CLEANUP_STATE *state, ssize_t index,
+				               const char *header_label,
+				               VSTRING *buf,
+				               int *prec_type,
+				               int allow_ptr_backup,
+				               int skip_headers,
+				               ssize_t *hdr_pos)
+{
+    const char *myname = "cleanup_find_header_start";
+    off_t   curr_offset;		/* offset after found record */
+    CLEANUP_HDR_POS *hp;
+    VSTRING *rbuf;
+    int     rec_type = REC_TYPE_ERROR;
+    int     use_ptr;
+    ssize_t pos;
+
+    if (msg_verbose)
+	msg_info("%s: index %ld name \"%s\"",
+	      myname, (long) index, header_label ? header_label : "(none)");
+
+    /*
+     * Sanity checks.
+     */
+    if (index < 1)
+	msg_panic("%s: bad header index %ld", myname, (long) index);
+
+    /*
+     * Look up the specified header in the header position index, and read
+     * its first record from the queue file. The index is built when it is
+     * needed for the first time.
+     * 
+     * The index specifies the header instance: 1 is the first one. The header
+     * label specifies the header name. A null pointer matches any header.
+     * 
+     * When the specified header is not found, the result value is -1.
+     * 
+     * When the specified header is found, its first record is stored in the
+     * caller-provided read buffer, and the result value is the queue file
+     * offset of that record. The file read position is left at the start of
+     * the next (non-filler) queue file record, which can be the remainder of
+     * a multi-record header. The header's position in the index is stored
+     * in the caller-provided hdr_pos result.
+     * 
+     * When a header is found and allow_ptr_backup is non-zero, then the result
+     * is either the first record of that header, or it is the pointer record
+     * that points to the first record of that header. In the latter case,
+     * the file read position is undefined. Returning the pointer allows us
+     * to do some optimizations when inserting text multiple times at the
+     * same place.
+     * 
+     * XXX Sendmail compatibility (based on Sendmail 8.13.6 measurements).
+     * 
+     * - When changing Received: header #1, we change the Received: header that
+     * follows our own one; a request to change Received: header #0 is
+     * silently treated as a request to change Received: header #1.
+     * 
+     * - When changing Date: header #1, we change the first Date: header; a
+     * request to change Date: header #0 is silently treated as a request to
+     * change Date: header #1.
+     * 
+     * Thus, header change requests are relative to the content as received,
+     * that is, the content after our own Received: header. They can affect
+     * only the headers that the MTA actually exposes to mail filter
+     * applications.
+     * 
+     * - However, when inserting a header at position 0, the new header appears
+     * before our own Received: header, and when inserting at position 1, the
+     * new header appears after our own Received: header.
+     * 
+     * Thus, header insert operations are relative to the content as delivered,
+     * that is, the content including our own Received: header.
+     * 
+     * None of the above is applicable after a Milter inserts a header before
+     * our own Received: header. From then on, our own Received: header
+     * becomes just like other headers.
+     */
+    if (state->hdr_index == 0
+	&& cleanup_hdr_index_build(state) == CLEANUP_FIND_HEADER_IOERROR)
+	return (CLEANUP_FIND_HEADER_IOERROR);
+    for (hp = 0, pos = skip_headers; pos < state->hdr_index_len; pos++) {
+	hp = state->hdr_index + pos;
+	if ((header_label == 0 || strcasecmp(header_label, hp->name) == 0)
+	    && --index == 0)
+	    break;
+    }
 
     /*
      * In case of failure, return negative start position.
@@ -890,45 +991,62 @@ static off_t cleanup_find_header_start(CLEANUP_STATE *state, ssize_t index,
 	curr_offset = CLEANUP_FIND_HEADER_NOTFOUND;
     } else {
 
-	/*
-	 * Skip over short-header padding, so that the file read pointer is
-	 * always positioned at the first non-padding record after the header
-	 * record. Insist on padding after short a header record, so that a
-	 * short header record can safely be overwritten by a pointer record.
-	 */
-	if (LEN(buf) < REC_TYPE_PTR_PAYL_SIZE) {
-	    VSTRING *rbuf = (ptr_offset ? buf :
-			     (ptr_buf ? ptr_buf :
-			      (ptr_buf = vstring_alloc(100))));
-	    int     rval;
-
-	    if ((rval = rec_get_raw(state->dst, rbuf, 0, REC_FLAG_NONE)) < 0) {
-		cleanup_milter_set_error(state, errno);
-		CLEANUP_FIND_HEADER_RETURN(CLEANUP_FIND_HEADER_IOERROR);
-	    }
-	    if (rval != REC_TYPE_DTXT)
-		msg_panic("%s: short header without padding", myname);
-	}
-
 	/*
 	 * Optionally return a pointer to the message header, instead of the
 	 * start of the message header itself. In that case the file read
-	 * position is undefined (actually it is at the first non-padding
-	 * record that follows the message header record).
+	 * position is undefined.
 	 */
-	if (ptr_offset != 0) {
-	    rec_type = REC_TYPE_PTR;
-	    curr_offset = ptr_offset;
-	    vstring_strcpy(buf, STR(ptr_buf));
+	use_ptr = (allow_ptr_backup && hp->ptr_offset != 0);
+	curr_offset = (use_ptr ? hp->ptr_offset : hp->offset);
+	if (vstream_fseek(state->dst, curr_offset, SEEK_SET) < 0) {
+	    msg_warn("%s: seek file %s: %m", myname, cleanup_path);
+	    cleanup_milter_set_error(state, errno);
+	    return (CLEANUP_FIND_HEADER_IOERROR);
+	}
+	if ((rec_type = rec_get_raw(state->dst, buf, 0, REC_FLAG_NONE)) < 0) {
+	    msg_warn("%s: read file %s: %m", myname, cleanup_path);
+	    cleanup_milter_set_error(state, errno);
+	    return (CLEANUP_FIND_HEADER_IOERROR);
+	}
+	if (use_ptr) {
+	    if (rec_type != REC_TYPE_PTR)
+		msg_panic("%s: no pointer record at %ld",
+			  myname, (long) curr_offset);
+	} else {
+	    if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
+		msg_panic("%s: no header record at %ld",
+			  myname, (long) curr_offset);
+
+	    /*
+	     * Skip over short-header padding, so that the file read pointer
+	     * is always positioned at the first non-padding record after the
+	     * header record. Insist on padding after short a header record,
+	     * so that a short header record can safely be overwritten by a
+	     * pointer record.
+	     */
+	    if (LEN(buf) < REC_TYPE_PTR_PAYL_SIZE) {
+		int     rval;
+
+		rbuf = vstring_alloc(100);
+		rval = rec_get_raw(state->dst, rbuf, 0, REC_FLAG_NONE);
+		vstring_free(rbuf);
+		if (rval < 0) {
+		    cleanup_milter_set_error(state, errno);
+		    return (CLEANUP_FIND_HEADER_IOERROR);
+		}
+		if (rval != REC_TYPE_DTXT)
+		    msg_panic("%s: short header without padding", myname);
+	    }
 	}
 	*prec_type = rec_type;
+	*hdr_pos = pos;
     }
     if (msg_verbose)
 	msg_info("%s: index %ld name %s type %d offset %ld",
 		 myname, (long) index, header_label ?
 		 header_label : "(none)", rec_type, (long) curr_offset);
 
-    CLEANUP_FIND_HEADER_RETURN(curr_offset);
+    return (curr_offset);
 }
 
 /* cleanup_find_header_end - find end of header */
@@ -988,11 +1106,17 @@ static const char *cleanup_patch_header(CLEANUP_STATE *state,
 					        off_t old_rec_offset,
 					        int old_rec_type,
 					        VSTRING *old_rec_buf,
-					        off_t next_offset)
+					        off_t next_offset,
+					        ssize_t hdr_pos)
 {
     const char *myname = "cleanup_patch_header";
     VSTRING *buf = vstring_alloc(100);
     off_t   new_hdr_offset;
+    off_t   saved_rec_offset;
+    off_t   reverse_ptr_offset = -1;
+    CLEANUP_HDR_POS *hp;
+    CLEANUP_HDR_POS *end;
+    ssize_t len;
 
 #define CLEANUP_PATCH_HEADER_RETURN(ret) do { \
 	vstring_free(buf); \
@@ -1022,6 +1146,10 @@ static const char *cleanup_patch_header(CLEANUP_STATE *state,
      * 
      * next_offset specifies the record that follows the to-be-overwritten
      * record. It is ignored when the to-be-saved record is a pointer record.
+     * 
+     * hdr_pos specifies the position in the header index of the header that
+     * is being replaced (old_rec_type == 0), or of the header that the new
+     * header is inserted before.
      */
 
     /*
@@ -1041,11 +1169,28 @@ static const char *cleanup_patch_header(CLEANUP_STATE *state,
 	msg_warn("%s: seek file %s: %m", myname, cleanup_path);
 	CLEANUP_PATCH_HEADER_RETURN(cleanup_milter_error(state, errno));
     }
+    len = is_header(STR(buf));
+    if (len > 0 && state->hdr_index) {
+	if (old_rec_type > 0) {
+	    cleanup_hdr_index_insert(state, hdr_pos, STR(buf), len,
+				     new_hdr_offset, old_rec_offset);
+	} else {
+	    hp = state->hdr_index + hdr_pos;
+	    myfree(hp->name);
+	    hp->name = mystrndup(STR(buf), len);
+	    hp->offset = new_hdr_offset;
+	    hp->ptr_offset = old_rec_offset;
+	}
+    }
     /* XXX emit prepended header, then clear it. */
     cleanup_out_header(state, buf);		/* Includes padding */
     if (msg_verbose > 1)
 	msg_info("%s: %ld: write %.*s", myname, (long) new_hdr_offset,
 		 LEN(buf) > 30 ? 30 : (int) LEN(buf), STR(buf));
+    if ((saved_rec_offset = vstream_ftell(state->dst)) < 0) {
+	msg_warn("%s: vstream_ftell file %s: %m", myname, cleanup_path);
+	CLEANUP_PATCH_HEADER_RETURN(cleanup_milter_error(state, errno));
+    }
 
     /*
      * Optionally, save the existing text record or pointer record that will
@@ -1071,12 +1216,41 @@ static const char *cleanup_patch_header(CLEANUP_STATE *state,
 	if (next_offset < 0)
 	    msg_panic("%s: bad reverse pointer %ld",
 		      myname, (long) next_offset);
+	if ((reverse_ptr_offset = vstream_ftell(state->dst)) < 0) {
+	    msg_warn("%s: vstream_ftell file %s: %m", myname, cleanup_path);
+	    CLEANUP_PATCH_HEADER_RETURN(cleanup_milter_error(state, errno));
+	}
 	cleanup_out_format(state, REC_TYPE_PTR, REC_TYPE_PTR_FORMAT,
 			   (long) next_offset);
 	if (msg_verbose > 1)
 	    msg_info("%s: write PTR %ld", myname, (long) next_offset);
     }
 
+    /*
+     * Update the header position index for the headers that follow the new
+     * header. A saved text record becomes the first record of the header
+     * that we insert before; a saved pointer record now points to that
+     * header. A header that starts at the reverse pointer target is now
+     * reached through the reverse pointer. Text that is not a header ends
+     * the message header; leave that mess to a complete queue file scan.
+     */
+    if (len == 0) {
+	cleanup_milter_hdr_index_free(state);
+    } else if (state->hdr_index) {
+	hp = state->hdr_index + hdr_pos + 1;
+	end = state->hdr_index + state->hdr_index_len;
+	if (old_rec_type == REC_TYPE_PTR) {
+	    hp->ptr_offset = saved_rec_offset;
+	} else if (old_rec_type > 0) {
+	    hp->offset = saved_rec_offset;
+	    hp->ptr_offset = 0;
+	    hp += 1;
+	}
+	if (old_rec_type != REC_TYPE_PTR && hp < end
+	    && hp->offset == next_offset)
+	    hp->ptr_offset = reverse_ptr_offset;
+    }
+
     /*
      * Write the forward pointer over the old record. Generally, a pointer
      * record will be shorter than a header record, so there will be a gap in
@@ -1119,6 +1293,7 @@ static const char *cleanup_ins_header(void *context, ssize_t index,
     off_t   old_rec_offset;
     int     old_rec_type;
     off_t   next_offset;
+    ssize_t hdr_pos;
     const char *ret;
 
 #define CLEANUP_INS_HEADER_RETURN(ret) do { \
@@ -1148,7 +1323,7 @@ static const char *cleanup_ins_header(void *context, ssize_t index,
     old_rec_offset = cleanup_find_header_start(state, index, NO_HEADER_NAME,
 					       old_rec_buf, &old_rec_type,
 					       ALLOW_PTR_BACKUP,
-					       DONT_SKIP_HEADERS);
+					       DONT_SKIP_HEADERS, &hdr_pos);
     if (old_rec_offset == CLEANUP_FIND_HEADER_IOERROR)
 	/* Warning and errno->error mapping are done elsewhere. */
 	CLEANUP_INS_HEADER_RETURN(cleanup_milter_error(state, 0));
@@ -1177,7 +1352,7 @@ static const char *cleanup_ins_header(void *context, ssize_t index,
     }
     ret = cleanup_patch_header(state, new_hdr_name, hdr_space, new_hdr_value,
 			       old_rec_offset, old_rec_type,
-			       old_rec_buf, next_offset);
+			       old_rec_buf, next_offset, hdr_pos);
     CLEANUP_INS_HEADER_RETURN(ret);
 }
 
@@ -1194,6 +1369,7 @@ static const char *cleanup_upd_header(void *context, ssize_t index,
     off_t   old_rec_offset;
     off_t   next_offset;
     int     last_type;
+    ssize_t hdr_pos;
     const char *ret;
 
     if (msg_verbose)
@@ -1229,7 +1405,7 @@ static const char *cleanup_upd_header(void *context, ssize_t index,
     old_rec_offset = cleanup_find_header_start(state, index, new_hdr_name,
 					       rec_buf, &last_type,
 					       NO_PTR_BACKUP,
-					       SKIP_ONE_HEADER);
+					       SKIP_ONE_HEADER, &hdr_pos);
     if (old_rec_offset == CLEANUP_FIND_HEADER_IOERROR)
 	/* Warning and errno->error mapping are done elsewhere. */
 	CLEANUP_UPD_HEADER_RETURN(cleanup_milter_error(state, 0));
@@ -1252,7 +1428,7 @@ static const char *cleanup_upd_header(void *context, ssize_t index,
 	CLEANUP_UPD_HEADER_RETURN(cleanup_milter_error(state, 0));
     ret = cleanup_patch_header(state, new_hdr_name, hdr_space, new_hdr_value,
 			       old_rec_offset, DONT_SAVE_RECORD,
-			       (VSTRING *) 0, next_offset);
+			       (VSTRING *) 0, next_offset, hdr_pos);
     CLEANUP_UPD_HEADER_RETURN(ret);
 }
 
@@ -1267,6 +1443,7 @@ static const char *cleanup_del_header(void *context, ssize_t index,
     off_t   header_offset;
     off_t   next_offset;
     int     last_type;
+    ssize_t hdr_pos;
 
     if (msg_verbose)
 	msg_info("%s: %ld \"%s\"", myname, (long) index, hdr_name);
@@ -1292,7 +1469,7 @@ static const char *cleanup_del_header(void *context, ssize_t index,
     rec_buf = vstring_alloc(100);
     header_offset = cleanup_find_header_start(state, index, hdr_name, rec_buf,
 					      &last_type, NO_PTR_BACKUP,
-					      SKIP_ONE_HEADER);
+					      SKIP_ONE_HEADER, &hdr_pos);
     if (header_offset == CLEANUP_FIND_HEADER_IOERROR)
 	/* Warning and errno->error mapping are done elsewhere. */
 	CLEANUP_DEL_HEADER_RETURN(cleanup_milter_error(state, 0));
@@ -1314,6 +1491,11 @@ static const char *cleanup_del_header(void *context, ssize_t index,
 	}
 	rec_fprintf(state->dst, REC_TYPE_PTR, REC_TYPE_PTR_FORMAT,
 		    (long) next_offset);
+	/* The header that follows is now reached through that pointer. */
+	cleanup_hdr_index_delete(state, hdr_pos);
+	if (hdr_pos < state->hdr_index_len
+	    && state->hdr_index[hdr_pos].offset == next_offset)
+	    state->hdr_index[hdr_pos].ptr_offset = header_offset;
     }
     vstring_free(rec_buf);
 
@@ -2143,6 +2325,7 @@ void    cleanup_milter_inspect(CLEANUP_STATE *state, MILTERS *milters)
      * Process mail filter replies. The reply format is verified by the mail
      * filter library.
      */
+    milter_body_cache(milters, var_milt_body_cache);
     if ((resp = milter_message(milters, state->handle->stream,
 			       state->data_offset, state->auto_hdrs)) != 0)
 	cleanup_milter_apply(state, "END-OF-MESSAGE", resp);
@@ -2307,6 +2490,7 @@ char   *var_milt_daemon_name = "host.example.com";
 char   *var_milt_v = DEF_MILT_V;
 MILTERS *cleanup_milters = (MILTERS *) ((char *) sizeof(*cleanup_milters));
 char   *var_milt_head_checks = "";
+int     var_milt_body_cache = DEF_MILT_BODY_CACHE;
 
 /* Dummies to satisfy unused external references. */
 
@@ -2472,6 +2656,7 @@ static void open_queue_file(CLEANUP_STATE *state, const char *path)
 
 static void close_queue_file(CLEANUP_STATE *state)
 {
+    cleanup_milter_hdr_index_free(state);
     (void) vstream_fclose(state->dst);
     state->dst = 0;
     myfree(cleanup_path);
@@ -137,6 +137,8 @@ CLEANUP_STATE *cleanup_state_alloc(VSTREAM *src)
     state->milter_err_text = 0;
     state->milter_dsn_buf = 0;
     state->free_regions = state->body_regions = state->curr_body_region = 0;
+    state->hdr_index = 0;
+    state->hdr_index_len = state->hdr_index_size = 0;
     state->smtputf8 = 0;
     return (state);
 }
@@ -198,5 +200,6 @@ void    cleanup_state_free(CLEANUP_STATE *state)
     if (state->milter_dsn_buf)
 	vstring_free(state->milter_dsn_buf);
     cleanup_region_done(state);
+    cleanup_milter_hdr_index_free(state);
     myfree((void *) state);
 }
@@ -582,15 +582,12 @@ static int dict_ldap_bind_st(DICT_LDAP *dict_ldap)
     return (rc == LDAP_SUCCESS ? err : rc);
 }
 
-/* search_st - Synchronous search with timeout */
+/* search_submit - Asynchronous search with timeout */
 
-static int search_st(LDAP *ld, char *base, int scope, char *query,
-		             char **attrs, int timeout, LDAPMessage **res)
+static int search_submit(LDAP *ld, char *base, int scope, char *query,
+			         char **attrs, int timeout, int *msgid)
 {
     struct timeval mytimeval;
-    int     msgid;
-    int     rc;
-    int     err;
 
     mytimeval.tv_sec = timeout;
     mytimeval.tv_usec = 0;
@@ -598,11 +595,22 @@ static int search_st(LDAP *ld, char *base, int scope, char *query,
 #define WANTVALS 0
 #define USE_SIZE_LIM_OPT -1			/* Any negative value will do */
 
-    if ((rc = ldap_search_ext(ld, base, scope, query, attrs, WANTVALS, 0, 0,
-			      &mytimeval, USE_SIZE_LIM_OPT,
-			      &msgid)) != LDAP_SUCCESS)
-	return rc;
+    return (ldap_search_ext(ld, base, scope, query, attrs, WANTVALS, 0, 0,
+			    &mytimeval, USE_SIZE_LIM_OPT, msgid));
+}
+
+/* search_wait - Wait for asynchronous search result */
+
+static int search_wait(LDAP *ld, int msgid, int timeout, LDAPMessage **res)
+{
+    int     rc;
+    int     err;
 
+    /*
+     * ldap_parse_result() leaves the result code of the last search in the
+     * handle. Don't let it stick to a search that was submitted earlier.
+     */
+    (void) dict_ldap_set_errno(ld, LDAP_SUCCESS);
     if ((rc = dict_ldap_result(ld, msgid, timeout, res)) != LDAP_SUCCESS)
 	return (rc);
 
@@ -611,6 +619,20 @@ static int search_st(LDAP *ld, char *base, int scope, char *query,
     return (err != LDAP_SUCCESS ? err : rc);
 }
 
+/* search_st - Synchronous search with timeout */
+
+static int search_st(LDAP *ld, char *base, int scope, char *query,
+		             char **attrs, int timeout, LDAPMessage **res)
+{
+    int     msgid;
+    int     rc;
+
+    if ((rc = search_submit(ld, base, scope, query, attrs, timeout,
+			    &msgid)) != LDAP_SUCCESS)
+	return rc;
+    return (search_wait(ld, msgid, timeout, res));
+}
+
 #ifdef LDAP_API_FEATURE_X_OPENLDAP
 static int dict_ldap_set_tls_options(DICT_LDAP *dict_ldap)
 {
@@ -1070,6 +1092,147 @@ static char **url_attrs(DICT_LDAP *dict_ldap, LDAPURLDesc * url)
     return ((attrs->argc > 0) ? attrs->argv : 0);
 }
 
+static void dict_ldap_get_values(DICT_LDAP *, LDAPMessage *, VSTRING *,
+				         const char *);
+
+ /*
+  * The DN and URL values of a special result attribute are looked up with
+  * up to this many searches in flight. With large groups, this saves one
+  * server round trip per member.
+  */
+#define DICT_LDAP_MAX_PENDING	32
+
+typedef struct {
+    char   *value;			/* DN or URL */
+    int     msgid;			/* search in flight, or -1 */
+    int     rc;				/* search submission status */
+} DICT_LDAP_PENDING;
+
+/*
+ * dict_ldap_get_special: look up the DN or URL values of a special result
+ * attribute, and recurse to collect the values found. Searches are
+ * submitted in batches before waiting for their results, and results are
+ * processed in submission order.
+ */
+static void dict_ldap_get_special(DICT_LDAP *dict_ldap, struct berval **vals,
+				          int valcount, VSTRING *result,
+				          const char *name, int recursion)
+{
+    const char *myname = "dict_ldap_get_special";
+    DICT_LDAP_PENDING pending[DICT_LDAP_MAX_PENDING];
+    DICT_LDAP_PENDING *pp;
+    LDAPMessage *resloop;
+    LDAPURLDesc *url;
+    char  **attrs;
+    int     first;
+    int     count;
+    int     rc;
+    int     i;
+
+    for (first = 0; first < valcount && dict_ldap->dict.error == 0;
+	 first += count) {
+	count = valcount - first;
+	if (count > DICT_LDAP_MAX_PENDING)
+	    count = DICT_LDAP_MAX_PENDING;
+
+	/*
+	 * Submit a batch of searches.
+	 */
+	for (i = 0; i < count; i++) {
+	    pp = pending + i;
+	    pp->value = vals[first + i]->bv_val;
+	    pp->msgid = -1;
+	    pp->rc = LDAP_SUCCESS;
+	    if (dict_ldap->dict.error != 0)
+		continue;
+	    if (ldap_is_ldap_url(pp->value)) {
+		rc = ldap_url_parse(pp->value, &url);
+		if (rc == 0) {
+		    if ((attrs = url_attrs(dict_ldap, url)) != 0) {
+			if (msg_verbose)
+			    msg_info("%s[%d]: looking up URL %s",
+				     myname, recursion, pp->value);
+			pp->rc = search_submit(dict_ldap->ld, url->lud_dn,
+					       url->lud_scope,
+					       url->lud_filter, attrs,
+					       dict_ldap->timeout,
+					       &pp->msgid);
+		    }
+		    ldap_free_urldesc(url);
+		    if (attrs == 0) {
+			if (msg_verbose)
+			    msg_info("%s[%d]: skipping URL %s: no "
+				     "pertinent attributes", myname,
+				     recursion, pp->value);
+			continue;
+		    }
+		} else {
+		    msg_warn("%s[%d]: malformed URL %s: %s(%d)",
+			     myname, recursion, pp->value,
+			     ldap_err2string(rc), rc);
+		    dict_ldap->dict.error = DICT_ERR_RETRY;
+		}
+	    } else {
+		if (msg_verbose)
+		    msg_info("%s[%d]: looking up DN %s",
+			     myname, recursion, pp->value);
+		pp->rc = search_submit(dict_ldap->ld, pp->value,
+				       LDAP_SCOPE_BASE, "objectclass=*",
+				       dict_ldap->result_attributes->argv,
+				       dict_ldap->timeout, &pp->msgid);
+	    }
+	    if (pp->rc != LDAP_SUCCESS)
+		pp->msgid = -1;
+	}
+
+	/*
+	 * Collect the results. After an error, abandon the searches that are
+	 * still in flight, without clobbering the error code that our caller
+	 * will inspect.
+	 */
+	for (i = 0; i < count; i++) {
+	    pp = pending + i;
+	    if (dict_ldap->dict.error != 0) {
+		if (pp->msgid >= 0) {
+		    rc = dict_ldap_get_errno(dict_ldap->ld);
+		    (void) dict_ldap_abandon(dict_ldap->ld, pp->msgid);
+		    (void) dict_ldap_set_errno(dict_ldap->ld, rc);
+		}
+		continue;
+	    }
+	    resloop = 0;
+	    if (pp->msgid >= 0)
+		rc = search_wait(dict_ldap->ld, pp->msgid, dict_ldap->timeout,
+				 &resloop);
+	    else if (pp->rc != LDAP_SUCCESS)
+		rc = pp->rc;
+	    else
+		continue;			/* skipped URL */
+	    switch (rc) {
+	    case LDAP_SUCCESS:
+		dict_ldap_get_values(dict_ldap, resloop, result, name);
+		break;
+	    case LDAP_NO_SUCH_OBJECT:
+
+		/*
+		 * Go ahead and treat this as though the DN existed and just
+		 * didn't have any result attributes.
+		 */
+		msg_warn("%s[%d]: DN %s not found, skipping ", myname,
+			 recursion, pp->value);
+		break;
+	    default:
+		msg_warn("%s[%d]: search error %d: %s ", myname,
+			 recursion, rc, ldap_err2string(rc));
+		dict_ldap->dict.error = DICT_ERR_RETRY;
+		break;
+	    }
+	    if (resloop != 0)
+		ldap_msgfree(resloop);
+	}
+    }
+}
+
 /*
  * dict_ldap_get_values: for each entry returned by a search, get the values
  * of all its attributes. Recurses to resolve any DN or URL values found.
@@ -1084,15 +1247,11 @@ static void dict_ldap_get_values(DICT_LDAP *dict_ldap, LDAPMessage *res,
     static int expansion;
     long    entries = 0;
     long    i = 0;
-    int     rc = 0;
-    LDAPMessage *resloop = 0;
     LDAPMessage *entry = 0;
     BerElement *ber;
     char   *attr;
-    char  **attrs;
     struct berval **vals;
     int     valcount;
-    LDAPURLDesc *url;
     const char *myname = "dict_ldap_get_values";
     int     is_leaf = 1;		/* No recursion via this entry */
     int     is_terminal = 0;		/* No expansion via this entry */
@@ -1236,71 +1395,8 @@ static void dict_ldap_get_values(DICT_LDAP *dict_ldap, LDAPMessage *res,
 	    } else if (recursion < dict_ldap->recursion_limit
 		       && dict_ldap->result_attributes->argv[i]) {
 		/* Special result attribute */
-		for (i = 0; i < valcount; i++) {
-		    if (ldap_is_ldap_url(vals[i]->bv_val)) {
-			rc = ldap_url_parse(vals[i]->bv_val, &url);
-			if (rc == 0) {
-			    if ((attrs = url_attrs(dict_ldap, url)) != 0) {
-				if (msg_verbose)
-				    msg_info("%s[%d]: looking up URL %s",
-					     myname, recursion,
-					     vals[i]->bv_val);
-				rc = search_st(dict_ldap->ld, url->lud_dn,
-					       url->lud_scope,
-					       url->lud_filter,
-					       attrs, dict_ldap->timeout,
-					       &resloop);
-			    }
-			    ldap_free_urldesc(url);
-			    if (attrs == 0) {
-				if (msg_verbose)
-				    msg_info("%s[%d]: skipping URL %s: no "
-					     "pertinent attributes", myname,
-					     recursion, vals[i]->bv_val);
-				continue;
-			    }
-			} else {
-			    msg_warn("%s[%d]: malformed URL %s: %s(%d)",
-				     myname, recursion, vals[i]->bv_val,
-				     ldap_err2string(rc), rc);
-			    dict_ldap->dict.error = DICT_ERR_RETRY;
-			    break;
-			}
-		    } else {
-			if (msg_verbose)
-			    msg_info("%s[%d]: looking up DN %s",
-				     myname, recursion, vals[i]->bv_val);
-			rc = search_st(dict_ldap->ld, vals[i]->bv_val,
-				       LDAP_SCOPE_BASE, "objectclass=*",
-				       dict_ldap->result_attributes->argv,
-				       dict_ldap->timeout, &resloop);
-		    }
-		    switch (rc) {
-		    case LDAP_SUCCESS:
-			dict_ldap_get_values(dict_ldap, resloop, result, name);
-			break;
-		    case LDAP_NO_SUCH_OBJECT:
-
-			/*
-			 * Go ahead and treat this as though the DN existed
-			 * and just didn't have any result attributes.
-			 */
-			msg_warn("%s[%d]: DN %s not found, skipping ", myname,
-				 recursion, vals[i]->bv_val);
-			break;
-		    default:
-			msg_warn("%s[%d]: search error %d: %s ", myname,
-				 recursion, rc, ldap_err2string(rc));
-			dict_ldap->dict.error = DICT_ERR_RETRY;
-			break;
-		    }
-
-		    if (resloop != 0)
-			ldap_msgfree(resloop);
-
-		    if (dict_ldap->dict.error != 0)
-			break;
-		}
+		dict_ldap_get_special(dict_ldap, vals, valcount, result, name,
+				      recursion);
 		if (msg_verbose && dict_ldap->dict.error == 0)
 		    msg_info("%s[%d]: search returned %d value(s) for"
 			     " special result attribute %s",
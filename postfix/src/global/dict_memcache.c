@@ -17,6 +17,14 @@
 /*
 /*	Configuration parameters are described in memcache_table(5).
 /*
+/*	With multiple memcache servers, each key is assigned to one
+/*	server with consistent hashing, so that adding or removing
+/*	a server moves only the keys of that server. A multi-key
+/*	search (see dict_get_first(3)) sends one "get" request with
+/*	all applicable keys to each server. Per-server request
+/*	counts and latencies are logged periodically, if enabled
+/*	with the statistics_interval parameter.
+/*
 /*	Arguments:
 /* .IP name
 /*	The path to the Postfix memcache configuration file.
@@ -44,8 +52,10 @@
 /* System library. */
 
 #include <sys_defs.h>
+#include <sys/time.h>
 #include <errno.h>
 #include <string.h>
+#include <stdlib.h>			/* qsort() */
 #include <ctype.h>
 #include <stdio.h>			/* XXX sscanf() */
 
@@ -58,6 +68,7 @@
 #include <stringops.h>
 #include <auto_clnt.h>
 #include <vstream.h>
+#include <argv.h>
 
 /* Global library. */
 
@@ -69,6 +80,28 @@
 
 #include <dict_memcache.h>
 
+ /*
+  * One memcache server, with request statistics.
+  */
+typedef struct {
+    char   *endpoint;			/* memcache server spec */
+    AUTO_CLNT *clnt;			/* memcache client stream */
+    unsigned long requests;		/* completed requests */
+    unsigned long errors;		/* failed requests */
+    double  total_time;			/* seconds, all completed */
+    double  max_time;			/* seconds, slowest completed */
+} DICT_MC_SERVER;
+
+ /*
+  * One point on the consistent hashing ring.
+  */
+typedef struct {
+    UINT32_TYPE point;			/* hash value */
+    int     server;			/* server index */
+} DICT_MC_POINT;
+
+#define DICT_MC_POINTS_PER_SERVER	160
+
  /*
   * Structure of one memcache dictionary handle.
   */
@@ -84,11 +117,23 @@ typedef struct {
     int     max_tries;			/* number of tries */
     int     max_line;			/* reply line limit */
     int     max_data;			/* reply data limit */
-    char   *memcache;			/* memcache server spec */
-    AUTO_CLNT *clnt;			/* memcache client stream */
+    int     stat_interval;		/* statistics logging interval */
+    time_t  stat_logged;		/* last statistics logging time */
+    char   *memcache;			/* memcache server specs */
+    DICT_MC_SERVER *servers;		/* memcache servers */
+    int     server_count;		/* number of servers */
+    DICT_MC_POINT *ring;		/* consistent hashing ring */
+    int     ring_size;			/* number of ring points */
+    DICT_MC_SERVER *server;		/* server for key_buf */
     VSTRING *clnt_buf;			/* memcache client buffer */
     VSTRING *key_buf;			/* lookup key */
     VSTRING *res_buf;			/* lookup result */
+    ARGV   *mget_keys;			/* multi-key memcache keys */
+    int    *mget_servers;		/* multi-key server indices */
+    int     mget_size;			/* multi-key array size */
+    VSTRING *mget_req;			/* multi-key request */
+    VSTRING *mget_res;			/* multi-key candidate result */
+    VSTRING *mget_skip;			/* multi-key other results */
     int     error;			/* memcache dict_errno */
     DICT   *backup;			/* persistent backup */
 } DICT_MC;
@@ -107,6 +152,7 @@ typedef struct {
 #define DICT_MC_DEF_MAX_LINE	1024
 #define DICT_MC_DEF_MAX_DATA	10240
 #define DICT_MC_DEF_ERR_PAUSE	1
+#define DICT_MC_DEF_STAT_INTERVAL	0
 
 #define DICT_MC_NAME_MEMCACHE	"memcache"
 #define DICT_MC_NAME_BACKUP	"backup"
@@ -118,6 +164,7 @@ typedef struct {
 #define DICT_MC_NAME_MAX_LINE	"line_size_limit"
 #define DICT_MC_NAME_MAX_DATA	"data_size_limit"
 #define DICT_MC_NAME_ERR_PAUSE	"retry_pause"
+#define DICT_MC_NAME_STAT_INTERVAL	"statistics_interval"
 
  /*
   * SLMs.
@@ -127,10 +174,134 @@ typedef struct {
 
 /*#define msg_verbose 1*/
 
+/* dict_memcache_hash - FNV-1a string hash */
+
+static UINT32_TYPE dict_memcache_hash(const char *str)
+{
+    UINT32_TYPE hash = 0x811c9dc5;
+
+    while (*str)
+	hash = (hash ^ *(const unsigned char *) str++) * 0x01000193;
+    return (hash);
+}
+
+/* dict_memcache_point_cmp - sort ring points */
+
+static int dict_memcache_point_cmp(const void *a, const void *b)
+{
+    UINT32_TYPE pa = ((const DICT_MC_POINT *) a)->point;
+    UINT32_TYPE pb = ((const DICT_MC_POINT *) b)->point;
+
+    return (pa < pb ? -1 : pa > pb ? 1 : 0);
+}
+
+/* dict_memcache_server_index - find server for memcache key */
+
+static int dict_memcache_server_index(DICT_MC *dict_mc, const char *key)
+{
+    UINT32_TYPE hash;
+    int     lo;
+    int     hi;
+    int     mid;
+
+    if (dict_mc->server_count == 1)
+	return (0);
+
+    /*
+     * The key belongs to the first ring point at or after its hash value,
+     * wrapping around at the end of the ring.
+     */
+    hash = dict_memcache_hash(key);
+    for (lo = 0, hi = dict_mc->ring_size; lo < hi; /* void */ ) {
+	mid = (lo + hi) / 2;
+	if (dict_mc->ring[mid].point < hash)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (lo == dict_mc->ring_size)
+	lo = 0;
+    return (dict_mc->ring[lo].server);
+}
+
+/* dict_memcache_ring_init - build consistent hashing ring */
+
+static void dict_memcache_ring_init(DICT_MC *dict_mc)
+{
+    VSTRING *buf = vstring_alloc(100);
+    DICT_MC_POINT *pp;
+    int     server;
+    int     n;
+
+    dict_mc->ring_size = dict_mc->server_count * DICT_MC_POINTS_PER_SERVER;
+    pp = dict_mc->ring = (DICT_MC_POINT *)
+	mymalloc(sizeof(*dict_mc->ring) * dict_mc->ring_size);
+    for (server = 0; server < dict_mc->server_count; server++) {
+	for (n = 0; n < DICT_MC_POINTS_PER_SERVER; n++, pp++) {
+	    vstring_sprintf(buf, "%s-%d",
+			    dict_mc->servers[server].endpoint, n);
+	    pp->point = dict_memcache_hash(STR(buf));
+	    pp->server = server;
+	}
+    }
+    qsort((void *) dict_mc->ring, dict_mc->ring_size,
+	  sizeof(*dict_mc->ring), dict_memcache_point_cmp);
+    vstring_free(buf);
+}
+
+/* dict_memcache_stat_log - log and reset server request statistics */
+
+static void dict_memcache_stat_log(DICT_MC *dict_mc)
+{
+    DICT_MC_SERVER *mcs;
+
+    for (mcs = dict_mc->servers;
+	 mcs < dict_mc->servers + dict_mc->server_count; mcs++) {
+	if (mcs->requests == 0 && mcs->errors == 0)
+	    continue;
+	msg_info("database %s:%s: server %s: requests=%lu errors=%lu "
+		 "latency avg=%.3fms max=%.3fms",
+		 DICT_TYPE_MEMCACHE, dict_mc->dict.name, mcs->endpoint,
+		 mcs->requests, mcs->errors, mcs->requests ?
+		 1000.0 * mcs->total_time / mcs->requests : 0.0,
+		 1000.0 * mcs->max_time);
+	mcs->requests = mcs->errors = 0;
+	mcs->total_time = mcs->max_time = 0;
+    }
+}
+
+/* dict_memcache_stat - update server request statistics */
+
+static void dict_memcache_stat(DICT_MC *dict_mc, DICT_MC_SERVER *mcs,
+			               struct timeval * start, int error)
+{
+    struct timeval now;
+    double  elapsed;
+
+    GETTIMEOFDAY(&now);
+    if (error) {
+	mcs->errors += 1;
+    } else {
+	elapsed = (now.tv_sec - start->tv_sec)
+	    + (now.tv_usec - start->tv_usec) / 1000000.0;
+	mcs->requests += 1;
+	mcs->total_time += elapsed;
+	if (elapsed > mcs->max_time)
+	    mcs->max_time = elapsed;
+    }
+    if (dict_mc->stat_interval > 0
+	&& now.tv_sec >= dict_mc->stat_logged + dict_mc->stat_interval) {
+	dict_memcache_stat_log(dict_mc);
+	dict_mc->stat_logged = now.tv_sec;
+    }
+}
+
 /* dict_memcache_set - set memcache key/value */
 
 static int dict_memcache_set(DICT_MC *dict_mc, const char *value, int ttl)
 {
+    DICT_MC_SERVER *mcs = dict_mc->server;
+    struct timeval start;
     VSTREAM *fp;
     int     count;
     size_t  data_len = strlen(value);
@@ -150,7 +321,8 @@ static int dict_memcache_set(DICT_MC *dict_mc, const char *value, int ttl)
     for (count = 0; count < dict_mc->max_tries; count++) {
 	if (count > 0)
 	    sleep(dict_mc->err_pause);
-	if ((fp = auto_clnt_access(dict_mc->clnt)) == 0) {
+	GETTIMEOFDAY(&start);
+	if ((fp = auto_clnt_access(mcs->clnt)) == 0) {
 	    break;
 	} else if (memcache_printf(fp, "set %s %d %d %ld",
 				   STR(dict_mc->key_buf), dict_mc->mc_flags,
@@ -169,10 +341,12 @@ static int dict_memcache_set(DICT_MC *dict_mc, const char *value, int ttl)
 			 STR(dict_mc->clnt_buf));
 	} else {
 	    /* Victory! */
+	    dict_memcache_stat(dict_mc, mcs, &start, 0);
 	    DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_NONE, DICT_STAT_SUCCESS);
 	}
-	auto_clnt_recover(dict_mc->clnt);
+	auto_clnt_recover(mcs->clnt);
     }
+    dict_memcache_stat(dict_mc, mcs, &start, 1);
     DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_RETRY, DICT_STAT_ERROR);
 }
 
@@ -180,6 +354,8 @@ static int dict_memcache_set(DICT_MC *dict_mc, const char *value, int ttl)
 
 static const char *dict_memcache_get(DICT_MC *dict_mc)
 {
+    DICT_MC_SERVER *mcs = dict_mc->server;
+    struct timeval start;
     VSTREAM *fp;
     long    todo;
     int     count;
@@ -187,7 +363,8 @@ static const char *dict_memcache_get(DICT_MC *dict_mc)
     for (count = 0; count < dict_mc->max_tries; count++) {
 	if (count > 0)
 	    sleep(dict_mc->err_pause);
-	if ((fp = auto_clnt_access(dict_mc->clnt)) == 0) {
+	GETTIMEOFDAY(&start);
+	if ((fp = auto_clnt_access(mcs->clnt)) == 0) {
 	    break;
 	} else if (memcache_printf(fp, "get %s", STR(dict_mc->key_buf)) < 0
 	    || memcache_get(fp, dict_mc->clnt_buf, dict_mc->max_line) < 0) {
@@ -197,6 +374,7 @@ static const char *dict_memcache_get(DICT_MC *dict_mc)
 			 DICT_TYPE_MEMCACHE, dict_mc->dict.name);
 	} else if (strcmp(STR(dict_mc->clnt_buf), "END") == 0) {
 	    /* Not found. */
+	    dict_memcache_stat(dict_mc, mcs, &start, 0);
 	    DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_NONE, (char *) 0);
 	} else if (sscanf(STR(dict_mc->clnt_buf),
 			  "VALUE %*s %*s %ld", &todo) != 1
@@ -212,11 +390,13 @@ static const char *dict_memcache_get(DICT_MC *dict_mc)
 	    /* Victory! */
 	    if (memcache_get(fp, dict_mc->clnt_buf, dict_mc->max_line) < 0
 		|| strcmp(STR(dict_mc->clnt_buf), "END") != 0)
-		auto_clnt_recover(dict_mc->clnt);
+		auto_clnt_recover(mcs->clnt);
+	    dict_memcache_stat(dict_mc, mcs, &start, 0);
 	    DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_NONE, STR(dict_mc->res_buf));
 	}
-	auto_clnt_recover(dict_mc->clnt);
+	auto_clnt_recover(mcs->clnt);
     }
+    dict_memcache_stat(dict_mc, mcs, &start, 1);
     DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_RETRY, (char *) 0);
 }
 
@@ -224,13 +404,16 @@ static const char *dict_memcache_get(DICT_MC *dict_mc)
 
 static int dict_memcache_del(DICT_MC *dict_mc)
 {
+    DICT_MC_SERVER *mcs = dict_mc->server;
+    struct timeval start;
     VSTREAM *fp;
     int     count;
 
     for (count = 0; count < dict_mc->max_tries; count++) {
 	if (count > 0)
 	    sleep(dict_mc->err_pause);
-	if ((fp = auto_clnt_access(dict_mc->clnt)) == 0) {
+	GETTIMEOFDAY(&start);
+	if ((fp = auto_clnt_access(mcs->clnt)) == 0) {
 	    break;
 	} else if (memcache_printf(fp, "delete %s", STR(dict_mc->key_buf)) < 0
 	    || memcache_get(fp, dict_mc->clnt_buf, dict_mc->max_line) < 0) {
@@ -240,9 +423,11 @@ static int dict_memcache_del(DICT_MC *dict_mc)
 			 DICT_TYPE_MEMCACHE, dict_mc->dict.name);
 	} else if (strcmp(STR(dict_mc->clnt_buf), "DELETED") == 0) {
 	    /* Victory! */
+	    dict_memcache_stat(dict_mc, mcs, &start, 0);
 	    DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_NONE, DICT_STAT_SUCCESS);
 	} else if (strcmp(STR(dict_mc->clnt_buf), "NOT_FOUND") == 0) {
 	    /* Not found! */
+	    dict_memcache_stat(dict_mc, mcs, &start, 0);
 	    DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_NONE, DICT_STAT_FAIL);
 	} else {
 	    if (count > 0)
@@ -250,8 +435,9 @@ static int dict_memcache_del(DICT_MC *dict_mc)
 			 DICT_TYPE_MEMCACHE, dict_mc->dict.name,
 			 STR(dict_mc->clnt_buf));
 	}
-	auto_clnt_recover(dict_mc->clnt);
+	auto_clnt_recover(mcs->clnt);
     }
+    dict_memcache_stat(dict_mc, mcs, &start, 1);
     DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_RETRY, DICT_STAT_ERROR);
 }
 
@@ -287,6 +473,12 @@ static ssize_t dict_memcache_prepare_key(DICT_MC *dict_mc, const char *name)
 	vstring_strcpy(dict_mc->key_buf, name);
     }
 
+    /*
+     * Select the server for this key.
+     */
+    dict_mc->server = dict_mc->servers
+	+ dict_memcache_server_index(dict_mc, STR(dict_mc->key_buf));
+
     /*
      * The length indicates whether the expansion is empty or not.
      */
@@ -409,6 +601,195 @@ static const char *dict_memcache_lookup(DICT *dict, const char *name)
     return (retval);
 }
 
+/* dict_memcache_mget_reply - receive multi-key lookup reply */
+
+static int dict_memcache_mget_reply(DICT_MC *dict_mc, VSTREAM *fp,
+				            int server, int limit)
+{
+    char  **keys = dict_mc->mget_keys->argv;
+    int     best = limit;
+    VSTRING *buf;
+    char   *key;
+    char   *cp;
+    long    todo;
+    int     n;
+
+    /*
+     * Receive VALUE blocks until END. A block is stored as the candidate
+     * result only if it belongs to a key that precedes all keys found so
+     * far. Other blocks must still be read, to stay in sync.
+     */
+    for (;;) {
+	if (memcache_get(fp, dict_mc->clnt_buf, dict_mc->max_line) < 0)
+	    return (-1);
+	if (strcmp(STR(dict_mc->clnt_buf), "END") == 0)
+	    return (best);
+	if (strncmp(STR(dict_mc->clnt_buf), "VALUE ", 6) != 0
+	    || (cp = strchr(key = STR(dict_mc->clnt_buf) + 6, ' ')) == 0
+	    || (*cp++ = 0, sscanf(cp, "%*s %ld", &todo) != 1)
+	    || todo < 0 || todo > dict_mc->max_data) {
+	    msg_warn("%s: unexpected memcache server reply: %.30s",
+		     dict_mc->dict.name, STR(dict_mc->clnt_buf));
+	    return (-1);
+	}
+	for (n = 0; n < best; n++)
+	    if (dict_mc->mget_servers[n] == server && strcmp(keys[n], key) == 0)
+		break;
+	buf = (n < best ? dict_mc->mget_res : dict_mc->mget_skip);
+	if (memcache_fread(fp, buf, todo) < 0) {
+	    msg_warn("%s: EOF receiving memcache server reply",
+		     dict_mc->dict.name);
+	    return (-1);
+	}
+	if (n < best)
+	    best = n;
+    }
+}
+
+/* dict_memcache_mget - look up multiple keys on one server */
+
+static int dict_memcache_mget(DICT_MC *dict_mc, int server, int limit)
+{
+    DICT_MC_SERVER *mcs = dict_mc->servers + server;
+    char  **keys = dict_mc->mget_keys->argv;
+    struct timeval start;
+    VSTREAM *fp;
+    int     count;
+    int     best;
+    int     n;
+
+    /*
+     * Request all keys that belong to this server and that precede the
+     * first key found so far, with one "get" command.
+     */
+    VSTRING_RESET(dict_mc->mget_req);
+    for (n = 0; n < limit; n++)
+	if (dict_mc->mget_servers[n] == server)
+	    vstring_sprintf_append(dict_mc->mget_req, " %s", keys[n]);
+    if (LEN(dict_mc->mget_req) == 0)
+	DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_NONE, limit);
+
+    for (count = 0; count < dict_mc->max_tries; count++) {
+	if (count > 0)
+	    sleep(dict_mc->err_pause);
+	GETTIMEOFDAY(&start);
+	if ((fp = auto_clnt_access(mcs->clnt)) == 0) {
+	    break;
+	} else if (memcache_printf(fp, "get%s", STR(dict_mc->mget_req)) < 0
+		   || (best = dict_memcache_mget_reply(dict_mc, fp, server,
+						       limit)) < 0) {
+	    if (count > 0)
+		msg_warn(errno ? "database %s:%s: I/O error: %m" :
+			 "database %s:%s: I/O error",
+			 DICT_TYPE_MEMCACHE, dict_mc->dict.name);
+	} else {
+	    /* Victory! */
+	    dict_memcache_stat(dict_mc, mcs, &start, 0);
+	    DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_NONE, best);
+	}
+	auto_clnt_recover(mcs->clnt);
+    }
+    dict_memcache_stat(dict_mc, mcs, &start, 1);
+    DICT_ERR_VAL_RETURN(dict_mc, DICT_ERR_RETRY, limit);
+}
+
+/* dict_memcache_lookup_first - find the first of multiple keys */
+
+static const char *dict_memcache_lookup_first(DICT *dict, const char **names,
+					              int count, int *index)
+{
+    const char *myname = "dict_memcache_lookup_first";
+    DICT_MC *dict_mc = (DICT_MC *) dict;
+    DICT   *backup = dict_mc->backup;
+    const char *retval = 0;
+    const char *value;
+    int     best = count;
+    int     best_error = DICT_ERR_NONE;
+    int     found;
+    int     server;
+    int     n;
+
+    /*
+     * Prepare the memcache key and server for each name. Skip names with an
+     * inapplicable key, silently, as with single-key lookups. Stop at a
+     * name that cannot be checked due to error.
+     */
+    if (dict_mc->mget_size < count) {
+	dict_mc->mget_size = count;
+	dict_mc->mget_servers = (int *)
+	    myrealloc((void *) dict_mc->mget_servers,
+		      sizeof(*dict_mc->mget_servers) * count);
+    }
+    argv_truncate(dict_mc->mget_keys, 0);
+    for (n = 0; n < count; n++) {
+	if (dict_memcache_valid_key(dict_mc, names[n], "lookup", msg_info)) {
+	    argv_add(dict_mc->mget_keys, STR(dict_mc->key_buf), (char *) 0);
+	    dict_mc->mget_servers[n] = dict_mc->server - dict_mc->servers;
+	} else if (dict_mc->error == 0) {
+	    argv_add(dict_mc->mget_keys, "", (char *) 0);
+	    dict_mc->mget_servers[n] = -1;
+	} else {
+	    best = n;
+	    best_error = dict_mc->error;
+	    break;
+	}
+    }
+
+    /*
+     * Search the memcache first, one request per server. After a hit at
+     * index N, search other servers only for keys that precede N. Without
+     * backup database, an error at index N also limits the search.
+     */
+    for (server = 0; server < dict_mc->server_count && best > 0; server++) {
+	found = dict_memcache_mget(dict_mc, server, best);
+	if (found < best) {
+	    best = found;
+	    best_error = DICT_ERR_NONE;
+	    vstring_strcpy(dict_mc->res_buf, STR(dict_mc->mget_res));
+	    retval = STR(dict_mc->res_buf);
+	} else if (dict_mc->error != 0 && backup == 0) {
+	    for (n = 0; n < best; n++) {
+		if (dict_mc->mget_servers[n] == server) {
+		    best = n;
+		    best_error = dict_mc->error;
+		    retval = 0;
+		    break;
+		}
+	    }
+	}
+    }
+
+    /*
+     * Search the backup database last, for names that precede the memcache
+     * hit. Update the memcache if the data is found.
+     */
+    if (backup) {
+	for (n = 0; n < best; n++) {
+	    if (dict_mc->mget_servers[n] < 0)
+		continue;
+	    backup->error = 0;
+	    if ((value = backup->lookup(backup, names[n])) != 0) {
+		best = n;
+		best_error = DICT_ERR_NONE;
+		retval = value;
+		if (dict_memcache_prepare_key(dict_mc, names[n]) > 0)
+		    dict_memcache_set(dict_mc, retval, dict_mc->mc_ttl);
+		break;
+	    } else if (backup->error != 0) {
+		best = n;
+		best_error = backup->error;
+		retval = 0;
+		break;
+	    }
+	}
+    }
+    if (msg_verbose)
+	msg_info("%s: %s: %d keys => %s", myname, dict_mc->dict.name, count,
+		 retval ? names[best] : best_error ? "(error)" : "(not found)");
+    *index = best;
+    DICT_ERR_VAL_RETURN(dict, best_error, retval);
+}
+
 /* dict_memcache_delete - delete memcache entry */
 
 static int dict_memcache_delete(DICT *dict, const char *name)
@@ -478,16 +859,30 @@ static int dict_memcache_sequence(DICT *dict, int function, const char **key,
 static void dict_memcache_close(DICT *dict)
 {
     DICT_MC *dict_mc = (DICT_MC *) dict;
+    int     n;
 
     cfg_parser_free(dict_mc->parser);
     db_common_free_ctx(dict_mc->dbc_ctxt);
     if (dict_mc->key_format)
 	myfree(dict_mc->key_format);
     myfree(dict_mc->memcache);
-    auto_clnt_free(dict_mc->clnt);
+    if (dict_mc->stat_interval > 0)
+	dict_memcache_stat_log(dict_mc);
+    for (n = 0; n < dict_mc->server_count; n++) {
+	myfree(dict_mc->servers[n].endpoint);
+	auto_clnt_free(dict_mc->servers[n].clnt);
+    }
+    myfree((void *) dict_mc->servers);
+    if (dict_mc->ring)
+	myfree((void *) dict_mc->ring);
     vstring_free(dict_mc->clnt_buf);
     vstring_free(dict_mc->key_buf);
     vstring_free(dict_mc->res_buf);
+    argv_free(dict_mc->mget_keys);
+    myfree((void *) dict_mc->mget_servers);
+    vstring_free(dict_mc->mget_req);
+    vstring_free(dict_mc->mget_res);
+    vstring_free(dict_mc->mget_skip);
     if (dict->fold_buf)
 	vstring_free(dict->fold_buf);
     if (dict_mc->backup)
@@ -500,8 +895,11 @@ static void dict_memcache_close(DICT *dict)
 DICT   *dict_memcache_open(const char *name, int open_flags, int dict_flags)
 {
     DICT_MC *dict_mc;
+    DICT_MC_SERVER *mcs;
     char   *backup;
     CFG_PARSER *parser;
+    ARGV   *servers;
+    int     n;
 
     /*
      * Sanity checks.
@@ -529,6 +927,7 @@ DICT   *dict_memcache_open(const char *name, int open_flags, int dict_flags)
     dict_mc = (DICT_MC *) dict_alloc(DICT_TYPE_MEMCACHE, name,
 				     sizeof(*dict_mc));
     dict_mc->dict.lookup = dict_memcache_lookup;
+    dict_mc->dict.lookup_first = dict_memcache_lookup_first;
     if (open_flags == O_RDWR) {
 	dict_mc->dict.update = dict_memcache_update;
 	dict_mc->dict.delete = dict_memcache_delete;
@@ -559,14 +958,44 @@ DICT   *dict_memcache_open(const char *name, int open_flags, int dict_flags)
 				    DICT_MC_DEF_MAX_LINE, 1, 0);
     dict_mc->max_data = cfg_get_int(dict_mc->parser, DICT_MC_NAME_MAX_DATA,
 				    DICT_MC_DEF_MAX_DATA, 1, 0);
+    dict_mc->stat_interval = cfg_get_int(dict_mc->parser,
+					 DICT_MC_NAME_STAT_INTERVAL,
+					 DICT_MC_DEF_STAT_INTERVAL, 0, 0);
+    dict_mc->stat_logged = time((time_t *) 0);
     dict_mc->memcache = cfg_get_str(dict_mc->parser, DICT_MC_NAME_MEMCACHE,
 				    DICT_MC_DEF_MEMCACHE, 0, 0);
 
     /*
-     * Initialize the memcache client.
+     * Initialize a memcache client for each server. With multiple servers,
+     * build the consistent hashing ring.
      */
-    dict_mc->clnt = auto_clnt_create(dict_mc->memcache, dict_mc->timeout, 0, 0);
+    servers = argv_split(dict_mc->memcache, CHARS_COMMA_SP);
+    if (servers->argc == 0)
+	argv_add(servers, DICT_MC_DEF_MEMCACHE, (char *) 0);
+    dict_mc->server_count = servers->argc;
+    dict_mc->servers = (DICT_MC_SERVER *)
+	mymalloc(sizeof(*dict_mc->servers) * dict_mc->server_count);
+    for (n = 0; n < dict_mc->server_count; n++) {
+	mcs = dict_mc->servers + n;
+	mcs->endpoint = mystrdup(servers->argv[n]);
+	mcs->clnt = auto_clnt_create(mcs->endpoint, dict_mc->timeout, 0, 0);
+	mcs->requests = mcs->errors = 0;
+	mcs->total_time = mcs->max_time = 0;
+    }
+    argv_free(servers);
+    dict_mc->server = dict_mc->servers;
+    dict_mc->ring = 0;
+    dict_mc->ring_size = 0;
+    if (dict_mc->server_count > 1)
+	dict_memcache_ring_init(dict_mc);
     dict_mc->clnt_buf = vstring_alloc(100);
+    dict_mc->mget_keys = argv_alloc(10);
+    dict_mc->mget_size = 10;
+    dict_mc->mget_servers = (int *)
+	mymalloc(sizeof(*dict_mc->mget_servers) * dict_mc->mget_size);
+    dict_mc->mget_req = vstring_alloc(100);
+    dict_mc->mget_res = vstring_alloc(100);
+    dict_mc->mget_skip = vstring_alloc(100);
 
     /*
      * Open the optional backup database.
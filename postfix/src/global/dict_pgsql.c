@@ -94,6 +94,14 @@
 /*	usually begins with "and") see pgsql_table(5).
 /* .IP hosts
 /*	List of hosts to connect to.
+/* .IP prepared_statements
+/*	Send the query to the server once per connection as a prepared
+/*	statement, and send each lookup key as a statement parameter
+/*	instead of as part of a quoted query string. This saves query
+/*	parsing and planning time on the server. Every query template
+/*	expansion must be inside a single-quoted string literal; the
+/*	literal is replaced with a statement parameter. The default
+/*	is "no".
 /* .PP
 /*	For example, if you want the map to reference databases of
 /*	the name "your_db" and execute a query like this: select
@@ -193,6 +201,7 @@ typedef struct {
     unsigned type;			/* TYPEUNIX | TYPEINET | TYPECONNSTRING*/
     unsigned stat;			/* STATUNTRIED | STATFAIL | STATCUR */
     time_t  ts;				/* used for attempting reconnection */
+    int     prepared;			/* statement prepared on connection */
 } HOST;
 
 typedef struct {
@@ -214,12 +223,18 @@ typedef struct {
     ARGV   *hosts;
     PLPGSQL *pldb;
     HOST   *active_host;
+    char   *stmt_text;			/* null or prepared statement text */
+    ARGV   *stmt_params;		/* statement parameter templates */
 } DICT_PGSQL;
 
+#define DICT_PGSQL_STMT_NAME		"postfix_lookup"
+
 
 /* Just makes things a little easier for me.. */
 #define PGSQL_RES PGresult
 
+#define STR(x)	vstring_str(x)
+
 /* internal function declarations */
 static PLPGSQL *plpgsql_init(ARGV *);
 static PGSQL_RES *plpgsql_query(DICT_PGSQL *, const char *, VSTRING *, char *,
@@ -511,6 +526,36 @@ static void dict_pgsql_event(int unused_event, void *context)
 	plpgsql_close_host(host);
 }
 
+/* plpgsql_exec_prepared - execute prepared statement, prepare if needed */
+
+static PGSQL_RES *plpgsql_exec_prepared(DICT_PGSQL *dict_pgsql, HOST *host,
+					        ARGV *values)
+{
+    PGSQL_RES *res;
+
+    /*
+     * A prepared statement lives as long as the connection. Prepare it after
+     * each (re)connect. A failure result is returned to the caller, which
+     * handles it like any other query failure.
+     */
+    if (host->prepared == 0) {
+	if ((res = PQprepare(host->db, DICT_PGSQL_STMT_NAME,
+			     dict_pgsql->stmt_text,
+			     dict_pgsql->stmt_params->argc,
+			     (Oid *) 0)) == 0
+	    || PQresultStatus(res) != PGRES_COMMAND_OK)
+	    return (res);
+	PQclear(res);
+	host->prepared = 1;
+	if (msg_verbose)
+	    msg_info("dict_pgsql: prepared statement on host %s",
+		     host->hostname);
+    }
+    return (PQexecPrepared(host->db, DICT_PGSQL_STMT_NAME,
+			   values->argc, (const char **) values->argv,
+			   (int *) 0, (int *) 0, 0));
+}
+
 /*
  * plpgsql_query - process a PostgreSQL query.  Return PGSQL_RES* on success.
  *			On failure, log failure and try other db instances.
@@ -529,24 +574,48 @@ static PGSQL_RES *plpgsql_query(DICT_PGSQL *dict_pgsql,
     HOST   *host;
     PGSQL_RES *res = 0;
     ExecStatusType status;
+    static ARGV *values;
+    char  **cpp;
 
+    /*
+     * Statement parameters are sent separately from the statement, and need
+     * no quoting. Expand them once for all hosts.
+     */
+    if (dict_pgsql->stmt_text != 0) {
+	if (values == 0)
+	    values = argv_alloc(1);
+	argv_truncate(values, 0);
+	for (cpp = dict_pgsql->stmt_params->argv; *cpp; cpp++) {
+	    VSTRING_RESET(query);
+	    VSTRING_TERMINATE(query);
+	    db_common_expand(dict_pgsql->ctx, *cpp, name, 0, query, 0);
+	    argv_add(values, STR(query), ARGV_END);
+	}
+	argv_terminate(values);
+    }
     while ((host = dict_pgsql_get_active(PLDB, dbname, username, password)) != NULL) {
 
-	/*
-	 * The active host is used to escape strings in the context of the
-	 * active connection's character encoding.
-	 */
-	dict_pgsql->active_host = host;
-	VSTRING_RESET(query);
-	VSTRING_TERMINATE(query);
-	db_common_expand(dict_pgsql->ctx, dict_pgsql->query,
-			 name, 0, query, dict_pgsql_quote);
-	dict_pgsql->active_host = 0;
-
-	/* Check for potential dict_pgsql_quote() failure. */
-	if (host->stat == STATFAIL) {
-	    plpgsql_down_host(host);
-	    continue;
+	if (dict_pgsql->stmt_text != 0) {
+	    res = plpgsql_exec_prepared(dict_pgsql, host, values);
+	} else {
+
+	    /*
+	     * The active host is used to escape strings in the context of
+	     * the active connection's character encoding.
+	     */
+	    dict_pgsql->active_host = host;
+	    VSTRING_RESET(query);
+	    VSTRING_TERMINATE(query);
+	    db_common_expand(dict_pgsql->ctx, dict_pgsql->query,
+			     name, 0, query, dict_pgsql_quote);
+	    dict_pgsql->active_host = 0;
+
+	    /* Check for potential dict_pgsql_quote() failure. */
+	    if (host->stat == STATFAIL) {
+		plpgsql_down_host(host);
+		continue;
+	    }
+	    res = PQexec(host->db, vstring_str(query));
 	}
 
 	/*
@@ -559,7 +628,7 @@ static PGSQL_RES *plpgsql_query(DICT_PGSQL *dict_pgsql,
 	 * returned except in out-of-memory conditions or serious errors such
 	 * as inability to send the command to the server.
 	 */
-	if ((res = PQexec(host->db, vstring_str(query))) != 0) {
+	if (res != 0) {
 
 	    /*
 	     * XXX Because non-null result pointer does not imply success, we
@@ -665,6 +734,7 @@ static void plpgsql_close_host(HOST *host)
     if (host->db)
 	PQfinish(host->db);
     host->db = 0;
+    host->prepared = 0;
     host->stat = STATUNTRIED;
 }
 
@@ -677,11 +747,95 @@ static void plpgsql_down_host(HOST *host)
     if (host->db)
 	PQfinish(host->db);
     host->db = 0;
+    host->prepared = 0;
     host->ts = time((time_t *) 0) + RETRY_CONN_INTV;
     host->stat = STATFAIL;
     event_cancel_timer(dict_pgsql_event, (void *) host);
 }
 
+/* pgsql_parse_statement - convert query template to prepared statement */
+
+static int pgsql_parse_statement(DICT_PGSQL *dict_pgsql)
+{
+    const char *myname = "pgsql_parse_statement";
+    VSTRING *text = vstring_alloc(100);
+    VSTRING *literal = vstring_alloc(100);
+    ARGV   *params = argv_alloc(1);
+    const char *cp;
+    const char *start;
+
+    /*
+     * Replace each single-quoted string literal that contains a template
+     * expansion with a $n parameter; the literal text (with '' unescaped)
+     * becomes the template for the parameter value. Give up on anything
+     * that we cannot convert without understanding SQL: expansions outside
+     * string literals, backslashes in literals (their meaning depends on
+     * server settings), and dollar signs (parameters, dollar quoting).
+     */
+#define PGSQL_PARSE_STMT_RETURN(ok) do { \
+	vstring_free(literal); \
+	if (ok) { \
+	    dict_pgsql->stmt_text = vstring_export(text); \
+	    dict_pgsql->stmt_params = params; \
+	} else { \
+	    vstring_free(text); \
+	    argv_free(params); \
+	} \
+	return (ok); \
+    } while (0)
+
+    for (cp = dict_pgsql->query; *cp; cp++) {
+	switch (*cp) {
+	case '\'':
+	    start = cp;
+	    VSTRING_RESET(literal);
+	    for (cp++; /* void */ ; cp++) {
+		if (*cp == 0 || *cp == '\\') {
+		    msg_warn("%s: %s: unsupported string literal in query",
+			     myname, dict_pgsql->parser->name);
+		    PGSQL_PARSE_STMT_RETURN(0);
+		}
+		if (*cp == '\'') {
+		    if (cp[1] != '\'')
+			break;
+		    cp++;
+		}
+		VSTRING_ADDCH(literal, *cp);
+	    }
+	    VSTRING_TERMINATE(literal);
+	    if (strchr(STR(literal), '%') != 0) {
+		argv_add(params, STR(literal), ARGV_END);
+		vstring_sprintf_append(text, "$%ld", (long) params->argc);
+	    } else {
+		vstring_strncat(text, start, cp - start + 1);
+	    }
+	    break;
+	case '%':
+	    if (cp[1] != '%') {
+		msg_warn("%s: %s: query expansion outside string literal",
+			 myname, dict_pgsql->parser->name);
+		PGSQL_PARSE_STMT_RETURN(0);
+	    }
+	    VSTRING_ADDCH(text, *cp++);
+	    break;
+	case '$':
+	    msg_warn("%s: %s: unsupported '$' in query",
+		     myname, dict_pgsql->parser->name);
+	    PGSQL_PARSE_STMT_RETURN(0);
+	default:
+	    VSTRING_ADDCH(text, *cp);
+	    break;
+	}
+    }
+    VSTRING_TERMINATE(text);
+    argv_terminate(params);
+    if (msg_verbose)
+	msg_info("%s: %s: statement \"%s\" with %ld parameters",
+		 myname, dict_pgsql->parser->name, STR(text),
+		 (long) params->argc);
+    PGSQL_PARSE_STMT_RETURN(1);
+}
+
 /* pgsql_parse_config - parse pgsql configuration file */
 
 static void pgsql_parse_config(DICT_PGSQL *dict_pgsql, const char *pgsqlcf)
@@ -751,6 +905,17 @@ static void pgsql_parse_config(DICT_PGSQL *dict_pgsql, const char *pgsqlcf)
 		     myname, pgsqlcf, dict_pgsql->hosts->argv[0]);
     }
     myfree(hosts);
+
+    /*
+     * Optionally, use a server-side prepared statement instead of a textual
+     * query with client-side quoting.
+     */
+    dict_pgsql->stmt_text = 0;
+    dict_pgsql->stmt_params = 0;
+    if (cfg_get_bool(p, "prepared_statements", 0)
+	&& pgsql_parse_statement(dict_pgsql) == 0)
+	msg_warn("%s: %s: cannot convert query to prepared statement; "
+		 "using textual queries", myname, pgsqlcf);
 }
 
 /* dict_pgsql_open - open PGSQL data base */
@@ -819,6 +984,7 @@ static HOST *host_init(const char *hostname)
     host->hostname = mystrdup(hostname);
     host->stat = STATUNTRIED;
     host->ts = 0;
+    host->prepared = 0;
 
     /*
      * Modern syntax: "postgresql://connection-info".
@@ -872,6 +1038,10 @@ static void dict_pgsql_close(DICT *dict)
 	argv_free(dict_pgsql->hosts);
     if (dict_pgsql->ctx)
 	db_common_free_ctx(dict_pgsql->ctx);
+    if (dict_pgsql->stmt_text)
+	myfree(dict_pgsql->stmt_text);
+    if (dict_pgsql->stmt_params)
+	argv_free(dict_pgsql->stmt_params);
     if (dict->fold_buf)
 	vstring_free(dict->fold_buf);
     dict_free(dict);
@@ -19,6 +19,10 @@
 /*	connects to the proxymap multiserver or to the
 /*	proxywrite single updater.
 /*
+/*	A multi-key search (see dict_get_first(3)) sends all lookup
+/*	requests to the proxymap server as one pipelined batch, and
+/*	costs one round trip instead of one per key.
+/*
 /*	The connection to the Postfix proxymap server is automatically
 /*	closed after $ipc_idle seconds of idle time, or after $ipc_ttl
 /*	seconds of activity.
@@ -242,6 +246,100 @@ static const char *dict_proxy_lookup(DICT *dict, const char *key)
     }
 }
 
+/* dict_proxy_lookup_first - find first of multiple table entries */
+
+static const char *dict_proxy_lookup_first(DICT *dict, const char **keys,
+					           int count, int *index)
+{
+    const char *myname = "dict_proxy_lookup_first";
+    DICT_PROXY *dict_proxy = (DICT_PROXY *) dict;
+    VSTREAM *stream;
+    VSTRING *buf;
+    int     status;
+    int     first_status;
+    int     tries = 0;
+    int     request_flags;
+    int     n;
+
+    /*
+     * Send all lookup requests before reading any reply, so that the
+     * proxymap server sees them as one pipelined batch, and the whole
+     * search costs one round trip. The server replies in request order. We
+     * must read every reply, even after the first match, to keep the stream
+     * in sync.
+     */
+    request_flags = dict_proxy->inst_flags
+	| (dict->flags & DICT_FLAG_RQST_MASK);
+    for (;;) {
+	VSTRING_RESET(dict_proxy->result);
+	VSTRING_TERMINATE(dict_proxy->result);
+	stream = clnt_stream_access(dict_proxy->clnt);
+	errno = 0;
+	tries += 1;
+	for (n = 0; n < count; n++)
+	    if (attr_print(stream, ATTR_FLAG_NONE,
+			   SEND_ATTR_STR(MAIL_ATTR_REQ, PROXY_REQ_LOOKUP),
+			   SEND_ATTR_STR(MAIL_ATTR_TABLE, dict->name),
+			   SEND_ATTR_INT(MAIL_ATTR_FLAGS, request_flags),
+			   SEND_ATTR_STR(MAIL_ATTR_KEY, keys[n]),
+			   ATTR_TYPE_END) != 0)
+		break;
+	if (n == count && vstream_fflush(stream) == 0) {
+	    first_status = PROXY_STAT_NOKEY;
+	    *index = count;
+	    for (n = 0; n < count; n++) {
+		buf = (first_status == PROXY_STAT_NOKEY ?
+		       dict_proxy->result : dict_proxy->reskey);
+		if (attr_scan(stream, ATTR_FLAG_STRICT,
+			      RECV_ATTR_INT(MAIL_ATTR_STATUS, &status),
+			      RECV_ATTR_STR(MAIL_ATTR_VALUE, buf),
+			      ATTR_TYPE_END) != 2)
+		    break;
+		if (msg_verbose)
+		    msg_info("%s: table=%s flags=%s key=%s "
+			     "-> status=%d result=%s", myname, dict->name,
+			     dict_flags_str(request_flags), keys[n],
+			     status, STR(buf));
+		if (first_status == PROXY_STAT_NOKEY
+		    && status != PROXY_STAT_NOKEY) {
+		    first_status = status;
+		    *index = n;
+		}
+	    }
+	}
+	if (n < count) {
+	    if (msg_verbose || tries > 1
+		|| (errno && errno != EPIPE && errno != ENOENT))
+		msg_warn("%s: service %s: %m", myname, VSTREAM_PATH(stream));
+	} else {
+	    switch (first_status) {
+	    case PROXY_STAT_BAD:
+		msg_fatal("%s lookup failed for table \"%s\" key \"%s\": "
+			  "invalid request",
+			  dict_proxy->service, dict->name, keys[*index]);
+	    case PROXY_STAT_DENY:
+		msg_fatal("%s service is not configured for table \"%s\"",
+			  dict_proxy->service, dict->name);
+	    case PROXY_STAT_OK:
+		DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, STR(dict_proxy->result));
+	    case PROXY_STAT_NOKEY:
+		DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, (char *) 0);
+	    case PROXY_STAT_RETRY:
+		DICT_ERR_VAL_RETURN(dict, DICT_ERR_RETRY, (char *) 0);
+	    case PROXY_STAT_CONFIG:
+		DICT_ERR_VAL_RETURN(dict, DICT_ERR_CONFIG, (char *) 0);
+	    default:
+		msg_warn("%s lookup failed for table \"%s\" key \"%s\": "
+			 "unexpected reply status %d",
+			 dict_proxy->service, dict->name, keys[*index],
+			 first_status);
+	    }
+	}
+	clnt_stream_recover(dict_proxy->clnt);
+	sleep(1);				/* XXX make configurable */
+    }
+}
+
 /* dict_proxy_update - update table entry */
 
 static int dict_proxy_update(DICT *dict, const char *key, const char *value)
@@ -455,6 +553,7 @@ DICT   *dict_proxy_open(const char *map, int open_flags, int dict_flags)
     dict_proxy = (DICT_PROXY *)
 	dict_alloc(DICT_TYPE_PROXY, map, sizeof(*dict_proxy));
     dict_proxy->dict.lookup = dict_proxy_lookup;
+    dict_proxy->dict.lookup_first = dict_proxy_lookup_first;
     dict_proxy->dict.update = dict_proxy_update;
     dict_proxy->dict.delete = dict_proxy_delete;
     dict_proxy->dict.sequence = dict_proxy_sequence;
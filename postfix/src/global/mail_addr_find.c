@@ -410,32 +410,37 @@ const char *mail_addr_find_opt(MAPS *path, const char *address, char **extp,
     }
 
     /*
-     * Try @domain.
+     * Try @domain, then domain (optionally, subdomains). These keys are
+     * searched with one maps_find_first() call, so that a table that
+     * supports multi-key lookups can answer them all in one request. The
+     * result is the same as with one maps_find() call per key.
      */
     if (result == 0 && path->error == 0 && ratsign != 0
-	&& (strategy & MA_FIND_AT_DOMAIN) != 0)
-	result = maps_find(path, ratsign, PARTIAL);
-
-    /*
-     * Try domain (optionally, subdomains).
-     */
-    if (result == 0 && path->error == 0 && ratsign != 0
-	&& (strategy & MA_FIND_DOMAIN) != 0) {
+	&& (strategy & (MA_FIND_AT_DOMAIN | MA_FIND_DOMAIN)) != 0) {
+	const char **keys;
 	const char *name;
 	const char *next;
-
-	if ((strategy & MA_FIND_PDMS) && (strategy & MA_FIND_PDDMDS))
-	    msg_warn("mail_addr_find_opt: do not specify both "
-		     "MA_FIND_PDMS and MA_FIND_PDDMDS");
-	for (name = ratsign + 1; *name != 0; name = next) {
-	    if ((result = maps_find(path, name, PARTIAL)) != 0
-		|| path->error != 0
-		|| (strategy & (MA_FIND_PDMS | MA_FIND_PDDMDS)) == 0
-		|| (next = strchr(name + 1, '.')) == 0)
-		break;
-	    if ((strategy & MA_FIND_PDDMDS) == 0)
-		next++;
+	int     count = 0;
+	int     index;
+
+	keys = (const char **) mymalloc(sizeof(*keys) * (strlen(ratsign) + 1));
+	if ((strategy & MA_FIND_AT_DOMAIN) != 0)
+	    keys[count++] = ratsign;
+	if ((strategy & MA_FIND_DOMAIN) != 0) {
+	    if ((strategy & MA_FIND_PDMS) && (strategy & MA_FIND_PDDMDS))
+		msg_warn("mail_addr_find_opt: do not specify both "
+			 "MA_FIND_PDMS and MA_FIND_PDDMDS");
+	    for (name = ratsign + 1; *name != 0; name = next) {
+		keys[count++] = name;
+		if ((strategy & (MA_FIND_PDMS | MA_FIND_PDDMDS)) == 0
+		    || (next = strchr(name + 1, '.')) == 0)
+		    break;
+		if ((strategy & MA_FIND_PDDMDS) == 0)
+		    next++;
+	    }
 	}
+	result = maps_find_first(path, keys, count, PARTIAL, &index);
+	myfree((void *) keys);
     }
 
     /*
@@ -897,6 +897,17 @@ extern int var_proc_limit;
 #define DEF_THROTTLE_TIME	"60s"
 extern int var_throttle_time;
 
+ /*
+  * Master: idle processes to keep ready per service.
+  */
+#define VAR_MIN_IDLE_PROCS	"min_idle_processes"
+#define DEF_MIN_IDLE_PROCS	0
+extern int var_min_idle_procs;
+
+#define VAR_MAX_IDLE_PROCS	"max_idle_processes"
+#define DEF_MAX_IDLE_PROCS	0
+extern int var_max_idle_procs;
+
  /*
   * Master: what master.cf services are turned off.
   */
@@ -3429,6 +3440,18 @@ extern char *var_milt_head_checks;
 #define DEF_MILT_MACRO_DEFLTS		""
 extern char *var_milt_macro_deflts;
 
+#define VAR_MILT_PARALLEL		"milter_parallel_events"
+#define DEF_MILT_PARALLEL		0
+extern bool var_milt_parallel;
+
+#define VAR_MILT_CONN_REUSE		"milter_connection_reuse"
+#define DEF_MILT_CONN_REUSE		0
+extern bool var_milt_conn_reuse;
+
+#define VAR_MILT_BODY_CACHE		"milter_body_cache_limit"
+#define DEF_MILT_BODY_CACHE		10240000
+extern int var_milt_body_cache;
+
  /*
   * What internal mail do we inspect/stamp/etc.? This is not yet safe enough
   * to enable world-wide.
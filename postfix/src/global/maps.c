@@ -16,6 +16,13 @@
 /*	const char *key;
 /*	int	flags;
 /*
+/*	const char *maps_find_first(maps, keys, count, flags, index)
+/*	MAPS	*maps;
+/*	const char **keys;
+/*	int	count;
+/*	int	flags;
+/*	int	*index;
+/*
 /*	MAPS	*maps_free(maps)
 /*	MAPS	*maps;
 /* DESCRIPTION
@@ -39,6 +46,19 @@
 /*	for example, DICT_FLAG_FIXED | DICT_FLAG_PATTERN selects
 /*	dictionaries that have fixed keys or pattern keys.
 /*
+/*	maps_find_first() is equivalent to calling maps_find() for
+/*	each of \fIcount\fR keys in the order given, and stopping at
+/*	the first key that is found or that results in an error.
+/*	Instead of making one lookup per (key, dictionary) pair, it
+/*	makes one dict_get_first(3) request per dictionary, so that
+/*	a dictionary that supports multi-key lookups (such as a
+/*	proxied table) answers all keys in one request. Once a key
+/*	is found, the remaining dictionaries are searched only for
+/*	keys that precede it. The \fIindex\fR result is the array
+/*	index of the key that was found (or that failed); it equals
+/*	\fIcount\fR when no key was found. Zero-length keys are
+/*	never found.
+/*
 /*	maps_free() releases storage claimed by maps_create()
 /*	and conveniently returns a null pointer.
 /*
@@ -97,6 +117,7 @@
 
 #include <argv.h>
 #include <mymalloc.h>
+#include <vstring.h>
 #include <msg.h>
 #include <dict.h>
 #include <stringops.h>
@@ -208,6 +229,101 @@ const char *maps_find(MAPS *maps, const char *name, int flags)
     return (0);
 }
 
+/* maps_find_first - search multiple keys at once */
+
+const char *maps_find_first(MAPS *maps, const char **names, int count,
+			            int flags, int *index)
+{
+    const char *myname = "maps_find_first";
+    static VSTRING *result;
+    char  **map_name;
+    const char *expansion;
+    DICT   *dict;
+    int     best = count;
+    int     best_error = 0;
+    int     limit;
+    int     n;
+
+    /*
+     * Temp. workaround, for buggy callers that pass zero-length keys when
+     * given partial addresses. This is rare; fall back to one maps_find()
+     * call per key.
+     */
+    maps->error = 0;
+    for (limit = 0; limit < count && *names[limit] != 0; limit++)
+	 /* void */ ;
+    if (limit < count) {
+	for (n = 0; n < count; n++) {
+	    if (*names[n] != 0
+		&& (expansion = maps_find(maps, names[n], flags)) != 0) {
+		*index = n;
+		return (expansion);
+	    } else if (maps->error != 0) {
+		*index = n;
+		return (0);
+	    }
+	}
+	*index = count;
+	return (0);
+    }
+
+    /*
+     * The overall result is the (key, dictionary) pair that comes first in
+     * key-major order, as with repeated maps_find() calls. After a match or
+     * an error at key index N, later dictionaries need to be searched only
+     * for keys [0, N).
+     */
+    for (map_name = maps->argv->argv; *map_name && best > 0; map_name++) {
+	if ((dict = dict_handle(*map_name)) == 0)
+	    msg_panic("%s: dictionary not found: %s", myname, *map_name);
+	if (flags != 0 && (dict->flags & flags) == 0)
+	    continue;
+	if ((expansion = dict_get_first(dict, names, best, &n)) != 0) {
+
+	    /*
+	     * An empty result is an error at (n, dict). A match for a key
+	     * in [0, n) in a later dictionary still takes precedence.
+	     */
+	    if (*expansion == 0) {
+		msg_warn("%s lookup of %s returns an empty string result",
+			 maps->title, names[n]);
+		msg_warn("%s should return NO RESULT in case of NOT FOUND",
+			 maps->title);
+		best = n;
+		best_error = DICT_ERR_RETRY;
+		continue;
+	    }
+	    if (msg_verbose)
+		msg_info("%s: %s: %s: %s = %s", myname, maps->title,
+			 *map_name, names[n], expansion);
+	    if (result == 0)
+		result = vstring_alloc(100);
+	    vstring_strcpy(result, expansion);
+	    best = n;
+	    best_error = 0;
+	} else if (dict->error != 0) {
+	    msg_warn("%s:%s lookup error for \"%.100s\"",
+		     dict->type, dict->name, names[n]);
+	    best = n;
+	    best_error = dict->error;
+	}
+    }
+    *index = best;
+    if (best_error != 0) {
+	maps->error = best_error;
+	if (msg_verbose)
+	    msg_info("%s: %s: %s: search aborted",
+		     myname, maps->title, names[best]);
+	return (0);
+    }
+    if (best == count) {
+	if (msg_verbose)
+	    msg_info("%s: %s: %d keys: not found", myname, maps->title, count);
+	return (0);
+    }
+    return (vstring_str(result));
+}
+
 /* maps_free - release storage */
 
 MAPS   *maps_free(MAPS *maps)
@@ -231,11 +347,18 @@ MAPS   *maps_free(MAPS *maps)
 #include <vstream.h>
 #include <vstring_vstream.h>
 
+ /*
+  * Test program. An input line with one key is looked up with maps_find().
+  * An input line with multiple whitespace-separated keys is looked up with
+  * maps_find_first().
+  */
 int     main(int argc, char **argv)
 {
     VSTRING *buf = vstring_alloc(100);
     MAPS   *maps;
     const char *result;
+    ARGV   *keys;
+    int     index;
 
     if (argc != 2)
 	msg_fatal("usage: %s maps", argv[0]);
@@ -245,7 +368,16 @@ int     main(int argc, char **argv)
     while (vstring_fgets_nonl(buf, VSTREAM_IN)) {
 	maps->error = 99;
 	vstream_printf("\"%s\": ", vstring_str(buf));
-	if ((result = maps_find(maps, vstring_str(buf), 0)) != 0) {
+	keys = argv_split(vstring_str(buf), CHARS_SPACE);
+	if (keys->argc > 1) {
+	    result = maps_find_first(maps, (const char **) keys->argv,
+				     keys->argc, 0, &index);
+	    vstream_printf("key %d: ", index);
+	} else {
+	    result = maps_find(maps, vstring_str(buf), 0);
+	}
+	argv_free(keys);
+	if (result != 0) {
 	    vstream_printf("%s\n", result);
 	} else if (maps->error != 0) {
 	    vstream_printf("lookup error\n");
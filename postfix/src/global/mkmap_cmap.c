@@ -0,0 +1,48 @@
+/*++
+/* NAME
+/*	mkmap_cmap 3
+/* SUMMARY
+/*	create or open database, cmap: style
+/* SYNOPSIS
+/*	#include <mkmap.h>
+/*
+/*	MKMAP	*mkmap_cmap_open(path)
+/*	const char *path;
+/* DESCRIPTION
+/*	This module implements support for creating constant
+/*	memory-mapped tables. The dict_cmap module writes a
+/*	temporary file, and renames it into place when the table
+/*	is closed; it needs no help from mkmap_open().
+/* SEE ALSO
+/*	dict_cmap(3), cmap dictionary interface.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+/* Utility library. */
+
+#include <mymalloc.h>
+#include <dict.h>
+#include <dict_cmap.h>
+
+/* Application-specific. */
+
+#include <mkmap.h>
+
+/* mkmap_cmap_open - create or open database */
+
+MKMAP  *mkmap_cmap_open(const char *unused_path)
+{
+    MKMAP  *mkmap = (MKMAP *) mymalloc(sizeof(*mkmap));
+
+    mkmap->open = dict_cmap_open;
+    mkmap->after_open = 0;
+    mkmap->after_close = 0;
+    return (mkmap);
+}
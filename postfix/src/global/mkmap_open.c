@@ -96,6 +96,7 @@
 #include <dict_lmdb.h>
 #include <dict_sdbm.h>
 #include <dict_proxy.h>
+#include <dict_cmap.h>
 #include <dict_fail.h>
 #include <sigdelay.h>
 #include <mymalloc.h>
@@ -136,6 +137,7 @@ static const MKMAP_OPEN_INFO mkmap_open_info[] = {
     DICT_TYPE_HASH, mkmap_hash_open,
     DICT_TYPE_BTREE, mkmap_btree_open,
 #endif
+    DICT_TYPE_CMAP, mkmap_cmap_open,
     DICT_TYPE_FAIL, mkmap_fail_open,
     0,
 };
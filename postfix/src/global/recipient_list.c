@@ -43,6 +43,10 @@
 /*	const char *orig_rcpt;
 /*	const char *recipient;
 /*
+/*	void	recipient_list_move(list, rcpt)
+/*	RECIPIENT_LIST *list;
+/*	RECIPIENT *rcpt;
+/*
 /*	void	recipient_list_swap(a, b)
 /*	RECIPIENT_LIST *a;
 /*	RECIPIENT_LIST *b;
@@ -58,6 +62,10 @@
 /*	int	dsn_notify;
 /*	char	*orig_rcpt;
 /*	char	*recipient;
+/*
+/*	void	RECIPIENT_UPDATE(ptr, new)
+/*	const char *ptr;
+/*	const char *new;
 /* DESCRIPTION
 /*	This module maintains lists of recipient structures. Each
 /*	recipient is characterized by a destination address and
@@ -74,7 +82,19 @@
 /*	RCPT_LIST_INIT_QUEUE to zero the queue field.
 /*
 /*	recipient_list_add() adds a recipient to the specified list.
-/*	Recipient address information is copied with mystrdup().
+/*	Recipient address information is copied. To save memory
+/*	with messages that have many recipients, a copy is shared
+/*	instead of duplicated when the original recipient is equal
+/*	to the recipient address, or when the original recipient or
+/*	DSN original recipient are equal to those of the preceding
+/*	list member. This is typical after mailing list expansion.
+/*
+/*	recipient_list_move() appends a recipient structure from
+/*	another list to the specified list, without making copies
+/*	of recipient address information. The recipient structure
+/*	in the other list is left without address information, and
+/*	must not be used except for releasing the other list with
+/*	recipient_list_free().
 /*
 /*	recipient_list_swap() swaps the recipients between
 /*	the given two recipient lists.
@@ -85,6 +105,9 @@
 /*	RECIPIENT_ASSIGN() assigns the fields of a recipient structure
 /*	without making copies of its arguments.
 /*
+/*	RECIPIENT_UPDATE() replaces address information of a
+/*	recipient list member with a copy of the new value.
+/*
 /*	Arguments:
 /* .IP list
 /*	Recipient list initialized by recipient_list_init().
@@ -114,6 +137,8 @@
 /* System library. */
 
 #include <sys_defs.h>
+#include <stddef.h>
+#include <string.h>
 
 /* Utility library. */
 
@@ -124,6 +149,71 @@
 
 #include "recipient_list.h"
 
+ /*
+  * Address information is stored with a reference count, so that list
+  * members can share one copy. The empty string is not copied at all.
+  */
+typedef struct RCPT_STRING {
+    int     refcount;
+    char    data[1];
+} RCPT_STRING;
+
+#define RCPT_STRING_HDR		offsetof(RCPT_STRING, data)
+#define RCPT_STRING_OF(str)	((RCPT_STRING *) ((str) - RCPT_STRING_HDR))
+
+static const char rcpt_empty_string[] = "";
+
+/* rcpt_string_dup - copy address information */
+
+static const char *rcpt_string_dup(const char *str)
+{
+    RCPT_STRING *rs;
+    size_t  len;
+
+    if (*str == 0)
+	return (rcpt_empty_string);
+    len = strlen(str);
+    rs = (RCPT_STRING *) mymalloc(RCPT_STRING_HDR + len + 1);
+    rs->refcount = 1;
+    memcpy(rs->data, str, len + 1);
+    return (rs->data);
+}
+
+/* rcpt_string_share - share or copy address information */
+
+static const char *rcpt_string_share(const char *copy, const char *str)
+{
+    if (copy != 0 && strcmp(copy, str) == 0) {
+	if (copy != rcpt_empty_string)
+	    RCPT_STRING_OF(copy)->refcount++;
+	return (copy);
+    }
+    return (rcpt_string_dup(str));
+}
+
+/* rcpt_string_free - release address information */
+
+static void rcpt_string_free(const char *str)
+{
+    RCPT_STRING *rs;
+
+    if (str == 0 || str == rcpt_empty_string)
+	return;
+    rs = RCPT_STRING_OF(str);
+    if (--rs->refcount <= 0)
+	myfree((void *) rs);
+}
+
+/* recipient_update - RECIPIENT_UPDATE() helper */
+
+void    recipient_update(const char **ptr, const char *new)
+{
+    const char *old = *ptr;
+
+    *ptr = rcpt_string_dup(new);
+    rcpt_string_free(old);
+}
+
 /* recipient_list_init - initialize */
 
 void    recipient_list_init(RECIPIENT_LIST *list, int variant)
@@ -140,6 +230,7 @@ void    recipient_list_add(RECIPIENT_LIST *list, long offset,
 			           const char *dsn_orcpt, int dsn_notify,
 			           const char *orig_rcpt, const char *rcpt)
 {
+    RECIPIENT *prev;
     int     new_avail;
 
     if (list->len >= list->avail) {
@@ -148,10 +239,15 @@ void    recipient_list_add(RECIPIENT_LIST *list, long offset,
 	    myrealloc((void *) list->info, new_avail * sizeof(RECIPIENT));
 	list->avail = new_avail;
     }
-    list->info[list->len].orig_addr = mystrdup(orig_rcpt);
-    list->info[list->len].address = mystrdup(rcpt);
+    prev = (list->len > 0 ? list->info + list->len - 1 : 0);
+    list->info[list->len].address = rcpt_string_dup(rcpt);
+    list->info[list->len].orig_addr =
+	rcpt_string_share(strcmp(orig_rcpt, rcpt) == 0 ?
+			  list->info[list->len].address :
+			  prev ? prev->orig_addr : 0, orig_rcpt);
     list->info[list->len].offset = offset;
-    list->info[list->len].dsn_orcpt = mystrdup(dsn_orcpt);
+    list->info[list->len].dsn_orcpt =
+	rcpt_string_share(prev ? prev->dsn_orcpt : 0, dsn_orcpt);
     list->info[list->len].dsn_notify = dsn_notify;
     if (list->variant == RCPT_LIST_INIT_STATUS)
 	list->info[list->len].u.status = 0;
@@ -162,6 +258,29 @@ void    recipient_list_add(RECIPIENT_LIST *list, long offset,
     list->len++;
 }
 
+/* recipient_list_move - move rcpt to list */
+
+void    recipient_list_move(RECIPIENT_LIST *list, RECIPIENT *rcpt)
+{
+    int     new_avail;
+
+    if (list->len >= list->avail) {
+	new_avail = list->avail * 2;
+	list->info = (RECIPIENT *)
+	    myrealloc((void *) list->info, new_avail * sizeof(RECIPIENT));
+	list->avail = new_avail;
+    }
+    list->info[list->len] = *rcpt;
+    if (list->variant == RCPT_LIST_INIT_STATUS)
+	list->info[list->len].u.status = 0;
+    else if (list->variant == RCPT_LIST_INIT_QUEUE)
+	list->info[list->len].u.queue = 0;
+    else if (list->variant == RCPT_LIST_INIT_ADDR)
+	list->info[list->len].u.addr_type = 0;
+    list->len++;
+    rcpt->dsn_orcpt = rcpt->orig_addr = rcpt->address = 0;
+}
+
 /* recipient_list_swap - swap recipients between the two recipient lists */
 
 void    recipient_list_swap(RECIPIENT_LIST *a, RECIPIENT_LIST *b)
@@ -183,9 +302,9 @@ void    recipient_list_free(RECIPIENT_LIST *list)
     RECIPIENT *rcpt;
 
     for (rcpt = list->info; rcpt < list->info + list->len; rcpt++) {
-	myfree((void *) rcpt->dsn_orcpt);
-	myfree((void *) rcpt->orig_addr);
-	myfree((void *) rcpt->address);
+	rcpt_string_free(rcpt->dsn_orcpt);
+	rcpt_string_free(rcpt->orig_addr);
+	rcpt_string_free(rcpt->address);
     }
     myfree((void *) list->info);
 }
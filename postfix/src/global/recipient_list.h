@@ -42,9 +42,9 @@ typedef struct RECIPIENT {
     (rcpt)->u.status = (0); \
 } while (0)
 
-#define RECIPIENT_UPDATE(ptr, new) do { \
-    myfree((char *) (ptr)); (ptr) = mystrdup(new); \
-} while (0)
+#define RECIPIENT_UPDATE(ptr, new) recipient_update(&(ptr), (new))
+
+extern void recipient_update(const char **, const char *);
 
 typedef struct RECIPIENT_LIST {
     RECIPIENT *info;
@@ -55,6 +55,7 @@ typedef struct RECIPIENT_LIST {
 
 extern void recipient_list_init(RECIPIENT_LIST *, int);
 extern void recipient_list_add(RECIPIENT_LIST *, long, const char *, int, const char *, const char *);
+extern void recipient_list_move(RECIPIENT_LIST *, RECIPIENT *);
 extern void recipient_list_swap(RECIPIENT_LIST *, RECIPIENT_LIST *);
 extern void recipient_list_free(RECIPIENT_LIST *);
 
@@ -18,6 +18,14 @@
 /*	const char *client_addr;
 /*	SERVER_ACL *intern_acl;
 /*	const char *param_name;
+/*
+/*	int	server_acl_eval_async(client_addr, intern_acl, param_name,
+/*					callback, context)
+/*	const char *client_addr;
+/*	SERVER_ACL *intern_acl;
+/*	const char *param_name;
+/*	void	(*callback)(int action, void *context);
+/*	void	*context;
 /* DESCRIPTION
 /*	This module implements a permanent black/whitelist that
 /*	is meant to be evaluated immediately after a client connects
@@ -36,6 +44,17 @@
 /*	decision), or SERVER_ACL_ACT_ERROR (error, unknown command
 /*	or database access error).
 /*
+/*	server_acl_eval_async() evaluates an access list without
+/*	blocking on tables that support event-driven lookups (see
+/*	dict_get_async(3)); other tables are searched as with
+/*	server_acl_eval(). The result is SERVER_ACL_ACT_PENDING
+/*	when the evaluation is waiting for a table lookup; in that
+/*	case the call-back is invoked later, under control by the
+/*	events(3) manager, with one of the other results above.
+/*	Otherwise, the result is final, and the call-back is not
+/*	invoked. The access list and param_name must not be destroyed
+/*	while evaluation is in progress.
+/*
 /*	Arguments:
 /* .IP mynetworks
 /*	Network addresses that match "permit_mynetworks".
@@ -90,6 +109,17 @@
 static ADDR_MATCH_LIST *server_acl_mynetworks;
 static ADDR_MATCH_LIST *server_acl_mynetworks_host;
 
+ /*
+  * Event-driven evaluation state.
+  */
+typedef struct {
+    char   *client_addr;		/* client address copy */
+    char  **cpp;			/* table in progress */
+    const char *origin;			/* param_name */
+    SERVER_ACL_ASYNC_FN callback;	/* application call-back */
+    void   *context;			/* application context */
+} SERVER_ACL_ASYNC;
+
 #define STR vstring_str
 
 /* server_acl_pre_jail_init - initialize */
@@ -153,20 +183,42 @@ SERVER_ACL *server_acl_parse(const char *extern_acl, const char *origin)
     return (intern_acl);
 }
 
-/* server_acl_eval - evaluate access list */
+/* server_acl_eval_value - evaluate table lookup result */
 
-int     server_acl_eval(const char *client_addr, SERVER_ACL * intern_acl,
-			        const char *origin)
+static int server_acl_eval_value(const char *client_addr, const char *dict_val,
+				         const char *acl)
 {
-    const char *myname = "server_acl_eval";
-    char  **cpp;
-    DICT   *dict;
     SERVER_ACL *argv;
+    int     ret;
+
+    /* Fake up an ARGV to avoid lots of mallocs and frees. */
+    if (dict_val[strcspn(dict_val, ":" CHARS_COMMA_SP)] == 0) {
+	ARGV_FAKE_BEGIN(fake_argv, dict_val);
+	ret = server_acl_eval(client_addr, &fake_argv, acl);
+	ARGV_FAKE_END;
+    } else {
+	argv = server_acl_parse(dict_val, acl);
+	ret = server_acl_eval(client_addr, argv, acl);
+	argv_free(argv);
+    }
+    return (ret);
+}
+
+static void server_acl_async_done(int, const char *, void *);
+
+/* server_acl_walk - evaluate access list, optionally event-driven */
+
+static int server_acl_walk(const char *client_addr, char **cpp,
+			           const char *origin,
+			           SERVER_ACL_ASYNC *async)
+{
+    const char *myname = "server_acl_walk";
+    DICT   *dict;
     const char *acl;
     const char *dict_val;
     int     ret;
 
-    for (cpp = intern_acl->argv; (acl = *cpp) != 0; cpp++) {
+    for ( /* void */ ; (acl = *cpp) != 0; cpp++) {
 	if (msg_verbose)
 	    msg_info("source=%s address=%s acl=%s",
 		     origin, client_addr, acl);
@@ -193,17 +245,14 @@ int     server_acl_eval(const char *client_addr, SERVER_ACL * intern_acl,
 	} else if (strchr(acl, ':') != 0) {
 	    if ((dict = dict_handle(acl)) == 0)
 		msg_panic("%s: unexpected dictionary: %s", myname, acl);
+	    if (async != 0 && dict->lookup_async != 0) {
+		async->cpp = cpp;
+		dict_get_async(dict, client_addr, server_acl_async_done,
+			       (void *) async);
+		return (SERVER_ACL_ACT_PENDING);
+	    }
 	    if ((dict_val = dict_get(dict, client_addr)) != 0) {
-		/* Fake up an ARGV to avoid lots of mallocs and frees. */
-		if (dict_val[strcspn(dict_val, ":" CHARS_COMMA_SP)] == 0) {
-		    ARGV_FAKE_BEGIN(fake_argv, dict_val);
-		    ret = server_acl_eval(client_addr, &fake_argv, acl);
-		    ARGV_FAKE_END;
-		} else {
-		    argv = server_acl_parse(dict_val, acl);
-		    ret = server_acl_eval(client_addr, argv, acl);
-		    argv_free(argv);
-		}
+		ret = server_acl_eval_value(client_addr, dict_val, acl);
 		if (ret != SERVER_ACL_ACT_DUNNO)
 		    return (ret);
 	    } else if (dict->error != 0) {
@@ -225,6 +274,70 @@ int     server_acl_eval(const char *client_addr, SERVER_ACL * intern_acl,
     return (SERVER_ACL_ACT_DUNNO);
 }
 
+/* server_acl_async_done - resume evaluation after table lookup */
+
+static void server_acl_async_done(int error, const char *dict_val,
+				          void *context)
+{
+    SERVER_ACL_ASYNC *async = (SERVER_ACL_ASYNC *) context;
+    const char *acl = *async->cpp;
+    int     ret;
+
+    /*
+     * Evaluate the lookup result as server_acl_walk() would, and continue
+     * with the next access list element if there is no decision yet.
+     */
+    if (dict_val != 0) {
+	ret = server_acl_eval_value(async->client_addr, dict_val, acl);
+    } else if (error != 0) {
+	msg_warn("%s: %s: table lookup error -- ignoring the remainder "
+		 "of this access list", async->origin, acl);
+	ret = SERVER_ACL_ACT_ERROR;
+    } else {
+	ret = SERVER_ACL_ACT_DUNNO;
+    }
+    if (ret == SERVER_ACL_ACT_DUNNO)
+	ret = server_acl_walk(async->client_addr, async->cpp + 1,
+			      async->origin, async);
+    if (ret != SERVER_ACL_ACT_PENDING) {
+	async->callback(ret, async->context);
+	myfree(async->client_addr);
+	myfree((void *) async);
+    }
+}
+
+/* server_acl_eval - evaluate access list */
+
+int     server_acl_eval(const char *client_addr, SERVER_ACL * intern_acl,
+			        const char *origin)
+{
+    return (server_acl_walk(client_addr, intern_acl->argv, origin,
+			    (SERVER_ACL_ASYNC *) 0));
+}
+
+/* server_acl_eval_async - evaluate access list, report result later */
+
+int     server_acl_eval_async(const char *client_addr, SERVER_ACL * intern_acl,
+			              const char *origin,
+			              SERVER_ACL_ASYNC_FN callback,
+			              void *context)
+{
+    SERVER_ACL_ASYNC *async;
+    int     ret;
+
+    async = (SERVER_ACL_ASYNC *) mymalloc(sizeof(*async));
+    async->client_addr = mystrdup(client_addr);
+    async->origin = origin;
+    async->callback = callback;
+    async->context = context;
+    if ((ret = server_acl_walk(client_addr, intern_acl->argv, origin,
+			       async)) != SERVER_ACL_ACT_PENDING) {
+	myfree(async->client_addr);
+	myfree((void *) async);
+    }
+    return (ret);
+}
+
  /*
   * Access lists need testing. Not only with good inputs; error cases must
   * also be handled appropriately.
@@ -235,6 +348,7 @@ int     server_acl_eval(const char *client_addr, SERVER_ACL * intern_acl,
 #include <vstring_vstream.h>
 #include <name_code.h>
 #include <split_at.h>
+#include <events.h>
 
 char   *var_par_dom_match = DEF_PAR_DOM_MATCH;
 char   *var_mynetworks = "";
@@ -242,10 +356,38 @@ char   *var_server_acl = "";
 
 #define UPDATE_VAR(s,v) do { if (*(s)) myfree(s); (s) = mystrdup(v); } while (0)
 
+ /*
+  * With "async_address=value", every table in the access list gets a
+  * lookup_async method that makes a blocking lookup and delivers the result
+  * later, so that server_acl_eval_async() suspends at each table.
+  */
+static int test_suspended;
+
+/* test_lookup_async - suspend the access list walk */
+
+static void test_lookup_async(DICT *dict, const char *key,
+			              DICT_ASYNC_FN callback, void *context)
+{
+    const char *value;
+
+    test_suspended += 1;
+    value = dict_get(dict, key);
+    dict_async_deliver(callback, context, dict->error, value);
+}
+
+/* test_async_done - save the final result */
+
+static void test_async_done(int action, void *context)
+{
+    *(int *) context = action;
+}
+
 int     main(void)
 {
     VSTRING *buf = vstring_alloc(100);
     SERVER_ACL *argv;
+    char  **cpp;
+    DICT   *dict;
     int     ret;
     int     have_tty = isatty(0);
     char   *bufp;
@@ -270,7 +412,8 @@ int     main(void)
 	if (*bufp == '#')
 	    continue;
 	if ((cmd = mystrtok(&bufp, " =")) == 0 || STREQ(cmd, "?")) {
-	    vstream_printf("usage: %s=value|%s=value|address=value\n",
+	    vstream_printf("usage: %s=value|%s=value|address=value"
+			   "|async_address=value\n",
 			   VAR_MYNETWORKS, VAR_SERVER_ACL);
 	} else if ((value = mystrtok(&bufp, " =")) == 0) {
 	    vstream_printf("missing value\n");
@@ -284,6 +427,20 @@ int     main(void)
 	    ret = server_acl_eval(value, argv, VAR_SERVER_ACL);
 	    argv_free(argv);
 	    vstream_printf("%s: %s\n", value, str_name_code(acl_map, ret));
+	} else if (STREQ(cmd, "async_address")) {
+	    server_acl_pre_jail_init(var_mynetworks, VAR_MYNETWORKS);
+	    argv = server_acl_parse(var_server_acl, VAR_SERVER_ACL);
+	    for (cpp = argv->argv; *cpp; cpp++)
+		if (strchr(*cpp, ':') != 0 && (dict = dict_handle(*cpp)) != 0)
+		    dict->lookup_async = test_lookup_async;
+	    test_suspended = 0;
+	    ret = server_acl_eval_async(value, argv, VAR_SERVER_ACL,
+					test_async_done, (void *) &ret);
+	    while (ret == SERVER_ACL_ACT_PENDING)
+		event_loop(-1);
+	    argv_free(argv);
+	    vstream_printf("%s: %s after %d suspended lookups\n", value,
+			   str_name_code(acl_map, ret), test_suspended);
 	} else {
 	    vstream_printf("unknown command: \"%s\"\n", cmd);
 	}
@@ -24,6 +24,10 @@ extern void server_acl_pre_jail_init(const char *, const char *);
 extern SERVER_ACL *server_acl_parse(const char *, const char *);
 extern int server_acl_eval(const char *, SERVER_ACL *, const char *);
 
+typedef void (*SERVER_ACL_ASYNC_FN) (int, void *);
+extern int server_acl_eval_async(const char *, SERVER_ACL *, const char *,
+				         SERVER_ACL_ASYNC_FN, void *);
+
 #define SERVER_ACL_NAME_WL_MYNETWORKS "permit_mynetworks"
 #define SERVER_ACL_NAME_PERMIT	"permit"
 #define SERVER_ACL_NAME_DUNNO	"dunno"
@@ -34,6 +38,7 @@ extern int server_acl_eval(const char *, SERVER_ACL *, const char *);
 #define SERVER_ACL_ACT_DUNNO	0
 #define SERVER_ACL_ACT_REJECT	(-1)
 #define SERVER_ACL_ACT_ERROR	(-2)
+#define SERVER_ACL_ACT_PENDING	(-3)	/* server_acl_eval_async() only */
 
 /* LICENSE
 /* .ad
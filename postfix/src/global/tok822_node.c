@@ -25,6 +25,11 @@
 /*
 /*	tok822_free() releases the memory used for the specified token
 /*	and conveniently returns a null pointer value.
+/*
+/*	Address parsing creates and destroys many tokens for every
+/*	message header. To avoid malloc() and free() overhead, a
+/*	limited number of released tokens are kept for re-use,
+/*	together with their string memory.
 /* LICENSE
 /* .ad
 /* .fi
@@ -50,21 +55,56 @@
 
 #include "tok822.h"
 
+#define CONTAINER_TOKEN(x) \
+	((x) == TOK822_ADDR || (x) == TOK822_STARTGRP)
+
+#define STRING_TOKEN(x) \
+	((x) >= TOK822_MINTOK && !CONTAINER_TOKEN(x))
+
+ /*
+  * Released tokens, linked through their next field. Tokens with string
+  * memory are kept separate from tokens without. A token with a large
+  * string is not kept, so that one unusual header does not pin memory.
+  */
+#define TOK822_FREE_LIMIT	500
+#define TOK822_FREE_STRLEN	256
+
+static TOK822 *tok822_free_str;		/* with string memory */
+static TOK822 *tok822_free_op;		/* without string memory */
+static int tok822_free_count;
+
 /* tok822_alloc - allocate and initialize token */
 
 TOK822 *tok822_alloc(int type, const char *strval)
 {
     TOK822 *tp;
 
-#define CONTAINER_TOKEN(x) \
-	((x) == TOK822_ADDR || (x) == TOK822_STARTGRP)
-
-    tp = (TOK822 *) mymalloc(sizeof(*tp));
+    if (STRING_TOKEN(type)) {
+	if ((tp = tok822_free_str) != 0) {
+	    tok822_free_str = tp->next;
+	    tok822_free_count -= 1;
+	    if (strval == 0) {
+		VSTRING_RESET(tp->vstr);
+		VSTRING_TERMINATE(tp->vstr);
+	    } else {
+		vstring_strcpy(tp->vstr, strval);
+	    }
+	} else {
+	    tp = (TOK822 *) mymalloc(sizeof(*tp));
+	    tp->vstr = (strval == 0 ? vstring_alloc(10) :
+		     vstring_strcpy(vstring_alloc(strlen(strval) + 1), strval));
+	}
+    } else {
+	if ((tp = tok822_free_op) != 0) {
+	    tok822_free_op = tp->next;
+	    tok822_free_count -= 1;
+	} else {
+	    tp = (TOK822 *) mymalloc(sizeof(*tp));
+	    tp->vstr = 0;
+	}
+    }
     tp->type = type;
     tp->next = tp->prev = tp->head = tp->tail = tp->owner = 0;
-    tp->vstr = (type < TOK822_MINTOK || CONTAINER_TOKEN(type) ? 0 :
-		strval == 0 ? vstring_alloc(10) :
-		vstring_strcpy(vstring_alloc(strlen(strval) + 1), strval));
     return (tp);
 }
 
@@ -72,6 +112,18 @@ TOK822 *tok822_alloc(int type, const char *strval)
 
 TOK822 *tok822_free(TOK822 *tp)
 {
+    if (tok822_free_count < TOK822_FREE_LIMIT
+	&& (tp->vstr == 0 || VSTRING_LEN(tp->vstr) <= TOK822_FREE_STRLEN)) {
+	if (tp->vstr) {
+	    tp->next = tok822_free_str;
+	    tok822_free_str = tp;
+	} else {
+	    tp->next = tok822_free_op;
+	    tok822_free_op = tp;
+	}
+	tok822_free_count += 1;
+	return (0);
+    }
     if (tp->vstr)
 	vstring_free(tp->vstr);
     myfree((void *) tp);
@@ -120,6 +120,7 @@
 
 #include <sys_defs.h>
 #include <ctype.h>
+#include <limits.h>
 #include <string.h>
 
 /* Utility library. */
@@ -135,26 +136,32 @@
 #include "tok822.h"
 
  /*
-  * I suppose this is my favorite macro. Used heavily for tokenizing.
+  * Character classes for the tokenizer. A table lookup replaces the
+  * strchr() calls that used to be made for every input character, and
+  * makes it possible to copy a run of ordinary characters in one
+  * operation instead of one character at a time.
   */
-#define COLLECT(t,s,c,cond) { \
-	while ((c = *(unsigned char *) s) != 0) { \
-	    if (c == '\\') { \
-		if ((c = *(unsigned char *)++s) == 0) \
-		    break; \
-	    } else if (!(cond)) { \
-		break; \
-	    } \
-	    VSTRING_ADDCH(t->vstr, IS_SPACE_TAB_CR_LF(c) ? ' ' : c); \
-	    s++; \
-	} \
-	VSTRING_TERMINATE(t->vstr); \
-    }
+#define TOK822_CL_END	(1<<0)		/* null terminator */
+#define TOK822_CL_BSL	(1<<1)		/* backslash */
+#define TOK822_CL_WSP	(1<<2)		/* tab, cr, lf */
+#define TOK822_CL_SP	(1<<3)		/* space */
+#define TOK822_CL_OP	(1<<4)		/* operator character */
+#define TOK822_CL_CTRL	(1<<5)		/* control character */
+#define TOK822_CL_DQ	(1<<6)		/* end of quoted string */
+#define TOK822_CL_RB	(1<<7)		/* end of domain literal */
+#define TOK822_CL_LP	(1<<8)		/* start of (nested) comment */
+#define TOK822_CL_RP	(1<<9)		/* end of (nested) comment */
+
+#define TOK822_CL_SPACE	(TOK822_CL_WSP | TOK822_CL_SP)
+#define TOK822_CL_ATOM_END (TOK822_CL_SPACE | TOK822_CL_OP)
+#define TOK822_CL_QUOTE	(TOK822_CL_SP | TOK822_CL_CTRL | TOK822_CL_OP)
 
-#define COLLECT_SKIP_LAST(t,s,c,cond) { COLLECT(t,s,c,cond); if (*s) s++; }
+static unsigned short tok822_class[UCHAR_MAX + 1];
+
+#define TOK822_CLASS(ch) tok822_class[(unsigned char) (ch)]
 
  /*
-  * Not quite as complex. The parser depends heavily on it.
+  * Not quite as complex as tokenizing. The parser depends heavily on it.
   */
 #define SKIP(tp, cond) { \
 	while (tp->type && (cond)) \
@@ -182,7 +189,8 @@
   * have a real rewriting language. Include | for aliases file parsing.
   */
 static char tok822_opchar[] = "|%!" LEX_822_SPECIALS;
-static void tok822_quote_atom(TOK822 *);
+static void tok822_init_class(void);
+static const char *tok822_collect(TOK822 *, const char *, int, int *);
 static const char *tok822_comment(TOK822 *, const char *);
 static TOK822 *tok822_group(int, TOK822 *, TOK822 *, int);
 static void tok822_copy_quoted(VSTRING *, char *, char *);
@@ -431,6 +439,10 @@ TOK822 *tok822_scan_limit(const char *str, TOK822 **tailp, int tok_count_limit)
     TOK822 *tp;
     int     ch;
     int     tok_count = 0;
+    int     seen;
+
+    if (tok822_class[0] == 0)
+	tok822_init_class();
 
     /*
      * XXX 2822 new feature: Section 4.1 allows "." to appear in a phrase (to
@@ -440,24 +452,35 @@ TOK822 *tok822_scan_limit(const char *str, TOK822 **tailp, int tok_count_limit)
      * white space as part of the token stream. Thanks a lot, people.
      */
     while ((ch = *(unsigned char *) str++) != 0) {
-	if (IS_SPACE_TAB_CR_LF(ch))
+	if (TOK822_CLASS(ch) & TOK822_CL_SPACE)
 	    continue;
 	if (ch == '(') {
 	    tp = tok822_alloc(TOK822_COMMENT, (char *) 0);
 	    str = tok822_comment(tp, str);
 	} else if (ch == '[') {
 	    tp = tok822_alloc(TOK822_DOMLIT, (char *) 0);
-	    COLLECT_SKIP_LAST(tp, str, ch, ch != ']');
+	    str = tok822_collect(tp, str, TOK822_CL_RB, &seen);
+	    if (*str)
+		str++;
 	} else if (ch == '"') {
 	    tp = tok822_alloc(TOK822_QSTRING, (char *) 0);
-	    COLLECT_SKIP_LAST(tp, str, ch, ch != '"');
-	} else if (ch != '\\' && strchr(tok822_opchar, ch)) {
+	    str = tok822_collect(tp, str, TOK822_CL_DQ, &seen);
+	    if (*str)
+		str++;
+	} else if (ch != '\\' && (TOK822_CLASS(ch) & TOK822_CL_OP)) {
 	    tp = tok822_alloc(ch, (char *) 0);
 	} else {
 	    tp = tok822_alloc(TOK822_ATOM, (char *) 0);
 	    str -= 1;				/* \ may be first */
-	    COLLECT(tp, str, ch, !IS_SPACE_TAB_CR_LF(ch) && !strchr(tok822_opchar, ch));
-	    tok822_quote_atom(tp);
+	    str = tok822_collect(tp, str, TOK822_CL_ATOM_END, &seen);
+
+	    /*
+	     * RFC 822 expects 7-bit data. Rather than quoting every 8-bit
+	     * character (and still passing it on as 8-bit data) we leave
+	     * 8-bit data alone.
+	     */
+	    if (seen & TOK822_CL_QUOTE)
+		tp->type = TOK822_QSTRING;
 	}
 	if (head == 0) {
 	    head = tail = tp;
@@ -562,33 +585,80 @@ TOK822 *tok822_parse_limit(const char *str, int tok_count_limit)
     return (tp);
 }
 
-/* tok822_quote_atom - see if an atom needs quoting when externalized */
+/* tok822_init_class - initialize character class table */
 
-static void tok822_quote_atom(TOK822 *tp)
+static void tok822_init_class(void)
 {
-    char   *cp;
+    const char *cp;
+    int     ch;
+
+    for (ch = 0; ch <= UCHAR_MAX; ch++)
+	if (ISCNTRL(ch))
+	    tok822_class[ch] |= TOK822_CL_CTRL;
+    for (cp = tok822_opchar; *cp; cp++)
+	TOK822_CLASS(*cp) |= TOK822_CL_OP;
+    for (cp = "\t\r\n"; *cp; cp++)
+	TOK822_CLASS(*cp) |= TOK822_CL_WSP;
+    TOK822_CLASS(' ') |= TOK822_CL_SP;
+    TOK822_CLASS('\\') |= TOK822_CL_BSL;
+    TOK822_CLASS('"') |= TOK822_CL_DQ;
+    TOK822_CLASS(']') |= TOK822_CL_RB;
+    TOK822_CLASS('(') |= TOK822_CL_LP;
+    TOK822_CLASS(')') |= TOK822_CL_RP;
+    tok822_class[0] |= TOK822_CL_END;		/* must be last */
+}
+
+/* tok822_collect - collect token text up to a delimiter */
+
+static const char *tok822_collect(TOK822 *tp, const char *str, int delim,
+				          int *seen)
+{
+    const char *cp;
+    int     stop = TOK822_CL_END | TOK822_CL_BSL | TOK822_CL_WSP | delim;
+    int     class;
     int     ch;
 
     /*
-     * RFC 822 expects 7-bit data. Rather than quoting every 8-bit character
-     * (and still passing it on as 8-bit data) we leave 8-bit data alone.
+     * Copy a run of ordinary characters at a time. A backslash quotes the
+     * next character; tab, cr and lf become space. The result records the
+     * classes of all characters that were collected, so that the caller can
+     * decide if an atom needs quoting without scanning it again.
      */
-    for (cp = vstring_str(tp->vstr); (ch = *(unsigned char *) cp) != 0; cp++) {
-	if ( /* !ISASCII(ch) || */ ch == ' '
-	    || ISCNTRL(ch) || strchr(tok822_opchar, ch)) {
-	    tp->type = TOK822_QSTRING;
+    *seen = 0;
+    for (;;) {
+	for (cp = str; ((class = TOK822_CLASS(*cp)) & stop) == 0; cp++)
+	    *seen |= class;
+	if (cp > str) {
+	    vstring_memcat(tp->vstr, str, cp - str);
+	    str = cp;
+	}
+	if (class & TOK822_CL_BSL) {
+	    if ((ch = *(unsigned char *) ++str) == 0)
+		break;
+	} else if ((class & delim) != 0 || (ch = *(unsigned char *) str) == 0) {
 	    break;
 	}
+	if (TOK822_CLASS(ch) & TOK822_CL_WSP)
+	    ch = ' ';
+	*seen |= TOK822_CLASS(ch);
+	VSTRING_ADDCH(tp->vstr, ch);
+	str++;
     }
+    VSTRING_TERMINATE(tp->vstr);
+    return (str);
 }
 
 /* tok822_comment - tokenize comment */
 
 static const char *tok822_comment(TOK822 *tp, const char *str)
 {
+    const char *cp;
     int     level = 1;
     int     ch;
 
+#define COMMENT_STOP \
+	(TOK822_CL_END | TOK822_CL_BSL | TOK822_CL_LP | TOK822_CL_RP)
+
     /*
      * XXX We cheat by storing comments in their external form. Otherwise it
      * would be a royal pain to preserve \ before (. That would require a
@@ -597,7 +667,15 @@ static const char *tok822_comment(TOK822 *tp, const char *str)
      */
     VSTRING_ADDCH(tp->vstr, '(');
 
-    while ((ch = *(unsigned char *) str) != 0) {
+    for (;;) {
+	for (cp = str; (TOK822_CLASS(*cp) & COMMENT_STOP) == 0; cp++)
+	     /* void */ ;
+	if (cp > str) {
+	    vstring_memcat(tp->vstr, str, cp - str);
+	    str = cp;
+	}
+	if ((ch = *(unsigned char *) str) == 0)
+	    break;
 	VSTRING_ADDCH(tp->vstr, ch);
 	str++;
 	if (ch == '(') {			/* comments can nest! */
@@ -116,6 +116,15 @@
 /* .IP "\fBmaster_service_disable (empty)\fR"
 /*	Selectively disable \fBmaster\fR(8) listener ports by service type
 /*	or by service name and type.
+/* .PP
+/*	Available in Postfix version 3.4 and later:
+/* .IP "\fBmin_idle_processes (0)\fR"
+/*	The number of idle processes below which the \fBmaster\fR(8) daemon
+/*	starts new processes for a service ahead of demand.
+/* .IP "\fBmax_idle_processes (0)\fR"
+/*	The number of idle processes that the \fBmaster\fR(8) daemon creates
+/*	for a service when the number of idle processes has dropped below
+/*	$min_idle_processes.
 /* MISCELLANEOUS CONTROLS
 /* .ad
 /* .fi
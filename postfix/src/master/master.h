@@ -42,6 +42,8 @@ typedef struct MASTER_SERV {
 #define MASTER_INET_PORT(s)	((s)->endpoint.inet_ep.port)
     }       endpoint;
     int     max_proc;			/* upper bound on # processes */
+    int     min_idle_proc;		/* lower bound on # idle processes */
+    int     max_idle_proc;		/* # idle processes after refill */
     char   *path;			/* command pathname */
     struct ARGV *args;			/* argument vector */
     char   *stress_param_val;		/* stress value: "yes" or empty */
@@ -65,6 +67,7 @@ typedef struct MASTER_SERV {
 #define MASTER_FLAG_INETHOST	(1<<3)	/* endpoint name specifies host */
 #define MASTER_FLAG_LOCAL_ONLY	(1<<4)	/* no remote clients */
 #define MASTER_FLAG_LISTEN	(1<<5)	/* monitor this port */
+#define MASTER_FLAG_PREFORK	(1<<6)	/* idle process creation pending */
 
 #define MASTER_THROTTLED(f)	((f)->flags & MASTER_FLAG_THROTTLE)
 #define MASTER_MARKED_FOR_DELETION(f) ((f)->flags & MASTER_FLAG_MARK)
@@ -72,6 +75,15 @@ typedef struct MASTER_SERV {
 
 #define MASTER_LIMIT_OK(limit, count) ((limit) == 0 || ((count) < (limit)))
 
+ /*
+  * When the number of idle processes drops below min_idle_proc, create idle
+  * processes until there are max_idle_proc (but at least min_idle_proc).
+  */
+#define MASTER_IDLE_TARGET(s) \
+	((s)->max_idle_proc > (s)->min_idle_proc ? \
+	 (s)->max_idle_proc : (s)->min_idle_proc)
+#define MASTER_PREFORK_DELAY	1	/* seconds */
+
  /*
   * Service types.
   */
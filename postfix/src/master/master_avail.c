@@ -31,6 +31,13 @@
 /*	servers are asked to restart at their convenience, and new
 /*	servers are created with stress mode enabled.
 /*
+/*	When the service has a non-zero min_idle_processes setting,
+/*	and the number of available processes drops below that
+/*	number, this module creates processes ahead of demand until
+/*	max_idle_processes processes are available (or until the
+/*	process limit is reached). Such processes still terminate
+/*	voluntarily after $max_idle seconds, and are then replaced.
+/*
 /*	master_avail_listen() ensures that someone monitors the service's
 /*	listen socket for connection requests (as long as resources
 /*	to handle connection requests are available).  This function may
@@ -119,6 +126,35 @@ static void master_avail_event(int event, void *context)
     }
 }
 
+/* master_avail_prefork - create idle processes ahead of demand */
+
+static void master_avail_prefork(int unused_event, void *context)
+{
+    MASTER_SERV *serv = (MASTER_SERV *) context;
+
+    serv->flags &= ~MASTER_FLAG_PREFORK;
+    if (MASTER_THROTTLED(serv)
+	|| !MASTER_LIMIT_OK(serv->max_proc, serv->total_proc))
+	return;
+
+    /*
+     * When the service has no processes, create only one, and look again
+     * later. A broken command will then be throttled before we create a
+     * whole pool of them.
+     */
+    if (serv->total_proc == 0) {
+	master_spawn(serv);
+	serv->flags |= MASTER_FLAG_PREFORK;
+	event_request_timer(master_avail_prefork, (void *) serv,
+			    MASTER_PREFORK_DELAY);
+	return;
+    }
+    while (!MASTER_THROTTLED(serv)
+	   && serv->avail_proc < MASTER_IDLE_TARGET(serv)
+	   && MASTER_LIMIT_OK(serv->max_proc, serv->total_proc))
+	master_spawn(serv);
+}
+
 /* master_avail_listen - enforce the socket monitoring policy */
 
 void    master_avail_listen(MASTER_SERV *serv)
@@ -162,6 +198,21 @@ void    master_avail_listen(MASTER_SERV *serv)
 	    }
 	}
     }
+
+    /*
+     * Keep a pool of idle processes, so that a burst of connection requests
+     * need not wait for process creation. We must not create processes here
+     * (see above), so we use a timer instead. The delay avoids competing for
+     * CPU with a burst that is still in progress.
+     */
+    if (serv->min_idle_proc > 0 && !MASTER_THROTTLED(serv)
+	&& (serv->flags & MASTER_FLAG_PREFORK) == 0
+	&& serv->avail_proc < serv->min_idle_proc
+	&& MASTER_LIMIT_OK(serv->max_proc, serv->total_proc)) {
+	serv->flags |= MASTER_FLAG_PREFORK;
+	event_request_timer(master_avail_prefork, (void *) serv,
+			    MASTER_PREFORK_DELAY);
+    }
     if (listen_flag && !MASTER_LISTENING(serv)) {
 	if (msg_verbose)
 	    msg_info("%s: enable events %s", myname, serv->name);
@@ -198,6 +249,8 @@ void    master_avail_cleanup(MASTER_SERV *serv)
 	    event_disable_readwrite(serv->listen_fd[n]);
 	serv->flags &= ~MASTER_FLAG_LISTEN;
     }
+    event_cancel_timer(master_avail_prefork, (void *) serv);
+    serv->flags &= ~MASTER_FLAG_PREFORK;
 }
 
 /* master_avail_more - one more available child process */
@@ -130,6 +130,8 @@ void    master_config(void)
 		serv->flags &= ~MASTER_FLAG_CONDWAKE;
 	    serv->wakeup_time = entry->wakeup_time;
 	    serv->max_proc = entry->max_proc;
+	    serv->min_idle_proc = entry->min_idle_proc;
+	    serv->max_idle_proc = entry->max_idle_proc;
 	    serv->throttle_delay = entry->throttle_delay;
 	    SWAP(char *, serv->ext_name, entry->ext_name);
 	    SWAP(char *, serv->path, entry->path);
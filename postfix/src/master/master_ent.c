@@ -196,7 +196,7 @@ static NORETURN PRINTFLIKE(1, 2) fatal_with_context(char *format,...)
 
 /* fatal_invalid_field - report invalid field value */
 
-static NORETURN fatal_invalid_field(char *name, char *value)
+static NORETURN fatal_invalid_field(const char *name, const char *value)
 {
     fatal_with_context("field \"%s\": bad value: \"%s\"", name, value);
 }
@@ -251,6 +251,37 @@ static int get_int_ent(char **bufp, char *name, char *def_val, int min_val)
     return (n);
 }
 
+/* get_idle_opt - extract idle process count from "-o name=value" */
+
+static void get_idle_opt(MASTER_SERV *serv, const char *nameval)
+{
+    char   *saved = mystrdup(nameval);
+    char   *name;
+    char   *value;
+    const char *expanded;
+    int    *target;
+
+    /*
+     * Expand $name in the value the same way as the child process will,
+     * so that both agree on the number.
+     */
+    if (split_nameval(saved, &name, &value) == 0) {
+	if (strcmp(name, VAR_MIN_IDLE_PROCS) == 0)
+	    target = &serv->min_idle_proc;
+	else if (strcmp(name, VAR_MAX_IDLE_PROCS) == 0)
+	    target = &serv->max_idle_proc;
+	else
+	    target = 0;
+	if (target != 0) {
+	    expanded = mail_conf_eval(value);
+	    if (!alldig(expanded))
+		fatal_invalid_field(name, expanded);
+	    *target = atoi(expanded);
+	}
+    }
+    myfree(saved);
+}
+
 /* get_master_ent - read entry from configuration file */
 
 MASTER_SERV *get_master_ent()
@@ -273,6 +304,7 @@ MASTER_SERV *get_master_ent()
     const char *parse_err;
     static char *saved_interfaces = 0;
     char   *err;
+    int     scan_opts;
 
     if (master_fp == 0)
 	msg_panic("get_master_ent: config file not open");
@@ -501,6 +533,13 @@ MASTER_SERV *get_master_ent()
     vstring_sprintf(junk, "%d", var_proc_limit);
     serv->max_proc = get_int_ent(&bufp, "max_proc", vstring_str(junk), 0);
 
+    /*
+     * Idle process pool. The main.cf defaults may be overridden with "-o
+     * name=value" in the command arguments below.
+     */
+    serv->min_idle_proc = var_min_idle_procs;
+    serv->max_idle_proc = var_max_idle_procs;
+
     /*
      * Path to command,
      */
@@ -561,10 +600,23 @@ MASTER_SERV *get_master_ent()
 	argv_add(serv->args, "-s",
 	    vstring_str(vstring_sprintf(junk, "%d", serv->listen_fd_count)),
 		 (char *) 0);
+
+    /*
+     * Pick up per-service idle process settings. Only "-o name=value" with
+     * "-o" as a separate argument is recognized, and the scan stops at a
+     * pipe(8) or spawn(8) "argv=" argument, because the arguments after
+     * it belong to an external command.
+     */
+    scan_opts = 1;
     while ((cp = mystrtokq(&bufp, master_blanks, CHARS_BRACE)) != 0) {
 	if (*cp == CHARS_BRACE[0]
 	    && (err = extpar(&cp, CHARS_BRACE, EXTPAR_FLAG_STRIP)) != 0)
 	    fatal_with_context("%s", err);
+	if (scan_opts && strncmp(cp, "argv=", 5) == 0)
+	    scan_opts = 0;
+	if (scan_opts
+	    && strcmp(serv->args->argv[serv->args->argc - 1], "-o") == 0)
+	    get_idle_opt(serv, cp);
 	argv_add(serv->args, cp, (char *) 0);
     }
     argv_terminate(serv->args);
@@ -597,6 +649,8 @@ void    print_master_ent(MASTER_SERV *serv)
     msg_info("listen_fd_count: %d", serv->listen_fd_count);
     msg_info("wakeup: %d", serv->wakeup_time);
     msg_info("max_proc: %d", serv->max_proc);
+    msg_info("min_idle_proc: %d", serv->min_idle_proc);
+    msg_info("max_idle_proc: %d", serv->max_idle_proc);
     msg_info("path: %s", serv->path);
     for (cpp = serv->args->argv; *cpp; cpp++)
 	msg_info("arg[%d]: %s", (int) (cpp - serv->args->argv), *cpp);
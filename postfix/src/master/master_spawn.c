@@ -156,7 +156,7 @@ void    master_spawn(MASTER_SERV *serv)
      */
     if (!MASTER_LIMIT_OK(serv->max_proc, serv->total_proc))
 	msg_panic("%s: at process limit %d", myname, serv->total_proc);
-    if (serv->avail_proc > 0)
+    if (serv->avail_proc > 0 && serv->avail_proc >= MASTER_IDLE_TARGET(serv))
 	msg_panic("%s: processes available: %d", myname, serv->avail_proc);
     if (serv->flags & MASTER_FLAG_THROTTLE)
 	msg_panic("%s: throttled service: %s", myname, serv->path);
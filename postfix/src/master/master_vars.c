@@ -49,6 +49,8 @@
 char   *var_inet_protocols;
 int     var_throttle_time;
 char   *var_master_disable;
+int     var_min_idle_procs;
+int     var_max_idle_procs;
 
 /* master_vars_init - initialize from global Postfix configuration file */
 
@@ -63,6 +65,11 @@ void    master_vars_init(void)
 	VAR_THROTTLE_TIME, DEF_THROTTLE_TIME, &var_throttle_time, 1, 0,
 	0,
     };
+    static const CONFIG_INT_TABLE int_table[] = {
+	VAR_MIN_IDLE_PROCS, DEF_MIN_IDLE_PROCS, &var_min_idle_procs, 0, 0,
+	VAR_MAX_IDLE_PROCS, DEF_MAX_IDLE_PROCS, &var_max_idle_procs, 0, 0,
+	0,
+    };
     static char *saved_inet_protocols;
     static char *saved_queue_dir;
     static char *saved_config_dir;
@@ -83,6 +90,7 @@ void    master_vars_init(void)
     mail_conf_read();
     get_mail_conf_str_table(str_table);
     get_mail_conf_time_table(time_table);
+    get_mail_conf_int_table(int_table);
     path = concatenate(var_config_dir, "/", MASTER_CONF_FILE, (void *) 0);
     fset_master_ent(path);
     myfree(path);
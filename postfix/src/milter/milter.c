@@ -36,6 +36,18 @@
 /*	const char *(*mac_lookup)(const char *name, void *context);
 /*	void	*mac_context;
 /*
+/*	void	milter_parallel_events(milters, enable)
+/*	MILTERS	*milters;
+/*	int	enable;
+/*
+/*	void	milter_conn_reuse(milters, enable)
+/*	MILTERS	*milters;
+/*	int	enable;
+/*
+/*	void	milter_body_cache(milters, limit)
+/*	MILTERS	*milters;
+/*	ssize_t	limit;
+/*
 /*	void	milter_edit_callback(milters, add_header, upd_header,
 /*					ins_header, del_header, chg_from,
 /*					add_rcpt, add_rcpt_par, del_rcpt,
@@ -142,6 +154,42 @@
 /*	context for macro lookup. This function must be called
 /*	before milter_conn_event().
 /*
+/*	milter_parallel_events() controls how the connect, helo,
+/*	mail, rcpt, data and unknown events are reported. By default,
+/*	each milter is sent the event and its reply is received
+/*	before the next milter is sent the event. With a non-zero
+/*	enable argument, the event is sent to each milter before
+/*	any reply is received, so that the milter applications
+/*	work on the event at the same time. The replies are then
+/*	received, and the result is the first non-null reply in
+/*	the order that the milters were specified. As before, a
+/*	milter is not sent the event when a preceding milter has
+/*	already decided the outcome without waiting for a reply;
+/*	unlike before, all milters see the event when the decision
+/*	comes from a milter reply.  milter_message() always reports
+/*	the message content to one milter at a time, so that each
+/*	milter sees the changes made by preceding milters.
+/*
+/*	milter_conn_reuse() controls what happens with a milter
+/*	connection after milter_disc_event(). By default, the
+/*	connection is closed, and the next milter_conn_event()
+/*	opens a new connection and negotiates the protocol again.
+/*	With a non-zero enable argument, the end of the SMTP session
+/*	is reported with the SMFIC_QUIT_NC command, and the
+/*	negotiated connection is kept in a per-process pool, so
+/*	that a later milter_conn_event() for a milter with the
+/*	same name and protocol can use it. This survives
+/*	milter_free(). This requires Milter protocol version 6 or
+/*	later, and applies only to milters created with milter_create().
+/*
+/*	milter_body_cache() specifies how much memory milter_message()
+/*	may use to save the message body in the form that it is
+/*	sent to the first milter, so that subsequent milters receive
+/*	the saved copy instead of a fresh copy from the queue file.
+/*	A body that is larger is sent from the queue file to each
+/*	milter. Specify zero to disable (the default). The saved
+/*	copy is discarded when a milter replaces the message body.
+/*
 /*	milter_edit_callback() specifies call-back functions and
 /*	context for editing the queue file after the end-of-data
 /*	is received. This function must be called before milter_message();
@@ -368,6 +416,69 @@ void    milter_macro_callback(MILTERS *milters,
     milters->mac_context = mac_context;
 }
 
+/* milter_parallel_events - enable or disable parallel event reporting */
+
+void    milter_parallel_events(MILTERS *milters, int enable)
+{
+    if (enable)
+	milters->flags |= MILTERS_FLAG_PARALLEL;
+    else
+	milters->flags &= ~MILTERS_FLAG_PARALLEL;
+}
+
+ /*
+  * With parallel event reporting, each milter's event routine sends the
+  * event and returns without waiting for a reply. Once the event has been
+  * sent to all milters, the replies are received in the order that the
+  * milters were specified. Each reply must be received, even when it no
+  * longer affects the result, to stay in sync with the milter protocol. A
+  * non-null result from an event routine means that the milter did not
+  * wait for a reply; that stops the event from being sent to subsequent
+  * milters, and it takes effect only if no earlier milter replies with a
+  * non-null result.
+  */
+#define MILTER_EVENT_DEFER(milters, m) do { \
+	if ((milters)->flags & MILTERS_FLAG_PARALLEL) \
+	    (m)->flags |= MILTER_FLAG_DEFER_REPLY; \
+    } while (0)
+
+#define MILTER_EVENT_SENT(m) do { \
+	(m)->flags &= ~MILTER_FLAG_DEFER_REPLY; \
+    } while (0)
+
+/* milter_event_replies - receive replies to parallel event */
+
+static const char *milter_event_replies(MILTERS *milters, const char *resp)
+{
+    const char *reply;
+    const char *first = 0;
+    MILTER *m;
+
+    if ((milters->flags & MILTERS_FLAG_PARALLEL) == 0)
+	return (resp);
+    for (m = milters->milter_list; m != 0; m = m->next)
+	if ((reply = m->event_reply(m)) != 0 && first == 0)
+	    first = reply;
+    return (first ? first : resp);
+}
+
+/* milter_conn_reuse - enable or disable milter connection reuse */
+
+void    milter_conn_reuse(MILTERS *milters, int enable)
+{
+    if (enable)
+	milters->flags |= MILTERS_FLAG_REUSE;
+    else
+	milters->flags &= ~MILTERS_FLAG_REUSE;
+}
+
+/* milter_body_cache - limit memory for shared message body */
+
+void    milter_body_cache(MILTERS *milters, ssize_t limit)
+{
+    milters->body_cache_limit = limit;
+}
+
 /* milter_edit_callback - specify queue file edit call-back information */
 
 void    milter_edit_callback(MILTERS *milters,
@@ -418,14 +529,16 @@ const char *milter_conn_event(MILTERS *milters,
 	msg_info("report connect to all milters");
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, conn_macros);
+	MILTER_EVENT_DEFER(milters, m);
 	resp = m->conn_event(m, client_name, client_addr, client_port,
 			     addr_family, any_macros);
+	MILTER_EVENT_SENT(m);
 	if (any_macros != global_macros)
 	    argv_free(any_macros);
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_event_replies(milters, resp));
 }
 
 /* milter_helo_event - report helo event */
@@ -442,13 +555,15 @@ const char *milter_helo_event(MILTERS *milters, const char *helo_name,
 	msg_info("report helo to all milters");
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, helo_macros);
+	MILTER_EVENT_DEFER(milters, m);
 	resp = m->helo_event(m, helo_name, esmtp_flag, any_macros);
+	MILTER_EVENT_SENT(m);
 	if (any_macros != global_macros)
 	    argv_free(any_macros);
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_event_replies(milters, resp));
 }
 
 /* milter_mail_event - report mail from event */
@@ -464,13 +579,15 @@ const char *milter_mail_event(MILTERS *milters, const char **argv)
 	msg_info("report sender to all milters");
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, mail_macros);
+	MILTER_EVENT_DEFER(milters, m);
 	resp = m->mail_event(m, argv, any_macros);
+	MILTER_EVENT_SENT(m);
 	if (any_macros != global_macros)
 	    argv_free(any_macros);
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_event_replies(milters, resp));
 }
 
 /* milter_rcpt_event - report rcpt to event */
@@ -489,14 +606,16 @@ const char *milter_rcpt_event(MILTERS *milters, int flags, const char **argv)
 	    || (m->flags & MILTER_FLAG_WANT_RCPT_REJ) != 0) {
 	    any_macros =
 		MILTER_MACRO_EVAL(global_macros, m, milters, rcpt_macros);
+	    MILTER_EVENT_DEFER(milters, m);
 	    resp = m->rcpt_event(m, argv, any_macros);
+	    MILTER_EVENT_SENT(m);
 	    if (any_macros != global_macros)
 		argv_free(any_macros);
 	}
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_event_replies(milters, resp));
 }
 
 /* milter_data_event - report data event */
@@ -512,13 +631,15 @@ const char *milter_data_event(MILTERS *milters)
 	msg_info("report data to all milters");
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, data_macros);
+	MILTER_EVENT_DEFER(milters, m);
 	resp = m->data_event(m, any_macros);
+	MILTER_EVENT_SENT(m);
 	if (any_macros != global_macros)
 	    argv_free(any_macros);
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_event_replies(milters, resp));
 }
 
 /* milter_unknown_event - report unknown command */
@@ -534,13 +655,15 @@ const char *milter_unknown_event(MILTERS *milters, const char *command)
 	msg_info("report unknown command to all milters");
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_macros = MILTER_MACRO_EVAL(global_macros, m, milters, unk_macros);
+	MILTER_EVENT_DEFER(milters, m);
 	resp = m->unknown_event(m, command, any_macros);
+	MILTER_EVENT_SENT(m);
 	if (any_macros != global_macros)
 	    argv_free(any_macros);
     }
     if (global_macros)
 	argv_free(global_macros);
-    return (resp);
+    return (milter_event_replies(milters, resp));
 }
 
 /* milter_other_event - other SMTP event */
@@ -571,6 +694,18 @@ const char *milter_message(MILTERS *milters, VSTREAM *fp, off_t data_offset,
 
     if (msg_verbose)
 	msg_info("inspect content by all milters");
+
+    /*
+     * When more than one milter may inspect the message body, the first one
+     * that does saves the body in on-the-wire form, and the others receive
+     * the saved copy. This avoids reading, parsing and encoding the same
+     * queue file content once per milter.
+     */
+    if (milters->body_cache_limit > 0 && milters->milter_list != 0
+	&& milters->milter_list->next != 0) {
+	milters->body_cache = vstring_alloc(100);
+	milters->body_cache_state = MILTER_BODY_CACHE_EMPTY;
+    }
     for (resp = 0, m = milters->milter_list; resp == 0 && m != 0; m = m->next) {
 	any_eoh_macros = MILTER_MACRO_EVAL(global_eoh_macros, m, milters, eoh_macros);
 	any_eod_macros = MILTER_MACRO_EVAL(global_eod_macros, m, milters, eod_macros);
@@ -585,6 +720,10 @@ const char *milter_message(MILTERS *milters, VSTREAM *fp, off_t data_offset,
 	argv_free(global_eoh_macros);
     if (global_eod_macros)
 	argv_free(global_eod_macros);
+    if (milters->body_cache) {
+	vstring_free(milters->body_cache);
+	milters->body_cache = 0;
+    }
     return (resp);
 }
 
@@ -715,6 +854,7 @@ MILTERS *milter_new(const char *names,
 	myfree(saved_names);
     }
     milters->milter_list = head;
+    milters->flags = MILTERS_FLAG_NONE;
     milters->mac_lookup = 0;
     milters->mac_context = 0;
     milters->macros = macros;
@@ -725,6 +865,9 @@ MILTERS *milter_new(const char *names,
     milters->add_rcpt = milters->del_rcpt = 0;
     milters->repl_body = 0;
     milters->chg_context = 0;
+    milters->body_cache_limit = 0;
+    milters->body_cache = 0;
+    milters->body_cache_state = MILTER_BODY_CACHE_EMPTY;
     return (milters);
 }
 
@@ -986,21 +1129,30 @@ int     main(int argc, char **argv)
     char   *cmd;
     int     ch;
     int     istty = isatty(vstream_fileno(VSTREAM_IN));
+    int     parallel = 0;
+    int     reuse = 0;
 
     conn_macros = helo_macros = mail_macros = rcpt_macros = data_macros
 	= eoh_macros = eod_macros = unk_macros = macro_deflts = "";
 
     msg_vstream_init(argv[0], VSTREAM_ERR);
-    while ((ch = GETOPT(argc, argv, "V:v")) > 0) {
+    while ((ch = GETOPT(argc, argv, "a:p:PRv")) > 0) {
 	switch (ch) {
 	default:
-	    msg_fatal("usage: %s [-a action] [-p protocol] [-v]", argv[0]);
+	    msg_fatal("usage: %s [-a action] [-p protocol] [-P] [-R] [-v]",
+		      argv[0]);
 	case 'a':
 	    var_milt_def_action = optarg;
 	    break;
 	case 'p':
 	    var_milt_protocol = optarg;
 	    break;
+	case 'P':
+	    parallel = 1;
+	    break;
+	case 'R':
+	    reuse = 1;
+	    break;
 	case 'v':
 	    msg_verbose++;
 	    break;
@@ -1044,6 +1196,8 @@ int     main(int argc, char **argv)
 				    conn_macros, helo_macros, mail_macros,
 				    rcpt_macros, data_macros, eoh_macros,
 				    eod_macros, unk_macros, macro_deflts);
+	    milter_parallel_events(milters, parallel);
+	    milter_conn_reuse(milters, reuse);
 	} else if (strcmp(cmd, "free") == 0 && argv->argc == 0) {
 	    if (milters == 0) {
 		msg_warn("no milters");
@@ -1112,6 +1266,7 @@ int     main(int argc, char **argv)
     }
     if (milters != 0)
 	milter_free(milters);
+    milter8_conn_stats();
     vstring_free(inbuf);
     return (0);
 }
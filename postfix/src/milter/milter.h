@@ -43,6 +43,7 @@ typedef struct MILTER {
     const char *(*message) (struct MILTER *, VSTREAM *, off_t, ARGV *, ARGV *, ARGV *);
     const char *(*unknown_event) (struct MILTER *, const char *, ARGV *);
     const char *(*other_event) (struct MILTER *);
+    const char *(*event_reply) (struct MILTER *);
     void    (*abort) (struct MILTER *);
     void    (*disc_event) (struct MILTER *);
     int     (*active) (struct MILTER *);
@@ -52,9 +53,11 @@ typedef struct MILTER {
 
 #define MILTER_FLAG_NONE		(0)
 #define MILTER_FLAG_WANT_RCPT_REJ	(1<<0)	/* see S8_RCPT_MAILER_ERROR */
+#define MILTER_FLAG_DEFER_REPLY		(1<<1)	/* don't wait for reply */
 
 extern MILTER *milter8_create(const char *, int, int, int, const char *, const char *, struct MILTERS *);
 extern MILTER *milter8_receive(VSTREAM *, struct MILTERS *);
+extern void milter8_conn_stats(void);
 
  /*
   * As of Sendmail 8.14 each milter can override the default macro list. If a
@@ -103,6 +106,7 @@ typedef const char *(*MILTER_EDIT_BODY_FN) (void *, int, VSTRING *);
 
 typedef struct MILTERS {
     MILTER *milter_list;		/* linked list of Milters */
+    int     flags;			/* see below */
     MILTER_MAC_LOOKUP_FN mac_lookup;
     void   *mac_context;		/* macro lookup context */
     struct MILTER_MACROS *macros;
@@ -117,8 +121,20 @@ typedef struct MILTERS {
     MILTER_EDIT_RCPT_PAR_FN add_rcpt_par;
     MILTER_EDIT_RCPT_FN del_rcpt;
     MILTER_EDIT_BODY_FN repl_body;
+    ssize_t body_cache_limit;		/* see milter_body_cache() */
+    VSTRING *body_cache;		/* encoded body, or null */
+    int     body_cache_state;		/* see below */
 } MILTERS;
 
+#define MILTERS_FLAG_NONE		(0)
+#define MILTERS_FLAG_PARALLEL		(1<<0)	/* parallel envelope events */
+#define MILTERS_FLAG_REUSE		(1<<1)	/* keep connections for reuse */
+
+#define MILTER_BODY_CACHE_EMPTY	0	/* nothing saved */
+#define MILTER_BODY_CACHE_SAVE	1	/* saving body */
+#define MILTER_BODY_CACHE_DONE	2	/* complete body saved */
+#define MILTER_BODY_CACHE_OFF	3	/* too large, don't save */
+
 #define milter_create(milter_names, conn_timeout, cmd_timeout, msg_timeout, \
 			protocol, def_action, conn_macros, helo_macros, \
 			mail_macros, rcpt_macros, data_macros, eoh_macros, \
@@ -133,6 +149,9 @@ extern MILTERS *milter_new(const char *, int, int, int, const char *,
 			           const char *, MILTER_MACROS *,
 			           struct HTABLE *);
 extern void milter_macro_callback(MILTERS *, MILTER_MAC_LOOKUP_FN, void *);
+extern void milter_parallel_events(MILTERS *, int);
+extern void milter_conn_reuse(MILTERS *, int);
+extern void milter_body_cache(MILTERS *, ssize_t);
 extern void milter_edit_callback(MILTERS *milters, MILTER_ADD_HEADER_FN,
 		               MILTER_EDIT_HEADER_FN, MILTER_EDIT_HEADER_FN,
 			          MILTER_DEL_HEADER_FN, MILTER_EDIT_FROM_FN,
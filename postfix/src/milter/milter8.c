@@ -18,6 +18,8 @@
 /*
 /*	MILTER	*milter8_receive(stream)
 /*	VSTREAM	*stream;
+/*
+/*	void	milter8_conn_stats(void)
 /* DESCRIPTION
 /*	This module implements the MTA side of the Sendmail 8 mail
 /*	filter protocol.
@@ -32,6 +34,10 @@
 /*	milter8_receive() receives a mail filter definition from the
 /*	specified stream. The result is zero in case of success.
 /*
+/*	milter8_conn_stats() logs and resets the per-process counts
+/*	of new and reused Milter connections, for Milters that were
+/*	created with connection reuse enabled (see milter_conn_reuse()).
+/*
 /*	Arguments:
 /* .IP name
 /*	The Milter application endpoint, either inet:host:port or
@@ -58,6 +64,7 @@
 #include <sys_defs.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <errno.h>
 #include <stddef.h>			/* offsetof() */
@@ -85,6 +92,7 @@
 #include <name_code.h>
 #include <stringops.h>
 #include <compat_va_copy.h>
+#include <iostuff.h>
 
 /* Global library. */
 
@@ -371,8 +379,43 @@ typedef struct {
     int     state;			/* MILTER8_STAT_mumble */
     char   *def_reply;			/* error response or null */
     int     skip_event_type;		/* skip operations of this type */
+    int     pending_event;		/* reply not yet received */
 } MILTER8;
 
+ /*
+  * Negotiated connections that are kept for reuse. When a Milter instance
+  * was created with connection reuse enabled, and the application speaks
+  * protocol version 6 or later, the end of an SMTP session is reported with
+  * SMFIC_QUIT_NC instead of SMFIC_QUIT. The application then waits for a
+  * new CONNECT command, without renegotiating the protocol. The connection
+  * and its negotiation results are saved here, so that a later session for
+  * a Milter with the same name and protocol can use them, even after the
+  * Milter instance was destroyed. There is one entry per Milter name and
+  * protocol; an entry without connection is kept for the statistics.
+  */
+typedef struct MILTER8_CONN {
+    char   *name;			/* Milter application endpoint */
+    char   *protocol;			/* protocol version/extension */
+    VSTREAM *fp;			/* idle connection or null */
+    int     version;			/* application protocol version */
+    int     rq_mask;			/* application requests (SMFIF_*) */
+    int     ev_mask;			/* application events (SMFIP_*) */
+    int     np_mask;			/* events outside my protocol version */
+    int     flags;			/* MILTER_FLAG_WANT_RCPT_REJ */
+    MILTER_MACROS *macros;		/* negotiated macro lists or null */
+    unsigned long new_count;		/* new connections */
+    unsigned long reuse_count;		/* reused connections */
+    struct MILTER8_CONN *next;		/* linkage */
+} MILTER8_CONN;
+
+static MILTER8_CONN *milter8_conn_list;
+
+#define MILTER8_QUIT_NC_VERSION	6	/* SMFIC_QUIT_NC support */
+
+#define MILTER8_CONN_REUSE(milter) \
+	((milter)->protocol != 0 && (milter)->m.parent != 0 \
+	 && ((milter)->m.parent->flags & MILTERS_FLAG_REUSE) != 0)
+
  /*
   * XXX Sendmail 8 libmilter automatically closes the MTA-to-filter socket
   * when it finds out that the SMTP client has disconnected. Because of this
@@ -569,6 +612,136 @@ static void milter8_close_stream(MILTER8 *milter)
     milter->state = MILTER8_STAT_CLOSED;
 }
 
+/* milter8_conn_find - find or create connection pool entry */
+
+static MILTER8_CONN *milter8_conn_find(MILTER8 *milter)
+{
+    MILTER8_CONN *conn;
+
+    for (conn = milter8_conn_list; conn != 0; conn = conn->next)
+	if (strcmp(conn->name, milter->m.name) == 0
+	    && strcmp(conn->protocol, milter->protocol) == 0)
+	    return (conn);
+    conn = (MILTER8_CONN *) mymalloc(sizeof(*conn));
+    conn->name = mystrdup(milter->m.name);
+    conn->protocol = mystrdup(milter->protocol);
+    conn->fp = 0;
+    conn->macros = 0;
+    conn->new_count = 0;
+    conn->reuse_count = 0;
+    conn->next = milter8_conn_list;
+    milter8_conn_list = conn;
+    return (conn);
+}
+
+/* milter8_conn_drop - close idle connection */
+
+static void milter8_conn_drop(MILTER8_CONN *conn)
+{
+    (void) vstream_fclose(conn->fp);
+    conn->fp = 0;
+    if (conn->macros) {
+	milter_macros_free(conn->macros);
+	conn->macros = 0;
+    }
+}
+
+/* milter8_conn_save - save negotiated connection for reuse */
+
+static void milter8_conn_save(MILTER8 *milter)
+{
+    const char *myname = "milter8_conn_save";
+    MILTER8_CONN *conn = milter8_conn_find(milter);
+
+    if (msg_verbose)
+	msg_info("%s: milter %s", myname, milter->m.name);
+
+    /*
+     * Keep the most recently used connection.
+     */
+    if (conn->fp != 0)
+	milter8_conn_drop(conn);
+    conn->fp = milter->fp;
+    conn->version = milter->version;
+    conn->rq_mask = milter->rq_mask;
+    conn->ev_mask = milter->ev_mask;
+    conn->np_mask = milter->np_mask;
+    conn->flags = (milter->m.flags & MILTER_FLAG_WANT_RCPT_REJ);
+    conn->macros = milter->m.macros;
+    milter->m.macros = 0;
+    milter->fp = 0;
+    milter->state = MILTER8_STAT_CLOSED;
+}
+
+/* milter8_conn_restore - reuse saved negotiated connection */
+
+static int milter8_conn_restore(MILTER8 *milter)
+{
+    const char *myname = "milter8_conn_restore";
+    MILTER8_CONN *conn = milter8_conn_find(milter);
+
+    /*
+     * Sanity check.
+     */
+    if (milter->fp != 0)
+	msg_panic("%s: milter %s: socket is not closed",
+		  myname, milter->m.name);
+
+    if (conn->fp == 0)
+	return (0);
+
+    /*
+     * An idle connection has nothing to read. Otherwise, the application
+     * has closed the connection, or it is out of sync.
+     */
+    if (readable(vstream_fileno(conn->fp))) {
+	if (msg_verbose)
+	    msg_info("%s: milter %s: drop idle connection",
+		     myname, milter->m.name);
+	milter8_conn_drop(conn);
+	return (0);
+    }
+    if (msg_verbose)
+	msg_info("%s: milter %s: reuse connection", myname, milter->m.name);
+    milter->fp = conn->fp;
+    vstream_control(milter->fp,
+		    CA_VSTREAM_CTL_TIMEOUT(milter->cmd_timeout),
+		    CA_VSTREAM_CTL_END);
+    milter->version = conn->version;
+    milter->rq_mask = conn->rq_mask;
+    milter->ev_mask = conn->ev_mask;
+    milter->np_mask = conn->np_mask;
+    milter->m.flags &= ~MILTER_FLAG_WANT_RCPT_REJ;
+    milter->m.flags |= conn->flags;
+    if (milter->m.macros)
+	milter_macros_free(milter->m.macros);
+    milter->m.macros = conn->macros;
+    conn->fp = 0;
+    conn->macros = 0;
+    conn->reuse_count += 1;
+    milter->state = MILTER8_STAT_READY;
+    milter8_def_reply(milter, 0);
+    milter->skip_event_type = 0;
+    milter->pending_event = 0;
+    return (1);
+}
+
+/* milter8_conn_stats - log and reset connection statistics */
+
+void    milter8_conn_stats(void)
+{
+    MILTER8_CONN *conn;
+
+    for (conn = milter8_conn_list; conn != 0; conn = conn->next) {
+	if (conn->new_count == 0 && conn->reuse_count == 0)
+	    continue;
+	msg_info("statistics: milter %s: connections new=%lu reused=%lu",
+		 conn->name, conn->new_count, conn->reuse_count);
+	conn->new_count = 0;
+	conn->reuse_count = 0;
+    }
+}
+
 /* milter8_read_resp - receive command code now, receive data later */
 
 static int milter8_read_resp(MILTER8 *milter, int event, unsigned char *command,
@@ -941,6 +1114,8 @@ static int milter8_write_cmd(MILTER8 *milter, int command,...)
     return (err);
 }
 
+static const char *milter8_event_reply(MILTER8 *, int);
+
 /* milter8_event - report event and receive reply */
 
 static const char *milter8_event(MILTER8 *milter, int event,
@@ -953,17 +1128,7 @@ static const char *milter8_event(MILTER8 *milter, int event,
     va_list ap2;
     ssize_t data_len;
     int     err;
-    unsigned char cmd;
-    ssize_t data_size;
     const char *smfic_name;
-    const char *smfir_name;
-    MILTERS *parent = milter->m.parent;
-    UINT32_TYPE index;
-    const char *edit_resp = 0;
-    const char *retval = 0;
-    VSTRING *body_line_buf = 0;
-    int     done = 0;
-    int     body_edit_lockout = 0;
 
 #define DONT_SKIP_REPLY	0
 
@@ -1085,6 +1250,40 @@ static const char *milter8_event(MILTER8 *milter, int event,
 	return (milter->def_reply);
     }
 
+    /*
+     * When the caller reports this event to multiple Milters in parallel,
+     * flush the request now and leave the reply for milter8_reply(), so that
+     * this Milter can work on the event while the caller talks to the next
+     * one.
+     */
+    if (milter->m.flags & MILTER_FLAG_DEFER_REPLY) {
+	if (vstream_fflush(milter->fp) != 0) {
+	    msg_warn("milter %s: error writing command: %m", milter->m.name);
+	    milter8_comm_error(milter);
+	    return (milter->def_reply);
+	}
+	milter->pending_event = event;
+	return (milter->def_reply);
+    }
+    return (milter8_event_reply(milter, event));
+}
+
+/* milter8_event_reply - receive reply to event */
+
+static const char *milter8_event_reply(MILTER8 *milter, int event)
+{
+    unsigned char cmd;
+    ssize_t data_size;
+    const char *smfic_name;
+    const char *smfir_name;
+    MILTERS *parent = milter->m.parent;
+    UINT32_TYPE index;
+    const char *edit_resp = 0;
+    const char *retval = 0;
+    VSTRING *body_line_buf = 0;
+    int     done = 0;
+    int     body_edit_lockout = 0;
+
     /*
      * Receive the reply or replies.
      * 
@@ -1541,6 +1740,11 @@ static const char *milter8_event(MILTER8 *milter, int event,
 			continue;
 		    /* Start body replacement. */
 		    if (body_line_buf == 0) {
+			/* Don't send the old body to subsequent milters. */
+			if (parent->body_cache) {
+			    parent->body_cache_state = MILTER_BODY_CACHE_EMPTY;
+			    VSTRING_RESET(parent->body_cache);
+			}
 			body_line_buf = vstring_alloc(var_line_limit);
 			edit_resp = parent->repl_body(parent->chg_context,
 						      MILTER_BODY_START,
@@ -1582,7 +1786,7 @@ static const char *milter8_event(MILTER8 *milter, int event,
 	 */
 	msg_warn("milter %s: reply %s was followed by %ld data bytes",
 	milter->m.name, (smfir_name = str_name_code(smfir_table, cmd)) != 0 ?
-		 smfir_name : "unknown", (long) data_len);
+		 smfir_name : "unknown", (long) data_size);
 	milter8_comm_error(milter);
 	MILTER8_EVENT_BREAK(milter->def_reply);
     }
@@ -1731,9 +1935,24 @@ static void milter8_connect(MILTER8 *milter)
 		    CA_VSTREAM_CTL_TIMEOUT(milter->cmd_timeout),
 		    CA_VSTREAM_CTL_END);
     /* Avoid poor performance when TCP MSS > VSTREAM_BUFSIZE. */
-    if (connect_fn == inet_connect)
+    if (connect_fn == inet_connect) {
 	vstream_tweak_tcp(milter->fp);
 
+	/*
+	 * With connection reuse, SMFIC_QUIT_NC is followed by the next
+	 * session's SMFIC_CONNECT without a reply in between. Don't let
+	 * Nagle's algorithm hold that command until the peer's delayed ACK.
+	 */
+	if (MILTER8_CONN_REUSE(milter)) {
+	    int     nodelay = 1;
+
+	    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (void *) &nodelay,
+			   sizeof(nodelay)) < 0)
+		msg_warn("milter %s: setsockopt TCP_NODELAY: %m",
+			 milter->m.name);
+	}
+    }
+
     /*
      * Open the negotiations by sending what actions the Milter may request
      * and what events the Milter can receive.
@@ -1854,6 +2073,9 @@ static void milter8_connect(MILTER8 *milter)
     milter->state = MILTER8_STAT_READY;
     milter8_def_reply(milter, 0);
     milter->skip_event_type = 0;
+    milter->pending_event = 0;
+    if (MILTER8_CONN_REUSE(milter))
+	milter8_conn_find(milter)->new_count += 1;
 
     /*
      * Secondary negotiations: override lists of macro names.
@@ -1918,10 +2140,12 @@ static const char *milter8_conn_event(MILTER *m,
     /*
      * XXX Sendmail 8 libmilter closes the MTA-to-filter socket when it finds
      * out that the SMTP client has disconnected. Because of this, Postfix
-     * has to open a new MTA-to-filter socket for each SMTP client.
+     * has to open a new MTA-to-filter socket for each SMTP client, unless a
+     * connection was kept after SMFIC_QUIT_NC.
      */
 #ifdef LIBMILTER_AUTO_DISCONNECT
-    milter8_connect(milter);
+    if (!MILTER8_CONN_REUSE(milter) || milter8_conn_restore(milter) == 0)
+	milter8_connect(milter);
 #endif
 
     /*
@@ -2185,6 +2409,26 @@ static const char *milter8_unknown_event(MILTER *m, const char *command,
     }
 }
 
+/* milter8_reply - receive deferred reply to envelope event */
+
+static const char *milter8_reply(MILTER *m)
+{
+    const char *myname = "milter8_reply";
+    MILTER8 *milter = (MILTER8 *) m;
+    int     event;
+
+    /*
+     * Without a deferred reply, the event routine has already returned the
+     * default reply.
+     */
+    if ((event = milter->pending_event) == 0)
+	return (milter->def_reply);
+    milter->pending_event = 0;
+    if (msg_verbose)
+	msg_info("%s: milter %s", myname, milter->m.name);
+    return (milter8_event_reply(milter, event));
+}
+
 /* milter8_other_event - reply for other event */
 
 static const char *milter8_other_event(MILTER *m)
@@ -2268,6 +2512,26 @@ static void milter8_disc_event(MILTER *m)
     case MILTER8_STAT_REJECT_CON:
 #endif
     case MILTER8_STAT_ACCEPT_MSG:
+
+	/*
+	 * With SMFIC_QUIT_NC the application waits for a new connect event
+	 * on the same connection. The command has no reply, so we flush it
+	 * now, instead of leaving it in the output buffer of an idle
+	 * connection. Keep the connection only if no unexpected input is
+	 * pending. See milter8_connect() for the TCP_NODELAY setting.
+	 */
+	if (MILTER8_CONN_REUSE(milter)
+	    && milter->version >= MILTER8_QUIT_NC_VERSION) {
+	    if (msg_verbose)
+		msg_info("%s: quit milter %s, keep connection",
+			 myname, milter->m.name);
+	    if (milter8_write_cmd(milter, SMFIC_QUIT_NC,
+				  MILTER8_DATA_END) == 0
+		&& vstream_fflush(milter->fp) == 0
+		&& vstream_peek(milter->fp) == 0)
+		milter8_conn_save(milter);
+	    break;
+	}
 	if (msg_verbose)
 	    msg_info("%s: quit milter %s", myname, milter->m.name);
 	(void) milter8_write_cmd(milter, SMFIC_QUIT, MILTER8_DATA_END);
@@ -2293,9 +2557,20 @@ typedef struct {
     int     auto_done;			/* good enough for now */
     int     first_header;		/* first header */
     int     first_body;			/* first body line */
+    int     in_body;			/* end of header seen */
+    int     body_cache;			/* see below */
     const char *resp;			/* milter application response */
 } MILTER_MSG_CONTEXT;
 
+ /*
+  * How this milter uses the message body that is shared via the parent
+  * MILTERS structure: not at all, save the body while sending it, or send
+  * the saved body instead of reading it from the queue file.
+  */
+#define MILTER8_BODY_NOCACHE	0
+#define MILTER8_BODY_SAVE	1
+#define MILTER8_BODY_REPLAY	2
+
 /* milter8_header - milter8_message call-back for message header */
 
 static void milter8_header(void *ptr, int unused_header_class,
@@ -2381,7 +2656,9 @@ static void milter8_eoh(void *ptr)
     MILTER8 *milter = msg_ctx->milter;
     int     skip_reply;
 
-    if (MILTER8_MESSAGE_DONE(milter, msg_ctx))
+    msg_ctx->in_body = 1;
+    if (MILTER8_MESSAGE_DONE(milter, msg_ctx)
+	|| (milter->ev_mask & SMFIP_NOEOH) != 0)
 	return;
     if (msg_verbose)
 	msg_info("%s: eoh milter %s", myname, milter->m.name);
@@ -2392,6 +2669,28 @@ static void milter8_eoh(void *ptr)
 		      MILTER8_DATA_END);
 }
 
+/* milter8_body_save - append body chunk to shared copy */
+
+static void milter8_body_save(MILTER_MSG_CONTEXT *msg_ctx)
+{
+    MILTER8 *milter = msg_ctx->milter;
+    MILTERS *parent = milter->m.parent;
+
+    if (msg_ctx->body_cache != MILTER8_BODY_SAVE)
+	return;
+    if (LEN(parent->body_cache) + LEN(milter->body)
+	> parent->body_cache_limit) {
+	if (msg_verbose)
+	    msg_info("milter %s: message body exceeds cache limit %ld",
+		     milter->m.name, (long) parent->body_cache_limit);
+	parent->body_cache_state = MILTER_BODY_CACHE_OFF;
+	VSTRING_RESET(parent->body_cache);
+	msg_ctx->body_cache = MILTER8_BODY_NOCACHE;
+	return;
+    }
+    vstring_memcat(parent->body_cache, STR(milter->body), LEN(milter->body));
+}
+
 /* milter8_body - milter8_message call-back for body content */
 
 static void milter8_body(void *ptr, int rec_type,
@@ -2407,7 +2706,8 @@ static void milter8_body(void *ptr, int rec_type,
     ssize_t count;
     int     skip_reply;
 
-    if (MILTER8_MESSAGE_DONE(milter, msg_ctx))
+    if (MILTER8_MESSAGE_DONE(milter, msg_ctx)
+	|| msg_ctx->body_cache == MILTER8_BODY_REPLAY)
 	return;
 
     /*
@@ -2452,6 +2752,7 @@ static void milter8_body(void *ptr, int rec_type,
 	todo -= count;
 	/* Flush body chunk buffer when full. See also milter8_eob(). */
 	if (LEN(milter->body) == MILTER_CHUNK_SIZE) {
+	    milter8_body_save(msg_ctx);
 	    msg_ctx->resp =
 		milter8_event(milter, SMFIC_BODY, SMFIP_NOBODY,
 			      skip_reply, msg_ctx->eod_macros,
@@ -2479,11 +2780,22 @@ static void milter8_eob(void *ptr)
     MILTER8 *milter = msg_ctx->milter;
     int     skip_reply;
 
-    if (MILTER8_MESSAGE_DONE(milter, msg_ctx))
+    if (MILTER8_MESSAGE_DONE(milter, msg_ctx)
+	|| msg_ctx->body_cache == MILTER8_BODY_REPLAY)
 	return;
     if (msg_verbose)
 	msg_info("%s: eob milter %s", myname, milter->m.name);
 
+    /*
+     * The last partial chunk completes the saved body, even if the milter
+     * decides before it receives the end-of-body event.
+     */
+    if (msg_ctx->body_cache == MILTER8_BODY_SAVE) {
+	milter8_body_save(msg_ctx);
+	if (msg_ctx->body_cache == MILTER8_BODY_SAVE)
+	    milter->m.parent->body_cache_state = MILTER_BODY_CACHE_DONE;
+    }
+
     /*
      * Flush partial body chunk buffer. See also milter8_body().
      * 
@@ -2511,6 +2823,40 @@ static void milter8_eob(void *ptr)
 		      MILTER8_DATA_END);
 }
 
+/* milter8_body_replay - send saved body content and end-of-body */
+
+static void milter8_body_replay(MILTER_MSG_CONTEXT *msg_ctx)
+{
+    const char *myname = "milter8_body_replay";
+    MILTER8 *milter = msg_ctx->milter;
+    VSTRING *saved = milter->m.parent->body_cache;
+    const char *cp = STR(saved);
+    const char *end = vstring_end(saved);
+    int     skip_reply;
+
+    if (msg_verbose)
+	msg_info("%s: milter %s: %ld bytes", myname, milter->m.name,
+		 (long) LEN(saved));
+
+    /*
+     * Send the same chunks as milter8_body() and milter8_eob() would.
+     */
+    msg_ctx->body_cache = MILTER8_BODY_NOCACHE;
+    skip_reply = ((milter->ev_mask & SMFIP_NR_BODY) != 0);
+    for ( /* void */ ; end - cp >= MILTER_CHUNK_SIZE; cp += MILTER_CHUNK_SIZE) {
+	vstring_memcpy(milter->body, cp, MILTER_CHUNK_SIZE);
+	msg_ctx->resp =
+	    milter8_event(milter, SMFIC_BODY, SMFIP_NOBODY,
+			  skip_reply, msg_ctx->eod_macros,
+			  MILTER8_DATA_BUFFER, milter->body,
+			  MILTER8_DATA_END);
+	if (MILTER8_MESSAGE_DONE(milter, msg_ctx))
+	    return;
+    }
+    vstring_memcpy(milter->body, cp, end - cp);
+    milter8_eob((void *) msg_ctx);
+}
+
 /* milter8_message - send message content and receive reply */
 
 static const char *milter8_message(MILTER *m, VSTREAM *qfile,
@@ -2528,6 +2874,7 @@ static const char *milter8_message(MILTER *m, VSTREAM *qfile,
     MILTER_MSG_CONTEXT msg_ctx;
     VSTRING *buf;
     int     saved_errno;
+    MILTERS *parent = milter->m.parent;
 
     switch (milter->state) {
     case MILTER8_STAT_ERROR:
@@ -2555,13 +2902,24 @@ static const char *milter8_message(MILTER *m, VSTREAM *qfile,
 	msg_ctx.auto_done = 0;
 	msg_ctx.first_header = 1;
 	msg_ctx.first_body = 1;
+	msg_ctx.in_body = 0;
 	msg_ctx.resp = 0;
+	if (parent->body_cache == 0 || (milter->ev_mask & SMFIP_NOBODY)) {
+	    msg_ctx.body_cache = MILTER8_BODY_NOCACHE;
+	} else if (parent->body_cache_state == MILTER_BODY_CACHE_DONE) {
+	    msg_ctx.body_cache = MILTER8_BODY_REPLAY;
+	} else if (parent->body_cache_state == MILTER_BODY_CACHE_EMPTY) {
+	    msg_ctx.body_cache = MILTER8_BODY_SAVE;
+	    parent->body_cache_state = MILTER_BODY_CACHE_SAVE;
+	    VSTRING_RESET(parent->body_cache);
+	} else {
+	    msg_ctx.body_cache = MILTER8_BODY_NOCACHE;
+	}
 	mime_state =
 	    mime_state_alloc(MIME_OPT_DISABLE_MIME,
 			     (milter->ev_mask & SMFIP_NOHDRS) ?
 			     (MIME_STATE_HEAD_OUT) 0 : milter8_header,
-			     (milter->ev_mask & SMFIP_NOEOH) ?
-			     (MIME_STATE_ANY_END) 0 : milter8_eoh,
+			     milter8_eoh,
 			     (milter->ev_mask & SMFIP_NOBODY) ?
 			     (MIME_STATE_BODY_OUT) 0 : milter8_body,
 			     milter8_eob,
@@ -2599,9 +2957,17 @@ static const char *milter8_message(MILTER *m, VSTREAM *qfile,
 	    }
 	    if (MILTER8_MESSAGE_DONE(milter, &msg_ctx))
 		break;
+	    /* Send the saved body instead of reading the queue file. */
+	    if (msg_ctx.body_cache == MILTER8_BODY_REPLAY && msg_ctx.in_body) {
+		milter8_body_replay(&msg_ctx);
+		break;
+	    }
 	    if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
 		break;
 	}
+	/* Don't trust a partial copy. */
+	if (parent->body_cache_state == MILTER_BODY_CACHE_SAVE)
+	    parent->body_cache_state = MILTER_BODY_CACHE_EMPTY;
 	mime_state_free(mime_state);
 	vstring_free(buf);
 	if (milter->fp)
@@ -2848,6 +3214,7 @@ static MILTER8 *milter8_alloc(const char *name, int conn_timeout,
     milter->m.message = milter8_message;
     milter->m.unknown_event = milter8_unknown_event;	/* may be null */
     milter->m.other_event = milter8_other_event;
+    milter->m.event_reply = milter8_reply;
     milter->m.abort = milter8_abort;
     milter->m.disc_event = milter8_disc_event;
     milter->m.active = milter8_active;
@@ -2867,6 +3234,7 @@ static MILTER8 *milter8_alloc(const char *name, int conn_timeout,
     milter->def_action = mystrdup(def_action);
     milter->def_reply = 0;
     milter->skip_event_type = 0;
+    milter->pending_event = 0;
 
     return (milter);
 }
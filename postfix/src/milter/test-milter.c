@@ -59,6 +59,11 @@
 /*	Request rejected recipients from the MTA.
 /* .IP "\fB-v\fR"
 /*	Make the program more verbose.
+/* .IP "\fB-w\fI seconds\fR"
+/*	Wait for the specified number of seconds before replying
+/*	to an MTA event. This simulates a slow filter; for example,
+/*	compare the time that "milter -P" (parallel events) and
+/*	"milter" need to report events to several delayed filters.
 /* LICENSE
 /* .ad
 /* .fi
@@ -91,6 +96,7 @@
 
 static int conn_count;
 static int verbose;
+static int reply_delay;
 
 static int test_connect_reply = SMFIS_CONTINUE;
 static int test_helo_reply = SMFIS_CONTINUE;
@@ -215,6 +221,9 @@ static int test_reply(SMFICTX *ctx, int code)
 	    printf("macro: %s=\"%s\"\n", *cpp, symval);
     (void) fflush(stdout);			/* In case output redirected. */
 
+    if (reply_delay > 0)
+	sleep(reply_delay);
+
     if (code == SMFIR_REPLYCODE) {
 	if (smfi_setmlreply(ctx, reply_code, reply_dsn, reply_message, reply_message, (char *) 0) == MI_FAILURE)
 	    fprintf(stderr, "smfi_setmlreply failed\n");
@@ -566,7 +575,8 @@ int     main(int argc, char **argv)
     char   *noreply = 0;
     const struct noproto_map *np;
 
-    while ((ch = getopt(argc, argv, "a:A:b:c:C:d:D:f:h:i:lm:M:n:N:p:rv")) > 0) {
+    while ((ch = getopt(argc, argv,
+			"a:A:b:c:C:d:D:f:h:i:lm:M:n:N:p:rvw:")) > 0) {
 	switch (ch) {
 	case 'a':
 	    action = optarg;
@@ -714,6 +724,9 @@ int     main(int argc, char **argv)
 	case 'v':
 	    verbose++;
 	    break;
+	case 'w':
+	    reply_delay = atoi(optarg);
+	    break;
 	case 'C':
 	    conn_count = atoi(optarg);
 	    break;
@@ -731,6 +744,7 @@ int     main(int argc, char **argv)
 		  "\t[-N events]		don't reply to these events\n"
 		    "\t-p port                  milter application\n"
 		  "\t-r                       request rejected recipients\n"
+		    "\t[-w seconds]             delay each reply\n"
 		    "\t[-C conn_count]          when to exit\n",
 		    argv[0]);
 	    exit(1);
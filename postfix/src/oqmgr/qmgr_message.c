@@ -1281,9 +1281,7 @@ static void qmgr_message_assign(QMGR_MESSAGE *message)
 			     entry->rcpt_list.len)) {
 		entry = qmgr_entry_create(queue, message);
 	    }
-	    recipient_list_add(&entry->rcpt_list, recipient->offset,
-			       recipient->dsn_orcpt, recipient->dsn_notify,
-			       recipient->orig_addr, recipient->address);
+	    recipient_list_move(&entry->rcpt_list, recipient);
 	    qmgr_recipient_count++;
 	}
     }
@@ -122,6 +122,9 @@
 /* .IP \fBcdb\fR
 /*	The output is one file named \fIfile_name\fB.cdb\fR.
 /*	This is available on systems with support for \fBcdb\fR databases.
+/* .IP \fBcmap\fR
+/*	The output is one file named \fIfile_name\fB.cmap\fR.
+/*	This is always available.
 /* .IP \fBdbm\fR
 /*	The output consists of two files, named \fIfile_name\fB.pag\fR and
 /*	\fIfile_name\fB.dir\fR.
@@ -238,6 +238,21 @@
 /* .IP \fBbtree\fR
 /*	A sorted, balanced tree structure.  Available on systems
 /*	with support for Berkeley DB databases.
+/* .IP "\fBcachemap\fR (read-only)"
+/*	A table that remembers the results from another table in
+/*	process memory, to reduce the number of queries sent to,
+/*	for example, an SQL or LDAP server. Example: "\fBcachemap:{
+/*	\fItype\fB:\fIname\fB, ttl=\fIseconds\fB, neg_ttl=\fIseconds\fB,
+/*	size=\fIcount\fB, log_interval=\fIseconds\fB }\fR". Found
+/*	results are remembered for \fBttl\fR seconds (default: 60),
+/*	"not found" results for \fBneg_ttl\fR seconds (default: 10),
+/*	and lookup errors are not remembered. When more than
+/*	\fBsize\fR results (default: 10000) are cached, the
+/*	least-recently used result is discarded. With a non-zero
+/*	\fBlog_interval\fR, cache hit/miss statistics are logged
+/*	at most once per that number of seconds.
+/*
+/*	This feature is available with Postfix 3.4 and later.
 /* .IP \fBcdb\fR
 /*	A read-optimized structure with no support for incremental
 /*	updates.  Available on systems with support for CDB databases.
@@ -248,6 +263,12 @@
 /*	Routing (CIDR) patterns. This is described in \fBcidr_table\fR(5).
 /*
 /*	This feature is available with Postfix 2.2 and later.
+/* .IP \fBcmap\fR
+/*	A read-optimized structure with no support for incremental
+/*	updates. The file is memory-mapped and shared by all
+/*	processes that use it. Always available.
+/*
+/*	This feature is available with Postfix 3.4 and later.
 /* .IP \fBdbm\fR
 /*	An indexed file type based on hashing.  Available on systems
 /*	with support for DBM databases.
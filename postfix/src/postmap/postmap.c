@@ -6,7 +6,7 @@
 /* SYNOPSIS
 /* .fi
 /*	\fBpostmap\fR [\fB-NbfhimnoprsuUvw\fR] [\fB-c \fIconfig_dir\fR]
-/*	[\fB-d \fIkey\fR] [\fB-q \fIkey\fR]
+/*	[\fB-D \fIold_file\fR] [\fB-d \fIkey\fR] [\fB-q \fIkey\fR]
 /*		[\fIfile_type\fR:]\fIfile_name\fR ...
 /* DESCRIPTION
 /*	The \fBpostmap\fR(1) command creates or queries one or more Postfix
@@ -84,6 +84,24 @@
 /* .IP "\fB-c \fIconfig_dir\fR"
 /*	Read the \fBmain.cf\fR configuration file in the named directory
 /*	instead of the default configuration directory.
+/* .IP "\fB-D \fIold_file\fR"
+/*	Delta mode. Update an existing database with only the
+/*	differences between \fIold_file\fR, the source file that
+/*	the database was built from, and the current \fIfile_name\fR.
+/*	Entries that are gone from \fIfile_name\fR are deleted,
+/*	and entries that are new or that have a different value are
+/*	added or replaced; unchanged entries are not touched. Keys
+/*	that occur more than once in \fIold_file\fR are always
+/*	replaced. Keys that occur more than once in \fIfile_name\fR
+/*	are handled as with a full rebuild: the first value wins
+/*	and a warning is logged, unless \fB-r\fR or \fB-w\fR is
+/*	specified. With \fBlmdb\fR, all changes are made in one
+/*	transaction. Specify only one \fIfile_name\fR.
+/* .sp
+/*	Processes that have the table open pick up an \fBlmdb\fR
+/*	update without restarting. With other file types, Postfix
+/*	daemon processes restart when they notice that the table
+/*	has changed, as they do after a full rebuild.
 /* .IP "\fB-d \fIkey\fR"
 /*	Search the specified maps for \fIkey\fR and remove one entry per map.
 /*	The exit status is zero when the requested information was found.
@@ -179,7 +197,9 @@
 /*	with the \fB-b\fR and \fB-h\fR options.
 /* .IP \fB-v\fR
 /*	Enable verbose logging for debugging purposes. Multiple \fB-v\fR
-/*	options make the software increasingly verbose.
+/*	options make the software increasingly verbose. When a table
+/*	is created, this also reports the number of entries and the
+/*	rate at which they were stored.
 /* .IP \fB-w\fR
 /*	When updating a table, do not complain about attempts to update
 /*	existing entries, and ignore those attempts.
@@ -198,6 +218,9 @@
 /* .IP \fBcdb\fR
 /*	The output consists of one file, named \fIfile_name\fB.cdb\fR.
 /*	This is available on systems with support for \fBcdb\fR databases.
+/* .IP \fBcmap\fR
+/*	The output consists of one file, named \fIfile_name\fB.cmap\fR.
+/*	This is always available.
 /* .IP \fBdbm\fR
 /*	The output consists of two files, named \fIfile_name\fB.pag\fR and
 /*	\fIfile_name\fB.dir\fR.
@@ -209,6 +232,14 @@
 /*	A table that reliably fails all requests. The lookup table
 /*	name is used for logging only. This table exists to simplify
 /*	Postfix error tests.
+/* .IP \fBlmdb\fR
+/*	The output is a btree-based file, named \fIfile_name\fB.lmdb\fR.
+/*	This is available on systems with support for \fBlmdb\fR databases.
+/*	When a large table is created from input that is sorted in
+/*	byte order (for example, with "LC_ALL=C sort"), entries are
+/*	appended instead of inserted, which is substantially faster
+/*	and produces a smaller file. Sorting is not needed for
+/*	correctness.
 /* .IP \fBsdbm\fR
 /*	The output consists of two files, named \fIfile_name\fB.pag\fR and
 /*	\fIfile_name\fB.dir\fR.
@@ -300,6 +331,7 @@
 
 #include <sys_defs.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -321,6 +353,7 @@
 #include <set_eugid.h>
 #include <warn_stat.h>
 #include <clean_env.h>
+#include <htable.h>
 
 /* Global library. */
 
@@ -334,6 +367,7 @@
 #include <mime_state.h>
 #include <rec_type.h>
 #include <mail_parm_split.h>
+#include <been_here.h>
 
 /* Application-specific. */
 
@@ -363,10 +397,196 @@ typedef struct {
     int     found;			/* result */
 } POSTMAP_KEY_STATE;
 
+/* postmap_parse - split one logical input line into key and value */
+
+static int postmap_parse(DICT *dict, VSTREAM *source_fp, VSTRING *line_buffer,
+			         int lineno, char **key, char **value)
+{
+    int     in_quotes = 0;
+    char   *cp;
+
+    /*
+     * First some UTF-8 checks sans casefolding.
+     */
+    if ((dict->flags & DICT_FLAG_UTF8_ACTIVE)
+	&& !allascii(STR(line_buffer))
+	&& !valid_utf8_string(STR(line_buffer), LEN(line_buffer))) {
+	msg_warn("%s, line %d: non-UTF-8 input \"%s\""
+		 " -- ignoring this line",
+		 VSTREAM_PATH(source_fp), lineno, STR(line_buffer));
+	return (0);
+    }
+
+    /*
+     * Terminate the key on the first unquoted whitespace character, then
+     * trim leading and trailing whitespace from the value.
+     */
+    for (cp = STR(line_buffer); *cp; cp++) {
+	if (*cp == '\\') {
+	    if (*++cp == 0)
+		break;
+	} else if (ISSPACE(*cp)) {
+	    if (!in_quotes)
+		break;
+	} else if (*cp == '"') {
+	    in_quotes = !in_quotes;
+	}
+    }
+    if (in_quotes) {
+	msg_warn("%s, line %d: unbalanced '\"' in '%s'"
+		 " -- ignoring this line",
+		 VSTREAM_PATH(source_fp), lineno, STR(line_buffer));
+	return (0);
+    }
+    if (*cp)
+	*cp++ = 0;
+    while (ISSPACE(*cp))
+	cp++;
+    trimblanks(cp, 0)[0] = 0;
+
+    /*
+     * Leave the key in quoted form, because 1) postmap cannot assume that a
+     * string without @ contains an email address localpart, and 2) an
+     * address localpart may require quoting even when the quoted form
+     * contains no backslash or ".
+     */
+    *key = STR(line_buffer);
+    *value = cp;
+
+    /*
+     * Enforce the "key whitespace value" format. Disallow missing keys or
+     * missing values.
+     */
+    if (**key == 0 || **value == 0) {
+	msg_warn("%s, line %d: expected format: key whitespace value",
+		 VSTREAM_PATH(source_fp), lineno);
+	return (0);
+    }
+    if ((*key)[strlen(*key) - 1] == ':')
+	msg_warn("%s, line %d: record is in \"key: value\" format; is this an alias file?",
+		 VSTREAM_PATH(source_fp), lineno);
+    return (1);
+}
+
+ /*
+  * Delta mode: the entries of the old source file, and what became of them
+  * in the new source file.
+  */
+typedef struct {
+    char   *value;			/* old value, or null */
+    int     status;			/* see below */
+} POSTMAP_DELTA;
+
+#define POSTMAP_DELTA_GONE	0	/* not in new source */
+#define POSTMAP_DELTA_SAME	1	/* same key and value */
+#define POSTMAP_DELTA_CHANGED	2	/* same key, other value */
+
+#define POSTMAP_DUP_FLAGS \
+	(DICT_FLAG_DUP_WARN | DICT_FLAG_DUP_IGNORE | DICT_FLAG_DUP_REPLACE)
+
+/* postmap_delta_free - destroy delta table entry */
+
+static void postmap_delta_free(void *ptr)
+{
+    POSTMAP_DELTA *delta = (POSTMAP_DELTA *) ptr;
+
+    if (delta->value)
+	myfree(delta->value);
+    myfree((void *) delta);
+}
+
+/* postmap_delta_create - compare old and new source file */
+
+static HTABLE *postmap_delta_create(DICT *dict, const char *old_path,
+				            VSTREAM *source_fp,
+				            VSTRING *line_buffer)
+{
+    HTABLE *delta_table = htable_create(100);
+    POSTMAP_DELTA *delta;
+    VSTREAM *old_fp;
+    int     lineno;
+    int     last_line;
+    char   *key;
+    char   *value;
+
+    /*
+     * Remember the entries in the old source file. With duplicate keys, we
+     * don't know which value is in the database: that depends on the "-r"
+     * etc. options that were used when it was built. Such keys are always
+     * rewritten.
+     */
+    if ((old_fp = vstream_fopen(old_path, O_RDONLY, 0)) == 0)
+	msg_fatal("open %s: %m", old_path);
+    last_line = 0;
+    while (readllines(line_buffer, old_fp, &last_line, &lineno)) {
+	if (postmap_parse(dict, old_fp, line_buffer, lineno, &key, &value) == 0)
+	    continue;
+	if ((delta = (POSTMAP_DELTA *) htable_find(delta_table, key)) != 0) {
+	    if (delta->value) {
+		myfree(delta->value);
+		delta->value = 0;
+	    }
+	} else {
+	    delta = (POSTMAP_DELTA *) mymalloc(sizeof(*delta));
+	    (void) htable_enter(delta_table, key, (void *) delta);
+	    delta->value = mystrdup(value);
+	    delta->status = POSTMAP_DELTA_GONE;
+	}
+    }
+    if (vstream_fclose(old_fp))
+	msg_fatal("read %s: %m", old_path);
+
+    /*
+     * Find out which old entries survive unchanged. A key that appears more
+     * than once in the new source file is changed if any of its values
+     * differs from the old value.
+     */
+    last_line = 0;
+    while (readllines(line_buffer, source_fp, &last_line, &lineno)) {
+	if (postmap_parse(dict, source_fp, line_buffer, lineno,
+			  &key, &value) == 0)
+	    continue;
+	if ((delta = (POSTMAP_DELTA *) htable_find(delta_table, key)) != 0
+	    && delta->status != POSTMAP_DELTA_CHANGED)
+	    delta->status = (delta->value != 0
+			     && strcmp(delta->value, value) == 0 ?
+			     POSTMAP_DELTA_SAME : POSTMAP_DELTA_CHANGED);
+    }
+    if (vstream_fseek(source_fp, SEEK_SET, 0) < 0)
+	msg_fatal("seek %s: %m", VSTREAM_PATH(source_fp));
+    return (delta_table);
+}
+
+/* postmap_delta_delete - remove entries that are gone from the source */
+
+static int postmap_delta_delete(DICT *dict, HTABLE *delta_table)
+{
+    HTABLE_INFO **ht_info_list;
+    HTABLE_INFO **ht;
+    int     deleted = 0;
+
+    /*
+     * Delete before adding new entries. A key that is gone may differ from
+     * a new key only in case, and both may map to the same database key.
+     */
+    ht_info_list = htable_list(delta_table);
+    for (ht = ht_info_list; *ht; ht++) {
+	if (((POSTMAP_DELTA *) (*ht)->value)->status != POSTMAP_DELTA_GONE)
+	    continue;
+	if (dict_del(dict, (*ht)->key) == 0)
+	    deleted++;
+	if (dict->error)
+	    msg_fatal("table %s:%s: delete error: %m", dict->type, dict->name);
+    }
+    myfree((void *) ht_info_list);
+    return (deleted);
+}
+
 /* postmap - create or update mapping database */
 
 static void postmap(char *map_type, char *path_name, int postmap_flags,
-		            int open_flags, int dict_flags)
+		            int open_flags, int dict_flags,
+		            const char *delta_path)
 {
     VSTREAM *NOCLOBBER source_fp;
     VSTRING *line_buffer;
@@ -377,12 +597,30 @@ static void postmap(char *map_type, char *path_name, int postmap_flags,
     char   *value;
     struct stat st;
     mode_t  saved_mask;
+    int     entries;
+    int     deleted;
+    HTABLE *delta_table = 0;
+    POSTMAP_DELTA *delta;
+    BH_TABLE *written = 0;
+    int     dup_flags;
+    struct timeval start;
+    struct timeval finish;
+    double  elapsed;
 
     /*
      * Initialize.
      */
     line_buffer = vstring_alloc(100);
-    if ((open_flags & O_TRUNC) == 0) {
+    GETTIMEOFDAY(&start);
+    if (delta_path != 0) {
+	/* Delta mode. Apply all changes in one transaction if supported. */
+	if (strcmp(map_type, DICT_TYPE_PROXY) == 0)
+	    msg_fatal("can't update maps via the proxy service");
+	open_flags &= ~O_TRUNC;
+	dict_flags |= DICT_FLAG_BULK_UPDATE;
+	if ((source_fp = vstream_fopen(path_name, O_RDONLY, 0)) == 0)
+	    msg_fatal("open %s: %m", path_name);
+    } else if ((open_flags & O_TRUNC) == 0) {
 	/* Incremental mode. */
 	source_fp = VSTREAM_IN;
 	vstream_control(source_fp, CA_VSTREAM_CTL_PATH("stdin"), CA_VSTREAM_CTL_END);
@@ -425,105 +663,109 @@ static void postmap(char *map_type, char *path_name, int postmap_flags,
     if ((postmap_flags & POSTMAP_FLAG_SAVE_PERM) && S_ISREG(st.st_mode))
 	umask(saved_mask);
 
+    /*
+     * In delta mode, find out what has changed before making any updates.
+     */
+    if (delta_path != 0)
+	delta_table = postmap_delta_create(mkmap->dict, delta_path,
+					   source_fp, line_buffer);
+
     /*
      * Trap "exceptions" so that we can restart a bulk-mode update after a
      * recoverable error.
      */
+    dup_flags = mkmap->dict->flags & POSTMAP_DUP_FLAGS;
     for (;;) {
 	if (dict_isjmp(mkmap->dict) != 0
 	    && dict_setjmp(mkmap->dict) != 0
 	    && vstream_fseek(source_fp, SEEK_SET, 0) < 0)
 	    msg_fatal("seek %s: %m", VSTREAM_PATH(source_fp));
+	mkmap->dict->flags &= ~POSTMAP_DUP_FLAGS;
+	mkmap->dict->flags |= dup_flags;
+
+	/*
+	 * Remove entries that are no longer in the source file.
+	 */
+	if (delta_table != 0) {
+	    deleted = postmap_delta_delete(mkmap->dict, delta_table);
+	    if (written != 0)
+		been_here_free(written);
+	    written = been_here_init(0, (mkmap->dict->flags
+					 & DICT_FLAG_FOLD_FIX) ?
+				     BH_FLAG_FOLD : BH_FLAG_NONE);
+	} else
+	    deleted = 0;
 
 	/*
 	 * Add records to the database. XXX This duplicates the parser in
 	 * dict_thash.c.
 	 */
 	last_line = 0;
+	entries = 0;
 	while (readllines(line_buffer, source_fp, &last_line, &lineno)) {
-	    int     in_quotes = 0;
-
-	    /*
-	     * First some UTF-8 checks sans casefolding.
-	     */
-	    if ((mkmap->dict->flags & DICT_FLAG_UTF8_ACTIVE)
-		&& !allascii(STR(line_buffer))
-		&& !valid_utf8_string(STR(line_buffer), LEN(line_buffer))) {
-		msg_warn("%s, line %d: non-UTF-8 input \"%s\""
-			 " -- ignoring this line",
-			 VSTREAM_PATH(source_fp), lineno, STR(line_buffer));
+	    if (postmap_parse(mkmap->dict, source_fp, line_buffer, lineno,
+			      &key, &value) == 0)
 		continue;
-	    }
 
 	    /*
-	     * Terminate the key on the first unquoted whitespace character,
-	     * then trim leading and trailing whitespace from the value.
+	     * In delta mode, skip entries that have not changed. The first
+	     * occurrence of a key in this pass replaces the value from the
+	     * old source. Later occurrences are duplicates, and the database
+	     * handles them as specified with "-r", "-w", etc., as it does
+	     * when the database is built from scratch.
 	     */
-	    for (value = STR(line_buffer); *value; value++) {
-		if (*value == '\\') {
-		    if (*++value == 0)
-			break;
-		} else if (ISSPACE(*value)) {
-		    if (!in_quotes)
-			break;
-		} else if (*value == '"') {
-		    in_quotes = !in_quotes;
-		}
+	    if (delta_table != 0 && been_here_fixed(written, key) == 0) {
+		if ((delta = (POSTMAP_DELTA *)
+		     htable_find(delta_table, key)) != 0
+		    && delta->status == POSTMAP_DELTA_SAME)
+		    continue;
+		mkmap->dict->flags &= ~POSTMAP_DUP_FLAGS;
+		mkmap->dict->flags |= DICT_FLAG_DUP_REPLACE;
 	    }
-	    if (in_quotes) {
-		msg_warn("%s, line %d: unbalanced '\"' in '%s'"
-			 " -- ignoring this line",
-			 VSTREAM_PATH(source_fp), lineno, STR(line_buffer));
-		continue;
-	    }
-	    if (*value)
-		*value++ = 0;
-	    while (ISSPACE(*value))
-		value++;
-	    trimblanks(value, 0)[0] = 0;
-
-	    /*
-	     * Leave the key in quoted form, because 1) postmap cannot assume
-	     * that a string without @ contains an email address localpart,
-	     * and 2) an address localpart may require quoting even when the
-	     * quoted form contains no backslash or ".
-	     */
-	    key = STR(line_buffer);
-
-	    /*
-	     * Enforce the "key whitespace value" format. Disallow missing
-	     * keys or missing values.
-	     */
-	    if (*key == 0 || *value == 0) {
-		msg_warn("%s, line %d: expected format: key whitespace value",
-			 VSTREAM_PATH(source_fp), lineno);
-		continue;
-	    }
-	    if (key[strlen(key) - 1] == ':')
-		msg_warn("%s, line %d: record is in \"key: value\" format; is this an alias file?",
-			 VSTREAM_PATH(source_fp), lineno);
 
 	    /*
 	     * Store the value under a (possibly case-insensitive) key, as
 	     * specified with open_flags.
 	     */
 	    mkmap_append(mkmap, key, value);
+	    mkmap->dict->flags &= ~POSTMAP_DUP_FLAGS;
+	    mkmap->dict->flags |= dup_flags;
 	    if (mkmap->dict->error)
 		msg_fatal("table %s:%s: write error: %m",
 			  mkmap->dict->type, mkmap->dict->name);
+	    entries++;
 	}
 	break;
     }
 
     /*
-     * Close the mapping database, and release the lock.
+     * Close the mapping database, and release the lock. The elapsed time
+     * includes the final commit, which is a large part of a bulk update.
      */
-    mkmap_close(mkmap);
+    if (msg_verbose) {
+	vstring_sprintf(line_buffer, "%s:%s", mkmap->dict->type,
+			mkmap->dict->name);
+	mkmap_close(mkmap);
+	GETTIMEOFDAY(&finish);
+	elapsed = (finish.tv_sec - start.tv_sec)
+	    + (finish.tv_usec - start.tv_usec) / 1000000.0;
+	msg_info("%s: stored %d entries in %.3f s (%.0f entries/s)",
+		 STR(line_buffer), entries, elapsed,
+		 elapsed > 0 ? entries / elapsed : 0.0);
+	if (delta_table != 0)
+	    msg_info("%s: deleted %d entries", STR(line_buffer), deleted);
+    } else {
+	mkmap_close(mkmap);
+    }
 
     /*
      * Cleanup. We're about to terminate, but it is a good sanity check.
      */
     vstring_free(line_buffer);
+    if (delta_table != 0)
+	htable_free(delta_table, postmap_delta_free);
+    if (written != 0)
+	been_here_free(written);
     if (source_fp != VSTREAM_IN)
 	vstream_fclose(source_fp);
 }
@@ -846,7 +1088,7 @@ static void postmap_seq(const char *map_type, const char *map_name,
 
 static NORETURN usage(char *myname)
 {
-    msg_fatal("usage: %s [-NfinoprsuUvw] [-c config_dir] [-d key] [-q key] [map_type:]file...",
+    msg_fatal("usage: %s [-NfinoprsuUvw] [-c config_dir] [-D old_file] [-d key] [-q key] [map_type:]file...",
 	      myname);
 }
 
@@ -868,6 +1110,7 @@ int     main(int argc, char **argv)
     int     sequence = 0;
     int     found;
     int     force_utf8 = 0;
+    char   *delta_path = 0;
     ARGV   *import_env;
 
     /*
@@ -914,11 +1157,14 @@ int     main(int argc, char **argv)
     /*
      * Parse JCL.
      */
-    while ((ch = GETOPT(argc, argv, "Nbc:d:fhimnopq:rsuUvw")) > 0) {
+    while ((ch = GETOPT(argc, argv, "D:Nbc:d:fhimnopq:rsuUvw")) > 0) {
 	switch (ch) {
 	default:
 	    usage(argv[0]);
 	    break;
+	case 'D':
+	    delta_path = optarg;
+	    break;
 	case 'N':
 	    dict_flags |= DICT_FLAG_TRY1NULL;
 	    dict_flags &= ~DICT_FLAG_TRY0NULL;
@@ -1004,6 +1250,8 @@ int     main(int argc, char **argv)
     if ((postmap_flags & (POSTMAP_FLAG_ANY_KEY & ~POSTMAP_FLAG_MIME_KEY))
 	&& force_utf8 == 0)
 	dict_flags &= ~DICT_FLAG_UTF8_MASK;
+    if (delta_path != 0 && (query || delkey || sequence))
+	msg_fatal("specify -D only when updating a table");
 
     /*
      * Use the map type specified by the user, or fall back to a default
@@ -1061,13 +1309,15 @@ int     main(int argc, char **argv)
     } else {					/* create/update map(s) */
 	if (optind + 1 > argc)
 	    usage(argv[0]);
+	if (delta_path != 0 && optind + 1 != argc)
+	    msg_fatal("specify only one table with -D");
 	while (optind < argc) {
 	    if ((path_name = split_at(argv[optind], ':')) != 0) {
 		postmap(argv[optind], path_name, postmap_flags,
-			open_flags, dict_flags);
+			open_flags, dict_flags, delta_path);
 	    } else {
 		postmap(var_db_type, argv[optind], postmap_flags,
-			open_flags, dict_flags);
+			open_flags, dict_flags, delta_path);
 	    }
 	    optind++;
 	}
@@ -556,6 +556,7 @@ static ADDR_MATCH_LIST *psc_wlist_if;	/* whitelist interfaces */
 static void psc_endpt_lookup_done(int, VSTREAM *,
 			             MAI_HOSTADDR_STR *, MAI_SERVPORT_STR *,
 			            MAI_HOSTADDR_STR *, MAI_SERVPORT_STR *);
+static void psc_acl_eval_done(int, void *);
 
 /* psc_dump - dump some statistics before exit */
 
@@ -660,8 +661,7 @@ static void psc_endpt_lookup_done(int endpt_status,
 {
     const char *myname = "psc_endpt_lookup_done";
     PSC_STATE *state;
-    const char *stamp_str;
-    int     saved_flags;
+    int     acl_action;
 
     /*
      * Best effort - if this non-blocking write(2) fails, so be it.
@@ -715,11 +715,35 @@ static void psc_endpt_lookup_done(int endpt_status,
 	return;
     }
 
+    /*
+     * The permanent white/blacklist has highest precedence. Lookups in
+     * socketmap or tcp tables do not block other sessions; we resume when
+     * the result arrives.
+     */
+    if (psc_acl == 0)
+	acl_action = PSC_ACL_ACT_DUNNO;
+    else if ((acl_action = psc_acl_eval_async(state, psc_acl, VAR_PSC_ACL,
+					      psc_acl_eval_done,
+					      (void *) state))
+	     == PSC_ACL_ACT_PENDING)
+	return;
+    psc_acl_eval_done(acl_action, (void *) state);
+}
+
+/* psc_acl_eval_done - permanent white/blacklist evaluation completed */
+
+static void psc_acl_eval_done(int acl_action, void *context)
+{
+    const char *myname = "psc_acl_eval_done";
+    PSC_STATE *state = (PSC_STATE *) context;
+    const char *stamp_str;
+    int     saved_flags;
+
     /*
      * The permanent white/blacklist has highest precedence.
      */
     if (psc_acl != 0) {
-	switch (psc_acl_eval(state, psc_acl, VAR_PSC_ACL)) {
+	switch (acl_action) {
 
 	    /*
 	     * Permanently blacklisted.
@@ -807,7 +831,7 @@ static void psc_endpt_lookup_done(int endpt_status,
      * Don't whitelist clients that connect to backup MX addresses. Fail
      * "closed" on error.
      */
-    if (addr_match_list_match(psc_wlist_if, smtp_server_addr->buf) == 0) {
+    if (addr_match_list_match(psc_wlist_if, state->smtp_server_addr) == 0) {
 	state->flags |= (PSC_STATE_FLAG_WLIST_FAIL | PSC_STATE_FLAG_NOFORWARD);
 	msg_info("WHITELIST VETO [%s]:%s", PSC_CLIENT_ADDR_PORT(state));
     }
@@ -570,10 +570,13 @@ extern void psc_endpt_lookup(VSTREAM *, PSC_ENDPT_LOOKUP_FN);
 #define PSC_ACL_ACT_DUNNO	SERVER_ACL_ACT_DUNNO
 #define PSC_ACL_ACT_BLACKLIST	SERVER_ACL_ACT_REJECT
 #define PSC_ACL_ACT_ERROR	SERVER_ACL_ACT_ERROR
+#define PSC_ACL_ACT_PENDING	SERVER_ACL_ACT_PENDING
 
 #define psc_acl_pre_jail_init	server_acl_pre_jail_init
 #define psc_acl_parse		server_acl_parse
 #define psc_acl_eval(s,a,p)	server_acl_eval((s)->smtp_client_addr, (a), (p))
+#define psc_acl_eval_async(s,a,p,c,x) \
+	server_acl_eval_async((s)->smtp_client_addr, (a), (p), (c), (x))
 
 /* LICENSE
 /* .ad
@@ -8,7 +8,8 @@
 /*	\fBpostsuper\fR [\fB-psSv\fR]
 /*	[\fB-c \fIconfig_dir\fR] [\fB-d \fIqueue_id\fR]
 /*		[\fB-h \fIqueue_id\fR] [\fB-H \fIqueue_id\fR]
-/*		[\fB-r \fIqueue_id\fR] [\fIdirectory ...\fR]
+/*		[\fB-m \fIname=value\fR] [\fB-r \fIqueue_id\fR]
+/*		[\fIdirectory ...\fR]
 /* DESCRIPTION
 /*	The \fBpostsuper\fR(1) command does maintenance jobs on the Postfix
 /*	queue. Use of the command is restricted to the superuser.
@@ -111,6 +112,53 @@
 /*	case.
 /* .sp
 /*	This feature is available in Postfix 2.0 and later.
+/* .IP "\fB-m \fIname=value\fR"
+/*	Limit the \fB-d\fR, \fB-h\fR, \fB-H\fR and \fB-r\fR
+/*	operations to messages that match the specified criterion.
+/*	This works with named queue IDs as well as with \fBALL\fR,
+/*	and avoids the need to produce a list of queue IDs with
+/*	\fBmailq\fR(1) or \fBpostqueue\fR(1).
+/*
+/*	To specify multiple criteria, specify the \fB-m\fR option
+/*	multiple times. A message is selected only when it matches
+/*	all criteria. The following criteria are supported:
+/* .RS
+/* .IP "\fBsender=\fIaddress\fR"
+/*	The envelope sender address is equal to \fIaddress\fR.
+/*	Specify \fBsender=<>\fR for the null sender address.
+/*	Specify \fBsender=@\fIdomain\fR to match any sender address
+/*	in \fIdomain\fR.
+/* .IP "\fBrecipient=\fIaddress\fR"
+/*	At least one undelivered envelope recipient is equal to
+/*	\fIaddress\fR.  Specify \fBrecipient=@\fIdomain\fR to match
+/*	any recipient address in \fIdomain\fR.
+/* .IP "\fBheader=\fItext\fR"
+/*	A primary message header contains \fItext\fR (case
+/*	insensitive).  A multi-line header is matched as one string
+/*	with embedded newline characters. To bound the cost per
+/*	message, at most $\fBheader_size_limit\fR bytes of message
+/*	header are examined, and the message body is not read.
+/* .IP "\fBmin_size=\fIbytes\fR, \fBmax_size=\fIbytes\fR"
+/*	The message content size is at least, or at most, the
+/*	specified number of bytes.
+/* .IP "\fBmin_age=\fItime\fR, \fBmax_age=\fItime\fR"
+/*	The time since the message arrived is at least, or at most,
+/*	the specified time. Specify a non-negative time value (an
+/*	integral value plus an optional one-letter suffix that
+/*	specifies the time unit).  Time units: s (seconds), m
+/*	(minutes), h (hours), d (days), w (weeks). The default time
+/*	unit is s (seconds).
+/* .RE
+/* .IP
+/*	Address comparisons are case insensitive. For example, to
+/*	delete all deferred mail from the null sender that is older
+/*	than 2 days:
+/* .sp
+/* .nf
+/*	postsuper -d ALL -m sender=<> -m min_age=2d deferred
+/* .fi
+/* .sp
+/*	This feature is available in Postfix 3.4 and later.
 /* .IP \fB-p\fR
 /*	Purge old temporary files that are left over after system or
 /*	software crashes.
@@ -204,8 +252,14 @@
 /*
 /*	\fBpostsuper\fR(1) reports the number of messages deleted with \fB-d\fR,
 /*	the number of messages requeued with \fB-r\fR, and the number of
-/*	messages whose queue file name was fixed with \fB-s\fR. The report
-/*	is written to the standard error stream and to \fBsyslogd\fR(8).
+/*	messages whose queue file name was fixed with \fB-s\fR. With
+/*	\fB-m\fR, it also reports the number of messages that were
+/*	skipped because they did not match. The report is written to
+/*	the standard error stream and to \fBsyslogd\fR(8).
+/*
+/*	While it works through a large queue, or through a long list
+/*	of queue IDs on the standard input stream, \fBpostsuper\fR(1)
+/*	reports its progress every 10 seconds.
 /* ENVIRONMENT
 /* .ad
 /* .fi
@@ -272,6 +326,7 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <string.h>
+#include <ctype.h>
 #include <signal.h>
 #include <stdio.h>			/* remove() */
 #include <utime.h>
@@ -293,6 +348,8 @@
 #include <myrand.h>
 #include <warn_stat.h>
 #include <clean_env.h>
+#include <split_at.h>
+#include <stringops.h>
 
 /* Global library. */
 
@@ -305,11 +362,16 @@
 #include <mail_open_ok.h>
 #include <file_id.h>
 #include <mail_parm_split.h>
+#include <record.h>
+#include <rec_type.h>
+#include <conv_time.h>
+#include <off_cvt.h>
 
 /* Application-specific. */
 
 #define MAX_TEMP_AGE (60 * 60 * 24)	/* temp file maximal age */
 #define STR vstring_str			/* silly little macro */
+#define LEN VSTRING_LEN			/* ditto */
 
 #define ACTION_STRUCT	(1<<0)		/* fix file organization */
 #define ACTION_PURGE	(1<<1)		/* purge old temp files */
@@ -387,6 +449,23 @@ const char *log_queue_names[] = {
 #define SUFFIX		"#FIX"
 #define SUFFIX_LEN	4
 
+ /*
+  * Message selection criteria (-m name=value). A message is selected only
+  * when it matches all specified criteria. Absent criteria are null or
+  * negative.
+  */
+typedef struct {
+    char   *sender;			/* sender address or @domain */
+    char   *recipient;			/* recipient address or @domain */
+    char   *header;			/* message header text */
+    off_t   min_size;			/* minimal content size */
+    off_t   max_size;			/* maximal content size */
+    int     min_age;			/* minimal time in queue */
+    int     max_age;			/* maximal time in queue */
+} MSG_SELECT;
+
+static MSG_SELECT *msg_select = 0;
+
  /*
   * Grr. These counters are global, because C only has clumsy ways to return
   * multiple results from a function.
@@ -398,6 +477,15 @@ static int message_deleted = 0;		/* deleted messages */
 static int inode_fixed = 0;		/* queue id matched to inode number */
 static int inode_mismatch = 0;		/* queue id inode mismatch */
 static int position_mismatch = 0;	/* file position mismatch */
+static int message_skipped = 0;		/* not selected with -m */
+static int message_examined = 0;	/* queue files examined */
+
+ /*
+  * Progress reports during long-running bulk operations.
+  */
+#define PROGRESS_INTERVAL	10	/* seconds */
+
+static time_t progress_time = 0;	/* time of last report */
 
  /*
   * Silly little macros. These translate arcane expressions into something
@@ -469,6 +557,244 @@ static int postrmdir(const char *path)
     return (ret);
 }
 
+/* select_parse - parse one -m name=value selection criterion */
+
+static void select_parse(MSG_SELECT *sp, char *nameval)
+{
+    char   *value;
+
+    if ((value = split_at(nameval, '=')) == 0)
+	msg_fatal("-m option requires name=value, found: \"%s\"", nameval);
+    if (strcmp(nameval, "sender") == 0) {
+	if (sp->sender)
+	    myfree(sp->sender);
+	sp->sender = mystrdup(strcmp(value, "<>") == 0 ? "" : value);
+    } else if (strcmp(nameval, "recipient") == 0) {
+	if (*value == 0)
+	    msg_fatal("-m recipient requires an address or @domain");
+	if (sp->recipient)
+	    myfree(sp->recipient);
+	sp->recipient = mystrdup(value);
+    } else if (strcmp(nameval, "header") == 0) {
+	if (*value == 0)
+	    msg_fatal("-m header requires header text");
+	if (sp->header)
+	    myfree(sp->header);
+	sp->header = lowercase(mystrdup(value));
+    } else if (strcmp(nameval, "min_size") == 0) {
+	if ((sp->min_size = off_cvt_string(value)) < 0)
+	    msg_fatal("-m %s requires a byte count", nameval);
+    } else if (strcmp(nameval, "max_size") == 0) {
+	if ((sp->max_size = off_cvt_string(value)) < 0)
+	    msg_fatal("-m %s requires a byte count", nameval);
+    } else if (strcmp(nameval, "min_age") == 0) {
+	if (conv_time(value, &sp->min_age, 's') == 0)
+	    msg_fatal("-m %s requires a time value", nameval);
+    } else if (strcmp(nameval, "max_age") == 0) {
+	if (conv_time(value, &sp->max_age, 's') == 0)
+	    msg_fatal("-m %s requires a time value", nameval);
+    } else {
+	msg_fatal("unknown -m selection criterion: \"%s\"", nameval);
+    }
+}
+
+/* select_addr_match - match address against address or @domain pattern */
+
+static int select_addr_match(const char *pattern, const char *addr)
+{
+    const char *at;
+
+    if (*pattern == '@' && pattern[1] != 0)
+	return ((at = strrchr(addr, '@')) != 0
+		&& strcasecmp(at + 1, pattern + 1) == 0);
+    return (strcasecmp(addr, pattern) == 0);
+}
+
+/* select_header - match primary message header against header text */
+
+static int select_header(VSTREAM *fp, const char *text)
+{
+    VSTRING *buf = vstring_alloc(100);
+    VSTRING *hdr = vstring_alloc(100);
+    ssize_t budget = var_header_limit;
+    int     prev_type = REC_TYPE_NORM;
+    int     rec_type;
+    int     found = 0;
+
+    /*
+     * Examine only the primary message header, and at most
+     * $header_size_limit bytes of it, so that the cost does not depend on
+     * the message size. Multi-line headers are joined, and so are long
+     * lines that were stored as a sequence of REC_TYPE_CONT records.
+     */
+    while (found == 0 && budget > 0
+	   && (rec_type = rec_get(fp, buf, 0)) > 0) {
+	if (rec_type != REC_TYPE_NORM && rec_type != REC_TYPE_CONT)
+	    break;
+	budget -= LEN(buf);
+	if (prev_type == REC_TYPE_CONT) {
+	    vstring_strcat(hdr, STR(buf));
+	} else if (LEN(buf) > 0 && ISSPACE(*STR(buf))) {
+	    VSTRING_ADDCH(hdr, '\n');
+	    vstring_strcat(hdr, STR(buf));
+	} else {
+	    if (LEN(hdr) > 0 && strstr(lowercase(STR(hdr)), text) != 0)
+		found = 1;
+	    if (LEN(buf) == 0)
+		break;
+	    vstring_strcpy(hdr, STR(buf));
+	}
+	prev_type = rec_type;
+    }
+    if (found == 0 && LEN(hdr) > 0 && strstr(lowercase(STR(hdr)), text) != 0)
+	found = 1;
+    vstring_free(buf);
+    vstring_free(hdr);
+    return (found);
+}
+
+/* select_message - match queue file against -m selection criteria */
+
+static int select_message(const char *path, struct stat * st)
+{
+    MSG_SELECT *sp = msg_select;
+    VSTREAM *fp;
+    VSTRING *buf;
+    int     rec_type;
+    char   *start;
+    off_t   msg_size = st->st_size;
+    off_t   content_offset;
+    time_t  arrival_time = 0;
+    int     size_seen = 0;
+    int     sender_ok = (sp->sender == 0);
+    int     rcpt_ok = (sp->recipient == 0);
+    int     header_ok = (sp->header == 0);
+    int     age;
+
+    /*
+     * Open the queue file read-only. We don't lock the file; a message that
+     * is being delivered may have recipients marked as done after we look.
+     * A missing file means we lost a race, and the caller skips it.
+     */
+    if ((fp = vstream_fopen(path, O_RDONLY, 0)) == 0) {
+	if (errno != ENOENT)
+	    msg_warn("open %s: %m", path);
+	return (0);
+    }
+    buf = vstring_alloc(100);
+
+    /*
+     * Read envelope records until we have seen everything that we need to
+     * know. Skip the message content, like showq(8) does, so that the cost
+     * does not depend on the message size; the header criterion looks at
+     * the primary message header only. Extracted recipients are found
+     * after the message content.
+     */
+    while ((rec_type = rec_get(fp, buf, 0)) > 0) {
+	start = STR(buf);
+	if (rec_type == REC_TYPE_SIZE) {
+	    if (size_seen == 0) {
+		size_seen = (start[strspn(start, "0123456789 ")] == 0
+			     && (msg_size = atol(start)) >= 0);
+		if (size_seen == 0)
+		    msg_size = st->st_size;
+	    }
+	} else if (rec_type == REC_TYPE_TIME) {
+	    if (arrival_time == 0)
+		arrival_time = atol(start);
+	} else if (rec_type == REC_TYPE_FROM) {
+	    if (sp->sender != 0)
+		sender_ok = (*sp->sender == 0 ? *start == 0 :
+			     select_addr_match(sp->sender, start));
+	    if (sender_ok == 0)
+		break;
+	} else if (rec_type == REC_TYPE_RCPT) {
+	    if (rcpt_ok == 0)
+		rcpt_ok = select_addr_match(sp->recipient, start);
+	} else if (rec_type == REC_TYPE_MESG) {
+	    content_offset = vstream_ftell(fp);
+	    if (header_ok == 0
+		&& (header_ok = select_header(fp, sp->header)) == 0)
+		break;
+	    if (rcpt_ok != 0)
+		break;
+	    if (size_seen && vstream_fseek(fp, content_offset + msg_size,
+					   SEEK_SET) < 0) {
+		msg_warn("seek file %s: %m", path);
+		break;
+	    }
+	} else if (rec_type == REC_TYPE_END) {
+	    break;
+	}
+    }
+    if (vstream_fclose(fp))
+	msg_warn("close %s: %m", path);
+    vstring_free(buf);
+
+    /*
+     * Apply the size and age criteria. Fall back to the file modification
+     * time only when the queue file has no arrival time record; in the
+     * deferred queue the modification time is the next retry time.
+     */
+    if (sender_ok == 0 || rcpt_ok == 0 || header_ok == 0)
+	return (0);
+    if (sp->min_size >= 0 && msg_size < sp->min_size)
+	return (0);
+    if (sp->max_size >= 0 && msg_size > sp->max_size)
+	return (0);
+    if (arrival_time == 0)
+	arrival_time = st->st_mtime;
+    age = time((time_t *) 0) - arrival_time;
+    if (sp->min_age >= 0 && age < sp->min_age)
+	return (0);
+    if (sp->max_age >= 0 && age > sp->max_age)
+	return (0);
+    return (1);
+}
+
+/* progress_report - periodic report during long-running operations */
+
+static void progress_report(int done)
+{
+    time_t  now = time((time_t *) 0);
+
+    if (progress_time == 0) {
+	progress_time = now;
+    } else if (now >= progress_time + PROGRESS_INTERVAL) {
+	progress_time = now;
+	msg_info("progress: %d queue file%s examined, %d done, %d not selected",
+		 message_examined, message_examined > 1 ? "s" : "",
+		 done, message_skipped);
+    }
+}
+
+/* select_one - match named queue file against -m selection criteria */
+
+static int select_one(const char **queue_names, const char *queue_id)
+{
+    struct stat st;
+    const char **msg_qpp;
+    const char *msg_path;
+
+    /*
+     * Don't complain about bad or missing queue IDs here. The operation
+     * that follows will do that.
+     */
+    if (msg_select == 0 || !mail_queue_id_ok(queue_id))
+	return (1);
+    for (msg_qpp = queue_names; *msg_qpp != 0; msg_qpp++) {
+	if (!MESSAGE_QUEUE(find_queue_info(*msg_qpp)))
+	    continue;
+	if (mail_open_ok(*msg_qpp, queue_id, &st, &msg_path) != MAIL_OPEN_YES)
+	    continue;
+	if (select_message(msg_path, &st))
+	    return (1);
+	message_skipped++;
+	return (0);
+    }
+    return (1);
+}
+
 /* delete_one - delete one message instance and all its associated files */
 
 static int delete_one(const char **queue_names, const char *queue_id)
@@ -665,8 +991,12 @@ static int operate_stream(VSTREAM *fp,
     VSTRING *buf = vstring_alloc(20);
     int     found = 0;
 
-    while (vstring_get_nonl(buf, fp) != VSTREAM_EOF)
-	found += operator(queues, STR(buf));
+    while (vstring_get_nonl(buf, fp) != VSTREAM_EOF) {
+	message_examined++;
+	if (select_one(queues, STR(buf)))
+	    found += operator(queues, STR(buf));
+	progress_report(found);
+    }
 
     vstring_free(buf);
     return (found);
@@ -753,6 +1083,8 @@ static void super(const char **queues, int action)
     unsigned long inum;
     int     long_name;
     int     error;
+    const char **log_qpp;
+    int     selected;
 
     /*
      * Make sure every file is in the right place, clean out stale files, and
@@ -827,6 +1159,12 @@ static void super(const char **queues, int action)
 	    vstring_sprintf(actual_path, "%s/%s", scan_dir_path(info), path);
 	    if (stat(STR(actual_path), &st) < 0)
 		continue;
+	    if (S_ISREG(st.st_mode) && MESSAGE_QUEUE(qp)) {
+		message_examined++;
+		progress_report(message_deleted + message_requeued
+				+ message_held + message_released);
+	    }
+	    selected = -1;			/* not yet examined */
 
 	    /*
 	     * Remove alien directories. If maildrop is compromised, then we
@@ -851,7 +1189,7 @@ static void super(const char **queues, int action)
 	     * mail_queue_remove(), so that it can avoid having to first move
 	     * queue files to the "right" subdirectory level.
 	     */
-	    if (action & ACTION_DELETE_ALL) {
+	    if ((action & ACTION_DELETE_ALL) && msg_select == 0) {
 		if (postremove(STR(actual_path)) == 0)
 		    if (MESSAGE_QUEUE(qp) && READY_MESSAGE(st))
 			message_deleted++;
@@ -859,6 +1197,26 @@ static void super(const char **queues, int action)
 		continue;
 	    }
 
+	    /*
+	     * Selective mass deletion (-d ALL with -m criteria). Only message
+	     * files are considered; like delete_one(), we delete the logfiles
+	     * before the message file. Other files are left alone.
+	     */
+	    if ((action & ACTION_DELETE_ALL)
+		&& S_ISREG(st.st_mode)
+		&& MESSAGE_QUEUE(qp) && READY_MESSAGE(st)
+		&& mail_queue_id_ok(path)) {
+		if ((selected = select_message(STR(actual_path), &st)) != 0) {
+		    for (log_qpp = log_queue_names; *log_qpp != 0; log_qpp++)
+			postremove(mail_queue_path(wanted_path, *log_qpp, path));
+		    if (postremove(STR(actual_path)) == 0)
+			message_deleted++;
+		    /* No further work on this object is possible. */
+		    continue;
+		}
+		message_skipped++;
+	    }
+
 	    /*
 	     * Remove non-file objects and old temporary files. Be careful
 	     * not to delete bounce or defer logs just because they are more
@@ -956,6 +1314,23 @@ static void super(const char **queues, int action)
 		}
 	    }
 
+	    /*
+	     * With -m selection criteria, mass requeue, hold and release
+	     * operations skip messages that don't match. We look at a queue
+	     * file only when one of those operations could apply, and only
+	     * once (selective mass deletion may already have looked).
+	     */
+	    if (msg_select != 0 && selected < 0
+		&& (((action & (ACTION_REQUEUE_ALL | ACTION_HOLD_ALL))
+		     && MESSAGE_QUEUE(qp)
+		     && strcmp(queue_name, MAIL_QUEUE_MAILDROP) != 0
+		     && ((action & ACTION_REQUEUE_ALL)
+			 || strcmp(queue_name, MAIL_QUEUE_HOLD) != 0))
+		    || ((action & ACTION_RELEASE_ALL)
+			&& strcmp(queue_name, MAIL_QUEUE_HOLD) == 0))
+		&& (selected = select_message(STR(actual_path), &st)) == 0)
+		message_skipped++;
+
 	    /*
 	     * Mass requeuing. The pickup daemon will copy requeued mail to a
 	     * new queue file, so that address rewriting is applied again.
@@ -964,7 +1339,7 @@ static void super(const char **queues, int action)
 	     * subdirectory level. Like the requeue_one() routine, this code
 	     * does not touch logfiles.
 	     */
-	    if ((action & ACTION_REQUEUE_ALL)
+	    if ((action & ACTION_REQUEUE_ALL) && selected != 0
 		&& MESSAGE_QUEUE(qp)
 		&& strcmp(queue_name, MAIL_QUEUE_MAILDROP) != 0) {
 		(void) mail_queue_path(wanted_path, MAIL_QUEUE_MAILDROP, path);
@@ -983,7 +1358,7 @@ static void super(const char **queues, int action)
 	     * files contain data that has not yet been sanitized and
 	     * therefore must not be mixed with already sanitized mail.
 	     */
-	    if ((action & ACTION_HOLD_ALL)
+	    if ((action & ACTION_HOLD_ALL) && selected != 0
 		&& MESSAGE_QUEUE(qp)
 		&& strcmp(queue_name, MAIL_QUEUE_MAILDROP) != 0
 		&& strcmp(queue_name, MAIL_QUEUE_HOLD) != 0) {
@@ -1000,7 +1375,7 @@ static void super(const char **queues, int action)
 	     * first move queue files to the "right" subdirectory level. Like
 	     * the release_one() routine, this code must not touch logfiles.
 	     */
-	    if ((action & ACTION_RELEASE_ALL)
+	    if ((action & ACTION_RELEASE_ALL) && selected != 0
 		&& strcmp(queue_name, MAIL_QUEUE_HOLD) == 0) {
 		(void) mail_queue_path(wanted_path, MAIL_QUEUE_DEFERRED, path);
 		if (postrename(STR(actual_path), STR(wanted_path)) == 0)
@@ -1172,13 +1547,14 @@ int     main(int argc, char **argv)
     /*
      * Parse JCL.
      */
-    while ((c = GETOPT(argc, argv, "c:d:h:H:pr:sSv")) > 0) {
+    while ((c = GETOPT(argc, argv, "c:d:h:H:m:pr:sSv")) > 0) {
 	switch (c) {
 	default:
 	    msg_fatal("usage: %s "
 		      "[-c config_dir] "
 		      "[-d queue_id (delete)] "
 		      "[-h queue_id (hold)] [-H queue_id (un-hold)] "
+		      "[-m name=value (select)] "
 		      "[-p (purge temporary files)] [-r queue_id (requeue)] "
 		      "[-s (structure fix)] [-S (redundant structure fix)]"
 		      "[-v (verbose)] [queue...]", argv[0]);
@@ -1209,6 +1585,16 @@ int     main(int argc, char **argv)
 	    action |= (strcmp(optarg, "ALL") == 0 ?
 		       ACTION_RELEASE_ALL : ACTION_RELEASE_ONE);
 	    break;
+	case 'm':
+	    if (msg_select == 0) {
+		msg_select = (MSG_SELECT *) mymalloc(sizeof(*msg_select));
+		msg_select->sender = msg_select->recipient = 0;
+		msg_select->header = 0;
+		msg_select->min_size = msg_select->max_size = -1;
+		msg_select->min_age = msg_select->max_age = -1;
+	    }
+	    select_parse(msg_select, optarg);
+	    break;
 	case 'p':
 	    action |= ACTION_PURGE;
 	    break;
@@ -1301,6 +1687,10 @@ int     main(int argc, char **argv)
 	msg_warn("option \"-H ALL\" will ignore other command line queue IDs");
 	action &= ~ACTION_RELEASE_ONE;
     }
+    if (msg_select != 0
+	&& (action & (ACTIONS_BY_QUEUE_ID | ACTION_DELETE_ALL
+		      | ACTIONS_AFTER_INUM_FIX)) == 0)
+	msg_fatal("option -m requires -d, -h, -H, or -r");
 
     /*
      * Execute the explicitly specified (or default) action, on the
@@ -1366,7 +1756,7 @@ int     main(int argc, char **argv)
 	    if (strcmp(*cpp, "-") == 0)
 		message_deleted +=
 		    operate_stream(VSTREAM_IN, delete_one, queues);
-	    else
+	    else if (select_one(queues, *cpp))
 		message_deleted += delete_one(queues, *cpp);
 	}
     }
@@ -1386,7 +1776,7 @@ int     main(int argc, char **argv)
 	    if (strcmp(*cpp, "-") == 0)
 		message_requeued +=
 		    operate_stream(VSTREAM_IN, requeue_one, queues);
-	    else
+	    else if (select_one(queues, *cpp))
 		message_requeued += requeue_one(queues, *cpp);
 	}
     }
@@ -1406,7 +1796,7 @@ int     main(int argc, char **argv)
 	    if (strcmp(*cpp, "-") == 0)
 		message_held +=
 		    operate_stream(VSTREAM_IN, hold_one, queues);
-	    else
+	    else if (select_one(queues, *cpp))
 		message_held += hold_one(queues, *cpp);
 	}
     }
@@ -1426,7 +1816,7 @@ int     main(int argc, char **argv)
 	    if (strcmp(*cpp, "-") == 0)
 		message_released +=
 		    operate_stream(VSTREAM_IN, release_one, queues);
-	    else
+	    else if (select_one(queues, *cpp))
 		message_released += release_one(queues, *cpp);
 	}
     }
@@ -1446,6 +1836,9 @@ int     main(int argc, char **argv)
     if (message_released > 0)
 	msg_info("Released from hold: %d message%s",
 		 message_released, message_released > 1 ? "s" : "");
+    if (message_skipped > 0)
+	msg_info("Not selected: %d message%s", message_skipped,
+		 message_skipped > 1 ? "s" : "");
     if (inode_fixed > 0)
 	msg_info("Renamed to match inode number: %d message%s", inode_fixed,
 		 inode_fixed > 1 ? "s" : "");
@@ -1463,6 +1856,15 @@ int     main(int argc, char **argv)
 	argv_free(hold_names);
     if (release_names)
 	argv_free(release_names);
+    if (msg_select) {
+	if (msg_select->sender)
+	    myfree(msg_select->sender);
+	if (msg_select->recipient)
+	    myfree(msg_select->recipient);
+	if (msg_select->header)
+	    myfree(msg_select->header);
+	myfree((void *) msg_select);
+    }
 
     exit(0);
 }
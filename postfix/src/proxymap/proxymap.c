@@ -85,6 +85,11 @@
 /*	There is no \fBclose\fR command, nor are tables implicitly closed
 /*	when a client disconnects. The purpose is to share tables among
 /*	multiple client processes.
+/*
+/*	A client may send multiple requests before it reads the
+/*	replies. The server processes requests in the order of
+/*	arrival, and flushes the replies when no more requests are
+/*	pending. This feature is available in Postfix 3.4 and later.
 /* SERVER PROCESS MANAGEMENT
 /* .ad
 /* .fi
@@ -612,18 +617,33 @@ static void proxymap_service(VSTREAM *client_stream, char *unused_service,
 			CA_VSTREAM_CTL_TIMEOUT(1),
 			CA_VSTREAM_CTL_END);
 
+    /*
+     * Pipelining support. The multi-server skeleton opens a single-buffered
+     * stream, which discards unread input when we write a reply. Use
+     * separate read and write buffers, so that requests that arrive with
+     * the first one survive.
+     */
+    if (vstream_fstat(client_stream, VSTREAM_FLAG_DOUBLE) == 0)
+	vstream_control(client_stream,
+			CA_VSTREAM_CTL_DOUBLE,
+			CA_VSTREAM_CTL_END);
+
     /*
      * This routine runs whenever a client connects to the socket dedicated
      * to the proxymap service. All connection-management stuff is handled by
      * the common code in multi_server.c.
+     * 
+     * A client may pipeline requests. Serve all requests that are already
+     * buffered before returning to the event loop: their arrival will not
+     * trigger another read event, and their replies can be flushed together.
      */
     vstream_control(client_stream,
 		    CA_VSTREAM_CTL_START_DEADLINE,
 		    CA_VSTREAM_CTL_END);
-    if (attr_scan(client_stream,
-		  ATTR_FLAG_MORE | ATTR_FLAG_STRICT,
-		  RECV_ATTR_STR(MAIL_ATTR_REQ, request),
-		  ATTR_TYPE_END) == 1) {
+    while (attr_scan(client_stream,
+		     ATTR_FLAG_MORE | ATTR_FLAG_STRICT,
+		     RECV_ATTR_STR(MAIL_ATTR_REQ, request),
+		     ATTR_TYPE_END) == 1) {
 	if (VSTREQ(request, PROXY_REQ_LOOKUP)) {
 	    proxymap_lookup_service(client_stream);
 	} else if (VSTREQ(request, PROXY_REQ_UPDATE)) {
@@ -640,6 +660,11 @@ static void proxymap_service(VSTREAM *client_stream, char *unused_service,
 		       SEND_ATTR_INT(MAIL_ATTR_STATUS, PROXY_STAT_BAD),
 		       ATTR_TYPE_END);
 	}
+	if (vstream_peek(client_stream) <= 0)
+	    break;
+	vstream_control(client_stream,
+			CA_VSTREAM_CTL_START_DEADLINE,
+			CA_VSTREAM_CTL_END);
     }
     vstream_control(client_stream,
 		    CA_VSTREAM_CTL_START_DEADLINE,
@@ -676,10 +676,20 @@ static void pre_accept(char *unused_name, char **unused_argv)
 
     if ((table = dict_changed_name()) != 0) {
 	msg_info("table %s has changed -- restarting", table);
+	qmgr_pool_log_stats();
+	qmgr_message_log_stats();
 	exit(0);
     }
 }
 
+/* qmgr_exit - report statistics before exiting */
+
+static void qmgr_exit(char *unused_name, char **unused_argv)
+{
+    qmgr_pool_log_stats();
+    qmgr_message_log_stats();
+}
+
 /* qmgr_pre_init - pre-jail initialization */
 
 static void qmgr_pre_init(char *unused_name, char **unused_argv)
@@ -733,6 +743,7 @@ static void qmgr_post_init(char *name, char **unused_argv)
     var_ipc_timeout = var_qmgr_ipc_timeout;
     var_use_limit = 0;
     var_idle_limit = 0;
+    qmgr_pool_init();
     qmgr_move(MAIL_QUEUE_ACTIVE, MAIL_QUEUE_INCOMING, event_time());
     qmgr_scans[QMGR_SCAN_IDX_INCOMING] = qmgr_scan_create(MAIL_QUEUE_INCOMING);
     qmgr_scans[QMGR_SCAN_IDX_DEFERRED] = qmgr_scan_create(MAIL_QUEUE_DEFERRED);
@@ -814,6 +825,7 @@ int     main(int argc, char **argv)
 			CA_MAIL_SERVER_POST_INIT(qmgr_post_init),
 			CA_MAIL_SERVER_LOOP(qmgr_loop),
 			CA_MAIL_SERVER_PRE_ACCEPT(pre_accept),
+			CA_MAIL_SERVER_EXIT(qmgr_exit),
 			CA_MAIL_SERVER_SOLITARY,
 			CA_MAIL_SERVER_WATCHDOG(&var_qmgr_daemon_timeout),
 			0);
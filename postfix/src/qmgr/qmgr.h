@@ -19,6 +19,7 @@
   */
 #include <vstream.h>
 #include <scan_dir.h>
+#include <mem_arena.h>
 
  /*
   * Global library.
@@ -329,6 +330,7 @@ struct QMGR_MESSAGE {
     VSTREAM *fp;			/* open queue file or null */
     int     refcount;			/* queue entries */
     int     single_rcpt;		/* send one rcpt at a time */
+    MEM_ARENA *arena;			/* attribute string storage */
     struct timeval arrival_time;	/* start of receive transaction */
     time_t  create_time;		/* queue file create time */
     struct timeval active_time;		/* time of entry into active queue */
@@ -387,6 +389,7 @@ extern void qmgr_message_update_warn(QMGR_MESSAGE *);
 extern void qmgr_message_kill_record(QMGR_MESSAGE *, long);
 extern QMGR_MESSAGE *qmgr_message_alloc(const char *, const char *, int, mode_t);
 extern QMGR_MESSAGE *qmgr_message_realloc(QMGR_MESSAGE *);
+extern void qmgr_message_log_stats(void);
 
 #define QMGR_MSG_STATS(stats, message) \
     MSG_STATS_INIT2(stats, \
@@ -523,6 +526,29 @@ extern QMGR_TRANSPORT *qmgr_error_transport(const char *);
 extern QMGR_QUEUE *qmgr_error_queue(const char *, DSN *);
 extern char *qmgr_error_nexthop(DSN *);
 
+ /*
+  * qmgr_pool.c
+  */
+typedef struct QMGR_POOL {
+    const char *name;			/* for diagnostics */
+    ssize_t size;			/* object size */
+    int     limit;			/* max free objects */
+    int     free_count;			/* free objects */
+    void   *free_list;			/* free objects */
+    long    hits;			/* allocation from free list */
+    long    misses;			/* allocation from mymalloc() */
+} QMGR_POOL;
+
+extern QMGR_POOL qmgr_message_pool;
+extern QMGR_POOL qmgr_job_pool;
+extern QMGR_POOL qmgr_peer_pool;
+extern QMGR_POOL qmgr_entry_pool;
+
+extern void qmgr_pool_init(void);
+extern void *qmgr_pool_alloc(QMGR_POOL *);
+extern void qmgr_pool_free(QMGR_POOL *, void *);
+extern void qmgr_pool_log_stats(void);
+
 /* LICENSE
 /* .ad
 /* .fi
@@ -280,7 +280,7 @@ void    qmgr_entry_done(QMGR_ENTRY *entry, int which)
     message->rcpt_count -= entry->rcpt_list.len;
     qmgr_recipient_count -= entry->rcpt_list.len;
     recipient_list_free(&entry->rcpt_list);
-    myfree((void *) entry);
+    qmgr_pool_free(&qmgr_entry_pool, (void *) entry);
 
     /*
      * Make sure that the transport of any retired or finishing job that
@@ -371,7 +371,7 @@ QMGR_ENTRY *qmgr_entry_create(QMGR_PEER *peer, QMGR_MESSAGE *message)
     /*
      * Create the delivery request.
      */
-    entry = (QMGR_ENTRY *) mymalloc(sizeof(QMGR_ENTRY));
+    entry = (QMGR_ENTRY *) qmgr_pool_alloc(&qmgr_entry_pool);
     entry->stream = 0;
     entry->message = message;
     recipient_list_init(&entry->rcpt_list, RCPT_LIST_INIT_QUEUE);
@@ -101,7 +101,7 @@ static QMGR_JOB *qmgr_job_create(QMGR_MESSAGE *message, QMGR_TRANSPORT *transpor
 {
     QMGR_JOB *job;
 
-    job = (QMGR_JOB *) mymalloc(sizeof(QMGR_JOB));
+    job = (QMGR_JOB *) qmgr_pool_alloc(&qmgr_job_pool);
     job->message = message;
     QMGR_LIST_APPEND(message->job_list, job, message_peers);
     htable_enter(transport->job_byname, message->queue_id, (void *) job);
@@ -446,7 +446,7 @@ void    qmgr_job_free(QMGR_JOB *job)
     QMGR_LIST_UNLINK(message->job_list, QMGR_JOB *, job, message_peers);
     htable_delete(transport->job_byname, message->queue_id, (void (*) (void *)) 0);
     htable_free(job->peer_byname, (void (*) (void *)) 0);
-    myfree((void *) job);
+    qmgr_pool_free(&qmgr_job_pool, (void *) job);
 }
 
 /* qmgr_job_count_slots - maintain the delivery slot counters */
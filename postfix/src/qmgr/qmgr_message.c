@@ -28,6 +28,8 @@
 /*	void	qmgr_message_kill_record(message, offset)
 /*	QMGR_MESSAGE *message;
 /*	long	offset;
+/*
+/*	void	qmgr_message_log_stats()
 /* DESCRIPTION
 /*	This module performs en-gross operations on queue messages.
 /*
@@ -79,6 +81,12 @@
 /*	the record type at the given offset to "killed", and closes the file.
 /*	A killed envelope record is ignored. Killed records are not allowed
 /*	inside the message content.
+/*
+/*	qmgr_message_log_stats() logs how much string storage was
+/*	used by the in-core message structures that were destroyed
+/*	so far. The sender, queue ID, client and other message
+/*	attribute strings are allocated from a per-message memory
+/*	arena that is released as a whole by qmgr_message_free().
 /* DIAGNOSTICS
 /*	Warnings: malformed message file. Fatal errors: out of memory.
 /* SEE ALSO
@@ -128,6 +136,7 @@
 #include <stringops.h>
 #include <myflock.h>
 #include <sane_time.h>
+#include <mem_arena.h>
 
 /* Global library. */
 
@@ -160,6 +169,30 @@ int     qmgr_message_count;
 int     qmgr_recipient_count;
 int     qmgr_vrfy_pend_count;
 
+ /*
+  * Message attribute strings live in a per-message arena. Most messages need
+  * only a few hundred bytes, so a small chunk size avoids waste when many
+  * messages are in the active queue. A string that is replaced (Milter
+  * overrides, recipient batch re-reads) is copied only when its value
+  * changes, so that the arena does not grow with each re-read.
+  */
+#define QMGR_MESSAGE_ARENA_SIZE	512
+
+#define QMGR_MESSAGE_SAVE(m, s)	mem_arena_strdup((m)->arena, (s))
+
+#define QMGR_MESSAGE_UPDATE(m, member, s) do { \
+	if ((m)->member == 0 || strcmp((m)->member, (s)) != 0) \
+	    (m)->member = QMGR_MESSAGE_SAVE((m), (s)); \
+    } while (0)
+
+static struct {
+    long    messages;			/* arenas released */
+    long    objects;			/* strings allocated */
+    long    bytes;			/* bytes allocated */
+    long    chunks;			/* chunks allocated */
+    ssize_t peak;			/* largest arena */
+} qmgr_message_arena_stats;
+
 /* qmgr_message_create - create in-core message structure */
 
 static QMGR_MESSAGE *qmgr_message_create(const char *queue_name,
@@ -167,8 +200,9 @@ static QMGR_MESSAGE *qmgr_message_create(const char *queue_name,
 {
     QMGR_MESSAGE *message;
 
-    message = (QMGR_MESSAGE *) mymalloc(sizeof(QMGR_MESSAGE));
+    message = (QMGR_MESSAGE *) qmgr_pool_alloc(&qmgr_message_pool);
     qmgr_message_count++;
+    message->arena = mem_arena_create("message", QMGR_MESSAGE_ARENA_SIZE);
     message->flags = 0;
     message->qflags = qflags;
     message->tflags = 0;
@@ -183,8 +217,8 @@ static QMGR_MESSAGE *qmgr_message_create(const char *queue_name,
     message->queued_time = sane_time();
     message->refill_time = 0;
     message->data_offset = 0;
-    message->queue_id = mystrdup(queue_id);
-    message->queue_name = mystrdup(queue_name);
+    message->queue_id = QMGR_MESSAGE_SAVE(message, queue_id);
+    message->queue_name = QMGR_MESSAGE_SAVE(message, queue_name);
     message->encoding = 0;
     message->sender = 0;
     message->dsn_envid = 0;
@@ -619,26 +653,20 @@ static int qmgr_message_read(QMGR_MESSAGE *message)
 	    continue;
 	}
 	if (rec_type == REC_TYPE_FILT) {
-	    if (message->filter_xport != 0)
-		myfree(message->filter_xport);
-	    message->filter_xport = mystrdup(start);
+	    QMGR_MESSAGE_UPDATE(message, filter_xport, start);
 	    continue;
 	}
 	if (rec_type == REC_TYPE_INSP) {
-	    if (message->inspect_xport != 0)
-		myfree(message->inspect_xport);
-	    message->inspect_xport = mystrdup(start);
+	    QMGR_MESSAGE_UPDATE(message, inspect_xport, start);
 	    continue;
 	}
 	if (rec_type == REC_TYPE_RDR) {
-	    if (message->redirect_addr != 0)
-		myfree(message->redirect_addr);
-	    message->redirect_addr = mystrdup(start);
+	    QMGR_MESSAGE_UPDATE(message, redirect_addr, start);
 	    continue;
 	}
 	if (rec_type == REC_TYPE_FROM) {
 	    if (message->sender == 0) {
-		message->sender = mystrdup(start);
+		message->sender = QMGR_MESSAGE_SAVE(message, start);
 		opened(message->queue_id, message->sender,
 		       message->cont_length, message->rcpt_unread,
 		       "queue %s", message->queue_name);
@@ -647,9 +675,7 @@ static int qmgr_message_read(QMGR_MESSAGE *message)
 	}
 	if (rec_type == REC_TYPE_DSN_ENVID) {
 	    /* Allow Milter override. */
-	    if (message->dsn_envid != 0)
-		myfree(message->dsn_envid);
-	    message->dsn_envid = mystrdup(start);
+	    QMGR_MESSAGE_UPDATE(message, dsn_envid, start);
 	}
 	if (rec_type == REC_TYPE_DSN_RET) {
 	    /* Allow Milter override. */
@@ -662,9 +688,7 @@ static int qmgr_message_read(QMGR_MESSAGE *message)
 	if (rec_type == REC_TYPE_ATTR) {
 	    /* Allow extra segment to override envelope segment info. */
 	    if (strcmp(name, MAIL_ATTR_ENCODING) == 0) {
-		if (message->encoding != 0)
-		    myfree(message->encoding);
-		message->encoding = mystrdup(value);
+		QMGR_MESSAGE_UPDATE(message, encoding, value);
 	    }
 
 	    /*
@@ -683,73 +707,63 @@ static int qmgr_message_read(QMGR_MESSAGE *message)
 	     */
 	    else if (strcmp(name, MAIL_ATTR_ACT_CLIENT_NAME) == 0) {
 		if (have_log_client_attr == 0 && message->client_name == 0)
-		    message->client_name = mystrdup(value);
+		    message->client_name = QMGR_MESSAGE_SAVE(message, value);
 	    } else if (strcmp(name, MAIL_ATTR_ACT_CLIENT_ADDR) == 0) {
 		if (have_log_client_attr == 0 && message->client_addr == 0)
-		    message->client_addr = mystrdup(value);
+		    message->client_addr = QMGR_MESSAGE_SAVE(message, value);
 	    } else if (strcmp(name, MAIL_ATTR_ACT_CLIENT_PORT) == 0) {
 		if (have_log_client_attr == 0 && message->client_port == 0)
-		    message->client_port = mystrdup(value);
+		    message->client_port = QMGR_MESSAGE_SAVE(message, value);
 	    } else if (strcmp(name, MAIL_ATTR_ACT_PROTO_NAME) == 0) {
 		if (have_log_client_attr == 0 && message->client_proto == 0)
-		    message->client_proto = mystrdup(value);
+		    message->client_proto = QMGR_MESSAGE_SAVE(message, value);
 	    } else if (strcmp(name, MAIL_ATTR_ACT_HELO_NAME) == 0) {
 		if (have_log_client_attr == 0 && message->client_helo == 0)
-		    message->client_helo = mystrdup(value);
+		    message->client_helo = QMGR_MESSAGE_SAVE(message, value);
 	    }
 	    /* Original client attributes. */
 	    else if (strcmp(name, MAIL_ATTR_LOG_CLIENT_NAME) == 0) {
-		if (message->client_name != 0)
-		    myfree(message->client_name);
-		message->client_name = mystrdup(value);
+		QMGR_MESSAGE_UPDATE(message, client_name, value);
 		have_log_client_attr = 1;
 	    } else if (strcmp(name, MAIL_ATTR_LOG_CLIENT_ADDR) == 0) {
-		if (message->client_addr != 0)
-		    myfree(message->client_addr);
-		message->client_addr = mystrdup(value);
+		QMGR_MESSAGE_UPDATE(message, client_addr, value);
 		have_log_client_attr = 1;
 	    } else if (strcmp(name, MAIL_ATTR_LOG_CLIENT_PORT) == 0) {
-		if (message->client_port != 0)
-		    myfree(message->client_port);
-		message->client_port = mystrdup(value);
+		QMGR_MESSAGE_UPDATE(message, client_port, value);
 		have_log_client_attr = 1;
 	    } else if (strcmp(name, MAIL_ATTR_LOG_PROTO_NAME) == 0) {
-		if (message->client_proto != 0)
-		    myfree(message->client_proto);
-		message->client_proto = mystrdup(value);
+		QMGR_MESSAGE_UPDATE(message, client_proto, value);
 		have_log_client_attr = 1;
 	    } else if (strcmp(name, MAIL_ATTR_LOG_HELO_NAME) == 0) {
-		if (message->client_helo != 0)
-		    myfree(message->client_helo);
-		message->client_helo = mystrdup(value);
+		QMGR_MESSAGE_UPDATE(message, client_helo, value);
 		have_log_client_attr = 1;
 	    } else if (strcmp(name, MAIL_ATTR_SASL_METHOD) == 0) {
 		if (message->sasl_method == 0)
-		    message->sasl_method = mystrdup(value);
+		    message->sasl_method = QMGR_MESSAGE_SAVE(message, value);
 		else
 		    msg_warn("%s: ignoring multiple %s attribute: %s",
 			   message->queue_id, MAIL_ATTR_SASL_METHOD, value);
 	    } else if (strcmp(name, MAIL_ATTR_SASL_USERNAME) == 0) {
 		if (message->sasl_username == 0)
-		    message->sasl_username = mystrdup(value);
+		    message->sasl_username = QMGR_MESSAGE_SAVE(message, value);
 		else
 		    msg_warn("%s: ignoring multiple %s attribute: %s",
 			 message->queue_id, MAIL_ATTR_SASL_USERNAME, value);
 	    } else if (strcmp(name, MAIL_ATTR_SASL_SENDER) == 0) {
 		if (message->sasl_sender == 0)
-		    message->sasl_sender = mystrdup(value);
+		    message->sasl_sender = QMGR_MESSAGE_SAVE(message, value);
 		else
 		    msg_warn("%s: ignoring multiple %s attribute: %s",
 			   message->queue_id, MAIL_ATTR_SASL_SENDER, value);
 	    } else if (strcmp(name, MAIL_ATTR_LOG_IDENT) == 0) {
 		if (message->log_ident == 0)
-		    message->log_ident = mystrdup(value);
+		    message->log_ident = QMGR_MESSAGE_SAVE(message, value);
 		else
 		    msg_warn("%s: ignoring multiple %s attribute: %s",
 			     message->queue_id, MAIL_ATTR_LOG_IDENT, value);
 	    } else if (strcmp(name, MAIL_ATTR_RWR_CONTEXT) == 0) {
 		if (message->rewrite_context == 0)
-		    message->rewrite_context = mystrdup(value);
+		    message->rewrite_context = QMGR_MESSAGE_SAVE(message, value);
 		else
 		    msg_warn("%s: ignoring multiple %s attribute: %s",
 			   message->queue_id, MAIL_ATTR_RWR_CONTEXT, value);
@@ -793,7 +807,7 @@ static int qmgr_message_read(QMGR_MESSAGE *message)
 			msg_info("%s: enabling VERP for sender \"%.100s\"",
 				 message->queue_id, message->sender);
 		    message->single_rcpt = 1;
-		    message->verp_delims = mystrdup(start);
+		    message->verp_delims = QMGR_MESSAGE_SAVE(message, start);
 		}
 	    }
 	    continue;
@@ -839,29 +853,30 @@ static int qmgr_message_read(QMGR_MESSAGE *message)
      * null pointer.
      */
     if (message->dsn_envid == 0)
-	message->dsn_envid = mystrdup("");
+	message->dsn_envid = QMGR_MESSAGE_SAVE(message, "");
     if (message->encoding == 0)
-	message->encoding = mystrdup(MAIL_ATTR_ENC_NONE);
+	message->encoding = QMGR_MESSAGE_SAVE(message, MAIL_ATTR_ENC_NONE);
     if (message->client_name == 0)
-	message->client_name = mystrdup("");
+	message->client_name = QMGR_MESSAGE_SAVE(message, "");
     if (message->client_addr == 0)
-	message->client_addr = mystrdup("");
+	message->client_addr = QMGR_MESSAGE_SAVE(message, "");
     if (message->client_port == 0)
-	message->client_port = mystrdup("");
+	message->client_port = QMGR_MESSAGE_SAVE(message, "");
     if (message->client_proto == 0)
-	message->client_proto = mystrdup("");
+	message->client_proto = QMGR_MESSAGE_SAVE(message, "");
     if (message->client_helo == 0)
-	message->client_helo = mystrdup("");
+	message->client_helo = QMGR_MESSAGE_SAVE(message, "");
     if (message->sasl_method == 0)
-	message->sasl_method = mystrdup("");
+	message->sasl_method = QMGR_MESSAGE_SAVE(message, "");
     if (message->sasl_username == 0)
-	message->sasl_username = mystrdup("");
+	message->sasl_username = QMGR_MESSAGE_SAVE(message, "");
     if (message->sasl_sender == 0)
-	message->sasl_sender = mystrdup("");
+	message->sasl_sender = QMGR_MESSAGE_SAVE(message, "");
     if (message->log_ident == 0)
-	message->log_ident = mystrdup("");
+	message->log_ident = QMGR_MESSAGE_SAVE(message, "");
     if (message->rewrite_context == 0)
-	message->rewrite_context = mystrdup(MAIL_ATTR_RWR_LOCAL);
+	message->rewrite_context =
+	    QMGR_MESSAGE_SAVE(message, MAIL_ATTR_RWR_LOCAL);
     /* Postfix < 2.3 compatibility. */
     if (message->create_time == 0)
 	message->create_time = message->arrival_time.tv_sec;
@@ -935,14 +950,23 @@ void    qmgr_message_kill_record(QMGR_MESSAGE *message, long offset)
 
 /* qmgr_message_sort_compare - compare recipient information */
 
+ /*
+  * With large recipient lists, the sort comparison function runs millions of
+  * times. We compute the sort key of each recipient only once, and sort an
+  * array of compact keys instead of the recipient structures themselves.
+  */
+typedef struct QMGR_SORT_KEY {
+    const char *transport;		/* transport name or null */
+    const char *queue;			/* queue name or null */
+    const char *domain;			/* casefolded domain or null */
+    const char *address;		/* recipient address */
+    int     index;			/* original list position */
+} QMGR_SORT_KEY;
+
 static int qmgr_message_sort_compare(const void *p1, const void *p2)
 {
-    RECIPIENT *rcpt1 = (RECIPIENT *) p1;
-    RECIPIENT *rcpt2 = (RECIPIENT *) p2;
-    QMGR_QUEUE *queue1;
-    QMGR_QUEUE *queue2;
-    char   *at1;
-    char   *at2;
+    QMGR_SORT_KEY *key1 = (QMGR_SORT_KEY *) p1;
+    QMGR_SORT_KEY *key2 = (QMGR_SORT_KEY *) p2;
     int     result;
 
     /*
@@ -950,60 +974,110 @@ static int qmgr_message_sort_compare(const void *p1, const void *p2)
      * The comparison function must be transitive, so NULL values need to be
      * assigned an ordinal (we set NULL last).
      */
-
-    queue1 = rcpt1->u.queue;
-    queue2 = rcpt2->u.queue;
-    if (queue1 != 0 && queue2 == 0)
+    if (key1->transport != 0 && key2->transport == 0)
 	return (-1);
-    if (queue1 == 0 && queue2 != 0)
+    if (key1->transport == 0 && key2->transport != 0)
 	return (1);
-    if (queue1 != 0 && queue2 != 0) {
+    if (key1->transport != 0 && key2->transport != 0) {
 
 	/*
 	 * Compare message transport.
 	 */
-	if ((result = strcmp(queue1->transport->name,
-			     queue2->transport->name)) != 0)
+	if ((result = strcmp(key1->transport, key2->transport)) != 0)
 	    return (result);
 
 	/*
 	 * Compare queue name (nexthop or recipient@nexthop).
 	 */
-	if ((result = strcmp(queue1->name, queue2->name)) != 0)
+	if ((result = strcmp(key1->queue, key2->queue)) != 0)
 	    return (result);
     }
 
     /*
-     * Compare recipient domain.
+     * Compare recipient domain. The domain was casefolded when the sort key
+     * was computed, so this is equivalent to strcasecmp_utf8().
      */
-    at1 = strrchr(rcpt1->address, '@');
-    at2 = strrchr(rcpt2->address, '@');
-    if (at1 == 0 && at2 != 0)
+    if (key1->domain == 0 && key2->domain != 0)
 	return (1);
-    if (at1 != 0 && at2 == 0)
+    if (key1->domain != 0 && key2->domain == 0)
 	return (-1);
-    if (at1 != 0 && at2 != 0
-	&& (result = strcasecmp_utf8(at1, at2)) != 0)
+    if (key1->domain != 0 && key2->domain != 0
+	&& (result = strcmp(key1->domain, key2->domain)) != 0)
 	return (result);
 
     /*
      * Compare recipient address.
      */
-    return (strcmp(rcpt1->address, rcpt2->address));
+    return (strcmp(key1->address, key2->address));
 }
 
 /* qmgr_message_sort - sort message recipient addresses by domain */
 
 static void qmgr_message_sort(QMGR_MESSAGE *message)
 {
-    qsort((void *) message->rcpt_list.info, message->rcpt_list.len,
-	  sizeof(message->rcpt_list.info[0]), qmgr_message_sort_compare);
-    if (msg_verbose) {
-	RECIPIENT_LIST list = message->rcpt_list;
-	RECIPIENT *rcpt;
+    static MEM_ARENA *arena;
+    static VSTRING *folded;
+    RECIPIENT_LIST *list = &message->rcpt_list;
+    QMGR_SORT_KEY *keys;
+    QMGR_SORT_KEY *key;
+    RECIPIENT *info;
+    RECIPIENT *rcpt;
+    QMGR_QUEUE *queue;
+    const char *at;
+    int     n;
+
+    if (list->len < 2)
+	goto done;
+    if (arena == 0) {
+	arena = mem_arena_create("qmgr_message_sort", 0);
+	folded = vstring_alloc(100);
+    }
 
+    /*
+     * Compute the sort keys. Recipients in the same domain usually come
+     * together, so we share the casefolded domain with the preceding key.
+     */
+    keys = (QMGR_SORT_KEY *) mymalloc(list->len * sizeof(*keys));
+    for (n = 0; n < list->len; n++) {
+	rcpt = list->info + n;
+	key = keys + n;
+	if ((queue = rcpt->u.queue) != 0) {
+	    key->transport = queue->transport->name;
+	    key->queue = queue->name;
+	} else {
+	    key->transport = key->queue = 0;
+	}
+	if ((at = strrchr(rcpt->address, '@')) == 0) {
+	    key->domain = 0;
+	} else {
+	    casefold(folded, at);
+	    if (n > 0 && key[-1].domain != 0
+		&& strcmp(key[-1].domain, vstring_str(folded)) == 0)
+		key->domain = key[-1].domain;
+	    else
+		key->domain = mem_arena_strndup(arena, vstring_str(folded),
+						VSTRING_LEN(folded));
+	}
+	key->address = rcpt->address;
+	key->index = n;
+    }
+    qsort((void *) keys, list->len, sizeof(*keys), qmgr_message_sort_compare);
+
+    /*
+     * Rearrange the recipient structures in sorted order.
+     */
+    info = (RECIPIENT *) mymalloc(list->avail * sizeof(*info));
+    for (n = 0; n < list->len; n++)
+	info[n] = list->info[keys[n].index];
+    myfree((void *) list->info);
+    list->info = info;
+    myfree((void *) keys);
+    mem_arena_reset(arena);
+
+done:
+    if (msg_verbose) {
 	msg_info("start sorted recipient list");
-	for (rcpt = list.info; rcpt < list.info + list.len; rcpt++)
+	for (rcpt = list->info; rcpt < list->info + list->len; rcpt++)
 	    msg_info("qmgr_message_sort: %s", rcpt->address);
 	msg_info("end sorted recipient list");
     }
@@ -1366,12 +1440,11 @@ static void qmgr_message_assign(QMGR_MESSAGE *message)
 	    entry = qmgr_entry_create(peer, message);
 
 	/*
-	 * Add the recipient to the current entry and increase all those
-	 * recipient counters accordingly.
+	 * Move the recipient to the current entry, without copying its
+	 * address information, and increase all those recipient counters
+	 * accordingly.
 	 */
-	recipient_list_add(&entry->rcpt_list, recipient->offset,
-			   recipient->dsn_orcpt, recipient->dsn_notify,
-			   recipient->orig_addr, recipient->address);
+	recipient_list_move(&entry->rcpt_list, recipient);
 	job->rcpt_count++;
 	message->rcpt_count++;
 	qmgr_recipient_count++;
@@ -1420,47 +1493,32 @@ void    qmgr_message_free(QMGR_MESSAGE *message)
 	msg_panic("qmgr_message_free: queue file is open");
     while ((job = message->job_list.next) != 0)
 	qmgr_job_free(job);
-    myfree(message->queue_id);
-    myfree(message->queue_name);
-    if (message->dsn_envid)
-	myfree(message->dsn_envid);
-    if (message->encoding)
-	myfree(message->encoding);
-    if (message->sender)
-	myfree(message->sender);
-    if (message->verp_delims)
-	myfree(message->verp_delims);
-    if (message->filter_xport)
-	myfree(message->filter_xport);
-    if (message->inspect_xport)
-	myfree(message->inspect_xport);
-    if (message->redirect_addr)
-	myfree(message->redirect_addr);
-    if (message->client_name)
-	myfree(message->client_name);
-    if (message->client_addr)
-	myfree(message->client_addr);
-    if (message->client_port)
-	myfree(message->client_port);
-    if (message->client_proto)
-	myfree(message->client_proto);
-    if (message->client_helo)
-	myfree(message->client_helo);
-    if (message->sasl_method)
-	myfree(message->sasl_method);
-    if (message->sasl_username)
-	myfree(message->sasl_username);
-    if (message->sasl_sender)
-	myfree(message->sasl_sender);
-    if (message->log_ident)
-	myfree(message->log_ident);
-    if (message->rewrite_context)
-	myfree(message->rewrite_context);
     recipient_list_free(&message->rcpt_list);
+    qmgr_message_arena_stats.messages += 1;
+    qmgr_message_arena_stats.objects += message->arena->alloc_count;
+    qmgr_message_arena_stats.bytes += message->arena->alloc_bytes;
+    qmgr_message_arena_stats.chunks += message->arena->chunk_count;
+    if (qmgr_message_arena_stats.peak < message->arena->peak_bytes)
+	qmgr_message_arena_stats.peak = message->arena->peak_bytes;
+    mem_arena_free(message->arena);
     qmgr_message_count--;
     if ((message->tflags & DEL_REQ_FLAG_MTA_VRFY) != 0)
 	qmgr_vrfy_pend_count--;
-    myfree((void *) message);
+    qmgr_pool_free(&qmgr_message_pool, (void *) message);
+}
+
+/* qmgr_message_log_stats - report per-message arena usage */
+
+void    qmgr_message_log_stats(void)
+{
+    if (qmgr_message_arena_stats.messages > 0)
+	msg_info("statistics: message arena messages=%ld objects=%ld"
+		 " bytes=%ld chunks=%ld peak=%ld",
+		 qmgr_message_arena_stats.messages,
+		 qmgr_message_arena_stats.objects,
+		 qmgr_message_arena_stats.bytes,
+		 qmgr_message_arena_stats.chunks,
+		 (long) qmgr_message_arena_stats.peak);
 }
 
 /* qmgr_message_alloc - create in-core message structure */
@@ -79,7 +79,7 @@ QMGR_PEER *qmgr_peer_create(QMGR_JOB *job, QMGR_QUEUE *queue)
 {
     QMGR_PEER *peer;
 
-    peer = (QMGR_PEER *) mymalloc(sizeof(QMGR_PEER));
+    peer = (QMGR_PEER *) qmgr_pool_alloc(&qmgr_peer_pool);
     peer->queue = queue;
     peer->job = job;
     QMGR_LIST_APPEND(job->peer_list, peer, peers);
@@ -107,7 +107,7 @@ void    qmgr_peer_free(QMGR_PEER *peer)
 
     QMGR_LIST_UNLINK(job->peer_list, QMGR_PEER *, peer, peers);
     htable_delete(job->peer_byname, queue->name, (void (*) (void *)) 0);
-    myfree((void *) peer);
+    qmgr_pool_free(&qmgr_peer_pool, (void *) peer);
 }
 
 /* qmgr_peer_find - lookup peer associated with given job and queue */
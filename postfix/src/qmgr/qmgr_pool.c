@@ -0,0 +1,145 @@
+/*++
+/* NAME
+/*	qmgr_pool 3
+/* SUMMARY
+/*	free lists for in-core queue manager objects
+/* SYNOPSIS
+/*	#include "qmgr.h"
+/*
+/*	QMGR_POOL qmgr_message_pool;
+/*	QMGR_POOL qmgr_job_pool;
+/*	QMGR_POOL qmgr_peer_pool;
+/*	QMGR_POOL qmgr_entry_pool;
+/*
+/*	void	qmgr_pool_init()
+/*
+/*	void	*qmgr_pool_alloc(pool)
+/*	QMGR_POOL *pool;
+/*
+/*	void	qmgr_pool_free(pool, ptr)
+/*	QMGR_POOL *pool;
+/*	void	*ptr;
+/*
+/*	void	qmgr_pool_log_stats()
+/* DESCRIPTION
+/*	This module recycles the fixed-size message, job, peer and
+/*	entry structures that the queue manager creates and destroys
+/*	for every message and destination. With thousands of
+/*	deliveries per second, this avoids a noticeable amount of
+/*	malloc() and free() overhead.
+/*
+/*	qmgr_pool_init() sets the maximal number of free objects
+/*	that each pool will keep. The message and job pools are
+/*	sized after the qmgr_message_active_limit parameter; the
+/*	peer and entry pools are sized after the
+/*	qmgr_message_recipient_limit parameter. This function must
+/*	be called after the configuration parameters are read, and
+/*	before any objects are allocated.
+/*
+/*	qmgr_pool_alloc() returns an uninitialized object from the
+/*	free list, or a new object when the free list is empty.
+/*
+/*	qmgr_pool_free() puts an object on the free list, or gives
+/*	it back to myfree() when the free list is full.
+/*
+/*	qmgr_pool_log_stats() logs the number of allocation requests
+/*	that were satisfied from the free list, and the number of
+/*	requests that needed a new object.
+/* DIAGNOSTICS
+/*	Panic: interface violations. Fatal: out of memory.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+
+/* Global library. */
+
+#include <mail_params.h>
+
+/* Application-specific. */
+
+#include "qmgr.h"
+
+ /*
+  * A free object is reused to hold the free list link.
+  */
+typedef struct QMGR_POOL_FREE {
+    struct QMGR_POOL_FREE *next;
+} QMGR_POOL_FREE;
+
+#define QMGR_POOL_INIT(name, type) \
+	{ (name), sizeof(type), 0, 0, 0, 0, 0 }
+
+QMGR_POOL qmgr_message_pool = QMGR_POOL_INIT("message", QMGR_MESSAGE);
+QMGR_POOL qmgr_job_pool = QMGR_POOL_INIT("job", QMGR_JOB);
+QMGR_POOL qmgr_peer_pool = QMGR_POOL_INIT("peer", QMGR_PEER);
+QMGR_POOL qmgr_entry_pool = QMGR_POOL_INIT("entry", QMGR_ENTRY);
+
+/* qmgr_pool_init - size the free lists */
+
+void    qmgr_pool_init(void)
+{
+    qmgr_message_pool.limit = var_qmgr_active_limit;
+    qmgr_job_pool.limit = var_qmgr_active_limit;
+    qmgr_peer_pool.limit = var_qmgr_rcpt_limit;
+    qmgr_entry_pool.limit = var_qmgr_rcpt_limit;
+}
+
+/* qmgr_pool_alloc - take object from free list */
+
+void   *qmgr_pool_alloc(QMGR_POOL *pool)
+{
+    QMGR_POOL_FREE *obj;
+
+    if ((obj = (QMGR_POOL_FREE *) pool->free_list) != 0) {
+	pool->free_list = (void *) obj->next;
+	pool->free_count--;
+	pool->hits++;
+	return ((void *) obj);
+    }
+    pool->misses++;
+    return (mymalloc(pool->size));
+}
+
+/* qmgr_pool_free - put object on free list */
+
+void    qmgr_pool_free(QMGR_POOL *pool, void *ptr)
+{
+    QMGR_POOL_FREE *obj = (QMGR_POOL_FREE *) ptr;
+
+    if (ptr == 0)
+	msg_panic("qmgr_pool_free: %s: null pointer", pool->name);
+    if (pool->free_count >= pool->limit) {
+	myfree(ptr);
+    } else {
+	obj->next = (QMGR_POOL_FREE *) pool->free_list;
+	pool->free_list = (void *) obj;
+	pool->free_count++;
+    }
+}
+
+/* qmgr_pool_log_stats - report free list effectiveness */
+
+void    qmgr_pool_log_stats(void)
+{
+    QMGR_POOL *pools[] = {
+	&qmgr_message_pool, &qmgr_job_pool, &qmgr_peer_pool, &qmgr_entry_pool, 0,
+    };
+    QMGR_POOL **pp;
+
+    for (pp = pools; *pp; pp++)
+	if ((*pp)->hits + (*pp)->misses > 0)
+	    msg_info("statistics: %s pool hits=%ld misses=%ld free=%d",
+		     (*pp)->name, (*pp)->hits, (*pp)->misses,
+		     (*pp)->free_count);
+}
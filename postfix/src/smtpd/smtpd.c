@@ -263,6 +263,14 @@
 /* .IP "\fBsmtpd_milter_maps (empty)\fR"
 /*	Lookup tables with Milter settings per remote SMTP client IP
 /*	address.
+/* .PP
+/*	Available in Postfix version 3.4 and later:
+/* .IP "\fBmilter_parallel_events (no)\fR"
+/*	Report envelope events to all Milter applications before
+/*	waiting for their replies.
+/* .IP "\fBmilter_connection_reuse (no)\fR"
+/*	Keep negotiated Milter connections open after an SMTP session
+/*	ends, and reuse them for later sessions.
 /* GENERAL CONTENT INSPECTION CONTROLS
 /* .ad
 /* .fi
@@ -1396,6 +1404,8 @@ char   *var_milt_eoh_macros;
 char   *var_milt_eod_macros;
 char   *var_milt_unk_macros;
 char   *var_milt_macro_deflts;
+bool    var_milt_parallel;
+bool    var_milt_conn_reuse;
 bool    var_smtpd_client_port_log;
 char   *var_stress;
 
@@ -5387,6 +5397,8 @@ static void setup_milters(SMTPD_STATE *state)
 				       var_milt_eod_macros,
 				       var_milt_unk_macros,
 				       var_milt_macro_deflts);
+	milter_parallel_events(state->milters, var_milt_parallel);
+	milter_conn_reuse(state->milters, var_milt_conn_reuse);
     }
 
     /*
@@ -5505,6 +5517,13 @@ static void pre_accept(char *unused_name, char **unused_argv)
     }
 }
 
+/* pre_exit - log Milter connection statistics */
+
+static void pre_exit(char *unused_name, char **unused_argv)
+{
+    milter8_conn_stats();
+}
+
 /* pre_jail_init - pre-jail initialization */
 
 static void pre_jail_init(char *unused_name, char **unused_argv)
@@ -5856,6 +5875,8 @@ int     main(int argc, char **argv)
 	VAR_SMTPD_PEERNAME_LOOKUP, DEF_SMTPD_PEERNAME_LOOKUP, &var_smtpd_peername_lookup,
 	VAR_SMTPD_DELAY_OPEN, DEF_SMTPD_DELAY_OPEN, &var_smtpd_delay_open,
 	VAR_SMTPD_CLIENT_PORT_LOG, DEF_SMTPD_CLIENT_PORT_LOG, &var_smtpd_client_port_log,
+	VAR_MILT_PARALLEL, DEF_MILT_PARALLEL, &var_milt_parallel,
+	VAR_MILT_CONN_REUSE, DEF_MILT_CONN_REUSE, &var_milt_conn_reuse,
 	0,
     };
     static const CONFIG_NBOOL_TABLE nbool_table[] = {
@@ -5994,5 +6015,6 @@ int     main(int argc, char **argv)
 		       CA_MAIL_SERVER_PRE_INIT(pre_jail_init),
 		       CA_MAIL_SERVER_PRE_ACCEPT(pre_accept),
 		       CA_MAIL_SERVER_POST_INIT(post_jail_init),
+		       CA_MAIL_SERVER_EXIT(pre_exit),
 		       0);
 }
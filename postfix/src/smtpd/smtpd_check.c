@@ -2750,6 +2750,42 @@ static int check_access(SMTPD_STATE *state, const char *table, const char *name,
     CHK_ACCESS_RETURN(SMTPD_CHECK_DUNNO, MISSED);
 }
 
+/* check_maps_find_first - look up name, then parent domains or networks */
+
+static const char *check_maps_find_first(MAPS *maps, ARGV *names, int flags)
+{
+    const char *myname = "check_maps_find_first";
+    char  **cpp;
+    DICT   *dict;
+    const char *value;
+    int     index;
+
+    /*
+     * The first name is looked up with the caller's flags, the parent names
+     * only in tables with fixed keys. When all tables have fixed keys, both
+     * select the same tables, and we search all names at once. A table that
+     * supports multi-key lookups (such as a proxied table) then answers all
+     * names in one request instead of one request per name.
+     */
+    if (names->argc > 1 && flags != PARTIAL) {
+	for (cpp = maps->argv->argv; *cpp; cpp++) {
+	    if ((dict = dict_handle(*cpp)) == 0)
+		msg_panic("%s: dictionary not found: %s", myname, *cpp);
+	    if ((dict->flags & PARTIAL) == 0)
+		break;
+	}
+	if (*cpp != 0 || flags != FULL) {
+	    if ((value = maps_find(maps, names->argv[0], flags)) != 0
+		|| maps->error != 0)
+		return (value);
+	    return (maps_find_first(maps, (const char **) names->argv + 1,
+				    names->argc - 1, PARTIAL, &index));
+	}
+    }
+    return (maps_find_first(maps, (const char **) names->argv,
+			    names->argc, flags, &index));
+}
+
 /* check_domain_access - domainname-based table lookup */
 
 static int check_domain_access(SMTPD_STATE *state, const char *table,
@@ -2759,6 +2795,7 @@ static int check_domain_access(SMTPD_STATE *state, const char *table,
 			               const char *def_acl)
 {
     const char *myname = "check_domain_access";
+    static ARGV *names;
     const char *name;
     const char *next;
     const char *value;
@@ -2786,8 +2823,23 @@ static int check_domain_access(SMTPD_STATE *state, const char *table,
 					     domain, reply_name, reply_class,
 					     def_acl), FOUND);
     }
+    if (names == 0)
+	names = argv_alloc(2);
+    else
+	argv_truncate(names, 0);
     for (name = domain; *name != 0; name = next) {
-	if ((value = maps_find(maps, name, flags)) != 0)
+	argv_add(names, name, ARGV_END);
+	/* Don't apply subdomain magic to numerical hostnames. */
+	if (maybe_numerical
+	    && (maybe_numerical = valid_hostaddr(domain, DONT_GRIPE)) != 0)
+	    break;
+	if ((next = strchr(name + 1, '.')) == 0)
+	    break;
+	if (access_parent_style == MATCH_FLAG_PARENT)
+	    next += 1;
+    }
+    if (names->argc > 0) {
+	if ((value = check_maps_find_first(maps, names, flags)) != 0)
 	    CHK_DOMAIN_RETURN(check_table_result(state, table, value,
 					    domain, reply_name, reply_class,
 						 def_acl), FOUND);
@@ -2798,15 +2850,6 @@ static int check_domain_access(SMTPD_STATE *state, const char *table,
 					    domain, reply_name, reply_class,
 						 def_acl), FOUND);
 	}
-	/* Don't apply subdomain magic to numerical hostnames. */
-	if (maybe_numerical
-	    && (maybe_numerical = valid_hostaddr(domain, DONT_GRIPE)) != 0)
-	    break;
-	if ((next = strchr(name + 1, '.')) == 0)
-	    break;
-	if (access_parent_style == MATCH_FLAG_PARENT)
-	    next += 1;
-	flags = PARTIAL;
     }
     CHK_DOMAIN_RETURN(SMTPD_CHECK_DUNNO, MISSED);
 }
@@ -2820,6 +2863,7 @@ static int check_addr_access(SMTPD_STATE *state, const char *table,
 			             const char *def_acl)
 {
     const char *myname = "check_addr_access";
+    static ARGV *names;
     char   *addr;
     const char *value;
     MAPS   *maps;
@@ -2850,21 +2894,26 @@ static int check_addr_access(SMTPD_STATE *state, const char *table,
 					   reply_name, reply_class,
 					   def_acl), FOUND);
     }
+    if (names == 0)
+	names = argv_alloc(2);
+    else
+	argv_truncate(names, 0);
     do {
-	if ((value = maps_find(maps, addr, flags)) != 0)
-	    CHK_ADDR_RETURN(check_table_result(state, table, value, address,
-					       reply_name, reply_class,
-					       def_acl), FOUND);
-	if (maps->error != 0) {
-	    /* Warning is already logged. */
-	    value = "451 4.3.5 Server configuration error";
-	    CHK_ADDR_RETURN(check_table_result(state, table, value, address,
-					       reply_name, reply_class,
-					       def_acl), FOUND);
-	}
-	flags = PARTIAL;
+	argv_add(names, addr, ARGV_END);
     } while (split_at_right(addr, delim));
 
+    if ((value = check_maps_find_first(maps, names, flags)) != 0)
+	CHK_ADDR_RETURN(check_table_result(state, table, value, address,
+					   reply_name, reply_class,
+					   def_acl), FOUND);
+    if (maps->error != 0) {
+	/* Warning is already logged. */
+	value = "451 4.3.5 Server configuration error";
+	CHK_ADDR_RETURN(check_table_result(state, table, value, address,
+					   reply_name, reply_class,
+					   def_acl), FOUND);
+    }
+
     CHK_ADDR_RETURN(SMTPD_CHECK_DUNNO, MISSED);
 }
 
@@ -96,8 +96,8 @@
 /*
 /*	proxy->rec_put() is a rec_put() clone that either buffers
 /*	up arbitrary message content records until the entire message
-/*	is received, or that immediately sends it to the proxy
-/*	server.
+/*	is received, or that sends it to the proxy server in chunks
+/*	of SMTPD_PROXY_CONTENT_SIZE bytes.
 /*	All data is expected to be in SMTP dot-escaped form.
 /*	All errors are reported as a REC_TYPE_ERROR result value,
 /*	with the state->error_mask, state->err and proxy-buffer
@@ -105,8 +105,8 @@
 /*
 /*	proxy->rec_fprintf() is a rec_fprintf() clone that formats
 /*	message content and either buffers up the record until the
-/*	entire message is received, or that immediately sends it
-/*	to the proxy server.
+/*	entire message is received, or that sends it to the proxy
+/*	server as with proxy->rec_put().
 /*	All data is expected to be in SMTP dot-escaped form.
 /*	All errors are reported as a REC_TYPE_ERROR result value,
 /*	with the state->error_mask, state->err and proxy-buffer
@@ -227,6 +227,13 @@
   */
 static VSTREAM *smtpd_proxy_replay_stream;
 
+ /*
+  * Message content is sent to the before-queue filter in chunks, instead of
+  * one line at a time. This avoids the cost of setting up an exception
+  * handler (on many systems, a sigprocmask() system call) for each line.
+  */
+#define SMTPD_PROXY_CONTENT_SIZE	(4 * VSTREAM_BUFSIZE)
+
  /*
   * Forward declarations.
   */
@@ -234,6 +241,7 @@ static void smtpd_proxy_fake_server_reply(SMTPD_STATE *, int);
 static int smtpd_proxy_rdwr_error(SMTPD_STATE *, int);
 static int PRINTFLIKE(3, 4) smtpd_proxy_cmd(SMTPD_STATE *, int, const char *,...);
 static int smtpd_proxy_rec_put(VSTREAM *, int, const char *, ssize_t);
+static int smtpd_proxy_content_flush(SMTPD_STATE *);
 
  /*
   * SLMs.
@@ -698,6 +706,13 @@ static int smtpd_proxy_cmd(SMTPD_STATE *state, int expect, const char *fmt,...)
     int     err = 0;
     static VSTRING *buffer = 0;
 
+    /*
+     * Send unsent message content before the command.
+     */
+    if (proxy->content != 0 && LEN(proxy->content) > 0
+	&& smtpd_proxy_content_flush(state) < 0)
+	return (-1);
+
     /*
      * Errors first. Be prepared for delayed errors from the DATA phase.
      */
@@ -849,32 +864,63 @@ static int smtpd_proxy_save_rec_put(VSTREAM *stream, int rec_type,
     return (rec_type);
 }
 
+/* smtpd_proxy_content_flush - send unsent message content */
+
+static int smtpd_proxy_content_flush(SMTPD_STATE *state)
+{
+    SMTPD_PROXY *proxy = state->proxy;
+    int     err = 0;
+
+    /*
+     * Errors first.
+     */
+    if (vstream_ferror(proxy->service_stream)
+	|| vstream_feof(proxy->service_stream)
+	|| (err = vstream_setjmp(proxy->service_stream)) != 0)
+	return (smtpd_proxy_rdwr_error(state, err));
+
+    /*
+     * Send the content as is. It already has the SMTP line terminators.
+     */
+    smtp_fwrite(STR(proxy->content), LEN(proxy->content),
+		proxy->service_stream);
+    VSTRING_RESET(proxy->content);
+    return (0);
+}
+
 /* smtpd_proxy_rec_put - send message content, rec_put() clone */
 
 static int smtpd_proxy_rec_put(VSTREAM *stream, int rec_type,
 			               const char *data, ssize_t len)
 {
     const char *myname = "smtpd_proxy_rec_put";
-    int     err = 0;
+    SMTPD_STATE *state = VSTREAM_TO_SMTPD_STATE(stream);
+    SMTPD_PROXY *proxy = state->proxy;
 
     /*
      * Errors first.
      */
-    if (vstream_ferror(stream) || vstream_feof(stream)
-	|| (err = vstream_setjmp(stream)) != 0) {
-	(void) smtpd_proxy_rdwr_error(VSTREAM_TO_SMTPD_STATE(stream), err);
+    if (vstream_ferror(stream) || vstream_feof(stream)) {
+	(void) smtpd_proxy_rdwr_error(state, 0);
 	return (REC_TYPE_ERROR);
     }
 
     /*
-     * Send one content record. Errors and results must be as with rec_put().
+     * Save one content record, and send the content when we have enough.
+     * Errors and results must be as with rec_put().
      */
-    if (rec_type == REC_TYPE_NORM)
-	smtp_fputs(data, len, stream);
-    else if (rec_type == REC_TYPE_CONT)
-	smtp_fwrite(data, len, stream);
+    if (proxy->content == 0)
+	proxy->content = vstring_alloc(SMTPD_PROXY_CONTENT_SIZE);
+    if (rec_type == REC_TYPE_NORM) {
+	vstring_memcat(proxy->content, data, len);
+	vstring_memcat(proxy->content, "\r\n", 2);
+    } else if (rec_type == REC_TYPE_CONT)
+	vstring_memcat(proxy->content, data, len);
     else
 	msg_panic("%s: need REC_TYPE_NORM or REC_TYPE_CONT", myname);
+    if (LEN(proxy->content) >= SMTPD_PROXY_CONTENT_SIZE
+	&& smtpd_proxy_content_flush(state) < 0)
+	return (REC_TYPE_ERROR);
     return (rec_type);
 }
 
@@ -920,28 +966,34 @@ static int smtpd_proxy_rec_fprintf(VSTREAM *stream, int rec_type,
 				           const char *fmt,...)
 {
     const char *myname = "smtpd_proxy_rec_fprintf";
+    SMTPD_STATE *state = VSTREAM_TO_SMTPD_STATE(stream);
+    SMTPD_PROXY *proxy = state->proxy;
     va_list ap;
-    int     err = 0;
 
     /*
      * Errors first.
      */
-    if (vstream_ferror(stream) || vstream_feof(stream)
-	|| (err = vstream_setjmp(stream)) != 0) {
-	(void) smtpd_proxy_rdwr_error(VSTREAM_TO_SMTPD_STATE(stream), err);
+    if (vstream_ferror(stream) || vstream_feof(stream)) {
+	(void) smtpd_proxy_rdwr_error(state, 0);
 	return (REC_TYPE_ERROR);
     }
 
     /*
-     * Send one content record. Errors and results must be as with
-     * rec_fprintf().
+     * Save one content record, and send the content when we have enough.
+     * Errors and results must be as with rec_fprintf().
      */
+    if (proxy->content == 0)
+	proxy->content = vstring_alloc(SMTPD_PROXY_CONTENT_SIZE);
     va_start(ap, fmt);
     if (rec_type == REC_TYPE_NORM)
-	smtp_vprintf(stream, fmt, ap);
+	vstring_vsprintf_append(proxy->content, fmt, ap);
     else
 	msg_panic("%s: need REC_TYPE_NORM", myname);
     va_end(ap);
+    vstring_memcat(proxy->content, "\r\n", 2);
+    if (LEN(proxy->content) >= SMTPD_PROXY_CONTENT_SIZE
+	&& smtpd_proxy_content_flush(state) < 0)
+	return (REC_TYPE_ERROR);
     return (rec_type);
 }
 
@@ -989,6 +1041,10 @@ static int smtpd_proxy_replay_setup(SMTPD_STATE *state)
 	if (msg_verbose)
 	    msg_info("%s: new speed-adjust stream fd=%d", myname,
 		     vstream_fileno(smtpd_proxy_replay_stream));
+	/* Fewer system calls when saving and replaying large messages. */
+	vstream_control(smtpd_proxy_replay_stream,
+			CA_VSTREAM_CTL_BUFSIZE(SMTPD_PROXY_CONTENT_SIZE),
+			CA_VSTREAM_CTL_END);
     }
 
     /*
@@ -1014,10 +1070,11 @@ int     smtpd_proxy_create(SMTPD_STATE *state, int flags, const char *service,
      * When an operation has many arguments it is safer to use named
      * parameters, and have the compiler enforce the argument count.
      */
-#define SMTPD_PROXY_ALLOC(p, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, a12) \
+#define SMTPD_PROXY_ALLOC(p, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11, \
+	    a12, a13) \
 	((p) = (SMTPD_PROXY *) mymalloc(sizeof(*(p))), (p)->a1, (p)->a2, \
 	 (p)->a3, (p)->a4, (p)->a5, (p)->a6, (p)->a7, (p)->a8, (p)->a9, \
-	 (p)->a10, (p)->a11, (p)->a12, (p))
+	 (p)->a10, (p)->a11, (p)->a12, (p)->a13, (p))
 
     /*
      * Sanity check.
@@ -1037,7 +1094,8 @@ int     smtpd_proxy_create(SMTPD_STATE *state, int flags, const char *service,
 			      rec_put = smtpd_proxy_rec_put,
 			      flags = flags, service_stream = 0,
 			      service_name = service, timeout = timeout,
-			      ehlo_name = ehlo_name, mail_from = mail_from);
+			      ehlo_name = ehlo_name, mail_from = mail_from,
+			      content = 0);
 	if (smtpd_proxy_connect(state) < 0) {
 	    /* NOT: smtpd_proxy_free(state); we still need proxy->reply. */
 	    return (-1);
@@ -1067,7 +1125,8 @@ int     smtpd_proxy_create(SMTPD_STATE *state, int flags, const char *service,
 			      rec_put = smtpd_proxy_save_rec_put,
 			      flags = flags, service_stream = 0,
 			      service_name = service, timeout = timeout,
-			      ehlo_name = ehlo_name, mail_from = mail_from);
+			      ehlo_name = ehlo_name, mail_from = mail_from,
+			      content = 0);
 	return (0);
 #endif
     }
@@ -1110,6 +1169,8 @@ void    smtpd_proxy_free(SMTPD_STATE *state)
 	vstring_free(proxy->request);
     if (proxy->reply != 0)
 	vstring_free(proxy->reply);
+    if (proxy->content != 0)
+	vstring_free(proxy->content);
     myfree((void *) proxy);
     state->proxy = 0;
 
@@ -37,6 +37,7 @@ typedef struct SMTPD_PROXY {
     int     timeout;
     const char *ehlo_name;
     const char *mail_from;
+    VSTRING *content;			/* unsent message content */
 } SMTPD_PROXY;
 
 #define SMTPD_PROXY_FLAG_SPEED_ADJUST	(1<<0)
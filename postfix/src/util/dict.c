@@ -64,6 +64,12 @@
 /*	const char *dict_name;
 /*	VSTREAM	*fp;
 /*
+/*	const char *dict_get_first(dict, keys, count, index)
+/*	DICT	*dict;
+/*	const char **keys;
+/*	int	count;
+/*	int	*index;
+/*
 /*	const char *dict_flags_str(dict_flags)
 /*	int	dict_flags;
 /*
@@ -160,6 +166,19 @@
 /*	dict_load_fp() reads name-value entries from an open stream.
 /*	It has the same semantics as the dict_load_file_xt() function.
 /*
+/*	dict_get_first() searches one physical dictionary for the
+/*	first of \fIcount\fR keys that exists, in the order given,
+/*	and returns its value. The \fIindex\fR result is the array
+/*	index of that key. When no key is found, the result is a
+/*	null pointer and \fIindex\fR equals \fIcount\fR.  When a
+/*	lookup fails with dict->error set, the result is a null
+/*	pointer and \fIindex\fR is the array index of the key that
+/*	could not be looked up; keys with a smaller index were not
+/*	found.  A dictionary may implement the lookup_first method
+/*	to resolve all keys in one request (for example, one network
+/*	round trip); otherwise this function makes one lookup per
+/*	key.  The result is owned by the underlying dictionary method.
+/*
 /*	dict_flags_str() returns a printable representation of the
 /*	specified dictionary flags. The result is overwritten upon
 /*	each call.
@@ -436,6 +455,26 @@ int     dict_error(const char *dict_name)
     return (dict ? dict->error : DICT_ERR_NONE);
 }
 
+/* dict_get_first - find the first of multiple keys */
+
+const char *dict_get_first(DICT *dict, const char **keys, int count,
+			           int *index)
+{
+    const char *value;
+    int     n;
+
+    if (dict->lookup_first != 0)
+	return (dict->lookup_first(dict, keys, count, index));
+    for (n = 0; n < count; n++) {
+	if ((value = dict_get(dict, keys[n])) != 0 || dict->error != 0) {
+	    *index = n;
+	    return (value);
+	}
+    }
+    *index = count;
+    DICT_ERR_VAL_RETURN(dict, DICT_ERR_NONE, (char *) 0);
+}
+
 /* dict_load_file_xt - read entries from text file */
 
 int     dict_load_file_xt(const char *dict_name, const char *path)
@@ -75,11 +75,16 @@ typedef struct DICT_OWNER {
   * Generic dictionary interface - in reality, a dictionary extends this
   * structure with private members to maintain internal state.
   */
+typedef void (*DICT_ASYNC_FN) (int, const char *, void *);
+
 typedef struct DICT {
     char   *type;			/* for diagnostics */
     char   *name;			/* for diagnostics */
     int     flags;			/* see below */
     const char *(*lookup) (struct DICT *, const char *);
+    const char *(*lookup_first) (struct DICT *, const char **, int, int *);
+    void    (*lookup_async) (struct DICT *, const char *, DICT_ASYNC_FN,
+			             void *);
     int     (*update) (struct DICT *, const char *, const char *);
     int     (*delete) (struct DICT *, const char *);
     int     (*sequence) (struct DICT *, int, const char **, const char **);
@@ -234,6 +239,9 @@ extern void dict_open_register(const char *, DICT_OPEN_FN);
 extern DICT_OPEN_EXTEND_FN dict_open_extend(DICT_OPEN_EXTEND_FN);
 
 #define dict_get(dp, key)	((const char *) (dp)->lookup((dp), (key)))
+extern const char *dict_get_first(DICT *, const char **, int, int *);
+extern void dict_get_async(DICT *, const char *, DICT_ASYNC_FN, void *);
+extern void dict_async_deliver(DICT_ASYNC_FN, void *, int, const char *);
 #define dict_put(dp, key, val)	(dp)->update((dp), (key), (val))
 #define dict_del(dp, key)	(dp)->delete((dp), (key))
 #define dict_seq(dp, f, key, val) (dp)->sequence((dp), (f), (key), (val))
@@ -251,6 +259,9 @@ extern void dict_type_override(DICT *, const char *);
   */
 typedef struct DICT_UTF8_BACKUP {
     const char *(*lookup) (struct DICT *, const char *);
+    const char *(*lookup_first) (struct DICT *, const char **, int, int *);
+    void    (*lookup_async) (struct DICT *, const char *, DICT_ASYNC_FN,
+			             void *);
     int     (*update) (struct DICT *, const char *, const char *);
     int     (*delete) (struct DICT *, const char *);
 } DICT_UTF8_BACKUP;
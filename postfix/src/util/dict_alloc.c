@@ -25,6 +25,11 @@
 /*	ones that it supports.
 /*	The purpose of the default methods is to trap an attempt to
 /*	invoke an unsupported method.
+/*	The optional lookup_first method is initialized with a
+/*	null pointer; dict_get_first() then falls back to one lookup
+/*	per key. Likewise, the optional lookup_async method is
+/*	initialized with a null pointer; dict_get_async() then falls
+/*	back to a blocking lookup.
 /*
 /*	One exception is the default lock function.  When the
 /*	dictionary provides a file handle for locking, the default
@@ -140,6 +145,8 @@ DICT   *dict_alloc(const char *dict_type, const char *dict_name, ssize_t size)
     dict->name = mystrdup(dict_name);
     dict->flags = DICT_FLAG_FIXED;
     dict->lookup = dict_default_lookup;
+    dict->lookup_first = 0;
+    dict->lookup_async = 0;
     dict->update = dict_default_update;
     dict->delete = dict_default_delete;
     dict->sequence = dict_default_sequence;
@@ -0,0 +1,468 @@
+/*++
+/* NAME
+/*	dict_async 3
+/* SUMMARY
+/*	event-driven dictionary lookup
+/* SYNOPSIS
+/*	#include <dict.h>
+/*
+/*	void	dict_get_async(dict, key, callback, context)
+/*	DICT	*dict;
+/*	const char *key;
+/*	void	(*callback)(int error, const char *value, void *context);
+/*	void	*context;
+/*
+/*	void	dict_async_deliver(callback, context, error, value)
+/*	void	(*callback)(int error, const char *value, void *context);
+/*	void	*context;
+/*	int	error;
+/*	const char *value;
+/* DESCRIPTION
+/*	dict_get_async() looks up the specified key without blocking
+/*	the caller, and reports the result to the application
+/*	call-back routine under control by the events(3) manager.
+/*	The call-back arguments are the dictionary error status
+/*	(DICT_ERR_NONE, DICT_ERR_RETRY or DICT_ERR_CONFIG), the
+/*	value (a null pointer when the key was not found or the
+/*	lookup failed), and the application context. The value
+/*	is overwritten after the call-back returns. The dict->error
+/*	member is also updated before the call-back is made.
+/*
+/*	The call-back is never invoked before dict_get_async()
+/*	returns, so that the caller does not need to be re-entrant.
+/*	Multiple requests for the same dictionary may be in progress
+/*	at the same time; replies may arrive in any order.
+/*
+/*	A dictionary may implement the lookup_async method to avoid
+/*	blocking on network I/O. Otherwise, this function makes a
+/*	blocking lookup and delivers the result with a zero-delay
+/*	timer event.
+/*
+/*	dict_async_deliver() is a helper for lookup_async methods
+/*	that know the result without doing any I/O. It copies the
+/*	value and invokes the call-back with a zero-delay timer
+/*	event.
+/* SEE ALSO
+/*	dict(3) generic dictionary manager
+/*	events(3) event manager
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <events.h>
+#include <dict.h>
+
+/* Application-specific. */
+
+typedef struct {
+    DICT_ASYNC_FN callback;		/* application call-back */
+    void   *context;			/* application context */
+    int     error;			/* lookup status */
+    char   *value;			/* lookup result or null */
+} DICT_ASYNC_REQ;
+
+/* dict_async_event - deliver result from blocking lookup */
+
+static void dict_async_event(int unused_event, void *context)
+{
+    DICT_ASYNC_REQ *req = (DICT_ASYNC_REQ *) context;
+
+    req->callback(req->error, req->value, req->context);
+    if (req->value)
+	myfree(req->value);
+    myfree((void *) req);
+}
+
+/* dict_async_deliver - report known result later */
+
+void    dict_async_deliver(DICT_ASYNC_FN callback, void *context,
+			           int error, const char *value)
+{
+    DICT_ASYNC_REQ *req;
+
+    req = (DICT_ASYNC_REQ *) mymalloc(sizeof(*req));
+    req->callback = callback;
+    req->context = context;
+    req->error = error;
+    req->value = value ? mystrdup(value) : 0;
+    event_request_timer(dict_async_event, (void *) req, 0);
+}
+
+/* dict_get_async - look up key, report result later */
+
+void    dict_get_async(DICT *dict, const char *key, DICT_ASYNC_FN callback,
+		               void *context)
+{
+    const char *value;
+
+    if (dict->lookup_async != 0) {
+	dict->lookup_async(dict, key, callback, context);
+    } else {
+	value = dict_get(dict, key);
+	dict_async_deliver(callback, context, dict->error, value);
+    }
+}
+
+#ifdef TEST
+
+ /*
+  * Latency benchmark. Usage: dict_async [-v] [-c concurrency] [-n count]
+  * type:name key. This makes count lookups, with up to concurrency lookups
+  * in progress at the same time, and reports the elapsed time and the
+  * average and maximal lookup latency. Compare -c 1 (one lookup at a time,
+  * as with a blocking client) against larger concurrency to see how much
+  * time an event-driven daemon would otherwise spend waiting.
+  * 
+  * Self-test. Usage: dict_async [-v] [-b chunk] -s socketmap|tcp key...
+  * This forks a server that answers each request as encoded in its key:
+  * "code:text" becomes the socketmap reply "code text" or the tcp reply
+  * "code text". The server writes each reply in chunks of -b bytes with a
+  * short delay in between, so that the client receives it in pieces. All
+  * keys are looked up with dict_get(), and then with dict_get_async() with
+  * all lookups in progress at the same time. The results are reported in
+  * key order; the exit status is non-zero when the results differ.
+  */
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <msg_vstream.h>
+#include <vstream.h>
+#include <vstring_vstream.h>
+#include <iostuff.h>
+#include <listen.h>
+#include <netstring.h>
+#include <hex_quote.h>
+#include <split_at.h>
+#include <stringops.h>
+
+#define STR(x)	vstring_str(x)
+#define LEN(x)	VSTRING_LEN(x)
+
+typedef struct {
+    struct timeval start;		/* request start time */
+} DICT_ASYNC_TEST;
+
+static DICT *test_dict;
+static const char *test_key;
+static int test_todo;			/* not yet started */
+static int test_busy;			/* in progress */
+static int test_found;
+static int test_error;
+static double test_total;		/* sum of latencies */
+static double test_max;			/* largest latency */
+
+#define TV_DIFF(t1, t0) \
+	(((t1)->tv_sec - (t0)->tv_sec) \
+	 + ((t1)->tv_usec - (t0)->tv_usec) / 1000000.0)
+
+#define DICT_ASYNC_TEST_USAGE "[-v] [-c concurrency] [-n count] type:name key" \
+	" or [-v] [-b chunk] -s socketmap|tcp key..."
+
+static void test_start(void);
+
+/* test_done - record one result, start another lookup */
+
+static void test_done(int error, const char *value, void *context)
+{
+    DICT_ASYNC_TEST *tp = (DICT_ASYNC_TEST *) context;
+    struct timeval now;
+    double  latency;
+
+    GETTIMEOFDAY(&now);
+    latency = TV_DIFF(&now, &tp->start);
+    test_total += latency;
+    if (latency > test_max)
+	test_max = latency;
+    if (error)
+	test_error++;
+    else if (value)
+	test_found++;
+    if (msg_verbose)
+	msg_info("%s: error=%d value=%s latency=%.3f",
+		 test_key, error, value ? value : "(notfound)", latency);
+    myfree((void *) tp);
+    test_busy--;
+    if (test_todo > 0)
+	test_start();
+}
+
+/* test_start - start one lookup */
+
+static void test_start(void)
+{
+    DICT_ASYNC_TEST *tp;
+
+    tp = (DICT_ASYNC_TEST *) mymalloc(sizeof(*tp));
+    GETTIMEOFDAY(&tp->start);
+    test_todo--;
+    test_busy++;
+    dict_get_async(test_dict, test_key, test_done, (void *) tp);
+}
+
+#define TEST_SOCKMAP	"socketmap"
+#define TEST_TCP	"tcp"
+#define TEST_SOCK_PATH	"dict_async_test.sock"
+#define TEST_DELAY	1000		/* microseconds between chunks */
+
+/* test_serve - serve one client connection */
+
+static NORETURN test_serve(const char *type, int fd, ssize_t chunk)
+{
+    VSTREAM *fp = vstream_fdopen(fd, O_RDWR);
+    VSTRING *request = vstring_alloc(100);
+    VSTRING *key = vstring_alloc(100);
+    VSTRING *reply = vstring_alloc(100);
+    char   *code;
+    char   *text;
+    ssize_t off;
+    ssize_t len;
+
+    netstring_setup(fp, 100);
+    for (;;) {
+
+	/*
+	 * Receive a request, and extract the key.
+	 */
+	if (strcmp(type, TEST_SOCKMAP) == 0) {
+	    if (vstream_setjmp(fp) != 0)
+		break;
+	    netstring_get(fp, request, 10000);
+	    VSTRING_TERMINATE(request);
+	    if ((text = split_at(STR(request), ' ')) == 0)
+		msg_fatal("server: bad socketmap request: %s", STR(request));
+	    vstring_strcpy(key, text);
+	} else {
+	    if (vstring_get_nonl(request, fp) == VSTREAM_EOF)
+		break;
+	    if (strncmp(STR(request), "get ", 4) != 0
+		|| hex_unquote(key, STR(request) + 4) == 0)
+		msg_fatal("server: bad tcp request: %s", STR(request));
+	}
+
+	/*
+	 * Format the reply that the key asks for.
+	 */
+	code = STR(key);
+	if ((text = split_at(code, ':')) == 0)
+	    text = "";
+	if (strcmp(type, TEST_SOCKMAP) == 0) {
+	    vstring_sprintf(reply, "%ld:%s %s,",
+			    (long) (strlen(code) + 1 + strlen(text)),
+			    code, text);
+	} else {
+	    vstring_sprintf(reply, "%s ", code);
+	    hex_quote(request, text);
+	    vstring_sprintf_append(reply, "%s\n", STR(request));
+	}
+
+	/*
+	 * Send the reply in pieces.
+	 */
+	for (off = 0; off < LEN(reply); off += len) {
+	    if ((len = LEN(reply) - off) > chunk)
+		len = chunk;
+	    if (write(fd, STR(reply) + off, len) != len)
+		msg_fatal("server: write: %m");
+	    doze(TEST_DELAY);
+	}
+    }
+    _exit(0);
+}
+
+/* test_server - fork server, return table name */
+
+static pid_t test_server(const char *type, ssize_t chunk, VSTRING *name)
+{
+    struct sockaddr_in sin;
+    SOCKADDR_SIZE sin_len = sizeof(sin);
+    int     listen_fd;
+    int     fd;
+    pid_t   pid;
+
+    if (strcmp(type, TEST_SOCKMAP) == 0) {
+	(void) unlink(TEST_SOCK_PATH);
+	listen_fd = unix_listen(TEST_SOCK_PATH, 10, BLOCKING);
+	vstring_sprintf(name, "%s:unix:%s:test", type, TEST_SOCK_PATH);
+    } else if (strcmp(type, TEST_TCP) == 0) {
+	listen_fd = inet_listen("127.0.0.1:0", 10, BLOCKING);
+	if (getsockname(listen_fd, (struct sockaddr *) &sin, &sin_len) < 0)
+	    msg_fatal("getsockname: %m");
+	vstring_sprintf(name, "%s:127.0.0.1:%d", type, ntohs(sin.sin_port));
+    } else {
+	msg_fatal("unsupported server type: %s", type);
+    }
+    switch (pid = fork()) {
+    case -1:
+	msg_fatal("fork: %m");
+    case 0:
+	signal(SIGCHLD, SIG_IGN);
+	for (;;) {
+	    if ((fd = accept(listen_fd, (struct sockaddr *) 0,
+			     (SOCKADDR_SIZE *) 0)) < 0)
+		continue;
+	    switch (fork()) {
+	    case -1:
+		msg_fatal("server: fork: %m");
+	    case 0:
+		(void) close(listen_fd);
+		test_serve(type, fd, chunk);
+	    default:
+		(void) close(fd);
+	    }
+	}
+    default:
+	(void) close(listen_fd);
+	return (pid);
+    }
+}
+
+/* test_result - format lookup result */
+
+static char *test_result(int error, const char *value)
+{
+    if (error)
+	return (concatenate("error ", error == DICT_ERR_RETRY ?
+			    "retry" : "config", (char *) 0));
+    else if (value)
+	return (concatenate("found ", value, (char *) 0));
+    else
+	return (mystrdup("not found"));
+}
+
+/* test_self_done - save event-driven lookup result */
+
+static void test_self_done(int error, const char *value, void *context)
+{
+    char  **result = (char **) context;
+
+    *result = test_result(error, value);
+    test_busy--;
+}
+
+/* test_self - compare blocking and event-driven lookups */
+
+static int test_self(const char *type, ssize_t chunk, char **keys, int count)
+{
+    VSTRING *name = vstring_alloc(100);
+    char  **blocking;
+    char  **async;
+    const char *value;
+    pid_t   pid;
+    int     errs = 0;
+    int     i;
+
+    pid = test_server(type, chunk, name);
+    test_dict = dict_open(STR(name), O_RDONLY, DICT_FLAG_LOCK);
+    blocking = (char **) mymalloc(sizeof(*blocking) * count);
+    async = (char **) mymalloc(sizeof(*async) * count);
+
+    for (i = 0; i < count; i++) {
+	value = dict_get(test_dict, keys[i]);
+	blocking[i] = test_result(test_dict->error, value);
+    }
+    for (i = 0; i < count; i++) {
+	test_busy++;
+	dict_get_async(test_dict, keys[i], test_self_done, (void *) (async + i));
+    }
+    while (test_busy > 0)
+	event_loop(-1);
+
+    for (i = 0; i < count; i++) {
+	if (strcmp(blocking[i], async[i]) == 0) {
+	    vstream_printf("%s: %s\n", keys[i], blocking[i]);
+	} else {
+	    vstream_printf("%s: blocking %s, event-driven %s\n",
+			   keys[i], blocking[i], async[i]);
+	    errs++;
+	}
+	myfree(blocking[i]);
+	myfree(async[i]);
+    }
+    vstream_fflush(VSTREAM_OUT);
+    myfree((void *) blocking);
+    myfree((void *) async);
+    dict_close(test_dict);
+    (void) kill(pid, SIGTERM);
+    if (strcmp(type, TEST_SOCKMAP) == 0)
+	(void) unlink(TEST_SOCK_PATH);
+    vstring_free(name);
+    return (errs);
+}
+
+int     main(int argc, char **argv)
+{
+    struct timeval start;
+    struct timeval finish;
+    int     concurrency = 1;
+    int     count = 100;
+    ssize_t chunk = 1;
+    char   *self_test = 0;
+    int     ch;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    while ((ch = GETOPT(argc, argv, "b:c:n:s:v")) > 0) {
+	switch (ch) {
+	case 'b':
+	    if ((chunk = atoi(optarg)) <= 0)
+		msg_fatal("bad chunk size: %s", optarg);
+	    break;
+	case 'c':
+	    if ((concurrency = atoi(optarg)) <= 0)
+		msg_fatal("bad concurrency: %s", optarg);
+	    break;
+	case 'n':
+	    if ((count = atoi(optarg)) <= 0)
+		msg_fatal("bad count: %s", optarg);
+	    break;
+	case 's':
+	    self_test = optarg;
+	    break;
+	case 'v':
+	    msg_verbose++;
+	    break;
+	default:
+	    msg_fatal("usage: %s %s", argv[0], DICT_ASYNC_TEST_USAGE);
+	}
+    }
+    if (self_test != 0) {
+	if (argc - optind < 1)
+	    msg_fatal("usage: %s %s", argv[0], DICT_ASYNC_TEST_USAGE);
+	exit(test_self(self_test, chunk, argv + optind, argc - optind) != 0);
+    }
+    if (argc - optind != 2)
+	msg_fatal("usage: %s %s", argv[0], DICT_ASYNC_TEST_USAGE);
+    test_dict = dict_open(argv[optind], O_RDONLY, DICT_FLAG_LOCK);
+    test_key = argv[optind + 1];
+    test_todo = count;
+
+    GETTIMEOFDAY(&start);
+    while (test_todo > 0 && test_busy < concurrency)
+	test_start();
+    while (test_busy > 0)
+	event_loop(-1);
+    GETTIMEOFDAY(&finish);
+
+    vstream_printf("%d lookups, concurrency %d: found %d, errors %d\n",
+		   count, concurrency, test_found, test_error);
+    vstream_printf("elapsed %.3f s, latency average %.3f s, max %.3f s\n",
+		   TV_DIFF(&finish, &start), test_total / count, test_max);
+    vstream_fflush(VSTREAM_OUT);
+    dict_close(test_dict);
+    exit(0);
+}
+
+#endif
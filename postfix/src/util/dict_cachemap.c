@@ -0,0 +1,362 @@
+/*++
+/* NAME
+/*	dict_cachemap 3
+/* SUMMARY
+/*	dictionary manager interface for cached lookups
+/* SYNOPSIS
+/*	#include <dict_cachemap.h>
+/*
+/*	DICT	*dict_cachemap_open(name, open_flags, dict_flags)
+/*	const char *name;
+/*	int	open_flags;
+/*	int	dict_flags;
+/* DESCRIPTION
+/*	dict_cachemap_open() opens a table that remembers the results
+/*	from another table in process memory.
+/*	Example: "\fBcachemap:{\fItype:name, attribute=value, ...\fR}".
+/*
+/*	A "cachemap:" query is answered from the in-memory cache
+/*	when a fresh result exists; otherwise the query is given to
+/*	the underlying table and the result is saved in the cache.
+/*	Lookup errors are not cached.
+/*
+/*	The first and last characters of a "cachemap:" table name
+/*	must be '{' and '}'. Within these, the underlying table and
+/*	the optional attributes are separated with comma or
+/*	whitespace. The attributes are:
+/* .IP "ttl=\fIseconds\fR (default: 60)"
+/*	The time to remember a result that was found.
+/* .IP "neg_ttl=\fIseconds\fR (default: 10)"
+/*	The time to remember that a result was not found. Specify
+/*	zero to disable negative caching.
+/* .IP "size=\fIcount\fR (default: 10000)"
+/*	The maximal number of cached results (the minimum is 5).
+/*	When the cache is full, the least-recently used result is
+/*	discarded.
+/* .IP "log_interval=\fIseconds\fR (default: 0)"
+/*	The minimal time between messages that log the number of
+/*	lookups, cache hits, cache misses, expired results, errors,
+/*	and the average time of a cache miss. Specify zero to disable
+/*	these messages.
+/* .PP
+/*	The open_flags and dict_flags arguments are passed on to
+/*	the underlying dictionary.
+/* SEE ALSO
+/*	dict(3) generic dictionary manager
+/*	ctable(3) cache manager
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <argv.h>
+#include <ctable.h>
+#include <dict.h>
+#include <dict_cachemap.h>
+#include <stringops.h>
+
+/* Application-specific. */
+
+typedef struct {
+    DICT    dict;			/* generic members */
+    char   *map_name;			/* underlying table */
+    CTABLE *cache;			/* cached results */
+    int     ttl;			/* positive result lifetime */
+    int     neg_ttl;			/* negative result lifetime */
+    int     log_interval;		/* statistics logging interval */
+    time_t  last_log;			/* last statistics message */
+    int     created;			/* cache miss flag */
+    /* Statistics. */
+    long    lookups;			/* all queries */
+    long    hits;			/* fresh results from cache */
+    long    misses;			/* queries sent to table */
+    long    expired;			/* stale results from cache */
+    long    errors;			/* table lookup errors */
+    struct timeval miss_time;		/* time spent in table lookups */
+} DICT_CACHEMAP;
+
+typedef struct {
+    char   *result;			/* null or lookup result */
+    int     error;			/* lookup status */
+    time_t  expires;			/* expiration time */
+} DICT_CACHEMAP_ENTRY;
+
+#define DICT_CACHEMAP_DEF_TTL		60
+#define DICT_CACHEMAP_DEF_NEG_TTL	10
+#define DICT_CACHEMAP_DEF_SIZE		10000
+#define DICT_CACHEMAP_DEF_LOG_INTERVAL	0
+
+/* dict_cachemap_create - query the underlying table */
+
+static void *dict_cachemap_create(const char *query, void *context)
+{
+    static const char myname[] = "dict_cachemap_create";
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) context;
+    DICT_CACHEMAP_ENTRY *entry;
+    DICT   *map;
+    const char *result;
+    struct timeval start;
+    struct timeval finish;
+
+    if ((map = dict_handle(dict_cachemap->map_name)) == 0)
+	msg_panic("%s: dictionary \"%s\" not found",
+		  myname, dict_cachemap->map_name);
+    GETTIMEOFDAY(&start);
+    result = dict_get(map, query);
+    GETTIMEOFDAY(&finish);
+
+    /*
+     * Update the statistics.
+     */
+    dict_cachemap->created = 1;
+    dict_cachemap->misses++;
+    dict_cachemap->miss_time.tv_sec += finish.tv_sec - start.tv_sec;
+    dict_cachemap->miss_time.tv_usec += finish.tv_usec - start.tv_usec;
+    while (dict_cachemap->miss_time.tv_usec < 0) {
+	dict_cachemap->miss_time.tv_usec += 1000000;
+	dict_cachemap->miss_time.tv_sec -= 1;
+    }
+    while (dict_cachemap->miss_time.tv_usec >= 1000000) {
+	dict_cachemap->miss_time.tv_usec -= 1000000;
+	dict_cachemap->miss_time.tv_sec += 1;
+    }
+
+    /*
+     * A result with a lookup error expires immediately.
+     */
+    entry = (DICT_CACHEMAP_ENTRY *) mymalloc(sizeof(*entry));
+    entry->result = (result ? mystrdup(result) : 0);
+    entry->error = (result ? DICT_ERR_NONE : map->error);
+    if (entry->error != DICT_ERR_NONE) {
+	dict_cachemap->errors++;
+	entry->expires = 0;
+    } else {
+	entry->expires = finish.tv_sec + (result ? dict_cachemap->ttl :
+					  dict_cachemap->neg_ttl);
+    }
+    return ((void *) entry);
+}
+
+/* dict_cachemap_delete - discard cached result */
+
+static void dict_cachemap_delete(void *ptr, void *unused_context)
+{
+    DICT_CACHEMAP_ENTRY *entry = (DICT_CACHEMAP_ENTRY *) ptr;
+
+    if (entry->result)
+	myfree(entry->result);
+    myfree((void *) entry);
+}
+
+/* dict_cachemap_log_stats - log cache effectiveness */
+
+static void dict_cachemap_log_stats(DICT_CACHEMAP *dict_cachemap)
+{
+    long    avg_msec;
+
+    avg_msec = (dict_cachemap->misses == 0 ? 0 :
+		(dict_cachemap->miss_time.tv_sec * 1000
+		 + dict_cachemap->miss_time.tv_usec / 1000)
+		/ dict_cachemap->misses);
+    msg_info("statistics: %s:%s lookups=%ld hits=%ld misses=%ld"
+	     " expired=%ld errors=%ld avg_miss_delay=%ldms",
+	     dict_cachemap->dict.type, dict_cachemap->dict.name,
+	     dict_cachemap->lookups, dict_cachemap->hits,
+	     dict_cachemap->misses, dict_cachemap->expired,
+	     dict_cachemap->errors, avg_msec);
+}
+
+/* dict_cachemap_lookup - search the cache, then the table */
+
+static const char *dict_cachemap_lookup(DICT *dict, const char *query)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) dict;
+    const DICT_CACHEMAP_ENTRY *entry;
+    time_t  now = time((time_t *) 0);
+
+    dict_cachemap->lookups++;
+    dict_cachemap->created = 0;
+    entry = (const DICT_CACHEMAP_ENTRY *)
+	ctable_locate(dict_cachemap->cache, query);
+    if (dict_cachemap->created == 0) {
+	if (entry->expires > now) {
+	    dict_cachemap->hits++;
+	} else {
+	    dict_cachemap->expired++;
+	    entry = (const DICT_CACHEMAP_ENTRY *)
+		ctable_refresh(dict_cachemap->cache, query);
+	}
+    }
+    if (dict_cachemap->log_interval > 0
+	&& now - dict_cachemap->last_log >= dict_cachemap->log_interval) {
+	dict_cachemap_log_stats(dict_cachemap);
+	dict_cachemap->last_log = now;
+    }
+    DICT_ERR_VAL_RETURN(dict, entry->error, entry->result);
+}
+
+/* dict_cachemap_close - disassociate from the table */
+
+static void dict_cachemap_close(DICT *dict)
+{
+    DICT_CACHEMAP *dict_cachemap = (DICT_CACHEMAP *) dict;
+
+    if (dict_cachemap->log_interval > 0 && dict_cachemap->lookups > 0)
+	dict_cachemap_log_stats(dict_cachemap);
+    ctable_free(dict_cachemap->cache);
+    dict_unregister(dict_cachemap->map_name);
+    myfree(dict_cachemap->map_name);
+    dict_free(dict);
+}
+
+/* dict_cachemap_open - open a cached table */
+
+DICT   *dict_cachemap_open(const char *name, int open_flags, int dict_flags)
+{
+    static const char myname[] = "dict_cachemap_open";
+    DICT_CACHEMAP *dict_cachemap;
+    char   *saved_name = 0;
+    char   *map_name = 0;
+    ARGV   *argv = 0;
+    char  **cpp;
+    char   *arg;
+    char   *attr_name;
+    char   *attr_value;
+    const char *err;
+    int     ttl = DICT_CACHEMAP_DEF_TTL;
+    int     neg_ttl = DICT_CACHEMAP_DEF_NEG_TTL;
+    int     size = DICT_CACHEMAP_DEF_SIZE;
+    int     log_interval = DICT_CACHEMAP_DEF_LOG_INTERVAL;
+    int    *int_ptr;
+    DICT   *dict;
+    size_t  len;
+
+    /*
+     * Clarity first. Let the optimizer worry about redundant code. Error
+     * messages may refer to parts of the saved name, so the result is
+     * computed before that storage is released.
+     */
+#define DICT_CACHEMAP_RETURN(x) do { \
+	      DICT *_dict = (x); \
+	      if (saved_name != 0) \
+	          myfree(saved_name); \
+	      if (argv != 0) \
+	          argv_free(argv); \
+	      return (_dict); \
+	  } while (0)
+
+#define DICT_CACHEMAP_SYNTAX_ERROR() \
+	DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name, \
+					    open_flags, dict_flags, \
+					    "bad syntax: \"%s:%s\"; " \
+					    "need \"%s:{type:name, " \
+					    "attribute=value...}\"", \
+					    DICT_TYPE_CACHEMAP, name, \
+					    DICT_TYPE_CACHEMAP))
+
+    /*
+     * Sanity checks.
+     */
+    if (open_flags != O_RDONLY)
+	DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name,
+					    open_flags, dict_flags,
+				  "%s:%s map requires O_RDONLY access mode",
+					    DICT_TYPE_CACHEMAP, name));
+
+    /*
+     * Split the table name into its constituent parts. An attribute has
+     * no ':' before its '='; a table name has a ':' before any '='.
+     */
+    if ((len = balpar(name, CHARS_BRACE)) == 0 || name[len] != 0
+	|| *(saved_name = mystrndup(name + 1, len - 2)) == 0
+	|| ((argv = argv_splitq(saved_name, CHARS_COMMA_SP, CHARS_BRACE)),
+	    (argv->argc == 0)))
+	DICT_CACHEMAP_SYNTAX_ERROR();
+    for (cpp = argv->argv; (arg = *cpp) != 0; cpp++) {
+	if (strcspn(arg, ":=") < strcspn(arg, "=")) {
+	    if (map_name != 0)
+		DICT_CACHEMAP_SYNTAX_ERROR();
+	    map_name = arg;
+	    continue;
+	}
+	if ((err = split_nameval(arg, &attr_name, &attr_value)) != 0)
+	    DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name,
+						open_flags, dict_flags,
+						"%s:%s: %s: \"%s\"",
+						DICT_TYPE_CACHEMAP, name,
+						err, arg));
+	if (strcmp(attr_name, "ttl") == 0)
+	    int_ptr = &ttl;
+	else if (strcmp(attr_name, "neg_ttl") == 0)
+	    int_ptr = &neg_ttl;
+	else if (strcmp(attr_name, "size") == 0)
+	    int_ptr = &size;
+	else if (strcmp(attr_name, "log_interval") == 0)
+	    int_ptr = &log_interval;
+	else
+	    DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name,
+						open_flags, dict_flags,
+					     "%s:%s: unknown attribute \"%s\"",
+						DICT_TYPE_CACHEMAP, name,
+						attr_name));
+	if (!alldig(attr_value) || (*int_ptr = atoi(attr_value)) < 0
+	    || (int_ptr == &size && *int_ptr == 0))
+	    DICT_CACHEMAP_RETURN(dict_surrogate(DICT_TYPE_CACHEMAP, name,
+						open_flags, dict_flags,
+				     "%s:%s: bad attribute value \"%s=%s\"",
+						DICT_TYPE_CACHEMAP, name,
+						attr_name, attr_value));
+    }
+    if (map_name == 0)
+	DICT_CACHEMAP_SYNTAX_ERROR();
+
+    /*
+     * Open or share the underlying table.
+     */
+    if (msg_verbose)
+	msg_info("%s: %s", myname, map_name);
+    if ((dict = dict_handle(map_name)) == 0)
+	dict = dict_open(map_name, open_flags, dict_flags);
+    dict_register(map_name, dict);
+
+    /*
+     * Bundle up the result.
+     */
+    dict_cachemap = (DICT_CACHEMAP *)
+	dict_alloc(DICT_TYPE_CACHEMAP, name, sizeof(*dict_cachemap));
+    dict_cachemap->dict.lookup = dict_cachemap_lookup;
+    dict_cachemap->dict.close = dict_cachemap_close;
+    dict_cachemap->dict.flags = dict_flags
+	| (dict->flags & (DICT_FLAG_FIXED | DICT_FLAG_PATTERN));
+    dict_cachemap->dict.owner = dict->owner;
+    dict_cachemap->map_name = mystrdup(map_name);
+    dict_cachemap->cache = ctable_create(size, dict_cachemap_create,
+					 dict_cachemap_delete,
+					 (void *) dict_cachemap);
+    dict_cachemap->ttl = ttl;
+    dict_cachemap->neg_ttl = neg_ttl;
+    dict_cachemap->log_interval = log_interval;
+    dict_cachemap->last_log = time((time_t *) 0);
+    dict_cachemap->created = 0;
+    dict_cachemap->lookups = 0;
+    dict_cachemap->hits = 0;
+    dict_cachemap->misses = 0;
+    dict_cachemap->expired = 0;
+    dict_cachemap->errors = 0;
+    dict_cachemap->miss_time.tv_sec = 0;
+    dict_cachemap->miss_time.tv_usec = 0;
+    DICT_CACHEMAP_RETURN(DICT_DEBUG (&dict_cachemap->dict));
+}
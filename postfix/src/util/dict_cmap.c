@@ -0,0 +1,652 @@
+/*++
+/* NAME
+/*	dict_cmap 3
+/* SUMMARY
+/*	dictionary manager interface to constant memory-mapped files
+/* SYNOPSIS
+/*	#include <dict_cmap.h>
+/*
+/*	DICT	*dict_cmap_open(path, open_flags, dict_flags)
+/*	const char *path;
+/*	int	open_flags;
+/*	int	dict_flags;
+/* DESCRIPTION
+/*	dict_cmap_open() opens the specified constant map file, or
+/*	creates a new one.  The result is a pointer to a structure
+/*	that can be used to access the dictionary using the generic
+/*	methods documented in dict_open(3).
+/*
+/*	A cmap file is created once, for example with postmap(1),
+/*	and is read-only after that. In query mode, the file is
+/*	mapped into memory with mmap(2), so that all processes
+/*	share one copy of the table through the kernel page cache,
+/*	and a lookup result points directly into the mapped file.
+/*	The file contains a hash index with about one bucket per
+/*	entry, so that a lookup usually compares one key.
+/*
+/*	In create mode, entries are collected in memory and the
+/*	file is written when the database is closed. The file is
+/*	written as \fIpath\fB.cmap.tmp\fR and then renamed to
+/*	\fIpath\fB.cmap\fR, so that processes that have the old
+/*	file open are not affected. Duplicate keys are reported
+/*	when the file is written.
+/*
+/*	A cmap file uses the byte order of the host that created
+/*	it, and is limited to 2^32-1 entries and 4GB of key and
+/*	value text.
+/*
+/*	Arguments:
+/* .IP path
+/*	The database pathname, not including the ".cmap" suffix.
+/* .IP open_flags
+/*	Flags passed to open(). Specify O_RDONLY or O_WRONLY|O_CREAT|O_TRUNC.
+/* .IP dict_flags
+/*	Flags used by the dictionary interface.
+/* SEE ALSO
+/*	dict(3) generic dictionary manager
+/* DIAGNOSTICS
+/*	Fatal errors: cannot open file, write error, out of memory,
+/*	corrupted file.
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdio.h>				/* rename() */
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <vstring.h>
+#include <vstream.h>
+#include <stringops.h>
+#include <iostuff.h>
+#include <myflock.h>
+#include <dict.h>
+#include <dict_cmap.h>
+#include <warn_stat.h>
+
+/* Application-specific. */
+
+ /*
+  * File format. All numbers are in host byte order. The header is followed
+  * by bucket_count + 1 bucket start indices into the entry array, by
+  * entry_count entries, and by the key and value text. An entry specifies
+  * the hash of a key, and the offset of that key in the text area. Each key
+  * is null-terminated, and is followed by its null-terminated value.
+  */
+#define DICT_CMAP_MAGIC		0x636d6170	/* "cmap" */
+#define DICT_CMAP_VERSION	1
+
+typedef struct {
+    UINT32_TYPE magic;			/* DICT_CMAP_MAGIC */
+    UINT32_TYPE version;		/* DICT_CMAP_VERSION */
+    UINT32_TYPE bucket_count;		/* hash buckets */
+    UINT32_TYPE entry_count;		/* table entries */
+    UINT32_TYPE text_size;		/* key and value text */
+    UINT32_TYPE spare[3];		/* future use */
+} DICT_CMAP_HDR;
+
+typedef struct {
+    UINT32_TYPE hash;			/* key hash */
+    UINT32_TYPE offset;			/* key offset in text area */
+} DICT_CMAP_ENT;
+
+#define DICT_CMAP_LIMIT		((UINT32_TYPE) ~0)
+
+#define DICT_CMAP_SUFFIX	".cmap"
+#define DICT_CMAP_TMP_SUFFIX	DICT_CMAP_SUFFIX ".tmp"
+
+typedef struct {
+    DICT    dict;			/* generic members */
+    void   *map;			/* mapped file */
+    size_t  map_size;			/* mapped file size */
+    const UINT32_TYPE *buckets;		/* bucket start indices */
+    const DICT_CMAP_ENT *entries;	/* entry array */
+    const char *text;			/* key and value text */
+    UINT32_TYPE bucket_count;		/* hash buckets */
+    UINT32_TYPE entry_count;		/* table entries */
+    UINT32_TYPE text_size;		/* key and value text */
+    UINT32_TYPE seq_next;		/* sequence cursor */
+} DICT_CMAPQ;				/* query interface */
+
+typedef struct {
+    UINT32_TYPE hash;			/* key hash */
+    UINT32_TYPE seqno;			/* input order */
+    size_t  offset;			/* key offset in text buffer */
+} DICT_CMAPM_ENT;
+
+typedef struct {
+    DICT    dict;			/* generic members */
+    VSTREAM *fp;			/* locked temporary file */
+    char   *cmap_path;			/* cmap pathname (.cmap) */
+    char   *tmp_path;			/* temporary pathname (.tmp) */
+    VSTRING *text;			/* keys and values */
+    DICT_CMAPM_ENT *entries;		/* entries so far */
+    ssize_t entry_count;		/* entries in use */
+    ssize_t entry_len;			/* entries allocated */
+} DICT_CMAPM;				/* rebuild interface */
+
+/* dict_cmap_hash - FNV-1a, part of the file format */
+
+static UINT32_TYPE dict_cmap_hash(const char *key)
+{
+    UINT32_TYPE h = 2166136261U;
+
+    while (*key) {
+	h ^= *(const unsigned char *) key++;
+	h *= 16777619U;
+    }
+    return (h);
+}
+
+/* dict_cmapq_entry - find key and value of table entry */
+
+static const char *dict_cmapq_entry(DICT_CMAPQ *dict_cmapq,
+				            const DICT_CMAP_ENT *ent,
+				            const char **value)
+{
+    const char *key;
+
+    /*
+     * The text area ends in a null byte, so that string operations on a
+     * valid offset stay inside the mapped file.
+     */
+    if (ent->offset >= dict_cmapq->text_size)
+	msg_fatal("%s: corrupted database: bad key offset",
+		  dict_cmapq->dict.name);
+    key = dict_cmapq->text + ent->offset;
+    *value = key + strlen(key) + 1;
+    if (*value >= dict_cmapq->text + dict_cmapq->text_size)
+	msg_fatal("%s: corrupted database: key without value",
+		  dict_cmapq->dict.name);
+    return (key);
+}
+
+/* dict_cmapq_lookup - find database entry, query mode */
+
+static const char *dict_cmapq_lookup(DICT *dict, const char *name)
+{
+    DICT_CMAPQ *dict_cmapq = (DICT_CMAPQ *) dict;
+    UINT32_TYPE hash;
+    UINT32_TYPE bucket;
+    UINT32_TYPE n;
+    UINT32_TYPE end;
+    const DICT_CMAP_ENT *ent;
+    const char *key;
+    const char *value;
+
+    dict->error = 0;
+
+    /* A cmap file is constant, so do not try to acquire a lock. */
+
+    /*
+     * Optionally fold the key.
+     */
+    if (dict->flags & DICT_FLAG_FOLD_FIX) {
+	if (dict->fold_buf == 0)
+	    dict->fold_buf = vstring_alloc(10);
+	vstring_strcpy(dict->fold_buf, name);
+	name = lowercase(vstring_str(dict->fold_buf));
+    }
+
+    /*
+     * Search the bucket. Compare keys only when the hash matches.
+     */
+    hash = dict_cmap_hash(name);
+    bucket = hash % dict_cmapq->bucket_count;
+    n = dict_cmapq->buckets[bucket];
+    end = dict_cmapq->buckets[bucket + 1];
+    if (n > end || end > dict_cmapq->entry_count)
+	msg_fatal("%s: corrupted database: bad bucket index", dict->name);
+    for (ent = dict_cmapq->entries + n; n < end; n++, ent++) {
+	if (ent->hash != hash)
+	    continue;
+	key = dict_cmapq_entry(dict_cmapq, ent, &value);
+	if (strcmp(key, name) == 0)
+	    return (value);
+    }
+    return (0);
+}
+
+/* dict_cmapq_sequence - traverse the dictionary, query mode */
+
+static int dict_cmapq_sequence(DICT *dict, int function,
+			               const char **key, const char **value)
+{
+    const char *myname = "dict_cmapq_sequence";
+    DICT_CMAPQ *dict_cmapq = (DICT_CMAPQ *) dict;
+
+    dict->error = 0;
+
+    switch (function) {
+    case DICT_SEQ_FUN_FIRST:
+	dict_cmapq->seq_next = 0;
+	break;
+    case DICT_SEQ_FUN_NEXT:
+	break;
+    default:
+	msg_panic("%s: invalid function: %d", myname, function);
+    }
+    if (dict_cmapq->seq_next >= dict_cmapq->entry_count)
+	return (1);
+    *key = dict_cmapq_entry(dict_cmapq,
+			    dict_cmapq->entries + dict_cmapq->seq_next++,
+			    value);
+    return (0);
+}
+
+/* dict_cmapq_close - close data base, query mode */
+
+static void dict_cmapq_close(DICT *dict)
+{
+    DICT_CMAPQ *dict_cmapq = (DICT_CMAPQ *) dict;
+
+    if (munmap(dict_cmapq->map, dict_cmapq->map_size) < 0)
+	msg_warn("%s: munmap: %m", dict->name);
+    (void) close(dict->stat_fd);
+    if (dict->fold_buf)
+	vstring_free(dict->fold_buf);
+    dict_free(dict);
+}
+
+/* dict_cmapq_open - open data base, query mode */
+
+static DICT *dict_cmapq_open(const char *path, int dict_flags)
+{
+    DICT_CMAPQ *dict_cmapq;
+    const DICT_CMAP_HDR *hdr;
+    struct stat st;
+    char   *cmap_path;
+    void   *map;
+    size_t  want_size;
+    const char *reason;
+    int     fd;
+
+    /*
+     * Let the optimizer worry about eliminating redundant code.
+     */
+#define DICT_CMAPQ_OPEN_RETURN(d) do { \
+	DICT *__d = (d); \
+	myfree(cmap_path); \
+	return (__d); \
+    } while (0)
+
+    cmap_path = concatenate(path, DICT_CMAP_SUFFIX, (char *) 0);
+
+    if ((fd = open(cmap_path, O_RDONLY)) < 0)
+	DICT_CMAPQ_OPEN_RETURN(dict_surrogate(DICT_TYPE_CMAP, path,
+					      O_RDONLY, dict_flags,
+					 "open database %s: %m", cmap_path));
+    if (fstat(fd, &st) < 0)
+	msg_fatal("dict_cmapq_open: fstat: %m");
+    if (st.st_size < sizeof(*hdr)) {
+	(void) close(fd);
+	DICT_CMAPQ_OPEN_RETURN(dict_surrogate(DICT_TYPE_CMAP, path,
+					      O_RDONLY, dict_flags,
+			       "open database %s: file is too short to be a "
+					      "cmap database", cmap_path));
+    }
+    if ((map = mmap((void *) 0, st.st_size, PROT_READ, MAP_SHARED,
+		    fd, (off_t) 0)) == MAP_FAILED)
+	msg_fatal("mmap database %s: %m", cmap_path);
+
+    /*
+     * Sanity check the header and the file size, so that lookups need to
+     * check only the indices and offsets that they actually use.
+     */
+    hdr = (const DICT_CMAP_HDR *) map;
+    want_size = sizeof(*hdr)
+	+ ((size_t) hdr->bucket_count + 1) * sizeof(UINT32_TYPE)
+	+ (size_t) hdr->entry_count * sizeof(DICT_CMAP_ENT)
+	+ hdr->text_size;
+    if (hdr->magic != DICT_CMAP_MAGIC)
+	reason = "not a cmap database or wrong byte order";
+    else if (hdr->version != DICT_CMAP_VERSION)
+	reason = "unsupported cmap database version";
+    else if (hdr->bucket_count == 0 || want_size != st.st_size)
+	reason = "corrupted cmap database";
+    else if (hdr->text_size > 0
+	     && ((const char *) map)[st.st_size - 1] != 0)
+	reason = "corrupted cmap database";
+    else
+	reason = 0;
+    if (reason != 0) {
+	(void) munmap(map, st.st_size);
+	(void) close(fd);
+	DICT_CMAPQ_OPEN_RETURN(dict_surrogate(DICT_TYPE_CMAP, path,
+					      O_RDONLY, dict_flags,
+					      "open database %s: %s",
+					      cmap_path, reason));
+    }
+    dict_cmapq = (DICT_CMAPQ *) dict_alloc(DICT_TYPE_CMAP,
+					   cmap_path, sizeof(*dict_cmapq));
+    dict_cmapq->map = map;
+    dict_cmapq->map_size = st.st_size;
+    dict_cmapq->bucket_count = hdr->bucket_count;
+    dict_cmapq->entry_count = hdr->entry_count;
+    dict_cmapq->text_size = hdr->text_size;
+    dict_cmapq->buckets = (const UINT32_TYPE *) (hdr + 1);
+    dict_cmapq->entries = (const DICT_CMAP_ENT *)
+	(dict_cmapq->buckets + hdr->bucket_count + 1);
+    dict_cmapq->text = (const char *)
+	(dict_cmapq->entries + hdr->entry_count);
+    dict_cmapq->seq_next = 0;
+    dict_cmapq->dict.lookup = dict_cmapq_lookup;
+    dict_cmapq->dict.sequence = dict_cmapq_sequence;
+    dict_cmapq->dict.close = dict_cmapq_close;
+    dict_cmapq->dict.stat_fd = fd;
+    dict_cmapq->dict.mtime = st.st_mtime;
+    dict_cmapq->dict.owner.uid = st.st_uid;
+    dict_cmapq->dict.owner.status = (st.st_uid != 0);
+    close_on_exec(fd, CLOSE_ON_EXEC);
+
+    /*
+     * Warn if the source file is newer than the indexed file, except when
+     * the source file changed only seconds ago.
+     */
+    if (stat(path, &st) == 0
+	&& st.st_mtime > dict_cmapq->dict.mtime
+	&& st.st_mtime < time((time_t *) 0) - 100)
+	msg_warn("database %s is older than source file %s", cmap_path, path);
+
+    dict_cmapq->dict.flags = dict_flags | DICT_FLAG_FIXED;
+    if (dict_flags & DICT_FLAG_FOLD_FIX)
+	dict_cmapq->dict.fold_buf = vstring_alloc(10);
+
+    DICT_CMAPQ_OPEN_RETURN(DICT_DEBUG (&dict_cmapq->dict));
+}
+
+/* dict_cmapm_update - add database entry, create mode */
+
+static int dict_cmapm_update(DICT *dict, const char *name, const char *value)
+{
+    DICT_CMAPM *dict_cmapm = (DICT_CMAPM *) dict;
+    DICT_CMAPM_ENT *ent;
+
+    dict->error = 0;
+
+    /*
+     * Optionally fold the key.
+     */
+    if (dict->flags & DICT_FLAG_FOLD_FIX) {
+	if (dict->fold_buf == 0)
+	    dict->fold_buf = vstring_alloc(10);
+	vstring_strcpy(dict->fold_buf, name);
+	name = lowercase(vstring_str(dict->fold_buf));
+    }
+
+    /*
+     * Save the entry for later. Duplicates are handled when the file is
+     * written.
+     */
+    if (dict_cmapm->entry_count >= DICT_CMAP_LIMIT)
+	msg_fatal("%s: too many entries", dict_cmapm->tmp_path);
+    if (dict_cmapm->entry_count >= dict_cmapm->entry_len) {
+	dict_cmapm->entry_len *= 2;
+	dict_cmapm->entries = (DICT_CMAPM_ENT *)
+	    myrealloc((void *) dict_cmapm->entries,
+		      dict_cmapm->entry_len * sizeof(*dict_cmapm->entries));
+    }
+    ent = dict_cmapm->entries + dict_cmapm->entry_count;
+    ent->hash = dict_cmap_hash(name);
+    ent->seqno = dict_cmapm->entry_count++;
+    ent->offset = VSTRING_LEN(dict_cmapm->text);
+    vstring_memcat(dict_cmapm->text, name, strlen(name) + 1);
+    vstring_memcat(dict_cmapm->text, value, strlen(value) + 1);
+    return (0);
+}
+
+ /*
+  * qsort() has no context argument.
+  */
+static const char *dict_cmapm_sort_text;
+static UINT32_TYPE dict_cmapm_sort_buckets;
+
+/* dict_cmapm_compare - order by bucket, key, then input order */
+
+static int dict_cmapm_compare(const void *a, const void *b)
+{
+    const DICT_CMAPM_ENT *ea = (const DICT_CMAPM_ENT *) a;
+    const DICT_CMAPM_ENT *eb = (const DICT_CMAPM_ENT *) b;
+    UINT32_TYPE ba = ea->hash % dict_cmapm_sort_buckets;
+    UINT32_TYPE bb = eb->hash % dict_cmapm_sort_buckets;
+    int     diff;
+
+    if (ba != bb)
+	return (ba < bb ? -1 : 1);
+    if (ea->hash != eb->hash)
+	return (ea->hash < eb->hash ? -1 : 1);
+    if ((diff = strcmp(dict_cmapm_sort_text + ea->offset,
+		       dict_cmapm_sort_text + eb->offset)) != 0)
+	return (diff);
+    return (ea->seqno < eb->seqno ? -1 : 1);
+}
+
+/* dict_cmapm_write - write the file */
+
+static void dict_cmapm_write(DICT_CMAPM *dict_cmapm)
+{
+    DICT   *dict = &dict_cmapm->dict;
+    const char *text = vstring_str(dict_cmapm->text);
+    DICT_CMAPM_ENT *entries = dict_cmapm->entries;
+    DICT_CMAPM_ENT *ent;
+    DICT_CMAP_HDR hdr;
+    DICT_CMAP_ENT out;
+    UINT32_TYPE *buckets;
+    UINT32_TYPE bucket_count;
+    ssize_t count;
+    ssize_t n;
+    ssize_t keep;
+    size_t  text_size;
+    size_t  len;
+    const char *key;
+    const char *value;
+
+    /*
+     * One bucket per input entry. The entries of a bucket are stored
+     * together, and equal keys end up next to each other.
+     */
+    bucket_count = dict_cmapm->entry_count > 0 ? dict_cmapm->entry_count : 1;
+    dict_cmapm_sort_text = text;
+    dict_cmapm_sort_buckets = bucket_count;
+    qsort((void *) entries, dict_cmapm->entry_count, sizeof(*entries),
+	  dict_cmapm_compare);
+
+    /*
+     * Handle duplicate keys. By default the first entry wins; with
+     * DICT_FLAG_DUP_REPLACE the last entry wins.
+     */
+    for (count = n = 0; n < dict_cmapm->entry_count; n = keep + 1) {
+	key = text + entries[n].offset;
+	for (keep = n; keep + 1 < dict_cmapm->entry_count
+	     && entries[keep + 1].hash == entries[n].hash
+	     && strcmp(text + entries[keep + 1].offset, key) == 0; keep++)
+	     /* void */ ;
+	if (keep > n) {
+	    if (dict->flags & (DICT_FLAG_DUP_IGNORE | DICT_FLAG_DUP_REPLACE))
+		 /* void */ ;
+	    else if (dict->flags & DICT_FLAG_DUP_WARN)
+		msg_warn("%s: duplicate entry: \"%s\"", dict->name, key);
+	    else
+		msg_fatal("%s: duplicate entry: \"%s\"", dict->name, key);
+	}
+	entries[count++] = entries[(dict->flags & DICT_FLAG_DUP_REPLACE) ?
+				   keep : n];
+    }
+
+    /*
+     * Build the bucket index.
+     */
+    buckets = (UINT32_TYPE *) mymalloc((bucket_count + 1) * sizeof(*buckets));
+    memset((void *) buckets, 0, (bucket_count + 1) * sizeof(*buckets));
+    for (ent = entries; ent < entries + count; ent++)
+	buckets[ent->hash % bucket_count + 1] += 1;
+    for (n = 0; n < bucket_count; n++)
+	buckets[n + 1] += buckets[n];
+
+    /*
+     * Write the header, the bucket index, and the entries. The text is
+     * written in bucket order, so that a lookup touches few pages.
+     */
+    for (text_size = 0, ent = entries; ent < entries + count; ent++) {
+	key = text + ent->offset;
+	value = key + strlen(key) + 1;
+	text_size += (value - key) + strlen(value) + 1;
+	if (text_size > DICT_CMAP_LIMIT)
+	    msg_fatal("%s: too much key and value text", dict_cmapm->tmp_path);
+    }
+    memset((void *) &hdr, 0, sizeof(hdr));
+    hdr.magic = DICT_CMAP_MAGIC;
+    hdr.version = DICT_CMAP_VERSION;
+    hdr.bucket_count = bucket_count;
+    hdr.entry_count = count;
+    hdr.text_size = text_size;
+    vstream_fwrite(dict_cmapm->fp, (void *) &hdr, sizeof(hdr));
+    vstream_fwrite(dict_cmapm->fp, (void *) buckets,
+		   (bucket_count + 1) * sizeof(*buckets));
+    for (text_size = 0, ent = entries; ent < entries + count; ent++) {
+	out.hash = ent->hash;
+	out.offset = text_size;
+	vstream_fwrite(dict_cmapm->fp, (void *) &out, sizeof(out));
+	key = text + ent->offset;
+	value = key + strlen(key) + 1;
+	text_size += (value - key) + strlen(value) + 1;
+    }
+    for (ent = entries; ent < entries + count; ent++) {
+	key = text + ent->offset;
+	value = key + strlen(key) + 1;
+	len = (value - key) + strlen(value) + 1;
+	vstream_fwrite(dict_cmapm->fp, key, len);
+    }
+    if (vstream_fflush(dict_cmapm->fp) != 0)
+	msg_fatal("write database %s: %m", dict_cmapm->tmp_path);
+    myfree((void *) buckets);
+}
+
+/* dict_cmapm_close - write data base and rename file.tmp to file.cmap */
+
+static void dict_cmapm_close(DICT *dict)
+{
+    DICT_CMAPM *dict_cmapm = (DICT_CMAPM *) dict;
+
+    /*
+     * Note: if FCNTL locking is used, closing any file descriptor on a
+     * locked file cancels all locks that the process may have on that file.
+     * We use the same file descriptor for writing and locking.
+     */
+    dict_cmapm_write(dict_cmapm);
+    if (rename(dict_cmapm->tmp_path, dict_cmapm->cmap_path) < 0)
+	msg_fatal("rename database from %s to %s: %m",
+		  dict_cmapm->tmp_path, dict_cmapm->cmap_path);
+    if (vstream_fclose(dict_cmapm->fp) != 0)	/* releases a lock */
+	msg_fatal("close database %s: %m", dict_cmapm->cmap_path);
+    myfree(dict_cmapm->cmap_path);
+    myfree(dict_cmapm->tmp_path);
+    vstring_free(dict_cmapm->text);
+    myfree((void *) dict_cmapm->entries);
+    if (dict->fold_buf)
+	vstring_free(dict->fold_buf);
+    dict_free(dict);
+}
+
+/* dict_cmapm_open - create database as file.tmp */
+
+static DICT *dict_cmapm_open(const char *path, int dict_flags)
+{
+    DICT_CMAPM *dict_cmapm;
+    char   *cmap_path;
+    char   *tmp_path;
+    int     fd;
+    struct stat st0, st1;
+
+    /*
+     * Let the optimizer worry about eliminating redundant code.
+     */
+#define DICT_CMAPM_OPEN_RETURN(d) do { \
+	DICT *__d = (d); \
+	if (cmap_path) \
+	    myfree(cmap_path); \
+	if (tmp_path) \
+	    myfree(tmp_path); \
+	return (__d); \
+    } while (0)
+
+    cmap_path = concatenate(path, DICT_CMAP_SUFFIX, (char *) 0);
+    tmp_path = concatenate(path, DICT_CMAP_TMP_SUFFIX, (char *) 0);
+
+    /*
+     * Repeat until we have opened *and* locked an *existing* file. The
+     * temporary file will be renamed, so we must make sure that we did not
+     * lock a file that another process has just renamed. We can't open the
+     * file with O_TRUNC, because another process may be creating it.
+     */
+    for (;;) {
+	if ((fd = open(tmp_path, O_RDWR | O_CREAT, 0644)) < 0)
+	    DICT_CMAPM_OPEN_RETURN(dict_surrogate(DICT_TYPE_CMAP, path,
+						  O_RDWR, dict_flags,
+						  "open database %s: %m",
+						  tmp_path));
+	if (fstat(fd, &st0) < 0)
+	    msg_fatal("fstat(%s): %m", tmp_path);
+	if (myflock(fd, INTERNAL_LOCK, MYFLOCK_OP_EXCLUSIVE) < 0)
+	    msg_fatal("lock %s: %m", tmp_path);
+	if (stat(tmp_path, &st1) < 0)
+	    msg_fatal("stat(%s): %m", tmp_path);
+	if (st0.st_ino == st1.st_ino && st0.st_dev == st1.st_dev
+	    && st0.st_nlink == st1.st_nlink && st0.st_nlink > 0)
+	    break;
+	(void) close(fd);
+    }
+    if (st0.st_size > 0 && ftruncate(fd, 0) < 0)
+	msg_fatal("truncate %s: %m", tmp_path);
+
+    dict_cmapm = (DICT_CMAPM *) dict_alloc(DICT_TYPE_CMAP, path,
+					   sizeof(*dict_cmapm));
+    dict_cmapm->dict.update = dict_cmapm_update;
+    dict_cmapm->dict.close = dict_cmapm_close;
+    dict_cmapm->fp = vstream_fdopen(fd, O_WRONLY);
+    dict_cmapm->cmap_path = cmap_path;
+    dict_cmapm->tmp_path = tmp_path;
+    cmap_path = tmp_path = 0;			/* DICT_CMAPM_OPEN_RETURN() */
+    dict_cmapm->text = vstring_alloc(10000);
+    dict_cmapm->entry_len = 1000;
+    dict_cmapm->entries = (DICT_CMAPM_ENT *)
+	mymalloc(dict_cmapm->entry_len * sizeof(*dict_cmapm->entries));
+    dict_cmapm->entry_count = 0;
+    dict_cmapm->dict.owner.uid = st1.st_uid;
+    dict_cmapm->dict.owner.status = (st1.st_uid != 0);
+    close_on_exec(fd, CLOSE_ON_EXEC);
+
+    dict_cmapm->dict.flags = dict_flags | DICT_FLAG_FIXED;
+    if (dict_flags & DICT_FLAG_FOLD_FIX)
+	dict_cmapm->dict.fold_buf = vstring_alloc(10);
+
+    DICT_CMAPM_OPEN_RETURN(DICT_DEBUG (&dict_cmapm->dict));
+}
+
+/* dict_cmap_open - open data base for query mode or create mode */
+
+DICT   *dict_cmap_open(const char *path, int open_flags, int dict_flags)
+{
+    switch (open_flags & (O_RDONLY | O_RDWR | O_WRONLY | O_CREAT | O_TRUNC)) {
+    case O_RDONLY:				/* query mode */
+	return (dict_cmapq_open(path, dict_flags));
+    case O_WRONLY | O_CREAT | O_TRUNC:		/* create mode */
+    case O_RDWR | O_CREAT | O_TRUNC:		/* sloppiness */
+	return (dict_cmapm_open(path, dict_flags));
+    default:
+	msg_fatal("dict_cmap_open: inappropriate open flags for cmap database"
+		  " - specify O_RDONLY or O_WRONLY|O_CREAT|O_TRUNC");
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef _DICT_CMAP_H_INCLUDED_
+#define _DICT_CMAP_H_INCLUDED_
+
+/*++
+/* NAME
+/*	dict_cmap 3h
+/* SUMMARY
+/*	dictionary manager interface to constant memory-mapped files
+/* SYNOPSIS
+/*	#include <dict_cmap.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <dict.h>
+
+ /*
+  * External interface.
+  */
+#define DICT_TYPE_CMAP "cmap"
+
+extern DICT *dict_cmap_open(const char *, int, int);
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+#endif
@@ -27,6 +27,13 @@
 /*	This variable cannot be exported via the dict(3) API and
 /*	must therefore be defined in the calling program by invoking
 /*	the DEFINE_DICT_LMDB_MAP_SIZE macro at the global level.
+/*
+/*	When a database is created or truncated in bulk mode (as
+/*	with postmap(1) and postalias(1)), keys that arrive in
+/*	ascending byte order are appended with MDB_APPEND. This
+/*	avoids a B-tree search per update, and leaves pages full
+/*	instead of half full. Input that is not sorted is handled
+/*	as before, at the old speed.
 /* DIAGNOSTICS
 /*	Fatal errors: cannot open file, file write error, out of
 /*	memory.
@@ -87,6 +94,7 @@ typedef struct {
     SLMDB   slmdb;			/* sane LMDB API */
     VSTRING *key_buf;			/* key buffer */
     VSTRING *val_buf;			/* value buffer */
+    VSTRING *append_key;		/* largest key, empty bulk load */
 } DICT_LMDB;
 
  /*
@@ -209,6 +217,24 @@ static const char *dict_lmdb_lookup(DICT *dict, const char *name)
     return (result);
 }
 
+/* dict_lmdb_key_after - key sorts after largest key so far */
+
+static int dict_lmdb_key_after(VSTRING *largest, MDB_val *mdb_key)
+{
+    size_t  len = VSTRING_LEN(largest);
+    int     diff;
+
+    /*
+     * Same as LMDB's default key comparison: bytewise, then by length.
+     */
+    if (len == 0)
+	return (1);
+    if ((diff = memcmp(mdb_key->mv_data, vstring_str(largest),
+		       mdb_key->mv_size < len ? mdb_key->mv_size : len)) != 0)
+	return (diff > 0);
+    return (mdb_key->mv_size > len);
+}
+
 /* dict_lmdb_update - add or update database entry */
 
 static int dict_lmdb_update(DICT *dict, const char *name, const char *value)
@@ -217,6 +243,7 @@ static int dict_lmdb_update(DICT *dict, const char *name, const char *value)
     MDB_val mdb_key;
     MDB_val mdb_value;
     int     status;
+    int     put_flags;
 
     dict->error = 0;
 
@@ -269,10 +296,20 @@ static int dict_lmdb_update(DICT *dict, const char *name, const char *value)
 	msg_fatal("%s: lock dictionary: %m", dict->name);
 
     /*
-     * Do the update.
+     * Do the update. When bulk-loading an initially empty database, a key
+     * that sorts after all keys so far can be appended without searching
+     * the B-tree. LMDB fills pages completely when appending, which also
+     * produces a smaller file. Keys that arrive out of order are inserted
+     * the normal way.
      */
-    status = slmdb_put(&dict_lmdb->slmdb, &mdb_key, &mdb_value,
-	       (dict->flags & DICT_FLAG_DUP_REPLACE) ? 0 : MDB_NOOVERWRITE);
+    put_flags = (dict->flags & DICT_FLAG_DUP_REPLACE) ? 0 : MDB_NOOVERWRITE;
+    if (dict_lmdb->append_key != 0
+	&& dict_lmdb_key_after(dict_lmdb->append_key, &mdb_key))
+	put_flags |= MDB_APPEND;
+    status = slmdb_put(&dict_lmdb->slmdb, &mdb_key, &mdb_value, put_flags);
+    if (status == 0 && (put_flags & MDB_APPEND))
+	vstring_memcpy(dict_lmdb->append_key, mdb_key.mv_data,
+		       mdb_key.mv_size);
     if (status != 0) {
 	if (status == MDB_KEYEXIST) {
 	    if (dict->flags & DICT_FLAG_DUP_IGNORE)
@@ -477,6 +514,8 @@ static void dict_lmdb_close(DICT *dict)
 	vstring_free(dict_lmdb->key_buf);
     if (dict_lmdb->val_buf)
 	vstring_free(dict_lmdb->val_buf);
+    if (dict_lmdb->append_key)
+	vstring_free(dict_lmdb->append_key);
     if (dict->fold_buf)
 	vstring_free(dict->fold_buf);
     dict_free(dict);
@@ -488,6 +527,11 @@ static void dict_lmdb_longjmp(void *context, int val)
 {
     DICT_LMDB *dict_lmdb = (DICT_LMDB *) context;
 
+    /*
+     * The restarted bulk transaction starts with an empty database.
+     */
+    if (dict_lmdb->append_key)
+	VSTRING_RESET(dict_lmdb->append_key);
     dict_longjmp(&dict_lmdb->dict, val);
 }
 
@@ -656,6 +700,15 @@ DICT   *dict_lmdb_open(const char *path, int open_flags, int dict_flags)
     dict_lmdb->key_buf = 0;
     dict_lmdb->val_buf = 0;
 
+    /*
+     * MDB_APPEND is safe only if we know the largest key in the database.
+     * A truncated database in a bulk-mode transaction starts out empty.
+     */
+    if ((dict_flags & DICT_FLAG_BULK_UPDATE) && (open_flags & O_TRUNC))
+	dict_lmdb->append_key = vstring_alloc(100);
+    else
+	dict_lmdb->append_key = 0;
+
     /*
      * Warn if the source file is newer than the indexed file, except when
      * the source file changed only seconds ago.
@@ -323,6 +323,8 @@
 #include <dict_pipe.h>
 #include <dict_random.h>
 #include <dict_union.h>
+#include <dict_cachemap.h>
+#include <dict_cmap.h>
 #include <dict_inline.h>
 #include <stringops.h>
 #include <split_at.h>
@@ -369,6 +371,8 @@ static const DICT_OPEN_INFO dict_open_info[] = {
     DICT_TYPE_PIPE, dict_pipe_open,
     DICT_TYPE_RANDOM, dict_random_open,
     DICT_TYPE_UNION, dict_union_open,
+    DICT_TYPE_CACHEMAP, dict_cachemap_open,
+    DICT_TYPE_CMAP, dict_cmap_open,
     DICT_TYPE_INLINE, dict_inline_open,
 #ifndef USE_DYNAMIC_MAPS
 #ifdef HAS_PCRE
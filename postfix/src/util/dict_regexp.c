@@ -85,6 +85,17 @@ typedef struct {
     int     match;			/* positive or negative match */
 } DICT_REGEXP_PATTERN;
 
+ /*
+  * Literal text that a ^-anchored pattern requires at the start of the
+  * lookup string. Comparing this text first avoids regexec() calls that
+  * cannot succeed.
+  */
+typedef struct {
+    char   *text;			/* literal text, or null */
+    size_t  len;			/* literal text length */
+    int     icase;			/* case-insensitive comparison */
+} DICT_REGEXP_PREFIX;
+
  /*
   * Compiled generic rule, and subclasses that derive from it.
   */
@@ -102,6 +113,8 @@ typedef struct {
     int     second_match;		/* positive or negative match */
     char   *replacement;		/* replacement text */
     size_t  max_sub;			/* largest $number in replacement */
+    DICT_REGEXP_PREFIX first_prefix;	/* primary pattern literal prefix */
+    struct DICT_REGEXP_RULE *prefix_last;/* last rule with same prefix */
 } DICT_REGEXP_MATCH_RULE;
 
 typedef struct {
@@ -109,6 +122,7 @@ typedef struct {
     regex_t *expr;			/* the condition */
     int     match;			/* positive or negative match */
     struct DICT_REGEXP_RULE *endif_rule;/* matching endif rule */
+    DICT_REGEXP_PREFIX prefix;		/* condition literal prefix */
 } DICT_REGEXP_IF_RULE;
 
  /*
@@ -212,6 +226,11 @@ static void dict_regexp_regerror(const char *mapname, int lineno, int error,
       (err) == 0 ? (match) : \
       (dict_regexp_regerror((map), (line), (err), (expr)), 0)))
 
+#define DICT_REGEXP_PREFIX_MATCH(prefix, str) \
+    ((prefix)->text == 0 || ((prefix)->icase ? \
+	strncasecmp((str), (prefix)->text, (prefix)->len) : \
+	strncmp((str), (prefix)->text, (prefix)->len)) == 0)
+
 /* dict_regexp_lookup - match string and perform optional substitution */
 
 static const char *dict_regexp_lookup(DICT *dict, const char *lookup_string)
@@ -247,7 +266,19 @@ static const char *dict_regexp_lookup(DICT *dict, const char *lookup_string)
 	     */
 	case DICT_REGEXP_OP_MATCH:
 	    match_rule = (DICT_REGEXP_MATCH_RULE *) rule;
-	    if (!DICT_REGEXP_REGEXEC(error, dict->name, rule->lineno,
+
+	    /*
+	     * A literal prefix mismatch is a regexec() mismatch. With a
+	     * positive match, also skip the rules that require the same
+	     * prefix (or a longer one that starts with it).
+	     */
+	    if (!DICT_REGEXP_PREFIX_MATCH(&match_rule->first_prefix,
+					  lookup_string)) {
+		if (match_rule->first_match) {
+		    rule = match_rule->prefix_last;
+		    continue;
+		}
+	    } else if (!DICT_REGEXP_REGEXEC(error, dict->name, rule->lineno,
 				     match_rule->first_exp,
 				     match_rule->first_match,
 				     lookup_string,
@@ -297,9 +328,11 @@ static const char *dict_regexp_lookup(DICT *dict, const char *lookup_string)
 	     */
 	case DICT_REGEXP_OP_IF:
 	    if_rule = (DICT_REGEXP_IF_RULE *) rule;
-	    if (DICT_REGEXP_REGEXEC(error, dict->name, rule->lineno,
+	    if (DICT_REGEXP_PREFIX_MATCH(&if_rule->prefix, lookup_string) ?
+		DICT_REGEXP_REGEXEC(error, dict->name, rule->lineno,
 			       if_rule->expr, if_rule->match, lookup_string,
-				    NULL_SUBSTITUTIONS, NULL_MATCH_RESULT))
+				    NULL_SUBSTITUTIONS, NULL_MATCH_RESULT) :
+		!if_rule->match)
 		continue;
 	    /* An IF without matching ENDIF has no "endif" rule. */
 	    if ((rule = if_rule->endif_rule) == 0)
@@ -344,6 +377,8 @@ static void dict_regexp_close(DICT *dict)
 	    }
 	    if (match_rule->replacement)
 		myfree((void *) match_rule->replacement);
+	    if (match_rule->first_prefix.text)
+		myfree(match_rule->first_prefix.text);
 	    break;
 	case DICT_REGEXP_OP_IF:
 	    if_rule = (DICT_REGEXP_IF_RULE *) rule;
@@ -351,6 +386,8 @@ static void dict_regexp_close(DICT *dict)
 		regfree(if_rule->expr);
 		myfree((void *) if_rule->expr);
 	    }
+	    if (if_rule->prefix.text)
+		myfree(if_rule->prefix.text);
 	    break;
 	case DICT_REGEXP_OP_ENDIF:
 	    break;
@@ -530,6 +567,100 @@ static regex_t *dict_regexp_compile_pat(const char *mapname, int lineno,
     return (expr);
 }
 
+/* dict_regexp_get_prefix - find literal text that a pattern requires */
+
+static void dict_regexp_get_prefix(const DICT_REGEXP_PATTERN *pat,
+				           DICT_REGEXP_PREFIX *prefix)
+{
+    const char *cp;
+    const char *start;
+    size_t  len;
+    int     depth = 0;
+    int     delim;
+
+    prefix->text = 0;
+    prefix->len = 0;
+    prefix->icase = (pat->options & REG_ICASE) != 0;
+
+    /*
+     * Keep it simple. Look only at extended expressions that are anchored
+     * at the start of the lookup string, and not at the start of each line.
+     */
+    if ((pat->options & (REG_EXTENDED | REG_NEWLINE)) != REG_EXTENDED
+	|| pat->regexp[0] != '^')
+	return;
+
+    /*
+     * Give up when the pattern has top-level alternatives: the anchor and
+     * the literal text belong to the first alternative only. The pattern
+     * was accepted by regcomp(), so we need not worry about syntax errors.
+     */
+    for (cp = pat->regexp; *cp; cp++) {
+	if (*cp == '\\') {
+	    if (*++cp == 0)
+		return;
+	} else if (*cp == '[') {
+	    if (*++cp == '^')
+		cp++;
+	    if (*cp == ']')
+		cp++;
+	    for ( /* void */ ; *cp && *cp != ']'; cp++) {
+		if (*cp == '[' && cp[1] != 0 && strchr(":.=", cp[1]) != 0) {
+		    for (delim = cp[1], cp += 2; *cp; cp++)
+			if (cp[0] == delim && cp[1] == ']')
+			    break;
+		    if (*cp++ == 0)
+			return;
+		}
+	    }
+	    if (*cp == 0)
+		return;
+	} else if (*cp == '(') {
+	    depth++;
+	} else if (*cp == ')') {
+	    depth--;
+	} else if (*cp == '|' && depth <= 0) {
+	    return;
+	}
+    }
+
+    /*
+     * Collect the literal text after the anchor. Drop the last character
+     * when it may be repeated zero times.
+     */
+    for (start = cp = pat->regexp + 1; *cp; cp++)
+	if (!ISASCII(*cp) || !ISPRINT(*cp) || strchr(".[]()*+?{}|\\^$", *cp))
+	    break;
+    len = cp - start;
+    if (len > 0 && (*cp == '*' || *cp == '?' || *cp == '{'))
+	len--;
+    if (len > 0) {
+	prefix->text = mystrndup(start, len);
+	prefix->len = len;
+    }
+}
+
+/* dict_regexp_prefix_implied - prefix mismatch implies next mismatch */
+
+static int dict_regexp_prefix_implied(DICT_REGEXP_RULE *rule,
+				              DICT_REGEXP_RULE *next)
+{
+    DICT_REGEXP_PREFIX *p1;
+    DICT_REGEXP_PREFIX *p2;
+
+    if (rule->op != DICT_REGEXP_OP_MATCH || next->op != DICT_REGEXP_OP_MATCH
+	|| !((DICT_REGEXP_MATCH_RULE *) rule)->first_match
+	|| !((DICT_REGEXP_MATCH_RULE *) next)->first_match)
+	return (0);
+    p1 = &((DICT_REGEXP_MATCH_RULE *) rule)->first_prefix;
+    p2 = &((DICT_REGEXP_MATCH_RULE *) next)->first_prefix;
+    if (p1->text == 0 || p2->text == 0 || p1->icase != p2->icase
+	|| p1->len > p2->len)
+	return (0);
+    return ((p1->icase ? strncasecmp(p2->text, p1->text, p1->len) :
+	     strncmp(p2->text, p1->text, p1->len)) == 0);
+}
+
 /* dict_regexp_rule_alloc - fill in a generic rule structure */
 
 static DICT_REGEXP_RULE *dict_regexp_rule_alloc(int op, int lineno, size_t size)
@@ -658,6 +789,8 @@ static DICT_REGEXP_RULE *dict_regexp_parseline(const char *mapname, int lineno,
 	match_rule->max_sub = prescan_context.max_sub;
 	match_rule->second_exp = second_exp;
 	match_rule->second_match = second_pat.match;
+	dict_regexp_get_prefix(&first_pat, &match_rule->first_prefix);
+	match_rule->prefix_last = (DICT_REGEXP_RULE *) match_rule;
 	if (prescan_context.literal)
 	    match_rule->replacement = prescan_context.literal;
 	else
@@ -694,6 +827,7 @@ static DICT_REGEXP_RULE *dict_regexp_parseline(const char *mapname, int lineno,
 	if_rule->expr = expr;
 	if_rule->match = pattern.match;
 	if_rule->endif_rule = 0;
+	dict_regexp_get_prefix(&pattern, &if_rule->prefix);
 	return ((DICT_REGEXP_RULE *) if_rule);
     }
 
@@ -844,6 +978,20 @@ DICT   *dict_regexp_open(const char *mapname, int open_flags, int dict_flags)
     if (rule_stack)
 	(void) mvect_free(&mvect);
 
+    /*
+     * Link each rule in a run of positive matches to the last rule in that
+     * run, when a literal prefix mismatch for one rule implies a mismatch
+     * for the next. A lookup that fails the first prefix skips the run.
+     */
+    for (rule = dict_regexp->head; rule; rule = last_rule->next) {
+	for (last_rule = rule; last_rule->next != 0
+	     && dict_regexp_prefix_implied(last_rule, last_rule->next);
+	     last_rule = last_rule->next)
+	     /* void */ ;
+	for ( /* void */ ; rule != last_rule; rule = rule->next)
+	    ((DICT_REGEXP_MATCH_RULE *) rule)->prefix_last = last_rule;
+    }
+
     /*
      * Allocate space for only as many matched substrings as used in the
      * replacement text.
@@ -21,6 +21,11 @@
 /*	or unix:pathname:socketmap-name, where socketmap-name
 /*	specifies the socketmap name that the socketmap server uses.
 /*
+/*	The lookup_async method sends requests and receives replies
+/*	under control by the events(3) manager, with one connection
+/*	per request in progress. It is an error to close a socketmap
+/*	while event-driven lookups are in progress.
+/*
 /*	To test this module, build the netstring and dict_open test
 /*	programs. Run "./netstring nc -l portnumber" as the server,
 /*	and "./dict_open socketmap:127.0.0.1:portnumber:socketmapname"
@@ -59,6 +64,7 @@
 /*	because neither the connection nor the server are authenticated.
 /* SEE ALSO
 /*	dict(3) generic dictionary manager
+/*	dict_async(3) event-driven dictionary lookup
 /*	netstring(3) netstring stream I/O support
 /* DIAGNOSTICS
 /*	Fatal errors: out of memory, unknown host or service name,
@@ -91,6 +97,7 @@
 #include <msg.h>
 #include <vstream.h>
 #include <auto_clnt.h>
+#include <event_clnt.h>
 #include <netstring.h>
 #include <split_at.h>
 #include <stringops.h>
@@ -105,6 +112,7 @@ typedef struct {
     char   *sockmap_name;		/* on-the-wire socketmap name */
     VSTRING *rdwr_buf;			/* read/write buffer */
     HTABLE_INFO *client_info;		/* shared endpoint name and handle */
+    int     async_pending;		/* event-driven lookups */
 } DICT_SOCKMAP;
 
  /*
@@ -132,15 +140,27 @@ static HTABLE *dict_sockmap_handles;	/* shared handles */
 
 typedef struct {
     AUTO_CLNT *client_handle;		/* the client handle */
+    EVENT_CLNT *event_handle;		/* event-driven client, or null */
     int     refcount;			/* the reference count */
 } DICT_SOCKMAP_REFC_HANDLE;
 
 #define DICT_SOCKMAP_RH_NAME(ht)	(ht)->key
 #define DICT_SOCKMAP_RH_HANDLE(ht) \
 	((DICT_SOCKMAP_REFC_HANDLE *) (ht)->value)->client_handle
+#define DICT_SOCKMAP_RH_EVENT_HANDLE(ht) \
+	((DICT_SOCKMAP_REFC_HANDLE *) (ht)->value)->event_handle
 #define DICT_SOCKMAP_RH_REFCOUNT(ht) \
 	((DICT_SOCKMAP_REFC_HANDLE *) (ht)->value)->refcount
 
+ /*
+  * Event-driven lookup state.
+  */
+typedef struct {
+    DICT_SOCKMAP *dp;			/* the socketmap */
+    DICT_ASYNC_FN callback;		/* application call-back */
+    void   *context;			/* application context */
+} DICT_SOCKMAP_ASYNC;
+
  /*
   * Socketmap protocol elements.
   */
@@ -156,6 +176,45 @@ typedef struct {
 #define STR(x)	vstring_str(x)
 #define LEN(x)	VSTRING_LEN(x)
 
+/* dict_sockmap_reply - parse reply, update dict->error */
+
+static const char *dict_sockmap_reply(DICT *dict, char *reply)
+{
+    char   *reply_payload;
+    const char *error_class;
+
+    reply_payload = split_at(reply, ' ');
+    if (strcmp(reply, DICT_SOCKMAP_PROT_OK) == 0) {
+	dict->error = 0;
+	return (reply_payload);
+    } else if (strcmp(reply, DICT_SOCKMAP_PROT_NOTFOUND) == 0) {
+	dict->error = 0;
+	return (0);
+    }
+    /* We got no definitive reply. */
+    if (strcmp(reply, DICT_SOCKMAP_PROT_TEMP) == 0) {
+	error_class = "temporary";
+	dict->error = DICT_ERR_RETRY;
+    } else if (strcmp(reply, DICT_SOCKMAP_PROT_TIMEOUT) == 0) {
+	error_class = "timeout";
+	dict->error = DICT_ERR_RETRY;
+    } else if (strcmp(reply, DICT_SOCKMAP_PROT_PERM) == 0) {
+	error_class = "permanent";
+	dict->error = DICT_ERR_CONFIG;
+    } else {
+	error_class = "unknown";
+	dict->error = DICT_ERR_RETRY;
+    }
+    while (reply_payload && ISSPACE(*reply_payload))
+	reply_payload++;
+    msg_warn("%s:%s socketmap server %s error%s%.200s",
+	     dict->type, dict->name, error_class,
+	     reply_payload && *reply_payload ? ": " : "",
+	     reply_payload && *reply_payload ?
+	     printable(reply_payload, '?') : "");
+    return (0);
+}
+
 /* dict_sockmap_lookup - socket map lookup */
 
 static const char *dict_sockmap_lookup(DICT *dict, const char *key)
@@ -165,9 +224,7 @@ static const char *dict_sockmap_lookup(DICT *dict, const char *key)
     AUTO_CLNT *sockmap_clnt = DICT_SOCKMAP_RH_HANDLE(dp->client_info);
     VSTREAM *fp;
     int     netstring_err;
-    char   *reply_payload;
     int     except_count;
-    const char *error_class;
 
     if (msg_verbose)
 	msg_info("%s: key %s", myname, key);
@@ -251,36 +308,111 @@ static const char *dict_sockmap_lookup(DICT *dict, const char *key)
      * Parse the reply.
      */
     VSTRING_TERMINATE(dp->rdwr_buf);
-    reply_payload = split_at(STR(dp->rdwr_buf), ' ');
-    if (strcmp(STR(dp->rdwr_buf), DICT_SOCKMAP_PROT_OK) == 0) {
-	dict->error = 0;
-	return (reply_payload);
-    } else if (strcmp(STR(dp->rdwr_buf), DICT_SOCKMAP_PROT_NOTFOUND) == 0) {
-	dict->error = 0;
+    return (dict_sockmap_reply(dict, STR(dp->rdwr_buf)));
+}
+
+/* dict_sockmap_parse - parse netstring reply from event-driven client */
+
+static ssize_t dict_sockmap_parse(const char *buf, ssize_t len, VSTRING *reply)
+{
+    const char *cp;
+    ssize_t count = 0;
+    ssize_t need;
+
+    for (cp = buf; cp < buf + len && ISDIGIT(*cp); cp++) {
+	count = count * 10 + *cp - '0';
+	if (count > dict_sockmap_max_reply) {
+	    vstring_strcpy(reply, netstring_strerror(NETSTRING_ERR_SIZE));
+	    return (-1);
+	}
+    }
+    if (cp >= buf + len)
 	return (0);
+    if (cp == buf || *cp != ':') {
+	vstring_strcpy(reply, netstring_strerror(NETSTRING_ERR_FORMAT));
+	return (-1);
     }
-    /* We got no definitive reply. */
-    if (strcmp(STR(dp->rdwr_buf), DICT_SOCKMAP_PROT_TEMP) == 0) {
-	error_class = "temporary";
-	dict->error = DICT_ERR_RETRY;
-    } else if (strcmp(STR(dp->rdwr_buf), DICT_SOCKMAP_PROT_TIMEOUT) == 0) {
-	error_class = "timeout";
+    cp += 1;
+    need = (cp - buf) + count + 1;
+    if (len < need)
+	return (0);
+    if (buf[need - 1] != ',') {
+	vstring_strcpy(reply, netstring_strerror(NETSTRING_ERR_FORMAT));
+	return (-1);
+    }
+    vstring_memcpy(reply, cp, count);
+    VSTRING_TERMINATE(reply);
+    return (need);
+}
+
+/* dict_sockmap_async_done - finish event-driven lookup */
+
+static void dict_sockmap_async_done(int status, VSTRING *reply, void *context)
+{
+    DICT_SOCKMAP_ASYNC *sa = (DICT_SOCKMAP_ASYNC *) context;
+    DICT   *dict = &sa->dp->dict;
+    const char *value;
+
+    sa->dp->async_pending -= 1;
+    if (status != EVENT_CLNT_STAT_OK) {
+	msg_warn("table %s:%s lookup error: %s",
+		 dict->type, dict->name, STR(reply));
 	dict->error = DICT_ERR_RETRY;
-    } else if (strcmp(STR(dp->rdwr_buf), DICT_SOCKMAP_PROT_PERM) == 0) {
-	error_class = "permanent";
-	dict->error = DICT_ERR_CONFIG;
+	value = 0;
     } else {
-	error_class = "unknown";
-	dict->error = DICT_ERR_RETRY;
+	value = dict_sockmap_reply(dict, STR(reply));
     }
-    while (reply_payload && ISSPACE(*reply_payload))
-	reply_payload++;
-    msg_warn("%s:%s socketmap server %s error%s%.200s",
-	     dict->type, dict->name, error_class,
-	     reply_payload && *reply_payload ? ": " : "",
-	     reply_payload && *reply_payload ?
-	     printable(reply_payload, '?') : "");
-    return (0);
+    sa->callback(dict->error, value, sa->context);
+    myfree((void *) sa);
+}
+
+/* dict_sockmap_lookup_async - event-driven socket map lookup */
+
+static void dict_sockmap_lookup_async(DICT *dict, const char *key,
+				              DICT_ASYNC_FN callback,
+				              void *context)
+{
+    const char *myname = "dict_sockmap_lookup_async";
+    DICT_SOCKMAP *dp = (DICT_SOCKMAP *) dict;
+    DICT_SOCKMAP_ASYNC *sa;
+
+    if (msg_verbose)
+	msg_info("%s: key %s", myname, key);
+
+    /*
+     * Optionally fold the key.
+     */
+    if (dict->flags & DICT_FLAG_FOLD_MUL) {
+	if (dict->fold_buf == 0)
+	    dict->fold_buf = vstring_alloc(100);
+	vstring_strcpy(dict->fold_buf, key);
+	key = lowercase(STR(dict->fold_buf));
+    }
+
+    /*
+     * Create the event-driven client handle on the fly, so that programs
+     * that make only blocking lookups do not pay for it.
+     */
+    if (DICT_SOCKMAP_RH_EVENT_HANDLE(dp->client_info) == 0)
+	DICT_SOCKMAP_RH_EVENT_HANDLE(dp->client_info) =
+	    event_clnt_create(DICT_SOCKMAP_RH_NAME(dp->client_info),
+			      dict_sockmap_timeout, dict_sockmap_max_idle,
+			      dict_sockmap_max_ttl);
+
+    /*
+     * Send the query as one netstring. The event client copies the request.
+     */
+    vstring_sprintf(dp->rdwr_buf, "%ld:%s %s,",
+		    (long) (strlen(dp->sockmap_name) + 1 + strlen(key)),
+		    dp->sockmap_name, key);
+    sa = (DICT_SOCKMAP_ASYNC *) mymalloc(sizeof(*sa));
+    sa->dp = dp;
+    sa->callback = callback;
+    sa->context = context;
+    dp->async_pending += 1;
+    event_clnt_request(DICT_SOCKMAP_RH_EVENT_HANDLE(dp->client_info),
+		       dp->rdwr_buf, dict_sockmap_parse,
+		       dict_sockmap_async_done, (void *) sa);
 }
 
 /* dict_sockmap_close - close socket map */
@@ -292,10 +424,15 @@ static void dict_sockmap_close(DICT *dict)
 
     if (dict_sockmap_handles == 0 || dict_sockmap_handles->used == 0)
 	msg_panic("%s: attempt to close a non-existent map", myname);
+    if (dp->async_pending > 0)
+	msg_panic("%s: %s:%s has %d lookups in progress",
+		  myname, dict->type, dict->name, dp->async_pending);
     vstring_free(dp->rdwr_buf);
     myfree(dp->sockmap_name);
     if (--DICT_SOCKMAP_RH_REFCOUNT(dp->client_info) == 0) {
 	auto_clnt_free(DICT_SOCKMAP_RH_HANDLE(dp->client_info));
+	if (DICT_SOCKMAP_RH_EVENT_HANDLE(dp->client_info))
+	    event_clnt_free(DICT_SOCKMAP_RH_EVENT_HANDLE(dp->client_info));
 	htable_delete(dict_sockmap_handles,
 		      DICT_SOCKMAP_RH_NAME(dp->client_info), myfree);
     }
@@ -365,6 +502,7 @@ DICT   *dict_sockmap_open(const char *mapname, int open_flags, int dict_flags)
 	DICT_SOCKMAP_RH_HANDLE(client_info) =
 	    auto_clnt_create(saved_name, dict_sockmap_timeout,
 			     dict_sockmap_max_idle, dict_sockmap_max_ttl);
+	DICT_SOCKMAP_RH_EVENT_HANDLE(client_info) = 0;
     } else
 	DICT_SOCKMAP_RH_REFCOUNT(client_info) += 1;
 
@@ -375,7 +513,9 @@ DICT   *dict_sockmap_open(const char *mapname, int open_flags, int dict_flags)
     dp->rdwr_buf = vstring_alloc(100);
     dp->sockmap_name = mystrdup(sockmap);
     dp->client_info = client_info;
+    dp->async_pending = 0;
     dp->dict.lookup = dict_sockmap_lookup;
+    dp->dict.lookup_async = dict_sockmap_lookup_async;
     dp->dict.close = dict_sockmap_close;
     /* Don't look up parent domains or network superblocks. */
     dp->dict.flags = dict_flags | DICT_FLAG_PATTERN;
@@ -18,6 +18,13 @@
 /*
 /*	Map names have the form host:port.
 /*
+/*	The lookup_async method sends requests and receives replies
+/*	under control by the events(3) manager, with one connection
+/*	per request in progress. Unlike the blocking lookup method,
+/*	it does not sleep and retry when the server is unavailable.
+/*	It is an error to close a map while event-driven lookups
+/*	are in progress.
+/*
 /*	The TCP map class implements a very simple protocol: the client
 /*	sends a request, and the server sends one reply. Requests and
 /*	replies are sent as one line of ASCII text, terminated by the
@@ -59,6 +66,7 @@
 /*	because neither the connection nor the server are authenticated.
 /* SEE ALSO
 /*	dict(3) generic dictionary manager
+/*	dict_async(3) event-driven dictionary lookup
 /*	hex_quote(3) http-style quoting
 /* DIAGNOSTICS
 /*	Fatal errors: out of memory, unknown host or service name,
@@ -95,6 +103,7 @@
 #include <hex_quote.h>
 #include <dict.h>
 #include <stringops.h>
+#include <event_clnt.h>
 #include <dict_tcp.h>
 
 /* Application-specific. */
@@ -104,11 +113,24 @@ typedef struct {
     VSTRING *raw_buf;			/* raw I/O buffer */
     VSTRING *hex_buf;			/* quoted I/O buffer */
     VSTREAM *fp;			/* I/O stream */
+    EVENT_CLNT *event_clnt;		/* event-driven client, or null */
+    int     async_pending;		/* event-driven lookups */
 } DICT_TCP;
 
+ /*
+  * Event-driven lookup state.
+  */
+typedef struct {
+    DICT_TCP *dict_tcp;			/* the map */
+    DICT_ASYNC_FN callback;		/* application call-back */
+    void   *context;			/* application context */
+} DICT_TCP_ASYNC;
+
 #define DICT_TCP_MAXTRY	10		/* attempts before giving up */
 #define DICT_TCP_TMOUT	100		/* connect/read/write timeout */
 #define DICT_TCP_MAXLEN	4096		/* server reply size limit */
+#define DICT_TCP_MAXIDLE 10		/* close idle async socket */
+#define DICT_TCP_MAXTTL	100		/* close old async socket */
 
 #define STR(x)		vstring_str(x)
 
@@ -263,14 +285,150 @@ static const char *dict_tcp_lookup(DICT *dict, const char *key)
     }
 }
 
+/* dict_tcp_parse - parse reply line from event-driven client */
+
+static ssize_t dict_tcp_parse(const char *buf, ssize_t len, VSTRING *reply)
+{
+    const char *myname = "dict_tcp_parse";
+    static VSTRING *line;
+    static VSTRING *raw;
+    const char *nl;
+    char   *start;
+
+    /*
+     * Wait for the complete reply line.
+     */
+    if ((nl = memchr(buf, '\n', len)) == 0) {
+	if (len < DICT_TCP_MAXLEN)
+	    return (0);
+	vstring_sprintf(reply, "text longer than %d", DICT_TCP_MAXLEN);
+	return (-1);
+    }
+    if (line == 0) {
+	line = vstring_alloc(100);
+	raw = vstring_alloc(100);
+    }
+    vstring_strncpy(line, buf, nl - buf);
+    if (msg_verbose)
+	msg_info("%s: recv: %s", myname, STR(line));
+
+    /*
+     * Check the general reply syntax and the reply status code. Any reply
+     * other than found or not found is reported as an error, so that the
+     * event client closes the connection as with blocking lookups. The
+     * result is the status digit followed by the decoded text.
+     */
+    if (start = STR(line),
+	!ISDIGIT(start[0]) || !ISDIGIT(start[1])
+	|| !ISDIGIT(start[2]) || !ISSPACE(start[3])
+	|| !hex_unquote(raw, start + 4)) {
+	vstring_sprintf(reply, "malformed reply: %.100s",
+			printable(STR(line), '_'));
+	return (-1);
+    }
+    switch (start[0]) {
+    default:
+	vstring_sprintf(reply, "bad status code: %.100s",
+			printable(STR(line), '_'));
+	return (-1);
+    case '4':
+	vstring_sprintf(reply, "soft error: %.100s",
+			printable(STR(line), '_'));
+	return (-1);
+    case '5':
+    case '2':
+	vstring_sprintf(reply, "%c%s", start[0], STR(raw));
+	return (nl - buf + 1);
+    }
+}
+
+/* dict_tcp_async_done - finish event-driven lookup */
+
+static void dict_tcp_async_done(int status, VSTRING *reply, void *context)
+{
+    DICT_TCP_ASYNC *ta = (DICT_TCP_ASYNC *) context;
+    DICT   *dict = &ta->dict_tcp->dict;
+    const char *value;
+
+    ta->dict_tcp->async_pending -= 1;
+    if (status != EVENT_CLNT_STAT_OK) {
+	msg_warn("read TCP map reply from %s: %s", dict->name, STR(reply));
+	dict->error = DICT_ERR_RETRY;
+	value = 0;
+    } else {
+	dict->error = DICT_ERR_NONE;
+	value = (STR(reply)[0] == '2' ? STR(reply) + 1 : 0);
+    }
+    ta->callback(dict->error, value, ta->context);
+    myfree((void *) ta);
+}
+
+/* dict_tcp_lookup_async - event-driven TCP server request */
+
+static void dict_tcp_lookup_async(DICT *dict, const char *key,
+				          DICT_ASYNC_FN callback,
+				          void *context)
+{
+    DICT_TCP *dict_tcp = (DICT_TCP *) dict;
+    const char *myname = "dict_tcp_lookup_async";
+    DICT_TCP_ASYNC *ta;
+
+    if (msg_verbose)
+	msg_info("%s: key %s", myname, key);
+
+    /*
+     * Optionally fold the key.
+     */
+    if (dict->flags & DICT_FLAG_FOLD_MUL) {
+	if (dict->fold_buf == 0)
+	    dict->fold_buf = vstring_alloc(10);
+	vstring_strcpy(dict->fold_buf, key);
+	key = lowercase(vstring_str(dict->fold_buf));
+    }
+
+    /*
+     * Allocate per-map I/O buffers and the event-driven client on the fly.
+     */
+    if (dict_tcp->raw_buf == 0) {
+	dict_tcp->raw_buf = vstring_alloc(10);
+	dict_tcp->hex_buf = vstring_alloc(10);
+    }
+    if (dict_tcp->event_clnt == 0) {
+	vstring_sprintf(dict_tcp->hex_buf, "inet:%s", dict->name);
+	dict_tcp->event_clnt =
+	    event_clnt_create(STR(dict_tcp->hex_buf), DICT_TCP_TMOUT,
+			      DICT_TCP_MAXIDLE, DICT_TCP_MAXTTL);
+    }
+
+    /*
+     * Send the request. The event client copies the request.
+     */
+    hex_quote(dict_tcp->hex_buf, key);
+    vstring_sprintf(dict_tcp->raw_buf, "get %s\n", STR(dict_tcp->hex_buf));
+    if (msg_verbose)
+	msg_info("%s: send: get %s", myname, STR(dict_tcp->hex_buf));
+    ta = (DICT_TCP_ASYNC *) mymalloc(sizeof(*ta));
+    ta->dict_tcp = dict_tcp;
+    ta->callback = callback;
+    ta->context = context;
+    dict_tcp->async_pending += 1;
+    event_clnt_request(dict_tcp->event_clnt, dict_tcp->raw_buf,
+		       dict_tcp_parse, dict_tcp_async_done, (void *) ta);
+}
+
 /* dict_tcp_close - close TCP map */
 
 static void dict_tcp_close(DICT *dict)
 {
     DICT_TCP *dict_tcp = (DICT_TCP *) dict;
 
+    if (dict_tcp->async_pending > 0)
+	msg_panic("dict_tcp_close: %s:%s has %d lookups in progress",
+		  dict->type, dict->name, dict_tcp->async_pending);
     if (dict_tcp->fp)
 	(void) vstream_fclose(dict_tcp->fp);
+    if (dict_tcp->event_clnt)
+	event_clnt_free(dict_tcp->event_clnt);
     if (dict_tcp->raw_buf)
 	vstring_free(dict_tcp->raw_buf);
     if (dict_tcp->hex_buf)
@@ -305,7 +463,10 @@ DICT   *dict_tcp_open(const char *map, int open_flags, int dict_flags)
     dict_tcp = (DICT_TCP *) dict_alloc(DICT_TYPE_TCP, map, sizeof(*dict_tcp));
     dict_tcp->fp = 0;
     dict_tcp->raw_buf = dict_tcp->hex_buf = 0;
+    dict_tcp->event_clnt = 0;
+    dict_tcp->async_pending = 0;
     dict_tcp->dict.lookup = dict_tcp_lookup;
+    dict_tcp->dict.lookup_async = dict_tcp_lookup_async;
     dict_tcp->dict.close = dict_tcp_close;
     dict_tcp->dict.flags = dict_flags | DICT_FLAG_PATTERN;
     if (dict_flags & DICT_FLAG_FOLD_MUL)
@@ -10,7 +10,8 @@
 /*	DICT	*dict)
 /* DESCRIPTION
 /*	dict_utf8_activate() wraps a dictionary's lookup/update/delete
-/*	methods with code that enforces UTF-8 checks on keys and
+/*	methods, and the optional lookup_first and lookup_async
+/*	methods, with code that enforces UTF-8 checks on keys and
 /*	values, and that logs a warning when incorrect UTF-8 is
 /*	encountered. The original dictionary handle becomes invalid.
 /*
@@ -54,6 +55,7 @@
 #include <dict.h>
 #include <mymalloc.h>
 #include <msg.h>
+#include <argv.h>
 
  /*
   * The goal is to maximize robustness: bad UTF-8 should not appear in keys,
@@ -173,6 +175,135 @@ static const char *dict_utf8_lookup(DICT *dict, const char *key)
     }
 }
 
+/* dict_utf8_lookup_first - UTF-8 multi-key lookup method wrapper */
+
+static const char *dict_utf8_lookup_first(DICT *dict, const char **keys,
+					          int count, int *index)
+{
+    static ARGV *fold_keys;
+    DICT_UTF8_BACKUP *backup;
+    const char *utf8_err;
+    const char *fold_res;
+    const char *value;
+    int     saved_flags;
+    int     n;
+
+    /*
+     * Validate and optionally fold all keys. If a key is invalid, fall back
+     * to one lookup per key, so that the invalid key is skipped without
+     * changing the meaning of the result index.
+     */
+    if (fold_keys == 0)
+	fold_keys = argv_alloc(count);
+    else
+	argv_truncate(fold_keys, 0);
+    for (n = 0; n < count; n++) {
+	if ((fold_res = dict_utf8_check_fold(dict, keys[n],
+					     (CONST_CHAR_STAR *) 0)) == 0) {
+	    for (n = 0; n < count; n++) {
+		if ((value = dict_utf8_lookup(dict, keys[n])) != 0
+		    || dict->error != 0) {
+		    *index = n;
+		    return (value);
+		}
+	    }
+	    *index = count;
+	    return (0);
+	}
+	argv_add(fold_keys, fold_res, (char *) 0);
+    }
+
+    /*
+     * Proxy the request with casefolding turned off.
+     */
+    saved_flags = (dict->flags & DICT_FLAG_FOLD_ANY);
+    dict->flags &= ~DICT_FLAG_FOLD_ANY;
+    backup = dict->utf8_backup;
+    value = backup->lookup_first(dict, (const char **) fold_keys->argv,
+				 count, index);
+    dict->flags |= saved_flags;
+
+    /*
+     * Validate the result, and if invalid fail the request.
+     */
+    if (value != 0 && dict_utf8_check(value, &utf8_err) == 0) {
+	msg_warn("%s:%s: key \"%s\": non-UTF-8 value \"%s\": %s",
+		 dict->type, dict->name, keys[*index], value, utf8_err);
+	dict->error = DICT_ERR_CONFIG;
+	return (0);
+    } else {
+	return (value);
+    }
+}
+
+typedef struct {
+    DICT   *dict;			/* the dictionary */
+    char   *key;			/* for diagnostics */
+    DICT_ASYNC_FN callback;		/* application call-back */
+    void   *context;			/* application context */
+} DICT_UTF8_ASYNC;
+
+/* dict_utf8_async_done - validate UTF-8 result from event-driven lookup */
+
+static void dict_utf8_async_done(int error, const char *value, void *context)
+{
+    DICT_UTF8_ASYNC *ua = (DICT_UTF8_ASYNC *) context;
+    DICT   *dict = ua->dict;
+    const char *utf8_err;
+
+    /*
+     * Validate the result, and if invalid fail the request.
+     */
+    if (value != 0 && dict_utf8_check(value, &utf8_err) == 0) {
+	msg_warn("%s:%s: key \"%s\": non-UTF-8 value \"%s\": %s",
+		 dict->type, dict->name, ua->key, value, utf8_err);
+	dict->error = error = DICT_ERR_CONFIG;
+	value = 0;
+    }
+    ua->callback(error, value, ua->context);
+    myfree(ua->key);
+    myfree((void *) ua);
+}
+
+/* dict_utf8_lookup_async - UTF-8 event-driven lookup method wrapper */
+
+static void dict_utf8_lookup_async(DICT *dict, const char *key,
+				           DICT_ASYNC_FN callback,
+				           void *context)
+{
+    DICT_UTF8_BACKUP *backup;
+    DICT_UTF8_ASYNC *ua;
+    const char *utf8_err;
+    const char *fold_res;
+    int     saved_flags;
+
+    /*
+     * Validate and optionally fold the key, and if invalid skip the request.
+     */
+    if ((fold_res = dict_utf8_check_fold(dict, key, &utf8_err)) == 0) {
+	msg_warn("%s:%s: non-UTF-8 key \"%s\": %s",
+		 dict->type, dict->name, key, utf8_err);
+	dict->error = DICT_ERR_NONE;
+	dict_async_deliver(callback, context, DICT_ERR_NONE, (char *) 0);
+	return;
+    }
+
+    /*
+     * Proxy the request with casefolding turned off. The backup method
+     * copies the key before it returns.
+     */
+    ua = (DICT_UTF8_ASYNC *) mymalloc(sizeof(*ua));
+    ua->dict = dict;
+    ua->key = mystrdup(key);
+    ua->callback = callback;
+    ua->context = context;
+    saved_flags = (dict->flags & DICT_FLAG_FOLD_ANY);
+    dict->flags &= ~DICT_FLAG_FOLD_ANY;
+    backup = dict->utf8_backup;
+    backup->lookup_async(dict, fold_res, dict_utf8_async_done, (void *) ua);
+    dict->flags |= saved_flags;
+}
+
 /* dict_utf8_update - UTF-8 update method wrapper */
 
 static int dict_utf8_update(DICT *dict, const char *key, const char *value)
@@ -284,10 +415,16 @@ DICT   *dict_utf8_activate(DICT *dict)
      * decision not to tinker with the iterator or destructor.
      */
     backup->lookup = dict->lookup;
+    backup->lookup_first = dict->lookup_first;
+    backup->lookup_async = dict->lookup_async;
     backup->update = dict->update;
     backup->delete = dict->delete;
 
     dict->lookup = dict_utf8_lookup;
+    if (dict->lookup_first != 0)
+	dict->lookup_first = dict_utf8_lookup_first;
+    if (dict->lookup_async != 0)
+	dict->lookup_async = dict_utf8_lookup_async;
     dict->update = dict_utf8_update;
     dict->delete = dict_utf8_delete;
 
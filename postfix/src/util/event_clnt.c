@@ -0,0 +1,452 @@
+/*++
+/* NAME
+/*	event_clnt 3
+/* SUMMARY
+/*	event-driven request/reply client endpoint
+/* SYNOPSIS
+/*	#include <event_clnt.h>
+/*
+/*	EVENT_CLNT *event_clnt_create(service, timeout, max_idle, max_ttl)
+/*	const char *service;
+/*	int	timeout;
+/*	int	max_idle;
+/*	int	max_ttl;
+/*
+/*	void	event_clnt_request(client, request, parse, done, context)
+/*	EVENT_CLNT *client;
+/*	VSTRING	*request;
+/*	ssize_t	(*parse)(const char *buf, ssize_t len, VSTRING *reply);
+/*	void	(*done)(int status, VSTRING *reply, void *context);
+/*	void	*context;
+/*
+/*	void	event_clnt_free(client)
+/*	EVENT_CLNT *client;
+/* DESCRIPTION
+/*	This module sends requests to a server and receives replies
+/*	without blocking the caller. It is the event-driven counterpart
+/*	of auto_clnt(3): all network I/O, including the connection
+/*	setup, runs under control by the events(3) manager, so that
+/*	a single-process server such as postscreen(8) can continue
+/*	to serve other clients while a request is in progress.
+/*
+/*	Each request in progress has its own connection; the server
+/*	is expected to handle one request and reply at a time per
+/*	connection. After a complete reply, the connection is kept
+/*	for reuse until it has been idle for \fImax_idle\fR seconds,
+/*	or until the server disconnects. A request that finds a
+/*	cached connection broken before any reply was received is
+/*	retried once with a new connection, to make server restarts
+/*	transparent.
+/*
+/*	event_clnt_create() instantiates a client endpoint.
+/*
+/*	event_clnt_request() copies the request and sends it to the
+/*	server. The \fIparse\fR function is called with all reply
+/*	data received so far. It returns zero when more data is
+/*	needed, or the length of a complete reply after storing the
+/*	decoded reply in its VSTRING argument, or -1 after storing
+/*	error text in its VSTRING argument. When the request completes
+/*	or fails, the \fIdone\fR function is called with status
+/*	EVENT_CLNT_STAT_OK and the decoded reply, or with status
+/*	EVENT_CLNT_STAT_FAIL and a description of the problem. The
+/*	reply storage is overwritten after the \fIdone\fR function
+/*	returns. The \fIdone\fR function is never called before
+/*	event_clnt_request() returns.
+/*
+/*	event_clnt_free() closes all connections and destroys the
+/*	client endpoint. Requests that are still in progress are
+/*	cancelled without notification.
+/*
+/*	Arguments:
+/* .IP service
+/*	The service argument specifies "transport:servername" where
+/*	transport is currently limited to one of the following:
+/* .RS
+/* .IP inet
+/*	servername has the form "inet:host:port".
+/* .IP local
+/*	servername has the form "local:private/servicename" or
+/*	"local:public/servicename". This is the preferred way to
+/*	specify Postfix daemons that are configured as "unix" in
+/*	master.cf.
+/* .IP unix
+/*	servername has the form "unix:private/servicename" or
+/*	"unix:public/servicename". This does not work on Solaris,
+/*	where Postfix uses STREAMS instead of UNIX-domain sockets.
+/* .RE
+/* .IP timeout
+/*	The time limit for connecting to, sending to, or receiving
+/*	from a server. Specify a value > 0.
+/* .IP max_idle
+/*	Idle time after which a cached connection is closed. Specify
+/*	0 to disable connection reuse.
+/* .IP max_ttl
+/*	Upper bound on the time that a connection is allowed to persist.
+/* DIAGNOSTICS
+/*	Warnings: none. Fatal: out of memory, invalid service name.
+/*	Panic: invalid timeout.
+/* BUGS
+/*	Host name lookup for the inet transport is not event-driven.
+/*	Specify a numerical address when that matters.
+/* SEE ALSO
+/*	auto_clnt(3) blocking client endpoint maintenance
+/*	nbbio(3) non-blocking buffered I/O
+/*	events(3) event manager
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <stddef.h>			/* offsetof() */
+#include <string.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <vstring.h>
+#include <events.h>
+#include <iostuff.h>
+#include <connect.h>
+#include <split_at.h>
+#include <nbbio.h>
+#include <ring.h>
+#include <event_clnt.h>
+
+/* Application-specific. */
+
+ /*
+  * A client endpoint has idle connections and busy connections, and
+  * requests that failed before they were given a connection.
+  */
+struct EVENT_CLNT {
+    char   *endpoint;			/* host:port or pathname */
+    int     timeout;			/* connect/read/write timeout */
+    int     max_idle;			/* time before client disconnect */
+    int     max_ttl;			/* time before client disconnect */
+    int     (*connect) (const char *, int, int);	/* unix, local, inet */
+    RING    idle;			/* connections waiting for work */
+    RING    busy;			/* connections with request */
+    RING    failed;			/* notification pending */
+};
+
+typedef struct EVENT_CLNT_REQ {
+    RING    ring;			/* failed request list */
+    VSTRING *request;			/* request copy */
+    ssize_t sent;			/* request bytes written */
+    VSTRING *inbuf;			/* reply bytes received */
+    VSTRING *reply;			/* decoded reply or error text */
+    EVENT_CLNT_PARSE_FN parse;		/* reply parser */
+    EVENT_CLNT_DONE_FN done;		/* completion call-back */
+    void   *context;			/* call-back context */
+    int     reused;			/* cached connection */
+    int     retried;			/* after broken cached connection */
+} EVENT_CLNT_REQ;
+
+typedef struct EVENT_CLNT_CONN {
+    RING    ring;			/* idle or busy list */
+    EVENT_CLNT *client;			/* parent */
+    NBBIO  *np;				/* buffered socket */
+    time_t  expire;			/* end of time to live */
+    EVENT_CLNT_REQ *req;		/* null if idle */
+} EVENT_CLNT_CONN;
+
+#define EVENT_CLNT_BUFSIZE	4096
+
+#define STR(x)	vstring_str(x)
+#define LEN(x)	VSTRING_LEN(x)
+
+static void event_clnt_start(EVENT_CLNT *, EVENT_CLNT_REQ *);
+
+/* event_clnt_req_free - destroy request */
+
+static void event_clnt_req_free(EVENT_CLNT_REQ *req)
+{
+    vstring_free(req->request);
+    vstring_free(req->inbuf);
+    vstring_free(req->reply);
+    myfree((void *) req);
+}
+
+/* event_clnt_finish - notify the application and clean up */
+
+static void event_clnt_finish(EVENT_CLNT_REQ *req, int status)
+{
+    req->done(status, req->reply, req->context);
+    event_clnt_req_free(req);
+}
+
+/* event_clnt_fail_event - deliver early failure */
+
+static void event_clnt_fail_event(int unused_event, void *context)
+{
+    EVENT_CLNT_REQ *req = (EVENT_CLNT_REQ *) context;
+
+    ring_detach(&req->ring);
+    event_clnt_finish(req, EVENT_CLNT_STAT_FAIL);
+}
+
+/* event_clnt_conn_free - disconnect and destroy connection */
+
+static void event_clnt_conn_free(EVENT_CLNT_CONN *conn)
+{
+    ring_detach(&conn->ring);
+    nbbio_free(conn->np);
+    myfree((void *) conn);
+}
+
+/* event_clnt_send - copy the next request chunk to the write buffer */
+
+static void event_clnt_send(EVENT_CLNT_CONN *conn)
+{
+    EVENT_CLNT_REQ *req = conn->req;
+    NBBIO  *np = conn->np;
+    ssize_t count;
+
+    count = LEN(req->request) - req->sent;
+    if (count > NBBIO_BUFSIZE(np))
+	count = NBBIO_BUFSIZE(np);
+    memcpy(NBBIO_WRITE_BUF(np), STR(req->request) + req->sent, count);
+    NBBIO_WRITE_PEND(np) = count;
+    req->sent += count;
+    nbbio_enable_write(np, conn->client->timeout);
+}
+
+/* event_clnt_event - I/O event handler */
+
+static void event_clnt_event(int event, void *context)
+{
+    const char *myname = "event_clnt_event";
+    EVENT_CLNT_CONN *conn = (EVENT_CLNT_CONN *) context;
+    EVENT_CLNT *client = conn->client;
+    EVENT_CLNT_REQ *req = conn->req;
+    NBBIO  *np = conn->np;
+    ssize_t count;
+    int     errflags;
+
+    nbbio_disable_readwrite(np);
+
+    /*
+     * Idle connection. The server disconnected, or it sent data that we did
+     * not ask for, or the connection has been idle for too long.
+     */
+    if (req == 0) {
+	if (msg_verbose)
+	    msg_info("%s: disconnect idle %s stream", myname, client->endpoint);
+	event_clnt_conn_free(conn);
+	return;
+    }
+
+    /*
+     * Handle I/O errors. We retry a broken cached connection only once, and
+     * only when the server has not started to reply.
+     */
+    if ((errflags = NBBIO_ERROR_FLAGS(np)) != 0) {
+	conn->req = 0;
+	event_clnt_conn_free(conn);
+	if (req->reused && req->retried == 0 && LEN(req->inbuf) == 0
+	    && (errflags & NBBIO_FLAG_TIMEOUT) == 0) {
+	    req->retried = 1;
+	    event_clnt_start(client, req);
+	    return;
+	}
+	if (errflags & NBBIO_FLAG_TIMEOUT)
+	    vstring_sprintf(req->reply, "timeout on %s", client->endpoint);
+	else if (errflags & NBBIO_FLAG_EOF)
+	    vstring_sprintf(req->reply, "lost connection with %s",
+			    client->endpoint);
+	else
+	    vstring_sprintf(req->reply, "I/O error with %s: %m",
+			    client->endpoint);
+	event_clnt_finish(req, EVENT_CLNT_STAT_FAIL);
+	return;
+    }
+
+    switch (event) {
+
+	/*
+	 * Send the remainder of the request, then wait for the reply.
+	 */
+    case EVENT_WRITE:
+	if (NBBIO_WRITE_PEND(np) > 0)
+	    nbbio_enable_write(np, client->timeout);
+	else if (req->sent < LEN(req->request))
+	    event_clnt_send(conn);
+	else
+	    nbbio_enable_read(np, client->timeout);
+	return;
+
+	/*
+	 * Collect reply data until the application says it is complete.
+	 */
+    case EVENT_READ:
+	vstring_memcat(req->inbuf, NBBIO_READ_BUF(np), NBBIO_READ_PEND(np));
+	NBBIO_READ_PEND(np) = 0;
+	if ((count = req->parse(STR(req->inbuf), LEN(req->inbuf),
+				req->reply)) == 0) {
+	    nbbio_enable_read(np, client->timeout);
+	    return;
+	}
+
+	/*
+	 * Don't reuse a connection that is out of sync, or that is too old.
+	 */
+	conn->req = 0;
+	if (count != LEN(req->inbuf) || client->max_idle <= 0
+	    || conn->expire <= event_time()) {
+	    event_clnt_conn_free(conn);
+	} else {
+	    ring_detach(&conn->ring);
+	    ring_append(&client->idle, &conn->ring);
+	    nbbio_enable_read(np, client->max_idle);
+	}
+	event_clnt_finish(req, count > 0 ?
+			  EVENT_CLNT_STAT_OK : EVENT_CLNT_STAT_FAIL);
+	return;
+
+    default:
+	msg_panic("%s: unexpected event %d", myname, event);
+    }
+}
+
+/* event_clnt_start - send request over cached or new connection */
+
+static void event_clnt_start(EVENT_CLNT *client, EVENT_CLNT_REQ *req)
+{
+    const char *myname = "event_clnt_start";
+    EVENT_CLNT_CONN *conn = 0;
+    RING   *ring;
+    int     fd;
+
+    /*
+     * Use the most recently used connection that has not expired.
+     */
+    while ((ring = ring_pred(&client->idle)) != &client->idle) {
+	conn = RING_TO_APPL(ring, EVENT_CLNT_CONN, ring);
+	if (conn->expire > event_time())
+	    break;
+	event_clnt_conn_free(conn);
+	conn = 0;
+    }
+    if (conn != 0) {
+	nbbio_disable_readwrite(conn->np);
+	ring_detach(&conn->ring);
+	req->reused = 1;
+    }
+
+    /*
+     * Start a non-blocking connection. The first write event fires when the
+     * connection is complete; a failed connection is reported as a write
+     * error.
+     */
+    else {
+	if ((fd = client->connect(client->endpoint, NON_BLOCKING, 0)) < 0) {
+	    vstring_sprintf(req->reply, "connect to %s: %m", client->endpoint);
+	    ring_append(&client->failed, &req->ring);
+	    event_request_timer(event_clnt_fail_event, (void *) req, 0);
+	    return;
+	}
+	if (msg_verbose)
+	    msg_info("%s: connecting to %s", myname, client->endpoint);
+	close_on_exec(fd, CLOSE_ON_EXEC);
+	conn = (EVENT_CLNT_CONN *) mymalloc(sizeof(*conn));
+	conn->client = client;
+	conn->np = nbbio_create(fd, EVENT_CLNT_BUFSIZE, client->endpoint,
+				event_clnt_event, (void *) conn);
+	conn->expire = event_time() + client->max_ttl;
+	req->reused = 0;
+    }
+    ring_append(&client->busy, &conn->ring);
+    conn->req = req;
+    req->sent = 0;
+    VSTRING_RESET(req->inbuf);
+    event_clnt_send(conn);
+}
+
+/* event_clnt_request - send request, receive reply later */
+
+void    event_clnt_request(EVENT_CLNT *client, VSTRING *request,
+			           EVENT_CLNT_PARSE_FN parse,
+			           EVENT_CLNT_DONE_FN done, void *context)
+{
+    EVENT_CLNT_REQ *req;
+
+    req = (EVENT_CLNT_REQ *) mymalloc(sizeof(*req));
+    req->request = vstring_alloc(LEN(request));
+    vstring_memcpy(req->request, STR(request), LEN(request));
+    req->inbuf = vstring_alloc(100);
+    req->reply = vstring_alloc(100);
+    req->parse = parse;
+    req->done = done;
+    req->context = context;
+    req->retried = 0;
+    event_clnt_start(client, req);
+}
+
+/* event_clnt_create - create client endpoint */
+
+EVENT_CLNT *event_clnt_create(const char *service, int timeout,
+			              int max_idle, int max_ttl)
+{
+    const char *myname = "event_clnt_create";
+    char   *transport = mystrdup(service);
+    char   *endpoint;
+    EVENT_CLNT *client;
+
+    if (timeout <= 0)
+	msg_panic("%s: bad timeout %d", myname, timeout);
+    if ((endpoint = split_at(transport, ':')) == 0
+	|| *endpoint == 0 || *transport == 0)
+	msg_fatal("need service transport:endpoint instead of \"%s\"", service);
+    if (msg_verbose)
+	msg_info("%s: transport=%s endpoint=%s", myname, transport, endpoint);
+    client = (EVENT_CLNT *) mymalloc(sizeof(*client));
+    client->endpoint = mystrdup(endpoint);
+    client->timeout = timeout;
+    client->max_idle = max_idle;
+    client->max_ttl = max_ttl;
+    if (strcmp(transport, "inet") == 0) {
+	client->connect = inet_connect;
+    } else if (strcmp(transport, "local") == 0) {
+	client->connect = LOCAL_CONNECT;
+    } else if (strcmp(transport, "unix") == 0) {
+	client->connect = unix_connect;
+    } else {
+	msg_fatal("invalid transport name: %s in service: %s",
+		  transport, service);
+    }
+    ring_init(&client->idle);
+    ring_init(&client->busy);
+    ring_init(&client->failed);
+    myfree(transport);
+    return (client);
+}
+
+/* event_clnt_free - destroy client endpoint */
+
+void    event_clnt_free(EVENT_CLNT *client)
+{
+    EVENT_CLNT_CONN *conn;
+    EVENT_CLNT_REQ *req;
+    RING   *ring;
+
+    while ((ring = ring_succ(&client->idle)) != &client->idle)
+	event_clnt_conn_free(RING_TO_APPL(ring, EVENT_CLNT_CONN, ring));
+    while ((ring = ring_succ(&client->busy)) != &client->busy) {
+	conn = RING_TO_APPL(ring, EVENT_CLNT_CONN, ring);
+	event_clnt_req_free(conn->req);
+	event_clnt_conn_free(conn);
+    }
+    while ((ring = ring_succ(&client->failed)) != &client->failed) {
+	req = RING_TO_APPL(ring, EVENT_CLNT_REQ, ring);
+	event_cancel_timer(event_clnt_fail_event, (void *) req);
+	ring_detach(ring);
+	event_clnt_req_free(req);
+    }
+    myfree(client->endpoint);
+    myfree((void *) client);
+}
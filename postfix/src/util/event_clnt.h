@@ -0,0 +1,40 @@
+#ifndef _EVENT_CLNT_H_INCLUDED_
+#define _EVENT_CLNT_H_INCLUDED_
+
+/*++
+/* NAME
+/*	event_clnt 3h
+/* SUMMARY
+/*	event-driven request/reply client endpoint
+/* SYNOPSIS
+/*	#include <event_clnt.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * Utility library.
+  */
+#include <vstring.h>
+
+ /*
+  * External interface.
+  */
+typedef struct EVENT_CLNT EVENT_CLNT;
+typedef ssize_t (*EVENT_CLNT_PARSE_FN) (const char *, ssize_t, VSTRING *);
+typedef void (*EVENT_CLNT_DONE_FN) (int, VSTRING *, void *);
+
+extern EVENT_CLNT *event_clnt_create(const char *, int, int, int);
+extern void event_clnt_request(EVENT_CLNT *, VSTRING *, EVENT_CLNT_PARSE_FN,
+			               EVENT_CLNT_DONE_FN, void *);
+extern void event_clnt_free(EVENT_CLNT *);
+
+#define EVENT_CLNT_STAT_OK	0	/* complete reply */
+#define EVENT_CLNT_STAT_FAIL	(-1)	/* no or malformed reply */
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+#endif
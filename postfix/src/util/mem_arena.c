@@ -0,0 +1,365 @@
+/*++
+/* NAME
+/*	mem_arena 3
+/* SUMMARY
+/*	bump allocator for short-lived objects
+/* SYNOPSIS
+/*	#include <mem_arena.h>
+/*
+/*	MEM_ARENA *mem_arena_create(name, chunk_size)
+/*	const char *name;
+/*	ssize_t	chunk_size;
+/*
+/*	void	*mem_arena_alloc(arena, len)
+/*	MEM_ARENA *arena;
+/*	ssize_t	len;
+/*
+/*	char	*mem_arena_strdup(arena, str)
+/*	MEM_ARENA *arena;
+/*	const char *str;
+/*
+/*	char	*mem_arena_strndup(arena, str, len)
+/*	MEM_ARENA *arena;
+/*	const char *str;
+/*	ssize_t	len;
+/*
+/*	char	*mem_arena_memdup(arena, ptr, len)
+/*	MEM_ARENA *arena;
+/*	const void *ptr;
+/*	ssize_t	len;
+/*
+/*	void	mem_arena_reset(arena)
+/*	MEM_ARENA *arena;
+/*
+/*	void	mem_arena_free(arena)
+/*	MEM_ARENA *arena;
+/*
+/*	void	mem_arena_log_stats(arena)
+/*	MEM_ARENA *arena;
+/* DESCRIPTION
+/*	This module manages memory for objects that have the same
+/*	lifetime, such as the objects that are created while
+/*	processing one message or one SMTP session. Objects are
+/*	carved out of large chunks that are obtained with mymalloc(),
+/*	and are released all at once. There is no way to release
+/*	an individual object, and objects cannot be resized.
+/*
+/*	mem_arena_create() creates an empty arena. The \fIname\fR
+/*	is used for diagnostics. Specify a \fIchunk_size\fR of zero
+/*	to use MEM_ARENA_DEF_CHUNK_SIZE.
+/*
+/*	mem_arena_alloc() returns \fIlen\fR bytes of memory that
+/*	are suitably aligned for any type. The memory is not set
+/*	to zero. Requests larger than half the chunk size are given
+/*	their own chunk.
+/*
+/*	mem_arena_strdup(), mem_arena_strndup() and mem_arena_memdup()
+/*	are the arena counterparts of mystrdup(), mystrndup() and
+/*	mymemdup(). The result has no special alignment.
+/*
+/*	mem_arena_reset() makes all objects in the arena available
+/*	for re-use. It keeps one chunk so that the next round of
+/*	allocations does not have to call mymalloc().
+/*
+/*	mem_arena_free() destroys an arena and all objects in it.
+/*
+/*	mem_arena_log_stats() logs the number of objects and bytes
+/*	allocated, the number of chunks obtained with mymalloc(),
+/*	the number of resets, and the peak memory footprint.
+/* DIAGNOSTICS
+/*	Problems are reported via the msg(3) diagnostics routines:
+/*	the requested amount of memory is not available; improper use
+/*	is detected; other fatal errors.
+/* SEE ALSO
+/*	mymalloc(3) memory management wrappers
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+/* System library. */
+
+#include <sys_defs.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Utility library. */
+
+#include <msg.h>
+#include <mymalloc.h>
+#include <mem_arena.h>
+
+ /*
+  * A chunk is one mymalloc() result. The payload has the same alignment as
+  * mymalloc() results.
+  */
+struct MEM_ARENA_CHUNK {
+    MEM_ARENA_CHUNK *next;		/* older chunk */
+    ssize_t size;			/* payload size */
+    union {
+	ALIGN_TYPE align;
+	char    payload[1];		/* actually a bunch of bytes */
+    }       u;
+};
+
+#define SPACE_FOR(len)	(offsetof(MEM_ARENA_CHUNK, u.payload[0]) + (len))
+#define ALIGN_TO(n)	(((n) + sizeof(ALIGN_TYPE) - 1) & ~(sizeof(ALIGN_TYPE) - 1))
+
+#define FILLER		0xff
+
+/* mem_arena_chunk - allocate and link a new chunk */
+
+static MEM_ARENA_CHUNK *mem_arena_chunk(MEM_ARENA *ap, ssize_t size)
+{
+    MEM_ARENA_CHUNK *cp;
+
+    cp = (MEM_ARENA_CHUNK *) mymalloc(SPACE_FOR(size));
+    cp->size = size;
+    ap->chunk_count += 1;
+    ap->curr_bytes += size;
+    if (ap->curr_bytes > ap->peak_bytes)
+	ap->peak_bytes = ap->curr_bytes;
+    return (cp);
+}
+
+/* mem_arena_space - find room for len bytes */
+
+static char *mem_arena_space(MEM_ARENA *ap, ssize_t len, ssize_t align)
+{
+    MEM_ARENA_CHUNK *cp;
+    ssize_t pad;
+    char   *ptr;
+
+    if (len < 1)
+	msg_panic("mem_arena_space: %s: requested length %ld",
+		  ap->name, (long) len);
+    ap->alloc_count += 1;
+    ap->alloc_bytes += len;
+
+    /*
+     * Large request. Give it a private chunk, and link that chunk behind
+     * the current one so that we can continue to use the free space there.
+     */
+    if (len > ap->chunk_size / 2) {
+	cp = mem_arena_chunk(ap, len);
+	if (ap->chunks == 0) {
+	    cp->next = 0;
+	    ap->chunks = cp;
+	    ap->ptr = cp->u.payload + len;
+	    ap->left = 0;
+	} else {
+	    cp->next = ap->chunks->next;
+	    ap->chunks->next = cp;
+	}
+	return (cp->u.payload);
+    }
+
+    /*
+     * Small request. Start a new chunk when the current one is full.
+     */
+    pad = (align > 1 && ap->chunks != 0) ?
+	ALIGN_TO(ap->ptr - ap->chunks->u.payload)
+	- (ap->ptr - ap->chunks->u.payload) : 0;
+    if (ap->chunks == 0 || ap->left < pad + len) {
+	cp = mem_arena_chunk(ap, ap->chunk_size);
+	cp->next = ap->chunks;
+	ap->chunks = cp;
+	ap->ptr = cp->u.payload;
+	ap->left = cp->size;
+	pad = 0;
+    }
+    ptr = ap->ptr + pad;
+    ap->ptr = ptr + len;
+    ap->left -= pad + len;
+    return (ptr);
+}
+
+/* mem_arena_create - create empty arena */
+
+MEM_ARENA *mem_arena_create(const char *name, ssize_t chunk_size)
+{
+    MEM_ARENA *ap;
+
+    if (chunk_size < 0)
+	msg_panic("mem_arena_create: %s: bad chunk size %ld",
+		  name, (long) chunk_size);
+    ap = (MEM_ARENA *) mymalloc(sizeof(*ap));
+    ap->name = mystrdup(name);
+    ap->chunk_size = (chunk_size > 0 ? ALIGN_TO(chunk_size) :
+		      MEM_ARENA_DEF_CHUNK_SIZE);
+    ap->chunks = 0;
+    ap->ptr = 0;
+    ap->left = 0;
+    ap->alloc_count = 0;
+    ap->alloc_bytes = 0;
+    ap->chunk_count = 0;
+    ap->reset_count = 0;
+    ap->peak_bytes = 0;
+    ap->curr_bytes = 0;
+    return (ap);
+}
+
+/* mem_arena_alloc - allocate aligned memory */
+
+void   *mem_arena_alloc(MEM_ARENA *ap, ssize_t len)
+{
+    return ((void *) mem_arena_space(ap, len, sizeof(ALIGN_TYPE)));
+}
+
+/* mem_arena_memdup - copy memory */
+
+char   *mem_arena_memdup(MEM_ARENA *ap, const void *ptr, ssize_t len)
+{
+    if (ptr == 0)
+	msg_panic("mem_arena_memdup: null pointer argument");
+    return (memcpy(mem_arena_space(ap, len, 1), ptr, len));
+}
+
+/* mem_arena_strndup - copy substring */
+
+char   *mem_arena_strndup(MEM_ARENA *ap, const char *str, ssize_t len)
+{
+    char   *result;
+    char   *cp;
+
+    if (str == 0)
+	msg_panic("mem_arena_strndup: null pointer argument");
+    if (len < 0)
+	msg_panic("mem_arena_strndup: requested length %ld", (long) len);
+    if ((cp = memchr(str, 0, len)) != 0)
+	len = cp - str;
+    result = memcpy(mem_arena_space(ap, len + 1, 1), str, len);
+    result[len] = 0;
+    return (result);
+}
+
+/* mem_arena_strdup - copy string */
+
+char   *mem_arena_strdup(MEM_ARENA *ap, const char *str)
+{
+    if (str == 0)
+	msg_panic("mem_arena_strdup: null pointer argument");
+    return (mem_arena_memdup(ap, str, strlen(str) + 1));
+}
+
+/* mem_arena_reset - release all objects, keep one chunk */
+
+void    mem_arena_reset(MEM_ARENA *ap)
+{
+    MEM_ARENA_CHUNK *cp;
+    MEM_ARENA_CHUNK *next;
+    MEM_ARENA_CHUNK *keep = 0;
+
+    /*
+     * Keep one regular-size chunk, and overwrite its content so that access
+     * to released objects is more likely to be noticed.
+     */
+    for (cp = ap->chunks; cp != 0; cp = next) {
+	next = cp->next;
+	if (keep == 0 && cp->size == ap->chunk_size) {
+	    keep = cp;
+	} else {
+	    ap->curr_bytes -= cp->size;
+	    myfree((void *) cp);
+	}
+    }
+    if ((ap->chunks = keep) != 0) {
+	keep->next = 0;
+	ap->ptr = keep->u.payload;
+	ap->left = keep->size;
+	memset(ap->ptr, FILLER, ap->left);
+    } else {
+	ap->ptr = 0;
+	ap->left = 0;
+    }
+    ap->reset_count += 1;
+}
+
+/* mem_arena_free - destroy arena */
+
+void    mem_arena_free(MEM_ARENA *ap)
+{
+    MEM_ARENA_CHUNK *cp;
+    MEM_ARENA_CHUNK *next;
+
+    for (cp = ap->chunks; cp != 0; cp = next) {
+	next = cp->next;
+	myfree((void *) cp);
+    }
+    myfree(ap->name);
+    myfree((void *) ap);
+}
+
+/* mem_arena_log_stats - report allocation statistics */
+
+void    mem_arena_log_stats(MEM_ARENA *ap)
+{
+    msg_info("%s: arena allocs=%ld bytes=%ld chunks=%ld resets=%ld peak=%ld",
+	     ap->name, ap->alloc_count, ap->alloc_bytes, ap->chunk_count,
+	     ap->reset_count, (long) ap->peak_bytes);
+}
+
+#ifdef TEST
+#include <assert.h>
+
+int     main(int argc, char **argv)
+{
+    MEM_ARENA *ap;
+    char   *s1;
+    char   *s2;
+    char   *big;
+    void   *p;
+    int     n;
+
+    msg_verbose = (argc > 1);
+    ap = mem_arena_create("test", 256);
+
+    /* Strings are copied, and do not overlap. */
+    s1 = mem_arena_strdup(ap, "foo");
+    s2 = mem_arena_strndup(ap, "barbaz", 3);
+    assert(strcmp(s1, "foo") == 0);
+    assert(strcmp(s2, "bar") == 0);
+    assert(s2 >= s1 + 4);
+    assert(*mem_arena_strdup(ap, "") == 0);
+
+    /* Aligned requests are aligned. */
+    for (n = 1; n < 100; n++) {
+	p = mem_arena_alloc(ap, n);
+	assert(((size_t) p % sizeof(ALIGN_TYPE)) == 0);
+	memset(p, 0, n);
+    }
+    assert(ap->chunk_count > 1);
+
+    /* Large requests get their own chunk, and don't waste the current one. */
+    s1 = mem_arena_strdup(ap, "x");
+    big = mem_arena_alloc(ap, 1000);
+    memset(big, 0, 1000);
+    s2 = mem_arena_strdup(ap, "y");
+    assert(s2 == s1 + 2);
+
+    /* Reset keeps one chunk. */
+    mem_arena_reset(ap);
+    assert(ap->chunks != 0 && ap->chunks->next == 0);
+    assert(ap->curr_bytes == ap->chunk_size);
+    n = ap->chunk_count;
+    s1 = mem_arena_strdup(ap, "after reset");
+    assert(strcmp(s1, "after reset") == 0);
+    assert(ap->chunk_count == n);
+
+    /* A large request in an empty arena. */
+    mem_arena_free(ap);
+    ap = mem_arena_create("test", 0);
+    big = mem_arena_alloc(ap, 100000);
+    memset(big, 0, 100000);
+    s1 = mem_arena_strdup(ap, "small");
+    assert(strcmp(s1, "small") == 0);
+    mem_arena_reset(ap);
+    assert(ap->curr_bytes == ap->chunk_size);
+    if (msg_verbose)
+	mem_arena_log_stats(ap);
+    mem_arena_free(ap);
+    return (0);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _MEM_ARENA_H_INCLUDED_
+#define _MEM_ARENA_H_INCLUDED_
+
+/*++
+/* NAME
+/*	mem_arena 3h
+/* SUMMARY
+/*	bump allocator for short-lived objects
+/* SYNOPSIS
+/*	#include <mem_arena.h>
+/* DESCRIPTION
+/* .nf
+
+ /*
+  * External interface. The statistics are public so that an application can
+  * decide when to report them, but they must be treated as read-only.
+  */
+typedef struct MEM_ARENA_CHUNK MEM_ARENA_CHUNK;
+
+typedef struct MEM_ARENA {
+    char   *name;			/* for diagnostics */
+    ssize_t chunk_size;			/* default chunk payload size */
+    MEM_ARENA_CHUNK *chunks;		/* newest chunk first */
+    char   *ptr;			/* next free byte in newest chunk */
+    ssize_t left;			/* free bytes in newest chunk */
+    /* Statistics, since arena creation. */
+    long    alloc_count;		/* objects allocated */
+    long    alloc_bytes;		/* bytes requested */
+    long    chunk_count;		/* chunks obtained from mymalloc() */
+    long    reset_count;		/* mem_arena_reset() calls */
+    ssize_t peak_bytes;			/* largest footprint before reset */
+    ssize_t curr_bytes;			/* current chunk footprint */
+} MEM_ARENA;
+
+extern MEM_ARENA *mem_arena_create(const char *, ssize_t);
+extern void *mem_arena_alloc(MEM_ARENA *, ssize_t);
+extern char *mem_arena_strdup(MEM_ARENA *, const char *);
+extern char *mem_arena_strndup(MEM_ARENA *, const char *, ssize_t);
+extern char *mem_arena_memdup(MEM_ARENA *, const void *, ssize_t);
+extern void mem_arena_reset(MEM_ARENA *);
+extern void mem_arena_free(MEM_ARENA *);
+extern void mem_arena_log_stats(MEM_ARENA *);
+
+#define MEM_ARENA_DEF_CHUNK_SIZE	8192
+
+/* LICENSE
+/* .ad
+/* .fi
+/*	The Secure Mailer license must be distributed with this software.
+/*--*/
+
+#endif
@@ -82,120 +82,216 @@
 #define VSTRING_GET_RESULT(vp) \
     (VSTRING_LEN(vp) > 0 ? vstring_end(vp)[-1] : VSTREAM_EOF)
 
-/* vstring_get - read line from file, keep newline */
+/* vstring_get_delim_bound - read up to delimiter, up to bound */
 
-int     vstring_get(VSTRING *vp, VSTREAM *fp)
+static int vstring_get_delim_bound(VSTRING *vp, VSTREAM *fp, int delim,
+				           ssize_t bound, int strip)
 {
+    const char *data;
+    const char *cp;
+    ssize_t avail;
+    ssize_t len;
+    int     found = 0;
     int     c;
 
+    /*
+     * Find the delimiter in buffered input with memchr(), and copy the data
+     * in one operation, instead of one character at a time. vstream_fread()
+     * makes no system call when the data is already buffered. When the
+     * buffer is empty, VSTREAM_GETC() refills it, so that the stream's own
+     * timeout, deadline and exception handling still apply.
+     */
     VSTRING_RESET(vp);
-    while ((c = VSTREAM_GETC(fp)) != VSTREAM_EOF) {
-	VSTRING_ADDCH(vp, c);
-	if (c == '\n')
-	    break;
+    while (bound > 0) {
+	if ((avail = vstream_peek(fp)) > 0) {
+	    data = vstream_peek_data(fp);
+	    if (avail > bound)
+		avail = bound;
+	    if ((cp = memchr(data, delim, avail)) != 0) {
+		avail = cp - data + 1;
+		found = 1;
+	    }
+	    len = VSTRING_LEN(vp);
+	    VSTRING_SPACE(vp, avail);
+	    if (vstream_fread(fp, vstring_str(vp) + len, avail) != avail)
+		msg_panic("vstring_get_delim_bound: short read from buffer");
+	    VSTRING_AT_OFFSET(vp, len + avail);
+	    if (found)
+		break;
+	    bound -= avail;
+	} else {
+	    if ((c = VSTREAM_GETC(fp)) == VSTREAM_EOF)
+		break;
+	    VSTRING_ADDCH(vp, c);
+	    if (c == delim) {
+		found = 1;
+		break;
+	    }
+	    bound -= 1;
+	}
+    }
+    if (found && strip) {
+	len = VSTRING_LEN(vp) - 1;
+	VSTRING_AT_OFFSET(vp, len);
     }
     VSTRING_TERMINATE(vp);
-    return (VSTRING_GET_RESULT(vp));
+    return (found && strip ? delim : VSTRING_GET_RESULT(vp));
+}
+
+/* vstring_get - read line from file, keep newline */
+
+int     vstring_get(VSTRING *vp, VSTREAM *fp)
+{
+    return (vstring_get_delim_bound(vp, fp, '\n', SSIZE_T_MAX, 0));
 }
 
 /* vstring_get_nonl - read line from file, strip newline */
 
 int     vstring_get_nonl(VSTRING *vp, VSTREAM *fp)
 {
-    int     c;
-
-    VSTRING_RESET(vp);
-    while ((c = VSTREAM_GETC(fp)) != VSTREAM_EOF && c != '\n')
-	VSTRING_ADDCH(vp, c);
-    VSTRING_TERMINATE(vp);
-    return (c == '\n' ? c : VSTRING_GET_RESULT(vp));
+    return (vstring_get_delim_bound(vp, fp, '\n', SSIZE_T_MAX, 1));
 }
 
 /* vstring_get_null - read null-terminated string from file */
 
 int     vstring_get_null(VSTRING *vp, VSTREAM *fp)
 {
-    int     c;
-
-    VSTRING_RESET(vp);
-    while ((c = VSTREAM_GETC(fp)) != VSTREAM_EOF && c != 0)
-	VSTRING_ADDCH(vp, c);
-    VSTRING_TERMINATE(vp);
-    return (c == 0 ? c : VSTRING_GET_RESULT(vp));
+    return (vstring_get_delim_bound(vp, fp, 0, SSIZE_T_MAX, 1));
 }
 
 /* vstring_get_bound - read line from file, keep newline, up to bound */
 
 int     vstring_get_bound(VSTRING *vp, VSTREAM *fp, ssize_t bound)
 {
-    int     c;
-
     if (bound <= 0)
 	msg_panic("vstring_get_bound: invalid bound %ld", (long) bound);
 
-    VSTRING_RESET(vp);
-    while (bound-- > 0 && (c = VSTREAM_GETC(fp)) != VSTREAM_EOF) {
-	VSTRING_ADDCH(vp, c);
-	if (c == '\n')
-	    break;
-    }
-    VSTRING_TERMINATE(vp);
-    return (VSTRING_GET_RESULT(vp));
+    return (vstring_get_delim_bound(vp, fp, '\n', bound, 0));
 }
 
 /* vstring_get_nonl_bound - read line from file, strip newline, up to bound */
 
 int     vstring_get_nonl_bound(VSTRING *vp, VSTREAM *fp, ssize_t bound)
 {
-    int     c;
-
     if (bound <= 0)
 	msg_panic("vstring_get_nonl_bound: invalid bound %ld", (long) bound);
 
-    VSTRING_RESET(vp);
-    while (bound-- > 0 && (c = VSTREAM_GETC(fp)) != VSTREAM_EOF && c != '\n')
-	VSTRING_ADDCH(vp, c);
-    VSTRING_TERMINATE(vp);
-    return (c == '\n' ? c : VSTRING_GET_RESULT(vp));
+    return (vstring_get_delim_bound(vp, fp, '\n', bound, 1));
 }
 
 /* vstring_get_null_bound - read null-terminated string from file */
 
 int     vstring_get_null_bound(VSTRING *vp, VSTREAM *fp, ssize_t bound)
 {
-    int     c;
-
     if (bound <= 0)
 	msg_panic("vstring_get_null_bound: invalid bound %ld", (long) bound);
 
-    VSTRING_RESET(vp);
-    while (bound-- > 0 && (c = VSTREAM_GETC(fp)) != VSTREAM_EOF && c != 0)
-	VSTRING_ADDCH(vp, c);
-    VSTRING_TERMINATE(vp);
-    return (c == 0 ? c : VSTRING_GET_RESULT(vp));
+    return (vstring_get_delim_bound(vp, fp, 0, bound, 1));
 }
 
 #ifdef TEST
 
  /*
-  * Proof-of-concept test program: copy the source to this module to stdout.
+  * Test program: each input line has the form "function bound bufsize
+  * text". The function name is one of the vstring_get*() functions without
+  * the vstring_ prefix; bound is ignored by the unbounded functions;
+  * bufsize is the stream buffer size (0 for the default), so that input
+  * can be split across buffer refills; text is the stream content, with
+  * C-like escape sequences. The test calls the function until it returns
+  * VSTREAM_EOF, and prints the result and the string after each call.
   */
+#include <stdlib.h>
+#include <unistd.h>
 #include <fcntl.h>
-
-#define TEXT_VSTREAM    "vstring_vstream.c"
-
-int     main(void)
+#include <msg_vstream.h>
+#include <stringops.h>
+
+typedef struct {
+    const char *name;
+    int     (*get) (VSTRING *, VSTREAM *);
+    int     (*get_bound) (VSTRING *, VSTREAM *, ssize_t);
+} TEST_CASE;
+
+static const TEST_CASE test_cases[] = {
+    "get", vstring_get, 0,
+    "get_nonl", vstring_get_nonl, 0,
+    "get_null", vstring_get_null, 0,
+    "get_bound", 0, vstring_get_bound,
+    "get_nonl_bound", 0, vstring_get_nonl_bound,
+    "get_null_bound", 0, vstring_get_null_bound,
+    0,
+};
+
+int     main(int argc, char **argv)
 {
-    VSTRING *vp = vstring_alloc(1);
+    VSTRING *inbuf = vstring_alloc(100);
+    VSTRING *text = vstring_alloc(100);
+    VSTRING *result = vstring_alloc(1);
+    VSTRING *quoted = vstring_alloc(100);
+    const TEST_CASE *tp;
     VSTREAM *fp;
-
-    if ((fp = vstream_fopen(TEXT_VSTREAM, O_RDONLY, 0)) == 0)
-	msg_fatal("open %s: %m", TEXT_VSTREAM);
-    while (vstring_fgets(vp, fp))
-	vstream_fprintf(VSTREAM_OUT, "%s", vstring_str(vp));
-    vstream_fclose(fp);
-    vstream_fflush(VSTREAM_OUT);
-    vstring_free(vp);
+    char   *bp;
+    char   *name;
+    char   *bound;
+    char   *bufsize;
+    char    ch;
+    int     fds[2];
+    int     ret;
+
+    msg_vstream_init(argv[0], VSTREAM_ERR);
+    while (vstring_fgets_nonl(inbuf, VSTREAM_IN)) {
+	vstream_printf("> %s\n", vstring_str(inbuf));
+	bp = vstring_str(inbuf);
+	if ((name = mystrtok(&bp, " ")) == 0 || *name == '#')
+	    continue;
+	if ((bound = mystrtok(&bp, " ")) == 0
+	    || (bufsize = mystrtok(&bp, " ")) == 0) {
+	    msg_warn("need function bound bufsize [text]");
+	    continue;
+	}
+	for (tp = test_cases; tp->name != 0; tp++)
+	    if (strcmp(tp->name, name) == 0)
+		break;
+	if (tp->name == 0) {
+	    msg_warn("unknown function: %s", name);
+	    continue;
+	}
+	unescape(text, bp ? bp : "");
+
+	/*
+	 * The text must fit in the pipe buffer.
+	 */
+	if (pipe(fds) < 0)
+	    msg_fatal("pipe: %m");
+	if (write(fds[1], vstring_str(text), VSTRING_LEN(text))
+	    != VSTRING_LEN(text))
+	    msg_fatal("write: %m");
+	(void) close(fds[1]);
+	fp = vstream_fdopen(fds[0], O_RDONLY);
+	if (atoi(bufsize) > 0)
+	    vstream_control(fp,
+			    CA_VSTREAM_CTL_BUFSIZE((ssize_t) atoi(bufsize)),
+			    CA_VSTREAM_CTL_END);
+	do {
+	    ret = tp->get ? tp->get(result, fp) :
+		tp->get_bound(result, fp, (ssize_t) atoi(bound));
+	    escape(quoted, vstring_str(result), VSTRING_LEN(result));
+	    if (ret == VSTREAM_EOF) {
+		vstream_printf("EOF \"%s\"\n", vstring_str(quoted));
+	    } else {
+		ch = ret;
+		vstream_printf("'%s' \"%s\"\n",
+			       vstring_str(escape(text, &ch, 1)),
+			       vstring_str(quoted));
+	    }
+	} while (ret != VSTREAM_EOF);
+	(void) vstream_fclose(fp);
+	vstream_fflush(VSTREAM_OUT);
+    }
+    vstring_free(inbuf);
+    vstring_free(text);
+    vstring_free(result);
+    vstring_free(quoted);
     return (0);
 }
 